@@ -0,0 +1,85 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+#define ARENA_ALIGN         16
+#define ARENA_MIN_BLOCK     4096
+
+struct arena_block {
+    struct arena_block *next;
+    size_t capacity;
+    size_t used;
+    size_t pad;                 // Keeps data[] 16-byte aligned
+    unsigned char data[];
+};
+
+static struct arena_block *new_block(size_t capacity) {
+    struct arena_block *block = malloc(sizeof(*block) + capacity);
+    if (block) {
+        block->next = NULL;
+        block->capacity = capacity;
+        block->used = 0;
+    }
+    return block;
+}
+
+void arena_init(struct arena *arena) {
+    arena->head = NULL;
+    arena->capacity = 0;
+}
+
+void *arena_alloc(struct arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size == 0) {
+        size = ARENA_ALIGN;
+    }
+
+    struct arena_block *block = arena->head;
+    if (!block || block->capacity - block->used < size) {
+        // Grow geometrically so a session needs few blocks
+        size_t capacity = arena->capacity > ARENA_MIN_BLOCK ? arena->capacity : ARENA_MIN_BLOCK;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        block = new_block(capacity);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->head;
+        arena->head = block;
+        arena->capacity += capacity;
+    }
+
+    void *p = block->data + block->used;
+    block->used += size;
+    return p;
+}
+
+void arena_reset(struct arena *arena) {
+    struct arena_block *block = arena->head;
+    if (!block) {
+        return;
+    }
+
+    if (block->next) {
+        // Replace the chain with a single block that fits the whole session
+        size_t capacity = arena->capacity;
+        arena_free(arena);
+        arena->head = new_block(capacity);
+        arena->capacity = arena->head ? capacity : 0;
+        return;
+    }
+
+    block->used = 0;
+}
+
+void arena_free(struct arena *arena) {
+    struct arena_block *block = arena->head;
+    while (block) {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->capacity = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for per-session buffers. Allocations stay valid until the
+ * next arena_reset(). Reset keeps the memory: if a session needed more than
+ * one block, the blocks are merged into one block of the combined size, so
+ * the next session of the same shape does not allocate at all.
+ */
+
+struct arena_block;
+
+struct arena {
+    struct arena_block *head;   // Block currently allocated from
+    size_t capacity;            // Sum of all block capacities
+};
+
+void arena_init(struct arena *arena);
+void *arena_alloc(struct arena *arena, size_t size);    // NULL if out of memory
+void arena_reset(struct arena *arena);
+void arena_free(struct arena *arena);
+
+#endif
@@ -0,0 +1,385 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "report.h"
+#include "report_buffer.h"
+#include "usb_descriptors.h"
+#include "usb_engine.h"
+
+#define BATCH_CHUNK     16      // Files a worker takes from its own range at a time
+
+static const char * const blob_kind_names[BLOB_KIND_COUNT] = {
+    [BLOB_UNREADABLE]       = "unreadable",
+    [BLOB_UNRECOGNIZED]     = "unrecognized",
+    [BLOB_BOS]              = "BOS",
+    [BLOB_MSOS20]           = "MS OS 2.0",
+    [BLOB_WEBUSB_URL]       = "WebUSB URL",
+    [BLOB_FFS_DESCRIPTORS]  = "FunctionFS descriptors",
+    [BLOB_FFS_STRINGS]      = "FunctionFS strings",
+};
+
+struct batch_result {
+    int kind;                   // enum blob_kind
+    int length;
+    int errors;
+    int warnings;
+    char *findings;             // Rendered findings, NULL if there are none
+};
+
+struct batch_worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int begin;                  // Remaining range [begin, end), protected by lock
+    int end;
+
+    struct batch *batch;
+    int index;
+
+    // Parser views are large, each worker reuses its own
+    struct bos_view bos_view;
+    struct msos20_view msos20_view;
+    struct webusb_url_view url_view;
+    struct ffs_view ffs_view;
+    struct ffs_strings_view ffs_strings_view;
+};
+
+struct batch {
+    const struct file_list *files;
+    struct batch_result *results;
+    struct batch_worker *workers;
+    int worker_count;
+};
+
+static int add_path(struct file_list *list, const char *path) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 256;
+        char **paths = realloc(list->paths, capacity * sizeof(*paths));
+        if (!paths) {
+            return -1;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count] = strdup(path);
+    return list->paths[list->count++] ? 0 : -1;
+}
+
+int file_list_collect(struct file_list *list, const char *path) {
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        printf(COLOR_RED "ERROR: Cannot access '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return S_ISREG(st.st_mode) ? add_path(list, path) : 0;
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        printf(COLOR_RED "ERROR: Cannot open directory '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+
+    int result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        size_t length = strlen(path) + strlen(entry->d_name) + 2;
+        char *child = malloc(length);
+        if (!child) {
+            result = -1;
+            break;
+        }
+        snprintf(child, length, "%s/%s", path, entry->d_name);
+        result = file_list_collect(list, child);
+        free(child);
+    }
+    closedir(dir);
+    return result;
+}
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+void file_list_sort(struct file_list *list) {
+    qsort(list->paths, list->count, sizeof(*list->paths), compare_strings);
+}
+
+void file_list_free(struct file_list *list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+    memset(list, 0, sizeof(*list));
+}
+
+// Truncated headers are still recognized so the parser can report them
+enum blob_kind blob_classify(const uint8_t *data, int length) {
+    if (length >= 2 && data[0] == USB_DT_BOS_SIZE && data[1] == USB_DT_BOS) {
+        return BLOB_BOS;
+    }
+    if (length >= 4 && get_le16(&data[0]) == 10 && get_le16(&data[2]) == MS_OS_20_SET_HEADER_DESCRIPTOR) {
+        return BLOB_MSOS20;
+    }
+    // String descriptors share bDescriptorType 3: only a known bScheme makes it a URL descriptor
+    if (length >= 3 && data[0] >= 3 && data[1] == WEBUSB_URL_DESCRIPTOR_TYPE &&
+        (data[2] == WEBUSB_URL_SCHEME_HTTP || data[2] == WEBUSB_URL_SCHEME_HTTPS ||
+         data[2] == WEBUSB_URL_SCHEME_NONE)) {
+        return BLOB_WEBUSB_URL;
+    }
+    if (length >= 4 && data[1] == 0 && data[2] == 0 && data[3] == 0) {
+        if (data[0] == FFS_DESCRIPTORS_MAGIC || data[0] == FFS_DESCRIPTORS_MAGIC_V2) {
+            return BLOB_FFS_DESCRIPTORS;
+        }
+        if (data[0] == FFS_STRINGS_MAGIC) {
+            return BLOB_FFS_STRINGS;
+        }
+    }
+    return BLOB_UNRECOGNIZED;
+}
+
+const char *blob_kind_name(enum blob_kind kind) {
+    return kind < BLOB_KIND_COUNT ? blob_kind_names[kind] : "unknown";
+}
+
+static void record_findings(struct batch_result *result, const struct finding_list *findings) {
+    result->errors = findings->error_count;
+    result->warnings = findings->warning_count;
+    if (findings->count == 0 && findings->dropped == 0) {
+        return;
+    }
+
+    size_t size;
+    FILE *out = report_stream_open(&result->findings, &size);
+    if (!out) {
+        return;
+    }
+    for (int i = 0; i < findings->count; i++) {
+        render_finding(out, "  ", &findings->items[i]);
+    }
+    if (findings->dropped > 0) {
+        fprintf(out, "  (%d further finding(s) not shown)\n", findings->dropped);
+    }
+    fclose(out);
+}
+
+static void process_file(struct batch_worker *worker, int index) {
+    struct batch_result *result = &worker->batch->results[index];
+    const char *path = worker->batch->files->paths[index];
+    struct stat st;
+
+    result->kind = BLOB_UNREADABLE;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size > 0xFFFFFF) {
+        close(fd);
+        return;
+    }
+
+    result->length = (int)st.st_size;
+    if (result->length == 0) {
+        result->kind = BLOB_UNRECOGNIZED;
+        close(fd);
+        return;
+    }
+
+    const uint8_t *data = mmap(NULL, result->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return;
+    }
+
+    result->kind = blob_classify(data, result->length);
+    switch (result->kind) {
+        case BLOB_BOS:
+            parse_bos_descriptor(&worker->bos_view, data, result->length, 0);
+            record_findings(result, &worker->bos_view.findings);
+            break;
+        case BLOB_MSOS20:
+            parse_msos20_descriptor(&worker->msos20_view, data, result->length, 0);
+            record_findings(result, &worker->msos20_view.findings);
+            break;
+        case BLOB_WEBUSB_URL:
+            parse_webusb_url_descriptor(&worker->url_view, data, result->length, 0);
+            record_findings(result, &worker->url_view.findings);
+            break;
+        case BLOB_FFS_DESCRIPTORS:
+            parse_ffs_descriptors(&worker->ffs_view, data, result->length);
+            record_findings(result, &worker->ffs_view.findings);
+            break;
+        case BLOB_FFS_STRINGS:
+            parse_ffs_strings(&worker->ffs_strings_view, data, result->length);
+            record_findings(result, &worker->ffs_strings_view.findings);
+            break;
+        default:
+            break;
+    }
+    munmap((void *)data, result->length);
+}
+
+// Take the next chunk of the own range, or steal the back half of another worker's
+static int take_work(struct batch_worker *self, int *begin, int *end) {
+    pthread_mutex_lock(&self->lock);
+    if (self->begin < self->end) {
+        *begin = self->begin;
+        *end = self->begin + BATCH_CHUNK < self->end ? self->begin + BATCH_CHUNK : self->end;
+        self->begin = *end;
+        pthread_mutex_unlock(&self->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    struct batch *batch = self->batch;
+    for (int i = 1; i < batch->worker_count; i++) {
+        struct batch_worker *victim = &batch->workers[(self->index + i) % batch->worker_count];
+        int stolen_begin = 0, stolen_end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        int remaining = victim->end - victim->begin;
+        if (remaining > 0) {
+            stolen_begin = victim->end - (remaining + 1) / 2;
+            stolen_end = victim->end;
+            victim->end = stolen_begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (stolen_end > stolen_begin) {
+            pthread_mutex_lock(&self->lock);
+            self->begin = stolen_begin;
+            self->end = stolen_end;
+            pthread_mutex_unlock(&self->lock);
+            return take_work(self, begin, end);
+        }
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    struct batch_worker *worker = arg;
+    int begin, end;
+
+    while (take_work(worker, &begin, &end)) {
+        for (int i = begin; i < end; i++) {
+            process_file(worker, i);
+        }
+    }
+    return NULL;
+}
+
+int batch_run(FILE *out, const char * const *paths, int path_count, int workers) {
+    struct file_list files = { 0 };
+    struct batch batch = { 0 };
+    uint64_t start_ns = engine_now_ns();
+    int status = 0;
+
+    for (int i = 0; i < path_count; i++) {
+        if (file_list_collect(&files, paths[i]) != 0) {
+            status = -1;
+        }
+    }
+    file_list_sort(&files);
+
+    if (workers <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 0 ? (int)cores : 1;
+    }
+    if (workers > BATCH_MAX_WORKERS) {
+        workers = BATCH_MAX_WORKERS;
+    }
+    if (workers > files.count) {
+        workers = files.count > 0 ? files.count : 1;
+    }
+
+    batch.files = &files;
+    batch.results = calloc(files.count > 0 ? files.count : 1, sizeof(*batch.results));
+    batch.workers = calloc(workers, sizeof(*batch.workers));
+    batch.worker_count = workers;
+    if (!batch.results || !batch.workers) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        status = -1;
+        workers = 0;
+    }
+
+    // Contiguous initial ranges; stealing evens out the rest
+    int started = 0;
+    for (int i = 0; i < workers; i++) {
+        struct batch_worker *worker = &batch.workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->batch = &batch;
+        worker->index = i;
+        worker->begin = (int)((long long)files.count * i / workers);
+        worker->end = (int)((long long)files.count * (i + 1) / workers);
+    }
+    for (int i = 1; i < workers; i++) {
+        if (pthread_create(&batch.workers[i].thread, NULL, worker_main, &batch.workers[i]) != 0) {
+            break;
+        }
+        started = i;
+    }
+    if (workers > 0) {
+        // The calling thread is worker 0; it also picks up ranges of threads that failed to start
+        worker_main(&batch.workers[0]);
+    }
+    for (int i = 1; i <= started; i++) {
+        pthread_join(batch.workers[i].thread, NULL);
+    }
+
+    int kinds[BLOB_KIND_COUNT] = { 0 };
+    int with_errors = 0, with_warnings = 0;
+    for (int i = 0; batch.results && i < files.count; i++) {
+        const struct batch_result *result = &batch.results[i];
+        kinds[result->kind]++;
+
+        if (result->kind == BLOB_UNREADABLE || result->kind == BLOB_UNRECOGNIZED) {
+            fprintf(out, "%s: " COLOR_RED "%s" COLOR_RESET "\n", files.paths[i], blob_kind_names[result->kind]);
+            status = -1;
+            continue;
+        }
+        fprintf(out, "%s: %s (%d bytes), %d errors, %d warnings\n", files.paths[i],
+                blob_kind_names[result->kind], result->length, result->errors, result->warnings);
+        if (result->findings) {
+            fputs(result->findings, out);
+            free(result->findings);
+        }
+        if (result->errors > 0) {
+            with_errors++;
+            status = -1;
+        } else if (result->warnings > 0) {
+            with_warnings++;
+        }
+    }
+
+    uint64_t elapsed_ns = engine_now_ns() - start_ns;
+    int ffs = kinds[BLOB_FFS_DESCRIPTORS] + kinds[BLOB_FFS_STRINGS];
+    fprintf(out, "\nBatch: %d files (%d BOS, %d MS OS 2.0, %d WebUSB URL, %d FunctionFS, %d unrecognized, "
+            "%d unreadable) in %.1f ms on %d thread(s)\n", files.count, kinds[BLOB_BOS], kinds[BLOB_MSOS20],
+            kinds[BLOB_WEBUSB_URL], ffs, kinds[BLOB_UNRECOGNIZED], kinds[BLOB_UNREADABLE],
+            (double)elapsed_ns / 1e6, workers);
+    fprintf(out, "%d clean, %d with warnings, %d with errors\n",
+            kinds[BLOB_BOS] + kinds[BLOB_MSOS20] + kinds[BLOB_WEBUSB_URL] + ffs - with_errors - with_warnings,
+            with_warnings, with_errors);
+
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_destroy(&batch.workers[i].lock);
+    }
+    free(batch.workers);
+    free(batch.results);
+    file_list_free(&files);
+    return status;
+}
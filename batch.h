@@ -0,0 +1,51 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Offline validation of descriptor dumps
+ *
+ * Every file under the given paths (directories are walked recursively) is
+ * memory-mapped, recognized as a BOS, MS OS 2.0 descriptor set, WebUSB
+ * URL descriptor or FunctionFS descriptors/strings blob by its header, and
+ * run through the matching parser. Files
+ * are split over one worker thread per core. Idle workers steal half of the
+ * remaining range of a busy one. Results are printed in path order, so the
+ * output does not depend on the number of threads or on scheduling.
+ */
+
+#define BATCH_MAX_WORKERS   64
+
+enum blob_kind {
+    BLOB_UNREADABLE,
+    BLOB_UNRECOGNIZED,
+    BLOB_BOS,
+    BLOB_MSOS20,
+    BLOB_WEBUSB_URL,
+    BLOB_FFS_DESCRIPTORS,
+    BLOB_FFS_STRINGS,
+    BLOB_KIND_COUNT
+};
+
+// Regular files found under a set of paths
+struct file_list {
+    char **paths;
+    int count;
+    int capacity;
+};
+
+// Add path, or every regular file below it if it is a directory; prints an error and returns -1 on failure
+int file_list_collect(struct file_list *list, const char *path);
+void file_list_sort(struct file_list *list);
+void file_list_free(struct file_list *list);
+
+// Recognize a descriptor blob by its leading header
+enum blob_kind blob_classify(const uint8_t *data, int length);
+const char *blob_kind_name(enum blob_kind kind);
+
+// 0 if every file was recognized and parsed without errors, -1 otherwise
+int batch_run(FILE *out, const char * const *paths, int path_count, int workers);
+
+#endif
@@ -0,0 +1,452 @@
+#define _POSIX_C_SOURCE 200809L
+
+/*
+ * Parser throughput benchmark
+ *
+ * Generates synthetic BOS descriptors and MS OS 2.0 descriptor sets of
+ * controlled shapes (many capabilities or function subsets, long registry
+ * properties, sets close to the 64 KiB limit, and damaged copies of each)
+ * and times the parse and output stages separately. Every measurement is
+ * repeated until it has run for a minimum time, and reported as ns/byte
+ * and descriptors/s.
+ *
+ * Results are appended to a tab-separated file, one row per case and
+ * stage, labelled with the commit they were measured on, so runs from
+ * different commits can be compared line by line.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "report.h"
+#include "usb_descriptors.h"
+
+#define BENCH_OUTPUT        "bench_results.tsv"
+#define BENCH_MIN_MS        200     // Per measurement
+#define BENCH_MAX_LENGTH    65535   // wTotalLength is 16 bits
+#define BENCH_SEED          0x9E3779B97F4A7C15ULL
+
+enum bench_kind {
+    BENCH_BOS,
+    BENCH_MSOS20,
+};
+
+struct bench_case {
+    const char *name;
+    int kind;               // enum bench_kind
+    uint8_t data[BENCH_MAX_LENGTH];
+    int length;
+    int descriptors;        // Capabilities or MS OS 2.0 descriptors the parser stored
+};
+
+struct bench_result {
+    uint64_t iterations;
+    double ns_per_op;
+};
+
+static const uint8_t webusb_uuid[16] = { 0x38, 0xb6, 0x08, 0x34, 0xa9, 0x09, 0xa0, 0x47,
+                                         0x8b, 0xfd, 0xa0, 0x76, 0x88, 0x15, 0xb6, 0x65 };
+static const uint8_t msos20_uuid[16] = { 0xdf, 0x60, 0xdd, 0xd8, 0x89, 0x45, 0xc7, 0x4c,
+                                         0x9c, 0xd2, 0x65, 0x9d, 0x9e, 0x64, 0x8a, 0x9f };
+
+// Keeps the compiler from dropping parse calls whose result is otherwise unused
+static volatile int sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static void put_le16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t value) {
+    put_le16(p, value & 0xFFFF);
+    put_le16(p + 2, value >> 16);
+}
+
+// ASCII as UTF-16LE with a terminator; returns the bytes written
+static int put_utf16(uint8_t *p, const char *text) {
+    int length = 0;
+    for (; *text; text++, length += 2) {
+        put_le16(p + length, (uint8_t)*text);
+    }
+    put_le16(p + length, 0);
+    return length + 2;
+}
+
+/*
+ * Corpus generators
+ */
+
+// 255 capabilities, the most bNumDeviceCaps allows: platform capabilities of every kind and USB 2.0 extensions
+static void make_bos_many_caps(struct bench_case *c) {
+    uint8_t *p = c->data;
+    int length = USB_DT_BOS_SIZE;
+    int count = 0;
+
+    for (; count < 255; count++) {
+        uint8_t *cap = &p[length];
+        switch (count % 4) {
+            case 0:
+                cap[0] = 24;
+                cap[2] = USB_PLAT_DEV_CAP_TYPE;
+                memcpy(&cap[4], webusb_uuid, 16);
+                put_le16(&cap[20], 0x0100);
+                cap[22] = 0x01;
+                cap[23] = 1;
+                break;
+            case 1:
+                cap[0] = 28;
+                cap[2] = USB_PLAT_DEV_CAP_TYPE;
+                memcpy(&cap[4], msos20_uuid, 16);
+                put_le32(&cap[20], 0x06030000);
+                put_le16(&cap[24], 162);
+                cap[26] = 0x02;
+                cap[27] = 0;
+                break;
+            case 2:
+                cap[0] = 20 + 8;   // Unknown platform, some capability data
+                cap[2] = USB_PLAT_DEV_CAP_TYPE;
+                for (int i = 0; i < 24; i++) {
+                    cap[4 + i] = (uint8_t)(count * 31 + i);
+                }
+                break;
+            default:
+                cap[0] = 7;         // USB 2.0 extension
+                cap[2] = 0x02;
+                put_le32(&cap[3], 0x00000002);
+                break;
+        }
+        cap[1] = USB_DT_DEVICE_CAPABILITY;
+        if (cap[2] == USB_PLAT_DEV_CAP_TYPE) {
+            cap[3] = 0;
+        }
+        length += cap[0];
+    }
+
+    p[0] = USB_DT_BOS_SIZE;
+    p[1] = USB_DT_BOS;
+    put_le16(&p[2], (uint16_t)length);
+    p[4] = (uint8_t)count;
+    c->length = length;
+}
+
+// A WebUSB and an MS OS 2.0 capability, as almost every real device has
+static void make_bos_typical(struct bench_case *c) {
+    struct bench_case many;
+    make_bos_many_caps(&many);
+
+    int length = USB_DT_BOS_SIZE + 24 + 28;
+    memcpy(c->data, many.data, length);
+    put_le16(&c->data[2], (uint16_t)length);
+    c->data[4] = 2;
+    c->length = length;
+}
+
+static int put_set_header(uint8_t *p) {
+    put_le16(&p[0], 10);
+    put_le16(&p[2], MS_OS_20_SET_HEADER_DESCRIPTOR);
+    put_le32(&p[4], 0x06030000);
+    return 10;
+}
+
+static int put_compatible_id(uint8_t *p) {
+    put_le16(&p[0], 20);
+    put_le16(&p[2], MS_OS_20_FEATURE_COMPATIBLE_ID);
+    memset(&p[4], 0, 16);
+    memcpy(&p[4], "WINUSB", 6);
+    return 20;
+}
+
+// REG_MULTI_SZ DeviceInterfaceGUIDs with guid_count GUIDs
+static int put_guid_property(uint8_t *p, int guid_count, uint32_t seed) {
+    put_le16(&p[2], MS_OS_20_FEATURE_REG_PROPERTY);
+    put_le16(&p[4], 7);
+    int name_length = put_utf16(&p[8], "DeviceInterfaceGUIDs");
+    put_le16(&p[6], (uint16_t)name_length);
+
+    int data_offset = 8 + name_length + 2;
+    int data_length = 0;
+    for (int i = 0; i < guid_count; i++) {
+        char guid[40];
+        snprintf(guid, sizeof(guid), "{%08X-0D1F-4F1E-9C31-%012X}", seed + i, (unsigned)i * 2654435761u);
+        data_length += put_utf16(&p[data_offset + data_length], guid);
+    }
+    put_le16(&p[data_offset + data_length], 0);
+    data_length += 2;
+    put_le16(&p[data_offset - 2], (uint16_t)data_length);
+
+    int length = data_offset + data_length;
+    put_le16(&p[0], (uint16_t)length);
+    return length;
+}
+
+// REG_SZ property with a long name and data_chars (< 4096) characters of data
+static int put_long_property(uint8_t *p, int index, int data_chars) {
+    char name[128];
+    char data[4096];
+
+    snprintf(name, sizeof(name), "VendorSpecificConfigurationValueWithAQuiteLongRegistryName%03d", index);
+    for (int i = 0; i < data_chars; i++) {
+        data[i] = (char)('A' + (index + i) % 26);
+    }
+    data[data_chars] = '\0';
+
+    put_le16(&p[2], MS_OS_20_FEATURE_REG_PROPERTY);
+    put_le16(&p[4], 1);
+    int name_length = put_utf16(&p[8], name);
+    put_le16(&p[6], (uint16_t)name_length);
+    int data_offset = 8 + name_length + 2;
+    int data_length = put_utf16(&p[data_offset], data);
+    put_le16(&p[data_offset - 2], (uint16_t)data_length);
+
+    int length = data_offset + data_length;
+    put_le16(&p[0], (uint16_t)length);
+    return length;
+}
+
+// One configuration with 255 functions, each with a compatible ID and a GUID
+static void make_msos20_subsets(struct bench_case *c) {
+    uint8_t *p = c->data;
+    int length = put_set_header(p);
+
+    int config = length;
+    put_le16(&p[config], 8);
+    put_le16(&p[config + 2], MS_OS_20_SUBSET_HEADER_CONFIGURATION);
+    p[config + 4] = 0;
+    p[config + 5] = 0;
+    length += 8;
+
+    for (int function = 0; function < 255; function++) {
+        int subset = length;
+        put_le16(&p[subset], 8);
+        put_le16(&p[subset + 2], MS_OS_20_SUBSET_HEADER_FUNCTION);
+        p[subset + 4] = (uint8_t)function;
+        p[subset + 5] = 0;
+        length += 8;
+        length += put_compatible_id(&p[length]);
+        length += put_guid_property(&p[length], 1, (uint32_t)function);
+        put_le16(&p[subset + 6], (uint16_t)(length - subset));
+    }
+
+    put_le16(&p[config + 6], (uint16_t)(length - config));
+    put_le16(&p[8], (uint16_t)length);
+    c->length = length;
+}
+
+// Sixteen REG_SZ properties of 1 KiB characters each
+static void make_msos20_long_properties(struct bench_case *c) {
+    uint8_t *p = c->data;
+    int length = put_set_header(p);
+
+    length += put_compatible_id(&p[length]);
+    for (int i = 0; i < 16; i++) {
+        length += put_long_property(&p[length], i, 1024);
+    }
+    put_le16(&p[8], (uint16_t)length);
+    c->length = length;
+}
+
+// GUID lists until the set is as close to 64 KiB as whole properties allow
+static void make_msos20_near_64k(struct bench_case *c) {
+    uint8_t *p = c->data;
+    int length = put_set_header(p);
+    int property_length = 8 + 42 + 2 + 100 * 78 + 2;   // 100 GUIDs
+
+    length += put_compatible_id(&p[length]);
+    for (uint32_t i = 0; length + property_length <= BENCH_MAX_LENGTH; i++) {
+        length += put_guid_property(&p[length], 100, i * 100);
+    }
+    put_le16(&p[8], (uint16_t)length);
+    c->length = length;
+}
+
+// Overwrite about one byte in every hundred with a random value
+static void damage(struct bench_case *c, const struct bench_case *from, uint64_t seed) {
+    memcpy(c->data, from->data, from->length);
+    c->length = from->length;
+    for (int i = 0; i < c->length / 100; i++) {
+        uint64_t r = next_random(&seed);
+        c->data[r % (uint64_t)c->length] = (uint8_t)(r >> 56);
+    }
+}
+
+/*
+ * Measurement
+ */
+
+static struct bos_view bos_view;
+static struct msos20_view msos20_view;
+
+static int parse_case(const struct bench_case *c) {
+    if (c->kind == BENCH_BOS) {
+        return parse_bos_descriptor(&bos_view, c->data, c->length, 0);
+    }
+    return parse_msos20_descriptor(&msos20_view, c->data, c->length, 0);
+}
+
+static void render_case(FILE *out, const struct bench_case *c) {
+    if (c->kind == BENCH_BOS) {
+        render_bos_descriptor(out, &bos_view);
+    } else {
+        render_msos20_descriptor(out, &msos20_view);
+    }
+}
+
+// Run batches of doubling size until min_ns have passed in one batch
+static struct bench_result measure_parse(const struct bench_case *c, uint64_t min_ns) {
+    struct bench_result result = { 0, 0 };
+
+    for (uint64_t batch = 1;; batch *= 2) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < batch; i++) {
+            sink += parse_case(c);
+        }
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= min_ns) {
+            result.iterations = batch;
+            result.ns_per_op = (double)elapsed / batch;
+            return result;
+        }
+    }
+}
+
+// The view is parsed once; only rendering is timed, into a stream that discards its output
+static struct bench_result measure_render(const struct bench_case *c, FILE *out, uint64_t min_ns) {
+    struct bench_result result = { 0, 0 };
+
+    parse_case(c);
+    for (uint64_t batch = 1;; batch *= 2) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < batch; i++) {
+            render_case(out, c);
+        }
+        fflush(out);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= min_ns) {
+            result.iterations = batch;
+            result.ns_per_op = (double)elapsed / batch;
+            return result;
+        }
+    }
+}
+
+static void report(FILE *results, const char *label, const struct bench_case *c, const char *stage,
+                   struct bench_result result) {
+    double ns_per_byte = result.ns_per_op / c->length;
+    double descriptors_per_s = c->descriptors * 1e9 / result.ns_per_op;
+    double mb_per_s = c->length * 1e3 / result.ns_per_op;
+
+    printf("%-24s %-6s %6d %6d %12.0f %9.3f %14.0f %9.1f\n", c->name, stage, c->length, c->descriptors,
+           result.ns_per_op, ns_per_byte, descriptors_per_s, mb_per_s);
+    fprintf(results, "%s\t%s\t%s\t%d\t%d\t%llu\t%.1f\t%.4f\t%.0f\t%.2f\n", label, c->name, stage, c->length,
+            c->descriptors, (unsigned long long)result.iterations, result.ns_per_op, ns_per_byte, descriptors_per_s,
+            mb_per_s);
+}
+
+static void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  -o FILE    Append results to FILE (default %s)\n", BENCH_OUTPUT);
+    printf("  -l LABEL   First column of every result row, e.g. the commit (default: unlabelled)\n");
+    printf("  -t MS      Minimum run time per measurement (default %d)\n", BENCH_MIN_MS);
+    printf("  -f TEXT    Only run cases whose name contains TEXT\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *output_path = BENCH_OUTPUT;
+    const char *label = "unlabelled";
+    const char *filter = NULL;
+    long min_ms = BENCH_MIN_MS;
+
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-o") == 0 && has_value) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && has_value) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && has_value) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && has_value) {
+            char *endptr;
+            min_ms = strtol(argv[++i], &endptr, 10);
+            if (*endptr != '\0' || min_ms <= 0) {
+                printf(COLOR_RED "ERROR: -t needs a positive number of milliseconds\n" COLOR_RESET);
+                return -1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    static struct bench_case cases[] = {
+        { .name = "bos-typical", .kind = BENCH_BOS },
+        { .name = "bos-many-caps", .kind = BENCH_BOS },
+        { .name = "bos-many-caps-damaged", .kind = BENCH_BOS },
+        { .name = "msos20-subsets", .kind = BENCH_MSOS20 },
+        { .name = "msos20-subsets-damaged", .kind = BENCH_MSOS20 },
+        { .name = "msos20-long-props", .kind = BENCH_MSOS20 },
+        { .name = "msos20-near-64k", .kind = BENCH_MSOS20 },
+        { .name = "msos20-near-64k-damaged", .kind = BENCH_MSOS20 },
+    };
+    const int case_count = (int)(sizeof(cases) / sizeof(cases[0]));
+
+    make_bos_typical(&cases[0]);
+    make_bos_many_caps(&cases[1]);
+    damage(&cases[2], &cases[1], BENCH_SEED);
+    make_msos20_subsets(&cases[3]);
+    damage(&cases[4], &cases[3], BENCH_SEED);
+    make_msos20_long_properties(&cases[5]);
+    make_msos20_near_64k(&cases[6]);
+    damage(&cases[7], &cases[6], BENCH_SEED);
+
+    FILE *results = fopen(output_path, "a");
+    FILE *discard = fopen("/dev/null", "w");
+    if (!results || !discard) {
+        printf(COLOR_RED "ERROR: Cannot open %s\n" COLOR_RESET, results ? "/dev/null" : output_path);
+        return -1;
+    }
+    if (ftell(results) == 0) {
+        fprintf(results, "label\tcase\tstage\tbytes\tdescriptors\titerations\tns_per_op\tns_per_byte\t"
+                "descriptors_per_s\tmb_per_s\n");
+    }
+
+    printf("%-24s %-6s %6s %6s %12s %9s %14s %9s\n", "Case", "Stage", "Bytes", "Descs", "ns/op", "ns/byte",
+           "descs/s", "MB/s");
+    uint64_t min_ns = (uint64_t)min_ms * 1000000u;
+    for (int i = 0; i < case_count; i++) {
+        struct bench_case *c = &cases[i];
+        if (filter && !strstr(c->name, filter)) {
+            continue;
+        }
+
+        parse_case(c);
+        c->descriptors = c->kind == BENCH_BOS ? bos_view.cap_count : msos20_view.entry_count;
+
+        report(results, label, c, "parse", measure_parse(c, min_ns));
+        report(results, label, c, "render", measure_render(c, discard, min_ns));
+    }
+
+    fclose(discard);
+    if (fclose(results) != 0) {
+        printf(COLOR_RED "ERROR: Cannot write %s\n" COLOR_RESET, output_path);
+        return -1;
+    }
+    printf("\nResults appended to %s\n", output_path);
+    return 0;
+}
@@ -0,0 +1,601 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "capture_scan.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "pcap_reader.h"
+#include "report.h"
+#include "report_buffer.h"
+#include "trace_analysis.h"
+#include "usb_engine.h"
+#include "usbmon.h"
+
+#define DEVICE_KEYS     (1 << 16)   // Bus (9 bits) and device address (7 bits)
+
+struct scan_format {
+    int pcapng;
+    int swapped;
+    uint32_t usec_limit;            // pcap: 1e6, or 1e9 for nanosecond captures
+    uint32_t snaplen;
+    int linktype;                   // pcap
+    int interface_count;            // pcapng, first section
+    uint16_t interface_linktypes[PCAP_MAX_INTERFACES];
+    size_t data_start;              // First record after the file and interface headers
+};
+
+// A record at some offset: a packet, or another pcapng block to step over
+struct scan_record {
+    size_t next;
+    int is_packet;
+    int linktype;
+    const uint8_t *data;
+    uint32_t length;
+};
+
+struct scan_exchange {
+    int64_t ts_sec;
+    int32_t ts_usec;
+    uint64_t offset;
+    uint16_t busnum;
+    uint8_t devnum;
+    uint8_t starts_enumeration;
+    uint8_t kind;
+    uint8_t request;                // bRequest
+    uint8_t unverified;             // See struct usb_exchange
+    uint8_t bos_parsed;             // The vendor codes below come from a parsed BOS
+    uint8_t has_msos20;
+    uint8_t msos20_vendor_code;
+    uint8_t has_webusb;
+    uint8_t webusb_vendor_code;
+    int errors;
+    int warnings;
+    char *report;
+    size_t report_size;
+};
+
+struct scan_chunk {
+    struct scan_exchange *exchanges;
+    int count;
+    int capacity;
+    uint64_t events;
+    uint64_t dropped;
+    int corrupt;                    // Records that did not parse inside the chunk
+    int sections;                   // pcapng section headers seen after the first
+};
+
+struct scan {
+    const uint8_t *data;
+    size_t size;
+    struct scan_format format;
+    struct scan_chunk *chunks;
+    int chunk_count;
+    pthread_mutex_t lock;
+    int next_chunk;                 // Protected by lock
+};
+
+static uint32_t read32(const struct scan *scan, size_t offset) {
+    uint32_t value = get_le32(&scan->data[offset]);
+    return scan->format.swapped ? pcap_swap32(value) : value;
+}
+
+static uint16_t read16(const struct scan *scan, size_t offset) {
+    uint16_t value = get_le16(&scan->data[offset]);
+    return scan->format.swapped ? (uint16_t)((value >> 8) | (value << 8)) : value;
+}
+
+static int usbmon_header_size(int linktype) {
+    return linktype == LINKTYPE_USB_LINUX ? USBMON_HEADER_SIZE :
+           linktype == LINKTYPE_USB_LINUX_MMAPPED ? USBMON_MMAPPED_HEADER_SIZE : 0;
+}
+
+// A usbmon header with a known event and transfer type
+static int plausible_usbmon(const struct scan_record *record) {
+    int header_size = usbmon_header_size(record->linktype);
+    if (header_size == 0) {
+        return 1;
+    }
+    if (record->length < (uint32_t)header_size) {
+        return 0;
+    }
+    char type = (char)record->data[8];
+    return (type == 'S' || type == 'C' || type == 'E') && record->data[9] <= 3;
+}
+
+// 1 if a well-formed record starts at offset, -1 otherwise
+static int record_at(const struct scan *scan, size_t offset, struct scan_record *record) {
+    const struct scan_format *format = &scan->format;
+
+    memset(record, 0, sizeof(*record));
+    if (!format->pcapng) {
+        if (scan->size - offset < PCAP_RECORD_SIZE) {
+            return -1;
+        }
+        uint32_t usec = read32(scan, offset + 4);
+        uint32_t captured = read32(scan, offset + 8);
+        uint32_t original = read32(scan, offset + 12);
+        if (usec >= format->usec_limit || captured > original || captured > PCAP_MAX_BLOCK ||
+            (format->snaplen > 0 && captured > format->snaplen) ||
+            scan->size - offset - PCAP_RECORD_SIZE < captured) {
+            return -1;
+        }
+        record->next = offset + PCAP_RECORD_SIZE + captured;
+        record->is_packet = 1;
+        record->linktype = format->linktype;
+        record->data = &scan->data[offset + PCAP_RECORD_SIZE];
+        record->length = captured;
+        return plausible_usbmon(record) ? 1 : -1;
+    }
+
+    if (offset % 4 != 0 || scan->size - offset < 12) {
+        return -1;
+    }
+    uint32_t type = read32(scan, offset);
+    uint32_t total_length = read32(scan, offset + 4);
+    if (total_length < 12 || total_length % 4 != 0 || total_length > scan->size - offset ||
+        read32(scan, offset + total_length - 4) != total_length) {
+        return -1;
+    }
+    record->next = offset + total_length;
+
+    uint32_t body_length = total_length - 12;
+    size_t body = offset + 8;
+    if (type == PCAPNG_ENHANCED_PACKET && body_length >= 20) {
+        uint32_t interface = read32(scan, body);
+        uint32_t captured = read32(scan, body + 12);
+        if (captured > body_length - 20) {
+            return -1;
+        }
+        if (interface < (uint32_t)format->interface_count && interface < PCAP_MAX_INTERFACES) {
+            record->is_packet = 1;
+            record->linktype = format->interface_linktypes[interface];
+            record->data = &scan->data[body + 20];
+            record->length = captured;
+        }
+    } else if (type == PCAPNG_SIMPLE_PACKET && body_length >= 4 && format->interface_count > 0) {
+        uint32_t original = read32(scan, body);
+        record->is_packet = 1;
+        record->linktype = format->interface_linktypes[0];
+        record->data = &scan->data[body + 4];
+        record->length = original < body_length - 4 ? original : body_length - 4;
+    } else if (type > 0x0000000Bu && type != PCAPNG_SECTION_HEADER && (type & 0x80000000u) == 0) {
+        // Neither a standard block nor a local-use one: not a boundary
+        return -1;
+    }
+    return !record->is_packet || plausible_usbmon(record) ? 1 : -1;
+}
+
+// A boundary is accepted if SCAN_SYNC_RECORDS records in a row parse, or parse up to the end of the file
+static int chain_ok(const struct scan *scan, size_t offset) {
+    struct scan_record record;
+    for (int i = 0; i < SCAN_SYNC_RECORDS && offset < scan->size; i++) {
+        if (record_at(scan, offset, &record) != 1) {
+            return 0;
+        }
+        offset = record.next;
+    }
+    return 1;
+}
+
+// First record boundary in [start, end), or end if there is none
+static size_t resync(const struct scan *scan, size_t start, size_t end) {
+    size_t step = scan->format.pcapng ? 4 : 1;
+    if (scan->format.pcapng) {
+        start = (start + 3) & ~(size_t)3;
+    }
+    for (size_t offset = start; offset < end; offset += step) {
+        if (chain_ok(scan, offset)) {
+            return offset;
+        }
+    }
+    return end;
+}
+
+static int parse_format(struct scan *scan) {
+    struct scan_format *format = &scan->format;
+
+    if (scan->size < 4) {
+        return -1;
+    }
+    uint32_t magic = get_le32(scan->data);
+
+    if (magic != PCAPNG_SECTION_HEADER) {
+        if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+            format->swapped = 0;
+        } else if (pcap_swap32(magic) == PCAP_MAGIC_USEC || pcap_swap32(magic) == PCAP_MAGIC_NSEC) {
+            format->swapped = 1;
+        } else {
+            return -1;
+        }
+        if (scan->size < PCAP_HEADER_SIZE) {
+            return -1;
+        }
+        uint32_t native = format->swapped ? pcap_swap32(magic) : magic;
+        format->usec_limit = native == PCAP_MAGIC_NSEC ? 1000000000u : 1000000u;
+        format->snaplen = read32(scan, 16);
+        format->linktype = (int)(read32(scan, 20) & 0xFFFF);
+        format->data_start = PCAP_HEADER_SIZE;
+        return 0;
+    }
+
+    // pcapng: the section header, then the interface descriptions before the first packet
+    format->pcapng = 1;
+    if (scan->size < 28) {
+        return -1;
+    }
+    uint32_t byte_order = get_le32(&scan->data[8]);
+    if (byte_order == PCAPNG_BYTE_ORDER_MAGIC) {
+        format->swapped = 0;
+    } else if (pcap_swap32(byte_order) == PCAPNG_BYTE_ORDER_MAGIC) {
+        format->swapped = 1;
+    } else {
+        return -1;
+    }
+
+    size_t offset = read32(scan, 4);
+    if (offset < 28 || offset > scan->size) {
+        return -1;
+    }
+    while (scan->size - offset >= 12) {
+        uint32_t type = read32(scan, offset);
+        uint32_t total_length = read32(scan, offset + 4);
+        if (total_length < 12 || total_length % 4 != 0 || total_length > scan->size - offset) {
+            return -1;
+        }
+        if (type != PCAPNG_INTERFACE) {
+            break;
+        }
+        if (total_length >= 20 && format->interface_count < PCAP_MAX_INTERFACES) {
+            format->interface_linktypes[format->interface_count++] = read16(scan, offset + 8);
+        }
+        offset += total_length;
+    }
+    format->data_start = offset;
+    return 0;
+}
+
+static int add_exchange(struct scan_chunk *chunk, const struct scan_exchange *exchange) {
+    if (chunk->count == chunk->capacity) {
+        int capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+        struct scan_exchange *exchanges = realloc(chunk->exchanges, capacity * sizeof(*exchanges));
+        if (!exchanges) {
+            return -1;
+        }
+        chunk->exchanges = exchanges;
+        chunk->capacity = capacity;
+    }
+    chunk->exchanges[chunk->count++] = *exchange;
+    return 0;
+}
+
+// Render one exchange into its own buffer; the header probe of a BOS renders nothing and is not kept
+static void record_exchange(struct trace_analyzer *analyzer, struct scan_chunk *chunk,
+                            const struct usb_exchange *exchange, uint64_t offset) {
+    struct scan_exchange result = { 0 };
+    uint64_t errors = analyzer->errors;
+    uint64_t warnings = analyzer->warnings;
+
+    analyzer->out = report_stream_open(&result.report, &result.report_size);
+    if (!analyzer->out) {
+        return;
+    }
+    trace_analyze_exchange(analyzer, exchange);
+    fclose(analyzer->out);
+    analyzer->out = NULL;
+
+    if (result.report_size == 0) {
+        free(result.report);
+        return;
+    }
+    result.ts_sec = exchange->ts_sec;
+    result.ts_usec = exchange->ts_usec;
+    result.offset = offset;
+    result.busnum = exchange->busnum;
+    result.devnum = exchange->devnum;
+    result.starts_enumeration = exchange->kind == EXCHANGE_BOS;
+    result.kind = (uint8_t)exchange->kind;
+    result.request = exchange->setup.bRequest;
+    result.unverified = exchange->unverified != 0;
+    if (exchange->kind == EXCHANGE_BOS && exchange->status == 0) {
+        const struct bos_summary *summary = &analyzer->bos_view.summary;
+        result.bos_parsed = 1;
+        result.has_msos20 = summary->has_msos20 != 0;
+        result.msos20_vendor_code = summary->msos20_vendor_code;
+        result.has_webusb = summary->has_webusb != 0;
+        result.webusb_vendor_code = summary->webusb_vendor_code;
+    }
+    result.errors = (int)(analyzer->errors - errors);
+    result.warnings = (int)(analyzer->warnings - warnings);
+    if (add_exchange(chunk, &result) != 0) {
+        free(result.report);
+    }
+}
+
+static void scan_chunk(struct scan *scan, struct trace_analyzer *analyzer, int index) {
+    struct scan_chunk *chunk = &scan->chunks[index];
+    size_t start = scan->format.data_start + (size_t)index * SCAN_CHUNK_SIZE;
+    size_t end = start + SCAN_CHUNK_SIZE < scan->size ? start + SCAN_CHUNK_SIZE : scan->size;
+    struct scan_record record;
+    struct usbmon_event event;
+    struct usb_exchange exchange;
+
+    usbmon_matcher_init(&analyzer->matcher);
+    size_t offset = index == 0 ? start : resync(scan, start, end);
+
+    while (offset < scan->size) {
+        int overrun = offset >= end;
+        if (overrun && (analyzer->matcher.outstanding == 0 || offset - end >= SCAN_OVERRUN_MAX)) {
+            break;
+        }
+
+        if (record_at(scan, offset, &record) != 1) {
+            if (overrun) {
+                break;
+            }
+            chunk->corrupt++;
+            offset = resync(scan, offset + 1, end);
+            continue;
+        }
+
+        if (!overrun && scan->format.pcapng && read32(scan, offset) == PCAPNG_SECTION_HEADER && offset > 0) {
+            chunk->sections++;
+        }
+
+        int header_size = record.is_packet ? usbmon_header_size(record.linktype) : 0;
+        if (header_size > 0 &&
+            usbmon_decode(&event, record.data, record.length, header_size, scan->format.swapped) == 0 &&
+            !(overrun && event.type == 'S')) {
+            if (!overrun) {
+                chunk->events++;
+            }
+            if (usbmon_matcher_feed(&analyzer->matcher, &event, &exchange)) {
+                record_exchange(analyzer, chunk, &exchange, offset);
+            }
+        }
+        offset = record.next;
+    }
+    chunk->dropped = analyzer->matcher.dropped;
+}
+
+static void *scan_worker(void *arg) {
+    struct scan *scan = arg;
+    struct trace_analyzer *analyzer = trace_analyzer_create(NULL);
+    if (!analyzer) {
+        return NULL;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&scan->lock);
+        int index = scan->next_chunk < scan->chunk_count ? scan->next_chunk++ : -1;
+        pthread_mutex_unlock(&scan->lock);
+        if (index < 0) {
+            break;
+        }
+        scan_chunk(scan, analyzer, index);
+    }
+
+    trace_analyzer_destroy(analyzer);
+    return NULL;
+}
+
+static int compare_exchanges(const void *a, const void *b) {
+    const struct scan_exchange *x = *(struct scan_exchange * const *)a;
+    const struct scan_exchange *y = *(struct scan_exchange * const *)b;
+
+    if (x->ts_sec != y->ts_sec) {
+        return x->ts_sec < y->ts_sec ? -1 : 1;
+    }
+    if (x->ts_usec != y->ts_usec) {
+        return x->ts_usec < y->ts_usec ? -1 : 1;
+    }
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+/*
+ * A chunk does not know the BOS that devices returned in earlier chunks, so
+ * it classifies their vendor requests by wIndex alone. Once the exchanges are
+ * in order, drop the ones that the enumeration's BOS rules out, as a
+ * sequential analysis would never have classified them.
+ */
+static int ruled_out(const struct scan_exchange *exchange, const struct scan_exchange *head) {
+    if (!exchange->unverified || !head->bos_parsed) {
+        return 0;
+    }
+    if (exchange->kind == EXCHANGE_MSOS20) {
+        return !head->has_msos20 || exchange->request != head->msos20_vendor_code;
+    }
+    if (exchange->kind == EXCHANGE_WEBUSB_URL) {
+        return !head->has_webusb || exchange->request != head->webusb_vendor_code;
+    }
+    return 0;
+}
+
+// Sort every exchange by time and print one report per enumeration
+static int print_enumerations(FILE *out, struct scan *scan, uint64_t *exchanges, uint64_t *errors,
+                              uint64_t *warnings) {
+    int total = 0;
+    for (int i = 0; i < scan->chunk_count; i++) {
+        total += scan->chunks[i].count;
+    }
+
+    struct scan_exchange **sorted = malloc((total > 0 ? total : 1) * sizeof(*sorted));
+    int *next = malloc((total > 0 ? total : 1) * sizeof(*next));
+    int *tail = malloc((total > 0 ? total : 1) * sizeof(*tail));
+    int *current = malloc(DEVICE_KEYS * sizeof(*current));
+    if (!sorted || !next || !tail || !current) {
+        free(sorted);
+        free(next);
+        free(tail);
+        free(current);
+        return -1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < scan->chunk_count; i++) {
+        for (int j = 0; j < scan->chunks[i].count; j++) {
+            sorted[n++] = &scan->chunks[i].exchanges[j];
+        }
+    }
+    qsort(sorted, total, sizeof(*sorted), compare_exchanges);
+
+    // Chain each exchange to the current enumeration of its device
+    for (int i = 0; i < DEVICE_KEYS; i++) {
+        current[i] = -1;
+    }
+    for (int i = 0; i < total; i++) {
+        const struct scan_exchange *exchange = sorted[i];
+        int key = ((exchange->busnum & 0x1FF) << 7) | (exchange->devnum & 0x7F);
+        next[i] = -1;
+        tail[i] = i;
+        if (exchange->starts_enumeration || current[key] < 0) {
+            current[key] = i;
+        } else if (ruled_out(exchange, sorted[current[key]])) {
+            tail[i] = -1;
+        } else {
+            int head = current[key];
+            next[tail[head]] = i;
+            tail[head] = i;
+            tail[i] = -1;           // Not a head
+        }
+    }
+
+    int enumerations = 0;
+    for (int i = 0; i < total; i++) {
+        if (tail[i] < 0) {
+            continue;
+        }
+        const struct scan_exchange *head = sorted[i];
+        fprintf(out, "######## Enumeration %d: bus %d device %d at %lld.%06d%s ########\n\n", ++enumerations,
+                head->busnum, head->devnum, (long long)head->ts_sec, (int)head->ts_usec,
+                head->starts_enumeration ? "" : " (BOS not seen)");
+        for (int j = i; j >= 0; j = next[j]) {
+            struct scan_exchange *exchange = sorted[j];
+            fwrite(exchange->report, 1, exchange->report_size, out);
+            (*exchanges)++;
+            *errors += exchange->errors;
+            *warnings += exchange->warnings;
+        }
+    }
+
+    free(sorted);
+    free(next);
+    free(tail);
+    free(current);
+    return enumerations;
+}
+
+int capture_scan(FILE *out, const char *path, int workers) {
+    struct scan scan;
+    struct stat st;
+    uint64_t start_ns = engine_now_ns();
+
+    memset(&scan, 0, sizeof(scan));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        printf(COLOR_RED "ERROR: Cannot open capture '%s' (a non-empty regular file is needed)\n" COLOR_RESET, path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    scan.size = (size_t)st.st_size;
+    void *map = mmap(NULL, scan.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf(COLOR_RED "ERROR: Cannot map capture '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+    scan.data = map;
+    posix_madvise(map, scan.size, POSIX_MADV_SEQUENTIAL);
+
+    if (parse_format(&scan) != 0) {
+        printf(COLOR_RED "ERROR: '%s' is not a pcap or pcapng capture\n" COLOR_RESET, path);
+        munmap(map, scan.size);
+        return -1;
+    }
+
+    size_t payload = scan.size - scan.format.data_start;
+    scan.chunk_count = (int)((payload + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE);
+    scan.chunks = calloc(scan.chunk_count > 0 ? scan.chunk_count : 1, sizeof(*scan.chunks));
+    if (!scan.chunks) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        munmap(map, scan.size);
+        return -1;
+    }
+    pthread_mutex_init(&scan.lock, NULL);
+
+    if (workers <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 0 ? (int)cores : 1;
+    }
+    if (workers > BATCH_MAX_WORKERS) {
+        workers = BATCH_MAX_WORKERS;
+    }
+    if (workers > scan.chunk_count) {
+        workers = scan.chunk_count > 0 ? scan.chunk_count : 1;
+    }
+
+    pthread_t threads[BATCH_MAX_WORKERS];
+    int started = 0;
+    for (int i = 1; i < workers; i++) {
+        if (pthread_create(&threads[i], NULL, scan_worker, &scan) != 0) {
+            break;
+        }
+        started = i;
+    }
+    scan_worker(&scan);
+    for (int i = 1; i <= started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    uint64_t events = 0, dropped = 0, errors = 0, warnings = 0, exchanges = 0;
+    int corrupt = 0, sections = 0;
+    for (int i = 0; i < scan.chunk_count; i++) {
+        events += scan.chunks[i].events;
+        dropped += scan.chunks[i].dropped;
+        corrupt += scan.chunks[i].corrupt;
+        sections += scan.chunks[i].sections;
+    }
+
+    int enumerations = print_enumerations(out, &scan, &exchanges, &errors, &warnings);
+    if (enumerations < 0) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+    }
+
+    fprintf(out, "Scan: %llu usbmon events, %llu descriptor exchanges in %d enumeration(s), %llu errors, "
+            "%llu warnings; %d chunk(s) on %d thread(s) in %.1f ms\n",
+            (unsigned long long)events, (unsigned long long)exchanges, enumerations > 0 ? enumerations : 0,
+            (unsigned long long)errors, (unsigned long long)warnings, scan.chunk_count, workers,
+            (double)(engine_now_ns() - start_ns) / 1e6);
+    if (corrupt > 0) {
+        fprintf(out, COLOR_ORANGE "WARNING: %d corrupt region(s) skipped\n" COLOR_RESET, corrupt);
+    }
+    if (dropped > 0) {
+        fprintf(out, COLOR_ORANGE "WARNING: %llu requests not analyzed, more than %d were outstanding\n"
+                COLOR_RESET, (unsigned long long)dropped, USBMON_MAX_OUTSTANDING);
+    }
+    if (sections > 0) {
+        fprintf(out, COLOR_ORANGE "WARNING: Capture has %d further pcapng section(s); use --pcap to analyze "
+                "them exactly\n" COLOR_RESET, sections);
+    }
+
+    for (int i = 0; i < scan.chunk_count; i++) {
+        for (int j = 0; j < scan.chunks[i].count; j++) {
+            free(scan.chunks[i].exchanges[j].report);
+        }
+        free(scan.chunks[i].exchanges);
+    }
+    free(scan.chunks);
+    pthread_mutex_destroy(&scan.lock);
+    munmap(map, scan.size);
+    return enumerations < 0 || errors > 0 || corrupt > 0 ? -1 : 0;
+}
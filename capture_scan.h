@@ -0,0 +1,33 @@
+#ifndef CAPTURE_SCAN_H
+#define CAPTURE_SCAN_H
+
+#include <stdio.h>
+
+/*
+ * Parallel scan of large usbmon capture files
+ *
+ * The capture is memory-mapped and cut into fixed-size chunks that worker
+ * threads pick up one at a time. A worker finds the first record boundary
+ * in its chunk by checking that several consecutive records parse (pcapng
+ * blocks repeat their length at the end, pcap records are checked for sane
+ * lengths, timestamps and usbmon headers). It owns every exchange whose
+ * submission starts in its chunk and reads past the chunk end only to
+ * collect the completions of those exchanges.
+ *
+ * Exchanges are then sorted by timestamp and grouped into one report per
+ * enumeration: a full BOS fetch starts a new enumeration of that bus and
+ * device address, and the MS OS 2.0 and WebUSB exchanges that follow are
+ * added to it.
+ *
+ * Only the interfaces of the first pcapng section are known to the
+ * workers; later sections are reported but their packets may be skipped.
+ */
+
+#define SCAN_CHUNK_SIZE     (8 * 1024 * 1024)
+#define SCAN_OVERRUN_MAX    (16 * 1024 * 1024)  // How far past its chunk a worker looks for completions
+#define SCAN_SYNC_RECORDS   4                   // Consecutive records that must parse to accept a boundary
+
+// 0 if no descriptor had errors, -1 otherwise
+int capture_scan(FILE *out, const char *path, int workers);
+
+#endif
@@ -0,0 +1,714 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "configfs_gadget.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "report.h"
+#include "usb_descriptors.h"
+
+// Capabilities composite.c puts in front of the WebUSB one on a SuperSpeed controller
+#define USB_CAP_TYPE_EXT        0x02
+#define USB_SS_CAP_TYPE         0x03
+#define USB_DT_USB_EXT_CAP_SIZE 7
+#define USB_DT_USB_SS_CAP_SIZE  10
+#define USB_DT_WEBUSB_SIZE      24
+#define WEBUSB_URL_HEADER_SIZE  3
+
+// Registry value types of MS OS extended properties (same numbers in 1.0 and 2.0)
+#define REG_SZ                  1
+#define REG_EXPAND_SZ           2
+#define REG_BINARY              3
+#define REG_DWORD_LITTLE_ENDIAN 4
+#define REG_DWORD_BIG_ENDIAN    5
+#define REG_LINK                6
+#define REG_MULTI_SZ            7
+
+static const uint8_t webusb_uuid[16] = {
+    0x38, 0xb6, 0x08, 0x34, 0xa9, 0x09, 0xa0, 0x47, 0x8b, 0xfd, 0xa0, 0x76, 0x88, 0x15, 0xb6, 0x65,
+};
+
+struct descriptor_buffer {
+    uint8_t *data;
+    int length;
+    int capacity;
+    int overflow;
+};
+
+struct gadget_check {
+    FILE *out;
+    const char *path;
+    int errors;
+    int warnings;
+
+    struct descriptor_buffer bos;
+    struct descriptor_buffer url;
+    struct descriptor_buffer set;
+    struct bos_view bos_view;
+    struct webusb_url_view url_view;
+    struct msos20_view msos20_view;
+
+    char attr[CONFIGFS_ATTR_SIZE + 1];
+};
+
+static void problem(struct gadget_check *check, int is_error, const char *format, ...) {
+    va_list args;
+
+    fputs(is_error ? COLOR_RED "ERROR: " : COLOR_ORANGE "WARNING: ", check->out);
+    va_start(args, format);
+    vfprintf(check->out, format, args);
+    va_end(args);
+    fputs("\n" COLOR_RESET, check->out);
+    if (is_error) {
+        check->errors++;
+    } else {
+        check->warnings++;
+    }
+}
+
+// Read dir/name into check->attr without its trailing newline; the length, or -1 if it is missing
+static int read_attr(struct gadget_check *check, const char *dir, const char *name) {
+    char path[PATH_MAX];
+
+    check->attr[0] = '\0';
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t length = read(fd, check->attr, CONFIGFS_ATTR_SIZE);
+    close(fd);
+    if (length < 0) {
+        return -1;
+    }
+
+    // Like the kernel's store functions, drop one trailing newline
+    if (length > 0 && check->attr[length - 1] == '\n') {
+        length--;
+    }
+    check->attr[length] = '\0';
+    return (int)length;
+}
+
+static long read_number(struct gadget_check *check, const char *dir, const char *name, long fallback) {
+    char *end;
+    if (read_attr(check, dir, name) <= 0) {
+        return fallback;
+    }
+    long value = strtol(check->attr, &end, 0);
+    return end == check->attr ? fallback : value;
+}
+
+static int read_bool(struct gadget_check *check, const char *dir, const char *name) {
+    if (read_attr(check, dir, name) <= 0) {
+        return 0;
+    }
+    char c = check->attr[0];
+    return c == '1' || c == 'y' || c == 'Y';
+}
+
+static int is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Names in dir that start with prefix, sorted; symlinks only if links is set
+static void list_names(const char *dir, const char *prefix, int links, struct file_list *names) {
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+
+    if (!d) {
+        return;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        char path[PATH_MAX];
+        struct stat st;
+
+        if (entry->d_name[0] == '.' || strncmp(entry->d_name, prefix, strlen(prefix)) != 0) {
+            continue;
+        }
+        if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path) ||
+            lstat(path, &st) != 0 || (links && !S_ISLNK(st.st_mode))) {
+            continue;
+        }
+        if (names->count == names->capacity) {
+            int capacity = names->capacity ? names->capacity * 2 : 16;
+            char **paths = realloc(names->paths, capacity * sizeof(*paths));
+            if (!paths) {
+                break;
+            }
+            names->paths = paths;
+            names->capacity = capacity;
+        }
+        char *name = strdup(entry->d_name);
+        if (!name) {
+            break;
+        }
+        names->paths[names->count++] = name;
+    }
+    closedir(d);
+    file_list_sort(names);
+}
+
+// Last component of a symlink's target, or NULL
+static const char *link_target(const char *dir, const char *name, char *target, size_t size) {
+    char path[PATH_MAX];
+
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        return NULL;
+    }
+    ssize_t length = readlink(path, target, size - 1);
+    if (length <= 0) {
+        return NULL;
+    }
+    while (length > 1 && target[length - 1] == '/') {
+        length--;
+    }
+    target[length] = '\0';
+    const char *slash = strrchr(target, '/');
+    return slash ? slash + 1 : target;
+}
+
+static void put(struct descriptor_buffer *buffer, const void *bytes, int length) {
+    if (buffer->length + length > buffer->capacity) {
+        buffer->overflow = 1;
+        return;
+    }
+    memcpy(&buffer->data[buffer->length], bytes, (size_t)length);
+    buffer->length += length;
+}
+
+static void put8(struct descriptor_buffer *buffer, unsigned value) {
+    uint8_t byte = (uint8_t)value;
+    put(buffer, &byte, 1);
+}
+
+static void put16(struct descriptor_buffer *buffer, unsigned value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    put(buffer, bytes, 2);
+}
+
+static void put32(struct descriptor_buffer *buffer, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    put(buffer, bytes, 4);
+}
+
+static void patch16(struct descriptor_buffer *buffer, int offset, unsigned value) {
+    if (!buffer->overflow) {
+        buffer->data[offset] = (uint8_t)value;
+        buffer->data[offset + 1] = (uint8_t)(value >> 8);
+    }
+}
+
+// ASCII text as UTF-16LE, with a terminator
+static void put_utf16(struct descriptor_buffer *buffer, const char *text, int length) {
+    for (int i = 0; i < length; i++) {
+        put16(buffer, (uint8_t)text[i]);
+    }
+    put16(buffer, 0);
+}
+
+static void count_findings(struct gadget_check *check, const struct finding_list *findings) {
+    check->errors += findings->error_count;
+    check->warnings += findings->warning_count;
+}
+
+/*
+ * The BOS of composite.c's bos_desc(). The USB 2.0 extension and SuperSpeed
+ * capabilities depend on the controller; they are included when max_speed
+ * asks for SuperSpeed.
+ */
+static void check_bos_and_url(struct gadget_check *check, int superspeed) {
+    char webusb_dir[PATH_MAX];
+    int use_webusb = 0;
+    long vendor_code = 0, version = 0x0100;
+    char landing_page[CONFIGFS_ATTR_SIZE + 1] = "";
+
+    snprintf(webusb_dir, sizeof(webusb_dir), "%s/webusb", check->path);
+    if (is_directory(webusb_dir)) {
+        use_webusb = read_bool(check, webusb_dir, "use");
+        vendor_code = read_number(check, webusb_dir, "bVendorCode", 0);
+        version = read_number(check, webusb_dir, "bcdVersion", 0x0100);
+        if (read_attr(check, webusb_dir, "landingPage") > 0) {
+            memcpy(landing_page, check->attr, sizeof(landing_page));
+        }
+    }
+
+    struct descriptor_buffer *bos = &check->bos;
+    int caps = 0;
+    bos->length = 0;
+    bos->overflow = 0;
+    put8(bos, USB_DT_BOS_SIZE);
+    put8(bos, USB_DT_BOS);
+    put16(bos, 0);
+    put8(bos, 0);
+    if (superspeed) {
+        put8(bos, USB_DT_USB_EXT_CAP_SIZE);
+        put8(bos, USB_DT_DEVICE_CAPABILITY);
+        put8(bos, USB_CAP_TYPE_EXT);
+        put32(bos, 0x06);                       // LPM and BESL
+        put8(bos, USB_DT_USB_SS_CAP_SIZE);
+        put8(bos, USB_DT_DEVICE_CAPABILITY);
+        put8(bos, USB_SS_CAP_TYPE);
+        put8(bos, 0);
+        put16(bos, 0x000E);                     // Full, high and SuperSpeed
+        put8(bos, 1);                           // Fully functional from full speed up
+        put8(bos, 0x01);                        // Default U1/U2 exit latencies
+        put16(bos, 0x01F4);
+        caps += 2;
+    }
+    if (use_webusb) {
+        put8(bos, USB_DT_WEBUSB_SIZE);
+        put8(bos, USB_DT_DEVICE_CAPABILITY);
+        put8(bos, USB_PLAT_DEV_CAP_TYPE);
+        put8(bos, 0);
+        put(bos, webusb_uuid, sizeof(webusb_uuid));
+        put16(bos, (unsigned)version);
+        put8(bos, (unsigned)vendor_code);
+        put8(bos, landing_page[0] != '\0');
+        caps++;
+    }
+    patch16(bos, 2, (unsigned)bos->length);
+    bos->data[4] = (uint8_t)caps;
+
+    fprintf(check->out, "=== BOS Descriptor ===\n");
+    if (caps == 0) {
+        fprintf(check->out, "INFO: The kernel sends no BOS (webusb/use is off and max_speed is below SuperSpeed)\n\n");
+        return;
+    }
+    render_raw_data(check->out, "BOS", bos->data, bos->length, NULL);
+    parse_bos_descriptor(&check->bos_view, bos->data, bos->length, 0);
+    render_bos_descriptor(check->out, &check->bos_view);
+    count_findings(check, &check->bos_view.findings);
+    fprintf(check->out, "\n");
+
+    if (!use_webusb) {
+        return;
+    }
+    if (version != 0x0100) {
+        problem(check, 0, "webusb/bcdVersion is 0x%04lx; WebUSB 1.0 is 0x0100", version);
+    }
+    if (vendor_code < 0 || vendor_code > 0xFF) {
+        problem(check, 1, "webusb/bVendorCode %ld does not fit in a byte", vendor_code);
+    }
+    if (landing_page[0] == '\0') {
+        fprintf(check->out, "INFO: No webusb/landingPage, iLandingPage is 0\n\n");
+        return;
+    }
+
+    // The URL descriptor of composite.c: the scheme is replaced by bScheme
+    int scheme = WEBUSB_URL_SCHEME_NONE;
+    int strip = 0;
+    if (strncmp(landing_page, "https://", 8) == 0) {
+        scheme = WEBUSB_URL_SCHEME_HTTPS;
+        strip = 8;
+    } else if (strncmp(landing_page, "http://", 7) == 0) {
+        scheme = WEBUSB_URL_SCHEME_HTTP;
+        strip = 7;
+    }
+    int url_length = (int)strlen(landing_page) - strip;
+    if (url_length + WEBUSB_URL_HEADER_SIZE > 255) {
+        problem(check, 1, "webusb/landingPage is too long for a URL descriptor (%d bytes, maximum %d)",
+                url_length + WEBUSB_URL_HEADER_SIZE, 255);
+        return;
+    }
+
+    struct descriptor_buffer *url = &check->url;
+    url->length = 0;
+    url->overflow = 0;
+    put8(url, (unsigned)(url_length + WEBUSB_URL_HEADER_SIZE));
+    put8(url, WEBUSB_URL_DESCRIPTOR_TYPE);
+    put8(url, (unsigned)scheme);
+    put(url, &landing_page[strip], url_length);
+
+    fprintf(check->out, "=== WebUSB URL ===\n");
+    render_raw_data(check->out, "WebUSB URL", url->data, url->length, NULL);
+    parse_webusb_url_descriptor(&check->url_view, url->data, url->length, 0);
+    render_webusb_url_descriptor(check->out, &check->url_view);
+    count_findings(check, &check->url_view.findings);
+    fprintf(check->out, "\n");
+}
+
+// A registry property directory: its type and data attributes become a registry property feature
+static void add_property(struct gadget_check *check, const char *interface_dir, const char *name) {
+    struct descriptor_buffer *set = &check->set;
+    char dir[PATH_MAX];
+
+    if (snprintf(dir, sizeof(dir), "%s/%s", interface_dir, name) >= (int)sizeof(dir)) {
+        return;
+    }
+    long type = read_number(check, dir, "type", 0);
+    if (type < REG_SZ || type > REG_MULTI_SZ) {
+        problem(check, 1, "Property %s has type %ld; the kernel only accepts 1 to 7", name, type);
+        return;
+    }
+    int length = read_attr(check, dir, "data");
+    if (length < 0) {
+        problem(check, 1, "Property %s has no data attribute", name);
+        return;
+    }
+    if (length > 0 && check->attr[length - 1] == '\0') {
+        length--;
+    }
+
+    int is_string = type == REG_SZ || type == REG_EXPAND_SZ || type == REG_LINK || type == REG_MULTI_SZ;
+    if ((type == REG_DWORD_LITTLE_ENDIAN || type == REG_DWORD_BIG_ENDIAN) && length != 4) {
+        problem(check, 1, "Property %s is a DWORD but holds %d bytes", name, length);
+    }
+    int name_length = ((int)strlen(name) + 1) * 2;
+    int data_length = is_string ? (length + 1 + (type == REG_MULTI_SZ)) * 2 : length;
+
+    put16(set, (unsigned)(8 + name_length + 2 + data_length));
+    put16(set, MS_OS_20_FEATURE_REG_PROPERTY);
+    put16(set, (unsigned)type);
+    put16(set, (unsigned)name_length);
+    put_utf16(set, name, (int)strlen(name));
+    put16(set, (unsigned)data_length);
+    if (is_string) {
+        put_utf16(set, check->attr, length);
+        if (type == REG_MULTI_SZ) {
+            put16(set, 0);
+        }
+    } else {
+        put(set, check->attr, length);
+    }
+}
+
+// One os_desc/interface.* directory as a function subset; 1 if it holds anything
+static int add_interface(struct gadget_check *check, const char *function, const char *dir, int first_interface) {
+    struct descriptor_buffer *set = &check->set;
+    struct file_list properties = { 0 };
+    char compatible_id[8] = { 0 }, sub_compatible_id[8] = { 0 };
+
+    // compatible_id and sub_compatible_id hold up to 8 bytes, zero-padded
+    int id_length = read_attr(check, dir, "compatible_id");
+    if (id_length > 8) {
+        problem(check, 1, "%s: compatible_id is %d bytes, at most 8 fit", function, id_length);
+    }
+    memcpy(compatible_id, check->attr, id_length > 8 ? 8 : id_length > 0 ? (size_t)id_length : 0);
+    int sub_length = read_attr(check, dir, "sub_compatible_id");
+    if (sub_length > 8) {
+        problem(check, 1, "%s: sub_compatible_id is %d bytes, at most 8 fit", function, sub_length);
+    }
+    memcpy(sub_compatible_id, check->attr, sub_length > 8 ? 8 : sub_length > 0 ? (size_t)sub_length : 0);
+
+    // Every subdirectory is a property
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    while (d && (entry = readdir(d)) != NULL) {
+        char path[PATH_MAX];
+        if (entry->d_name[0] == '.' ||
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path) || !is_directory(path)) {
+            continue;
+        }
+        if (properties.count == properties.capacity) {
+            int capacity = properties.capacity ? properties.capacity * 2 : 8;
+            char **paths = realloc(properties.paths, capacity * sizeof(*paths));
+            if (!paths) {
+                break;
+            }
+            properties.paths = paths;
+            properties.capacity = capacity;
+        }
+        if ((properties.paths[properties.count] = strdup(entry->d_name)) != NULL) {
+            properties.count++;
+        }
+    }
+    if (d) {
+        closedir(d);
+    }
+    file_list_sort(&properties);
+
+    if (compatible_id[0] == '\0' && properties.count == 0) {
+        file_list_free(&properties);
+        return 0;
+    }
+
+    int subset = set->length;
+    put16(set, 8);
+    put16(set, MS_OS_20_SUBSET_HEADER_FUNCTION);
+    put8(set, (unsigned)first_interface);
+    put8(set, 0);
+    put16(set, 0);
+    if (compatible_id[0] != '\0') {
+        put16(set, 20);
+        put16(set, MS_OS_20_FEATURE_COMPATIBLE_ID);
+        put(set, compatible_id, 8);
+        put(set, sub_compatible_id, 8);
+    }
+    for (int i = 0; i < properties.count; i++) {
+        add_property(check, dir, properties.paths[i]);
+    }
+    patch16(set, subset + 6, (unsigned)(set->length - subset));
+    file_list_free(&properties);
+    return 1;
+}
+
+// Add the os_desc interfaces of one function; the number of interfaces that hold descriptors
+static int add_function(struct gadget_check *check, const char *function, int *first_interface, int linked) {
+    struct file_list interfaces = { 0 };
+    char dir[PATH_MAX];
+    int described = 0;
+
+    if (snprintf(dir, sizeof(dir), "%s/functions/%s/os_desc", check->path, function) >= (int)sizeof(dir)) {
+        return 0;
+    }
+    list_names(dir, "interface.", 0, &interfaces);
+    for (int i = 0; i < interfaces.count; i++) {
+        char interface_dir[PATH_MAX];
+        if (snprintf(interface_dir, sizeof(interface_dir), "%s/%s", dir, interfaces.paths[i]) >=
+            (int)sizeof(interface_dir)) {
+            continue;
+        }
+        if (!linked) {
+            // Only read to see whether the function describes anything
+            int length = read_attr(check, interface_dir, "compatible_id");
+            described += length > 0;
+            continue;
+        }
+        described += add_interface(check, function, interface_dir, (*first_interface)++);
+    }
+    file_list_free(&interfaces);
+    return described;
+}
+
+/*
+ * MS OS descriptors: the kernel sends the 0xEE string with os_desc's
+ * signature and vendor code, then the extended compat ID and properties of
+ * the functions in the configuration linked into os_desc.
+ */
+static void check_os_descriptors(struct gadget_check *check) {
+    char os_desc[PATH_MAX], config_dir[PATH_MAX], target[PATH_MAX];
+    struct file_list links = { 0 };
+    struct file_list functions = { 0 };
+    const char *config = NULL;
+
+    snprintf(os_desc, sizeof(os_desc), "%s/os_desc", check->path);
+    int use = read_bool(check, os_desc, "use");
+    long vendor_code = read_number(check, os_desc, "b_vendor_code", 0);
+    read_attr(check, os_desc, "qw_sign");
+    char signature[32];
+    snprintf(signature, sizeof(signature), "%.*s", (int)sizeof(signature) - 1, check->attr);
+
+    list_names(os_desc, "", 1, &links);
+    if (links.count > 0) {
+        config = link_target(os_desc, links.paths[0], target, sizeof(target));
+    }
+    char functions_dir[PATH_MAX];
+    snprintf(functions_dir, sizeof(functions_dir), "%s/functions", check->path);
+    list_names(functions_dir, "", 0, &functions);
+
+    // Functions of the linked configuration, in link name order
+    struct file_list config_links = { 0 };
+    if (config) {
+        snprintf(config_dir, sizeof(config_dir), "%s/configs/%s", check->path, config);
+        list_names(config_dir, "", 1, &config_links);
+    }
+
+    fprintf(check->out, "=== MS OS Descriptors ===\n");
+    if (!use) {
+        int described = 0;
+        for (int i = 0; i < functions.count; i++) {
+            int first = 0;
+            described += add_function(check, functions.paths[i], &first, 0);
+        }
+        if (described > 0) {
+            problem(check, 0, "%d function interface(s) set a compatible_id but os_desc/use is off; "
+                    "Windows will not see them", described);
+        } else {
+            fprintf(check->out, "INFO: os_desc/use is off, the kernel sends no MS OS descriptors\n");
+        }
+        fprintf(check->out, "\n");
+        file_list_free(&links);
+        file_list_free(&functions);
+        file_list_free(&config_links);
+        return;
+    }
+
+    fprintf(check->out, "String 0xEE: \"%s\", vendor code 0x%02lx\n", signature, vendor_code & 0xFF);
+    if (strcmp(signature, "MSFT100") != 0) {
+        problem(check, 1, "os_desc/qw_sign is \"%s\"; Windows only accepts \"MSFT100\"", signature);
+    }
+    if (vendor_code == 0) {
+        problem(check, 0, "os_desc/b_vendor_code is 0");
+    } else if (vendor_code < 0 || vendor_code > 0xFF) {
+        problem(check, 1, "os_desc/b_vendor_code %ld does not fit in a byte", vendor_code);
+    }
+    if (!config) {
+        problem(check, 1, "os_desc/use is on but no configuration is linked into os_desc; "
+                "the kernel sends no extended descriptors");
+    }
+
+    // Lay the functions' descriptors out as an MS OS 2.0 set: header, configuration subset, function subsets
+    struct descriptor_buffer *set = &check->set;
+    set->length = 0;
+    set->overflow = 0;
+    put16(set, 10);
+    put16(set, MS_OS_20_SET_HEADER_DESCRIPTOR);
+    put32(set, 0x06030000);
+    put16(set, 0);
+    put16(set, 8);
+    put16(set, MS_OS_20_SUBSET_HEADER_CONFIGURATION);
+    put8(set, 0);
+    put8(set, 0);
+    put16(set, 0);
+
+    // First interface numbers are only known after bind; one interface per function is assumed
+    int first_interface = 0;
+    int described = 0;
+    for (int i = 0; i < config_links.count; i++) {
+        char function_target[PATH_MAX];
+        const char *function = link_target(config_dir, config_links.paths[i], function_target,
+                                           sizeof(function_target));
+        if (function) {
+            described += add_function(check, function, &first_interface, 1);
+        }
+    }
+
+    // Functions outside the configuration are never reported
+    for (int i = 0; i < functions.count; i++) {
+        int in_config = 0;
+        for (int k = 0; k < config_links.count && !in_config; k++) {
+            char function_target[PATH_MAX];
+            const char *function = link_target(config_dir, config_links.paths[k], function_target,
+                                               sizeof(function_target));
+            in_config = function && strcmp(function, functions.paths[i]) == 0;
+        }
+        int first = 0;
+        if (!in_config && add_function(check, functions.paths[i], &first, 0) > 0) {
+            problem(check, 0, "%s sets a compatible_id but is not in the os_desc configuration; "
+                    "Windows will not see it", functions.paths[i]);
+        }
+    }
+
+    patch16(set, 8, (unsigned)set->length);
+    patch16(set, 16, (unsigned)(set->length - 10));
+    if (set->overflow) {
+        problem(check, 1, "The extended descriptors exceed %d bytes", CONFIGFS_SET_SIZE);
+    } else if (described == 0) {
+        fprintf(check->out, "INFO: No function in the os_desc configuration sets a compatible_id or property\n");
+    } else {
+        fprintf(check->out, "The kernel sends these as MS OS 1.0 extended compat ID and property descriptors.\n");
+        fprintf(check->out, "Their contents are checked as the equivalent MS OS 2.0 descriptor set.\n\n");
+        render_raw_data(check->out, "MS OS 2.0 equivalent", set->data, set->length, NULL);
+        parse_msos20_descriptor(&check->msos20_view, set->data, set->length, 0);
+        render_msos20_descriptor(check->out, &check->msos20_view);
+        count_findings(check, &check->msos20_view.findings);
+    }
+    fprintf(check->out, "\n");
+
+    file_list_free(&links);
+    file_list_free(&functions);
+    file_list_free(&config_links);
+}
+
+static int check_gadget(struct gadget_check *check, const char *path) {
+    const char *name = strrchr(path, '/');
+    char strings[PATH_MAX];
+
+    check->path = path;
+    check->errors = 0;
+    check->warnings = 0;
+    name = name && name[1] != '\0' ? name + 1 : path;
+
+    fprintf(check->out, "=== Gadget %s (%s) ===\n", name, path);
+    long vid = read_number(check, path, "idVendor", 0);
+    long pid = read_number(check, path, "idProduct", 0);
+    fprintf(check->out, "idVendor: 0x%04lx, idProduct: 0x%04lx\n", vid, pid);
+    snprintf(strings, sizeof(strings), "%s/strings/0x409", path);
+    if (read_attr(check, strings, "product") > 0) {
+        fprintf(check->out, "Product: %s\n", check->attr);
+    }
+    if (read_attr(check, path, "UDC") > 0) {
+        fprintf(check->out, "Bound to UDC %s\n", check->attr);
+    } else {
+        fprintf(check->out, "Not bound\n");
+    }
+    int superspeed = read_attr(check, path, "max_speed") > 0 && strncmp(check->attr, "super-speed", 11) == 0;
+    fprintf(check->out, "\n");
+
+    check_bos_and_url(check, superspeed);
+    check_os_descriptors(check);
+
+    const char *verdict = check->errors > 0 ? COLOR_RED "FAIL" COLOR_RESET :
+                          check->warnings > 0 ? COLOR_ORANGE "WARN" COLOR_RESET : "PASS";
+    fprintf(check->out, "Gadget %s: %s (%d errors, %d warnings)\n\n", name, verdict, check->errors,
+            check->warnings);
+    return check->errors > 0 ? -1 : 0;
+}
+
+static int is_gadget(const char *path) {
+    char functions[PATH_MAX];
+    return snprintf(functions, sizeof(functions), "%s/functions", path) < (int)sizeof(functions) &&
+           is_directory(functions);
+}
+
+int configfs_check(FILE *out, const char * const *paths, int path_count) {
+    static const char * const default_paths[] = { CONFIGFS_GADGET_ROOT };
+    int status = 0, gadgets = 0, failing = 0;
+
+    struct gadget_check *check = calloc(1, sizeof(*check));
+    uint8_t *bytes = malloc(CONFIGFS_SET_SIZE + 255 + 255);
+    if (!check || !bytes) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        free(check);
+        free(bytes);
+        return -1;
+    }
+    check->out = out;
+    check->set = (struct descriptor_buffer){ bytes, 0, CONFIGFS_SET_SIZE, 0 };
+    check->bos = (struct descriptor_buffer){ bytes + CONFIGFS_SET_SIZE, 0, 255, 0 };
+    check->url = (struct descriptor_buffer){ bytes + CONFIGFS_SET_SIZE + 255, 0, 255, 0 };
+
+    if (path_count == 0) {
+        paths = default_paths;
+        path_count = 1;
+    }
+    for (int i = 0; i < path_count; i++) {
+        if (!is_directory(paths[i])) {
+            printf(COLOR_RED "ERROR: %s is not a directory\n" COLOR_RESET, paths[i]);
+            printf("Make sure libcomposite is loaded and configfs is mounted on /sys/kernel/config\n");
+            status = -1;
+            continue;
+        }
+        if (is_gadget(paths[i])) {
+            failing += check_gadget(check, paths[i]) != 0;
+            gadgets++;
+            continue;
+        }
+
+        struct file_list names = { 0 };
+        list_names(paths[i], "", 0, &names);
+        for (int k = 0; k < names.count; k++) {
+            char gadget[PATH_MAX];
+            if (snprintf(gadget, sizeof(gadget), "%s/%s", paths[i], names.paths[k]) < (int)sizeof(gadget) &&
+                is_gadget(gadget)) {
+                failing += check_gadget(check, gadget) != 0;
+                gadgets++;
+            }
+        }
+        file_list_free(&names);
+    }
+
+    if (gadgets == 0 && status == 0) {
+        printf(COLOR_RED "ERROR: No gadgets found\n" COLOR_RESET);
+        status = -1;
+    } else if (gadgets > 0) {
+        fprintf(out, "Gadgets: %d checked, %d failing\n", gadgets, failing);
+    }
+
+    free(bytes);
+    free(check);
+    return failing > 0 ? -1 : status;
+}
@@ -0,0 +1,32 @@
+#ifndef CONFIGFS_GADGET_H
+#define CONFIGFS_GADGET_H
+
+#include <stdio.h>
+
+/*
+ * Pre-bind checks of Linux configfs gadgets
+ *
+ * A gadget directory (usb_gadget/<name>) is read the way libcomposite reads
+ * it at bind time: the webusb attributes give the WebUSB platform capability
+ * and URL descriptor, os_desc gives the MS OS string and vendor code, and
+ * the os_desc/interface.* directories of the functions linked into the
+ * os_desc configuration give the Compatible IDs and registry properties.
+ * The BOS and URL descriptor are built byte for byte as the kernel sends
+ * them. The kernel answers MS OS requests with MS OS 1.0 descriptors; their
+ * contents are laid out as the equivalent MS OS 2.0 descriptor set so the
+ * same Compatible ID and registry property rules apply. Every blob goes
+ * through the usual parsers, so nothing has to be bound or plugged in.
+ *
+ * Any directory with the same layout works, so fixtures can be checked on
+ * machines without libcomposite.
+ */
+
+#define CONFIGFS_GADGET_ROOT    "/sys/kernel/config/usb_gadget"
+#define CONFIGFS_ATTR_SIZE      4096    // configfs attributes are at most one page
+#define CONFIGFS_SET_SIZE       65535   // wTotalLength of a descriptor set is 16 bits
+
+// Check every gadget under each path (a gadget directory or a directory of gadgets)
+// 0 if gadgets were found and none has errors, -1 otherwise
+int configfs_check(FILE *out, const char * const *paths, int path_count);
+
+#endif
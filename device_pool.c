@@ -0,0 +1,534 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "device_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "report.h"
+#include "report_buffer.h"
+
+#define WATCH_POLL_MS   100     // How often watch mode checks the stop flag
+
+// Bus first, then port chain; a hub sorts before the devices behind it
+static int compare_paths(const void *a, const void *b) {
+    const struct pool_device *x = *(struct pool_device * const *)a;
+    const struct pool_device *y = *(struct pool_device * const *)b;
+
+    if (x->bus != y->bus) {
+        return x->bus < y->bus ? -1 : 1;
+    }
+    for (int i = 0; i < x->port_count && i < y->port_count; i++) {
+        if (x->ports[i] != y->ports[i]) {
+            return x->ports[i] < y->ports[i] ? -1 : 1;
+        }
+    }
+    return x->port_count - y->port_count;
+}
+
+// Same notation as sysfs: "1-4.2", root hubs are "1-0"
+static void format_path(struct pool_device *d) {
+    int length = snprintf(d->path, sizeof(d->path), "%d-", d->bus);
+    if (d->port_count == 0) {
+        snprintf(d->path + length, sizeof(d->path) - length, "0");
+        return;
+    }
+    for (int i = 0; i < d->port_count && length < (int)sizeof(d->path); i++) {
+        length += snprintf(d->path + length, sizeof(d->path) - length, i ? ".%d" : "%d", d->ports[i]);
+    }
+}
+
+void pool_init(struct device_pool *pool, struct usb_engine *engine) {
+    memset(pool, 0, sizeof(*pool));
+    pool->engine = engine;
+}
+
+// A new entry at the end of the queue, or NULL if out of memory
+static struct pool_device *append_device(struct device_pool *pool, uint16_t vid, uint16_t pid) {
+    if (pool->count == pool->capacity) {
+        int capacity = pool->capacity ? pool->capacity * 2 : 16;
+        struct pool_device **devices = realloc(pool->devices, capacity * sizeof(*devices));
+        if (!devices) {
+            return NULL;
+        }
+        pool->devices = devices;
+        pool->capacity = capacity;
+    }
+
+    struct pool_device *d = calloc(1, sizeof(*d));
+    if (!d) {
+        return NULL;
+    }
+    d->vid = vid;
+    d->pid = pid;
+    d->arrival_ns = engine_now_ns();
+    pool->devices[pool->count++] = d;
+    return d;
+}
+
+int pool_add(struct device_pool *pool, libusb_device *device) {
+    struct libusb_device_descriptor desc;
+    int result = libusb_get_device_descriptor(device, &desc);
+    if (result != 0) {
+        return result;
+    }
+
+    struct pool_device *d = append_device(pool, desc.idVendor, desc.idProduct);
+    if (!d) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+    d->device = libusb_ref_device(device);
+    d->bus = libusb_get_bus_number(device);
+    d->port_count = libusb_get_port_numbers(device, d->ports, sizeof(d->ports));
+    if (d->port_count < 0) {
+        d->port_count = 0;
+    }
+    format_path(d);
+    return 0;
+}
+
+int pool_add_virtual(struct device_pool *pool, libusb_device_handle *handle, uint16_t vid, uint16_t pid) {
+    int index = pool->count;
+    if (index >= POOL_VIRTUAL_MAX) {
+        return LIBUSB_ERROR_OVERFLOW;
+    }
+
+    struct pool_device *d = append_device(pool, vid, pid);
+    if (!d) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+    d->handle = handle;
+    d->bus = 0;
+    d->ports[0] = 1 + index / (127 * 127);
+    d->ports[1] = 1 + index / 127 % 127;
+    d->ports[2] = 1 + index % 127;
+    d->port_count = 3;
+    format_path(d);
+    return 0;
+}
+
+int pool_collect(struct device_pool *pool, int match_all, uint16_t vid, uint16_t pid) {
+    libusb_device **list;
+
+    ssize_t count = libusb_get_device_list(pool->engine->ctx, &list);
+    if (count < 0) {
+        return (int)count;
+    }
+
+    for (ssize_t i = 0; i < count; i++) {
+        struct libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(list[i], &desc) != 0) {
+            continue;
+        }
+        if (!match_all && (desc.idVendor != vid || desc.idProduct != pid)) {
+            continue;
+        }
+        int result = pool_add(pool, list[i]);
+        if (result != 0) {
+            libusb_free_device_list(list, 1);
+            return result;
+        }
+    }
+    libusb_free_device_list(list, 1);
+
+    qsort(pool->devices, pool->count, sizeof(*pool->devices), compare_paths);
+    return pool->count;
+}
+
+static void session_finished(struct usb_session *session) {
+    struct pool_device *d = session->user_data;
+
+    // JSON records are written when the device is reaped, outside the event handler
+    if (d->report_stream) {
+        session_render(d->report_stream, session);
+    }
+    d->status = session_status(session);
+    d->state = POOL_FINISHED;
+}
+
+// Path and identity first, so a consumer can route the record before reading the rest
+static void json_begin_device(struct json_writer *json, const struct pool_device *d) {
+    json_begin_object(json, NULL);
+    json_string(json, "path", d->path);
+    json_int(json, "vid", d->vid);
+    json_int(json, "pid", d->pid);
+}
+
+static void json_open_failed(struct json_writer *json, const struct pool_device *d, int result) {
+    json_begin_device(json, d);
+    json_string(json, "status", "error");
+    json_string(json, "error", libusb_error_name(result));
+    json_end_object(json);
+    json_end_record(json);
+}
+
+// Close the report and mark the device ready to print
+static void device_done(struct device_pool *pool, struct pool_device *d) {
+    if (d->report_stream) {
+        fclose(d->report_stream);
+        d->report_stream = NULL;
+    }
+    d->state = POOL_DONE;
+    pool->analyzed++;
+    if (d->status != 0) {
+        pool->failed++;
+    }
+}
+
+// A virtual device's handle belongs to its backend and is never closed
+static void close_handle(struct pool_device *d) {
+    if (d->device && d->handle) {
+        libusb_close(d->handle);
+    }
+    d->handle = NULL;
+}
+
+static void start_device(struct device_pool *pool, struct pool_device *d) {
+    int quiet = pool->session_flags & SESSION_QUIET;
+
+    d->status = -1;
+    if (!pool->json && !quiet) {
+        d->report_stream = report_stream_open(&d->report, &d->report_size);
+        if (!d->report_stream) {
+            device_done(pool, d);
+            return;
+        }
+        fprintf(d->report_stream, "######## Device %s (%04x:%04x) ########\n\n", d->path, d->vid, d->pid);
+    }
+
+    // Virtual devices come with their handle
+    if (d->device) {
+        int result = libusb_open(d->device, &d->handle);
+        if (result != 0) {
+            if (pool->json) {
+                json_open_failed(pool->json, d, result);
+            } else if (quiet) {
+                d->outcome = OUTCOME_NO_DEVICE;
+                d->outcome_detail = libusb_error_name(result);
+            } else {
+                fprintf(d->report_stream, COLOR_RED "ERROR: Could not open device: %s\n\n" COLOR_RESET,
+                        libusb_error_name(result));
+            }
+            d->handle = NULL;
+            device_done(pool, d);
+            return;
+        }
+
+        session_detach_kernel_driver(pool->json || quiet ? stderr : d->report_stream, d->handle);
+    }
+
+    if (pool->spare_count > 0) {
+        d->session = pool->spare_sessions[--pool->spare_count];
+        session_reset(d->session, d->handle);
+    } else {
+        d->session = session_create(pool->engine, d->handle);
+    }
+    if (!d->session) {
+        if (pool->json) {
+            json_open_failed(pool->json, d, LIBUSB_ERROR_NO_MEM);
+        } else if (quiet) {
+            d->outcome = OUTCOME_USB_ERROR;
+            d->outcome_detail = libusb_error_name(LIBUSB_ERROR_NO_MEM);
+        } else {
+            fprintf(d->report_stream, COLOR_RED "ERROR: Out of memory\n\n" COLOR_RESET);
+        }
+        close_handle(d);
+        device_done(pool, d);
+        return;
+    }
+
+    d->session->flags = pool->session_flags;
+    d->session->on_complete = session_finished;
+    d->session->user_data = d;
+    d->state = POOL_RUNNING;
+    pool->active++;
+    session_start(d->session);
+}
+
+// Keep a finished session for the next device, up to one per slot
+static void release_session(struct device_pool *pool, struct usb_session *session) {
+    if (!pool->spare_sessions) {
+        pool->spare_sessions = malloc(pool->max_active * sizeof(*pool->spare_sessions));
+    }
+    if (pool->spare_sessions && pool->spare_count < pool->max_active) {
+        pool->spare_sessions[pool->spare_count++] = session;
+    } else {
+        session_destroy(session);
+    }
+}
+
+// Release finished devices outside the event handler, freeing their slot
+static void reap_finished(struct device_pool *pool) {
+    for (int i = 0; i < pool->next_queued; i++) {
+        struct pool_device *d = pool->devices[i];
+        if (d->state != POOL_FINISHED) {
+            continue;
+        }
+
+        // The verdict is the last line of the report
+        int errors, warnings;
+        session_count_findings(d->session, &errors, &warnings);
+        double since_attach_ms = (double)(engine_now_ns() - d->arrival_ns) / 1e6;
+        if (pool->json) {
+            json_begin_device(pool->json, d);
+            json_string(pool->json, "verdict", d->status != 0 || errors > 0 ? "fail" : warnings > 0 ? "warn" : "pass");
+            json_double(pool->json, "since_attach_ms", since_attach_ms);
+            session_render_json(pool->json, d->session);
+            json_end_object(pool->json);
+            json_end_record(pool->json);
+        } else if (pool->session_flags & SESSION_QUIET) {
+            d->outcome = session_outcome(d->session, &d->outcome_detail);
+        } else {
+            const char *verdict = d->status != 0 || errors > 0 ? COLOR_RED "FAIL" COLOR_RESET :
+                                  warnings > 0 ? COLOR_ORANGE "WARN" COLOR_RESET : "PASS";
+            fprintf(d->report_stream, "Verdict %s: %s (%d errors, %d warnings, %.1f ms since attach)\n\n",
+                    d->path, verdict, errors, warnings, since_attach_ms);
+        }
+
+        release_session(pool, d->session);
+        d->session = NULL;
+        close_handle(d);
+        pool->active--;
+        device_done(pool, d);
+    }
+}
+
+/*
+ * After an event error, bring back every transfer still in flight so the
+ * sessions can be released. If the loop cannot drain, the running devices
+ * give up their session and handle without freeing them.
+ */
+static void cancel_running(struct device_pool *pool, FILE *out) {
+    int result = engine_cancel(pool->engine);
+    if (result != 0) {
+        fprintf(out, COLOR_RED "ERROR: Could not cancel pending USB transfers: %s\n" COLOR_RESET,
+                libusb_error_name(result));
+        for (int i = 0; i < pool->next_queued; i++) {
+            struct pool_device *d = pool->devices[i];
+            if (d->state == POOL_RUNNING) {
+                d->session = NULL;
+                d->handle = NULL;
+            }
+        }
+        return;
+    }
+    reap_finished(pool);
+}
+
+// Write the reports of finished devices in order, each run of complete reports with one writev()
+static void print_reports(FILE *out, struct pool_device **ready, int count) {
+    struct iovec parts[REPORT_WRITE_MAX_PARTS];
+    int next = 0;
+
+    while (next < count) {
+        int parts_count = 0;
+        while (next + parts_count < count && parts_count < REPORT_WRITE_MAX_PARTS && ready[next + parts_count]->report) {
+            parts[parts_count].iov_base = ready[next + parts_count]->report;
+            parts[parts_count].iov_len = ready[next + parts_count]->report_size;
+            parts_count++;
+        }
+        if (parts_count == 0) {
+            fprintf(out, COLOR_RED "ERROR: No report for device %s (out of memory)\n\n" COLOR_RESET,
+                    ready[next++]->path);
+            continue;
+        }
+        report_write(out, parts, parts_count);
+        for (int i = 0; i < parts_count; i++, next++) {
+            free(ready[next]->report);
+            ready[next]->report = NULL;
+        }
+    }
+}
+
+// Reports, or one outcome line per device for quiet sessions; the first failure printed becomes the pool's outcome
+static void print_devices(struct device_pool *pool, FILE *out, struct pool_device **ready, int count) {
+    if (pool->json) {
+        return;
+    }
+    if (!(pool->session_flags & SESSION_QUIET)) {
+        print_reports(out, ready, count);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        session_print_outcome(out, ready[i]->path, ready[i]->outcome, ready[i]->outcome_detail);
+        if (pool->outcome <= OUTCOME_WARN && ready[i]->outcome > pool->outcome) {
+            pool->outcome = ready[i]->outcome;
+        }
+    }
+}
+
+static void print_ready(struct device_pool *pool, FILE *out) {
+    int first = pool->next_printed;
+
+    while (pool->next_printed < pool->count && pool->devices[pool->next_printed]->state == POOL_DONE) {
+        pool->next_printed++;
+    }
+    print_devices(pool, out, &pool->devices[first], pool->next_printed - first);
+    fflush(out);
+}
+
+static void free_device(struct pool_device *d) {
+    session_destroy(d->session);
+    close_handle(d);
+    if (d->report_stream) {
+        fclose(d->report_stream);
+    }
+    free(d->report);
+    if (d->device) {
+        libusb_unref_device(d->device);
+    }
+    free(d);
+}
+
+// Start queued devices while there is a free slot
+static void start_queued(struct device_pool *pool) {
+    while (pool->active < pool->max_active && pool->next_queued < pool->count) {
+        start_device(pool, pool->devices[pool->next_queued++]);
+    }
+}
+
+int pool_run(struct device_pool *pool, FILE *out, int max_active) {
+    uint64_t start_ns = engine_now_ns();
+
+    pool->max_active = max_active > 0 ? max_active : 1;
+
+    for (;;) {
+        reap_finished(pool);
+        print_ready(pool, out);
+        start_queued(pool);
+        if (pool->active == 0 && pool->next_queued == pool->count) {
+            reap_finished(pool);
+            print_ready(pool, out);
+            break;
+        }
+
+        int result = engine_handle_events(pool->engine, ENGINE_POLL_MS);
+        if (result != 0) {
+            fprintf(out, COLOR_RED "ERROR: USB event handling failed: %s\n" COLOR_RESET,
+                    libusb_error_name(result));
+            cancel_running(pool, out);
+            print_ready(pool, out);
+            return result;
+        }
+    }
+
+    if (!(pool->session_flags & SESSION_QUIET)) {
+        fprintf(out, "Analyzed %d device(s) in %.1f ms: %d ok, %d failed\n", pool->analyzed,
+                (double)(engine_now_ns() - start_ns) / 1e6, pool->analyzed - pool->failed, pool->failed);
+    }
+    return 0;
+}
+
+static int LIBUSB_CALL device_arrived(libusb_context *ctx, libusb_device *device,
+                                      libusb_hotplug_event event, void *user_data) {
+    struct device_pool *pool = user_data;
+    (void)ctx;
+    (void)event;
+
+    // No I/O from the hotplug callback: queue the device, the watch loop opens it
+    int result = pool_add(pool, device);
+    if (result != 0) {
+        printf(COLOR_RED "ERROR: Could not queue new device: %s\n" COLOR_RESET, libusb_error_name(result));
+    }
+    return 0;
+}
+
+static void drop_devices(struct device_pool *pool, FILE *out, struct pool_device **done, int count) {
+    print_devices(pool, out, done, count);
+    for (int i = 0; i < count; i++) {
+        free_device(done[i]);
+    }
+}
+
+// Print and drop every finished device in completion order, keeping the queue order of the rest
+static void print_and_drop_done(struct device_pool *pool, FILE *out) {
+    struct pool_device *done[REPORT_WRITE_MAX_PARTS];
+    int done_count = 0;
+    int kept = 0;
+    int kept_queued = 0;
+
+    for (int i = 0; i < pool->count; i++) {
+        struct pool_device *d = pool->devices[i];
+        if (d->state == POOL_DONE) {
+            done[done_count++] = d;
+            if (done_count == REPORT_WRITE_MAX_PARTS) {
+                drop_devices(pool, out, done, done_count);
+                done_count = 0;
+            }
+            continue;
+        }
+        if (i < pool->next_queued) {
+            kept_queued++;
+        }
+        pool->devices[kept++] = d;
+    }
+    drop_devices(pool, out, done, done_count);
+    pool->count = kept;
+    pool->next_queued = kept_queued;
+    pool->next_printed = 0;
+    fflush(out);
+}
+
+int pool_watch(struct device_pool *pool, FILE *out, int max_active, int match_all,
+               uint16_t vid, uint16_t pid, volatile sig_atomic_t *stop) {
+    libusb_hotplug_callback_handle callback;
+
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        fprintf(out, COLOR_RED "ERROR: Hotplug is not supported on this platform\n" COLOR_RESET);
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+
+    pool->max_active = max_active > 0 ? max_active : 1;
+
+    int result = libusb_hotplug_register_callback(pool->engine->ctx, LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED, 0,
+                                                  match_all ? LIBUSB_HOTPLUG_MATCH_ANY : vid,
+                                                  match_all ? LIBUSB_HOTPLUG_MATCH_ANY : pid,
+                                                  LIBUSB_HOTPLUG_MATCH_ANY, device_arrived, pool, &callback);
+    if (result != 0) {
+        fprintf(out, COLOR_RED "ERROR: Could not register hotplug callback: %s\n" COLOR_RESET,
+                libusb_error_name(result));
+        return result;
+    }
+
+    while (!*stop) {
+        reap_finished(pool);
+        print_and_drop_done(pool, out);
+        start_queued(pool);
+
+        result = engine_handle_events(pool->engine, WATCH_POLL_MS);
+        if (result != 0) {
+            fprintf(out, COLOR_RED "ERROR: USB event handling failed: %s\n" COLOR_RESET,
+                    libusb_error_name(result));
+            break;
+        }
+    }
+
+    libusb_hotplug_deregister_callback(pool->engine->ctx, callback);
+
+    // Let devices already being analyzed finish
+    while (result == 0 && pool->active > 0) {
+        result = engine_handle_events(pool->engine, ENGINE_POLL_MS);
+        reap_finished(pool);
+    }
+    if (result != 0) {
+        cancel_running(pool, out);
+    }
+    print_and_drop_done(pool, out);
+    return result;
+}
+
+int pool_status(const struct device_pool *pool) {
+    return pool->analyzed > 0 && pool->failed == 0 ? 0 : -1;
+}
+
+void pool_free(struct device_pool *pool) {
+    for (int i = 0; i < pool->count; i++) {
+        free_device(pool->devices[i]);
+    }
+    free(pool->devices);
+    for (int i = 0; i < pool->spare_count; i++) {
+        session_destroy(pool->spare_sessions[i]);
+    }
+    free(pool->spare_sessions);
+    memset(pool, 0, sizeof(*pool));
+}
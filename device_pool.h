@@ -0,0 +1,117 @@
+#ifndef DEVICE_POOL_H
+#define DEVICE_POOL_H
+
+#include <libusb-1.0/libusb.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "json_writer.h"
+#include "usb_engine.h"
+#include "usb_session.h"
+
+/*
+ * Concurrent analysis of several devices
+ *
+ * Every selected device gets its own session, and all sessions share one
+ * event loop. At most max_active devices are open at a time; when one
+ * finishes, its handle is closed and the next queued device is opened.
+ * Each device's report is rendered into its own buffer and printed in
+ * bus/port order, so the output does not depend on completion order.
+ *
+ * In watch mode devices are added by the hotplug callback as they arrive,
+ * and each report is printed with a one-line verdict as soon as the device
+ * is done.
+ *
+ * With a JSON writer set, each device becomes one NDJSON record instead,
+ * written as soon as the device is done and never buffered in the pool.
+ * Kernel driver messages then go to stderr. Sessions with SESSION_QUIET
+ * render nothing either: each device prints one outcome line in place of
+ * its report.
+ */
+
+#define POOL_DEFAULT_ACTIVE     8
+#define POOL_PATH_MAX           32      // "bus-port.port...", USB allows 7 tiers
+#define POOL_VIRTUAL_MAX        (127 * 127 * 127)
+
+enum pool_device_state {
+    POOL_QUEUED = 0,
+    POOL_RUNNING,
+    POOL_FINISHED,          // Report rendered, handle still open
+    POOL_DONE,              // Handle closed, report ready to print
+};
+
+struct pool_device {
+    libusb_device *device;              // NULL for a virtual device
+    char path[POOL_PATH_MAX];
+    uint8_t bus;
+    uint8_t ports[7];
+    int port_count;
+    uint16_t vid;
+    uint16_t pid;
+    uint64_t arrival_ns;
+
+    int state;                          // enum pool_device_state
+    libusb_device_handle *handle;
+    struct usb_session *session;
+    FILE *report_stream;
+    char *report;
+    size_t report_size;
+    int status;                         // session_status(), or -1 if the device could not be opened
+    int outcome;                        // enum session_outcome, for quiet sessions
+    const char *outcome_detail;
+};
+
+struct device_pool {
+    struct usb_engine *engine;
+    struct pool_device **devices;       // Sorted by bus/port path, except in watch mode
+    int count;
+    int capacity;
+    int max_active;
+    int active;
+    int next_queued;
+    int next_printed;
+    int analyzed;                       // Devices whose report is complete
+    int failed;                         // ...of which status != 0
+    struct json_writer *json;           // NDJSON records instead of text reports, if set
+    int session_flags;                  // Flags of every device's session (SESSION_*)
+    int outcome;                        // First failure printed, else WARN if any device warned (quiet runs)
+    struct usb_session **spare_sessions; // Finished sessions kept for reuse, at most max_active
+    int spare_count;
+};
+
+void pool_init(struct device_pool *pool, struct usb_engine *engine);
+
+// Queue a device for analysis, taking a reference to it
+int pool_add(struct device_pool *pool, libusb_device *device);
+
+/*
+ * Queue a simulated device that is already open: the backend of the pool's
+ * engine must understand handle. Virtual devices are numbered on bus 0 in
+ * the order they are added ("0-1.1.1", "0-1.1.2", ...) and are never closed.
+ */
+int pool_add_virtual(struct device_pool *pool, libusb_device_handle *handle, uint16_t vid, uint16_t pid);
+
+/*
+ * Select devices from the host's device list. With match_all set every
+ * device is selected; otherwise only those with the given VID and PID.
+ * Returns the number of selected devices or a LIBUSB_ERROR_* code.
+ */
+int pool_collect(struct device_pool *pool, int match_all, uint16_t vid, uint16_t pid);
+
+// Analyze every selected device, printing each report to out as soon as its turn comes
+int pool_run(struct device_pool *pool, FILE *out, int max_active);
+
+/*
+ * Analyze devices as they are attached until *stop is set, streaming each
+ * report and its verdict to out. Devices already present are not analyzed.
+ */
+int pool_watch(struct device_pool *pool, FILE *out, int max_active, int match_all,
+               uint16_t vid, uint16_t pid, volatile sig_atomic_t *stop);
+
+// 0 if at least one device was analyzed and none failed, -1 otherwise
+int pool_status(const struct device_pool *pool);
+
+void pool_free(struct device_pool *pool);
+
+#endif
@@ -0,0 +1,525 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "firmware_scan.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "batch.h"
+#include "report.h"
+#include "report_buffer.h"
+#include "usb_descriptors.h"
+#include "usb_engine.h"
+
+#define FIRMWARE_MAX_REGIONS    64
+#define MSOS20_WINDOWS_MAJOR    0x06    // High byte of dwWindowsVersion, 0x06030000 and later
+
+// A searched part of the file: the whole of a raw image, or one loadable ELF segment
+struct region {
+    size_t offset;
+    size_t size;
+    uint64_t address;
+};
+
+enum hit_kind {
+    HIT_CAPABILITY,             // WebUSB or MS OS 2.0 platform capability
+    HIT_SET_HEADER,             // MS OS 2.0 descriptor set header
+};
+
+struct hit {
+    size_t offset;              // Start of the descriptor in the file
+    int region;
+    enum hit_kind kind;
+};
+
+struct hit_list {
+    struct hit *items;
+    int count;
+    int capacity;
+};
+
+struct firmware_result {
+    char *report;
+    size_t report_size;
+    int readable;
+    int descriptors;
+    int errors;
+    int warnings;
+};
+
+struct firmware_worker {
+    struct bos_view bos_view;
+    struct msos20_view msos20_view;
+};
+
+struct firmware_batch {
+    const char * const *paths;
+    struct firmware_result *results;
+    int count;
+    pthread_mutex_t lock;
+    int next;                   // Protected by lock
+};
+
+static void add_hit(struct hit_list *hits, size_t offset, int region, enum hit_kind kind) {
+    if (hits->count == hits->capacity) {
+        int capacity = hits->capacity ? hits->capacity * 2 : 16;
+        struct hit *items = realloc(hits->items, capacity * sizeof(*items));
+        if (!items) {
+            return;
+        }
+        hits->items = items;
+        hits->capacity = capacity;
+    }
+    hits->items[hits->count++] = (struct hit){ offset, region, kind };
+}
+
+// Full check of a position the vector search flagged
+static void check_candidate(const uint8_t *data, size_t size, size_t pos, const struct region *region,
+                            int region_index, struct hit_list *hits) {
+    if (pos >= 4 && size - pos >= 16 && data[pos - 4] >= 20 && data[pos - 3] == USB_DT_DEVICE_CAPABILITY &&
+        data[pos - 2] == USB_PLAT_DEV_CAP_TYPE) {
+        enum platform_capability kind = lookup_platform_capability(&data[pos]);
+        if (kind == PLATFORM_WEBUSB || kind == PLATFORM_MSOS20) {
+            add_hit(hits, region->offset + pos - 4, region_index, HIT_CAPABILITY);
+            return;
+        }
+    }
+    if (size - pos >= 10 && get_le16(&data[pos]) == 10 &&
+        get_le16(&data[pos + 2]) == MS_OS_20_SET_HEADER_DESCRIPTOR &&
+        data[pos + 7] == MSOS20_WINDOWS_MAJOR && get_le16(&data[pos + 8]) >= 10) {
+        add_hit(hits, region->offset + pos, region_index, HIT_SET_HEADER);
+    }
+}
+
+/*
+ * Flag positions that start with the first two bytes of either UUID, or
+ * with a 10-byte length whose dwWindowsVersion has the expected major byte.
+ */
+static void search_region(const uint8_t *file, const struct region *region, int region_index,
+                          struct hit_list *hits) {
+    const uint8_t *data = file + region->offset;
+    size_t size = region->size;
+    size_t pos = 0;
+
+#if defined(__SSE2__)
+    const __m128i webusb_0 = _mm_set1_epi8((char)0x38), webusb_1 = _mm_set1_epi8((char)0xb6);
+    const __m128i msos20_0 = _mm_set1_epi8((char)0xdf), msos20_1 = _mm_set1_epi8((char)0x60);
+    const __m128i set_0 = _mm_set1_epi8(10), set_7 = _mm_set1_epi8(MSOS20_WINDOWS_MAJOR);
+
+    for (; size >= 23 && pos <= size - 23; pos += 16) {
+        __m128i at_0 = _mm_loadu_si128((const __m128i *)&data[pos]);
+        __m128i at_1 = _mm_loadu_si128((const __m128i *)&data[pos + 1]);
+        __m128i at_7 = _mm_loadu_si128((const __m128i *)&data[pos + 7]);
+
+        __m128i webusb = _mm_and_si128(_mm_cmpeq_epi8(at_0, webusb_0), _mm_cmpeq_epi8(at_1, webusb_1));
+        __m128i msos20 = _mm_and_si128(_mm_cmpeq_epi8(at_0, msos20_0), _mm_cmpeq_epi8(at_1, msos20_1));
+        __m128i set = _mm_and_si128(_mm_cmpeq_epi8(at_0, set_0), _mm_cmpeq_epi8(at_7, set_7));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(webusb, msos20), set));
+
+        while (mask) {
+            check_candidate(data, size, pos + (size_t)__builtin_ctz(mask), region, region_index, hits);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; pos < size; pos++) {
+        if (data[pos] == 0x38 || data[pos] == 0xdf || data[pos] == 10) {
+            check_candidate(data, size, pos, region, region_index, hits);
+        }
+    }
+}
+
+static uint16_t elf16(const uint8_t *p, int big_endian) {
+    return big_endian ? (uint16_t)((p[0] << 8) | p[1]) : get_le16(p);
+}
+
+static uint32_t elf32(const uint8_t *p, int big_endian) {
+    return big_endian ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3] :
+                        get_le32(p);
+}
+
+static uint64_t elf64(const uint8_t *p, int big_endian) {
+    uint64_t first = elf32(p, big_endian), second = elf32(p + 4, big_endian);
+    return big_endian ? (first << 32) | second : (second << 32) | first;
+}
+
+// Loadable segments of an ELF file; -1 if the headers are damaged
+static int elf_regions(const uint8_t *data, size_t size, struct region *regions, int *count) {
+    if (size < EI_NIDENT || (data[EI_CLASS] != ELFCLASS32 && data[EI_CLASS] != ELFCLASS64)) {
+        return -1;
+    }
+    int is64 = data[EI_CLASS] == ELFCLASS64;
+    int big_endian = data[EI_DATA] == ELFDATA2MSB;
+    size_t header_size = is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+    if (size < header_size) {
+        return -1;
+    }
+
+    uint64_t phoff = is64 ? elf64(&data[offsetof(Elf64_Ehdr, e_phoff)], big_endian) :
+                            elf32(&data[offsetof(Elf32_Ehdr, e_phoff)], big_endian);
+    uint16_t phentsize = elf16(&data[is64 ? offsetof(Elf64_Ehdr, e_phentsize) : offsetof(Elf32_Ehdr, e_phentsize)],
+                               big_endian);
+    uint16_t phnum = elf16(&data[is64 ? offsetof(Elf64_Ehdr, e_phnum) : offsetof(Elf32_Ehdr, e_phnum)],
+                           big_endian);
+    size_t entry_size = is64 ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+    if (phentsize < entry_size || phoff > size || (uint64_t)phnum * phentsize > size - phoff) {
+        return -1;
+    }
+
+    *count = 0;
+    for (int i = 0; i < phnum && *count < FIRMWARE_MAX_REGIONS; i++) {
+        const uint8_t *ph = &data[phoff + (size_t)i * phentsize];
+        uint32_t type = elf32(ph, big_endian);
+        uint64_t offset, filesz, vaddr;
+        if (is64) {
+            offset = elf64(&ph[offsetof(Elf64_Phdr, p_offset)], big_endian);
+            filesz = elf64(&ph[offsetof(Elf64_Phdr, p_filesz)], big_endian);
+            vaddr = elf64(&ph[offsetof(Elf64_Phdr, p_vaddr)], big_endian);
+        } else {
+            offset = elf32(&ph[offsetof(Elf32_Phdr, p_offset)], big_endian);
+            filesz = elf32(&ph[offsetof(Elf32_Phdr, p_filesz)], big_endian);
+            vaddr = elf32(&ph[offsetof(Elf32_Phdr, p_vaddr)], big_endian);
+        }
+        if (type != PT_LOAD || filesz == 0) {
+            continue;
+        }
+        if (offset > size || filesz > size - offset) {
+            return -1;
+        }
+        regions[(*count)++] = (struct region){ (size_t)offset, (size_t)filesz, vaddr };
+    }
+    return 0;
+}
+
+static void print_location(FILE *out, int is_elf, const struct region *region, size_t offset) {
+    if (is_elf) {
+        fprintf(out, "  0x%08zx (address 0x%08llx): ", offset,
+                (unsigned long long)(region->address + (offset - region->offset)));
+    } else {
+        fprintf(out, "  0x%08zx: ", offset);
+    }
+}
+
+static void print_findings(FILE *out, struct firmware_result *result, const struct finding_list *findings) {
+    for (int i = 0; i < findings->count; i++) {
+        render_finding(out, "    ", &findings->items[i]);
+    }
+    if (findings->dropped > 0) {
+        fprintf(out, "    (%d further finding(s) not shown)\n", findings->dropped);
+    }
+    result->descriptors++;
+    result->errors += findings->error_count;
+    result->warnings += findings->warning_count;
+}
+
+/*
+ * The nearest BOS header before a capability whose chain of device
+ * capabilities reaches it exactly; returns its offset or the capability's
+ * own offset if there is none.
+ */
+static size_t find_bos_header(const uint8_t *data, const struct region *region, size_t capability) {
+    size_t lowest = capability - region->offset > FIRMWARE_BOS_LOOKBACK ? capability - FIRMWARE_BOS_LOOKBACK :
+                    region->offset;
+
+    if (capability - lowest < USB_DT_BOS_SIZE) {
+        return capability;
+    }
+    for (size_t bos = capability - USB_DT_BOS_SIZE; ; bos--) {
+        if (data[bos] == USB_DT_BOS_SIZE && data[bos + 1] == USB_DT_BOS) {
+            size_t pos = bos + USB_DT_BOS_SIZE;
+            while (pos < capability && data[pos] >= 3 && data[pos + 1] == USB_DT_DEVICE_CAPABILITY) {
+                pos += data[pos];
+            }
+            if (pos == capability) {
+                return bos;
+            }
+        }
+        if (bos == lowest) {
+            break;
+        }
+    }
+    return capability;
+}
+
+// End of the capability chain after a BOS header, as far as it looks like one
+static size_t capability_chain_end(const uint8_t *data, const struct region *region, size_t bos) {
+    size_t end = region->offset + region->size;
+    size_t pos = bos + USB_DT_BOS_SIZE;
+    for (int i = 0; i < data[bos + 4] && end - pos >= 3; i++) {
+        if (data[pos] < 3 || data[pos + 1] != USB_DT_DEVICE_CAPABILITY || data[pos] > end - pos) {
+            break;
+        }
+        pos += data[pos];
+    }
+    return pos;
+}
+
+static size_t carve_bos(FILE *out, struct firmware_worker *worker, struct firmware_result *result,
+                        const uint8_t *data, int is_elf, const struct region *region, size_t capability,
+                        uint16_t *declared_set_length) {
+    size_t end = region->offset + region->size;
+    size_t bos = find_bos_header(data, region, capability);
+
+    if (bos == capability) {
+        // No BOS header: check the capability on its own inside a minimal BOS
+        uint8_t buffer[USB_DT_BOS_SIZE + 255];
+        size_t length = data[capability] < end - capability ? data[capability] : end - capability;
+        buffer[0] = USB_DT_BOS_SIZE;
+        buffer[1] = USB_DT_BOS;
+        buffer[2] = (uint8_t)((USB_DT_BOS_SIZE + length) & 0xFF);
+        buffer[3] = (uint8_t)((USB_DT_BOS_SIZE + length) >> 8);
+        buffer[4] = 1;
+        memcpy(&buffer[USB_DT_BOS_SIZE], &data[capability], length);
+
+        parse_bos_descriptor(&worker->bos_view, buffer, (int)(USB_DT_BOS_SIZE + length), 0);
+        print_location(out, is_elf, region, capability);
+        fprintf(out, "platform capability without a BOS header (%zu bytes), %d errors, %d warnings\n", length,
+                worker->bos_view.findings.error_count, worker->bos_view.findings.warning_count);
+        print_findings(out, result, &worker->bos_view.findings);
+        *declared_set_length = worker->bos_view.summary.has_msos20 ? worker->bos_view.summary.msos20_set_length : 0;
+        return capability + length;
+    }
+
+    // Carve whatever is longer, wTotalLength or the capabilities that follow, so either mistake shows up
+    size_t length = get_le16(&data[bos + 2]);
+    if (length > end - bos) {
+        length = end - bos;
+    }
+    size_t chain = capability_chain_end(data, region, bos) - bos;
+    if (chain > length) {
+        length = chain;
+    }
+
+    parse_bos_descriptor(&worker->bos_view, &data[bos], (int)length, 0);
+    print_location(out, is_elf, region, bos);
+    fprintf(out, "BOS (%zu bytes), %d errors, %d warnings\n", length, worker->bos_view.findings.error_count,
+            worker->bos_view.findings.warning_count);
+    print_findings(out, result, &worker->bos_view.findings);
+    *declared_set_length = worker->bos_view.summary.has_msos20 ? worker->bos_view.summary.msos20_set_length : 0;
+    return bos + length;
+}
+
+static size_t carve_set(FILE *out, struct firmware_worker *worker, struct firmware_result *result,
+                        const uint8_t *data, int is_elf, const struct region *region, size_t header) {
+    size_t end = region->offset + region->size;
+    size_t length = get_le16(&data[header + 8]);
+    if (length > end - header) {
+        length = end - header;
+    }
+
+    parse_msos20_descriptor(&worker->msos20_view, &data[header], (int)length, 0);
+    print_location(out, is_elf, region, header);
+    fprintf(out, "MS OS 2.0 descriptor set (%zu bytes), %d errors, %d warnings\n", length,
+            worker->msos20_view.findings.error_count, worker->msos20_view.findings.warning_count);
+    print_findings(out, result, &worker->msos20_view.findings);
+    return header + length;
+}
+
+static void scan_image(FILE *out, struct firmware_worker *worker, struct firmware_result *result,
+                       const uint8_t *data, size_t size) {
+    struct region regions[FIRMWARE_MAX_REGIONS];
+    struct hit_list hits = { 0 };
+    int region_count = 1;
+    int is_elf = size >= SELFMAG && memcmp(data, ELFMAG, SELFMAG) == 0;
+
+    int damaged = is_elf && elf_regions(data, size, regions, &region_count) != 0;
+    if (!is_elf || damaged) {
+        region_count = 1;
+        regions[0] = (struct region){ 0, size, 0 };
+    }
+
+    size_t searched = 0;
+    for (int i = 0; i < region_count; i++) {
+        search_region(data, &regions[i], i, &hits);
+        searched += regions[i].size;
+    }
+    fprintf(out, "%s, %d region(s), %zu bytes searched\n", is_elf ? "ELF" : "raw image", region_count, searched);
+    if (damaged) {
+        fprintf(out, COLOR_ORANGE "  WARNING: Damaged ELF program headers, searched the whole file\n" COLOR_RESET);
+        is_elf = 0;
+        result->warnings++;
+    }
+
+    // Hits come out in file order per region; skip those inside a blob already carved
+    uint16_t declared[FIRMWARE_MAX_REGIONS * 4];
+    uint16_t found[FIRMWARE_MAX_REGIONS * 4];
+    int declared_count = 0, found_count = 0;
+    size_t carved_end = 0;
+    int carved_region = -1;
+    for (int i = 0; i < hits.count; i++) {
+        const struct hit *hit = &hits.items[i];
+        const struct region *region = &regions[hit->region];
+        if (hit->region == carved_region && hit->offset < carved_end) {
+            continue;
+        }
+        carved_region = hit->region;
+        if (hit->kind == HIT_CAPABILITY) {
+            uint16_t set_length;
+            carved_end = carve_bos(out, worker, result, data, is_elf, region, hit->offset, &set_length);
+            if (set_length > 0 && declared_count < (int)(sizeof(declared) / sizeof(declared[0]))) {
+                declared[declared_count++] = set_length;
+            }
+        } else {
+            carved_end = carve_set(out, worker, result, data, is_elf, region, hit->offset);
+            if (found_count < (int)(sizeof(found) / sizeof(found[0]))) {
+                found[found_count++] = get_le16(&data[hit->offset + 8]);
+            }
+        }
+    }
+
+    // A BOS promises a set of a given length; the image should contain it
+    for (int i = 0; i < declared_count; i++) {
+        int present = 0;
+        for (int j = 0; j < found_count && !present; j++) {
+            present = found[j] == declared[i];
+        }
+        if (!present) {
+            fprintf(out, COLOR_ORANGE "  WARNING: A BOS declares a %d-byte MS OS 2.0 descriptor set, "
+                    "but no set of that length was found\n" COLOR_RESET, declared[i]);
+            result->warnings++;
+        }
+    }
+    if (result->descriptors == 0) {
+        fprintf(out, "  No BOS or MS OS 2.0 descriptors found\n");
+    }
+    free(hits.items);
+}
+
+static void scan_file(struct firmware_worker *worker, struct firmware_batch *batch, int index) {
+    struct firmware_result *result = &batch->results[index];
+    const char *path = batch->paths[index];
+    struct stat st;
+
+    FILE *out = report_stream_open(&result->report, &result->report_size);
+    if (!out) {
+        return;
+    }
+    fprintf(out, "%s: ", path);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+        st.st_size > FIRMWARE_MAX_SIZE) {
+        fprintf(out, COLOR_RED "unreadable, empty or larger than %d MiB\n" COLOR_RESET,
+                FIRMWARE_MAX_SIZE / (1024 * 1024));
+        if (fd >= 0) {
+            close(fd);
+        }
+        fclose(out);
+        return;
+    }
+    size_t size = (size_t)st.st_size;
+    const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(out, COLOR_RED "cannot be mapped\n" COLOR_RESET);
+        fclose(out);
+        return;
+    }
+
+    result->readable = 1;
+    scan_image(out, worker, result, data, size);
+    munmap((void *)data, size);
+    fclose(out);
+}
+
+static void *worker_main(void *arg) {
+    struct firmware_batch *batch = arg;
+
+    // Too large for a thread stack; reused for every image this thread scans
+    struct firmware_worker *worker = calloc(1, sizeof(*worker));
+    if (!worker) {
+        return NULL;
+    }
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        int index = batch->next < batch->count ? batch->next++ : -1;
+        pthread_mutex_unlock(&batch->lock);
+        if (index < 0) {
+            break;
+        }
+        scan_file(worker, batch, index);
+    }
+    free(worker);
+    return NULL;
+}
+
+int firmware_scan(FILE *out, const char * const *paths, int path_count, int workers) {
+    struct firmware_batch batch = { 0 };
+    pthread_t threads[BATCH_MAX_WORKERS];
+    uint64_t start_ns = engine_now_ns();
+
+    batch.paths = paths;
+    batch.count = path_count;
+    batch.results = calloc(path_count > 0 ? path_count : 1, sizeof(*batch.results));
+    if (!batch.results) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        return -1;
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+
+    if (workers <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 0 ? (int)cores : 1;
+    }
+    if (workers > BATCH_MAX_WORKERS) {
+        workers = BATCH_MAX_WORKERS;
+    }
+    if (workers > path_count) {
+        workers = path_count > 0 ? path_count : 1;
+    }
+
+    int started = 0;
+    for (int i = 1; i < workers; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, &batch) != 0) {
+            break;
+        }
+        started = i;
+    }
+    worker_main(&batch);
+    for (int i = 1; i <= started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int status = 0, unreadable = 0, with_errors = 0, with_warnings = 0, descriptors = 0;
+    for (int i = 0; i < path_count; i++) {
+        struct firmware_result *result = &batch.results[i];
+        if (result->report) {
+            fwrite(result->report, 1, result->report_size, out);
+            free(result->report);
+        } else {
+            fprintf(out, "%s: " COLOR_RED "not scanned (out of memory)\n" COLOR_RESET, paths[i]);
+        }
+        descriptors += result->descriptors;
+        if (!result->readable) {
+            unreadable++;
+            status = -1;
+        } else if (result->errors > 0) {
+            with_errors++;
+            status = -1;
+        } else if (result->warnings > 0) {
+            with_warnings++;
+        }
+    }
+
+    fprintf(out, "\nFirmware: %d images, %d descriptors found in %.1f ms on %d thread(s)\n", path_count,
+            descriptors, (double)(engine_now_ns() - start_ns) / 1e6, workers);
+    fprintf(out, "%d clean, %d with warnings, %d with errors, %d unreadable\n",
+            path_count - unreadable - with_errors - with_warnings, with_warnings, with_errors, unreadable);
+
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.results);
+    return status;
+}
@@ -0,0 +1,30 @@
+#ifndef FIRMWARE_SCAN_H
+#define FIRMWARE_SCAN_H
+
+#include <stdio.h>
+
+/*
+ * Descriptor search in firmware images
+ *
+ * Raw images are searched whole; for ELF files only the file contents of
+ * loadable segments are searched and hits are also shown at their load
+ * address. The search looks for the WebUSB and MS OS 2.0 platform
+ * capability UUIDs and for MS OS 2.0 descriptor set headers, testing 16
+ * positions per step with SSE2 (a scalar loop elsewhere) and checking the
+ * few candidate positions in full.
+ *
+ * A platform capability is carved out together with the BOS that contains
+ * it, found by walking back to a BOS header whose capability chain reaches
+ * it; a capability without one is validated in a BOS built around it. A set
+ * header is carved by its wTotalLength. Every blob goes through the same
+ * parsers as a live analysis. Files are spread over the worker threads and
+ * reported in argument order.
+ */
+
+#define FIRMWARE_MAX_SIZE       (256 * 1024 * 1024)
+#define FIRMWARE_BOS_LOOKBACK   1024    // How far before a capability its BOS header is looked for
+
+// 0 if no carved descriptor had errors and every file could be read, -1 otherwise
+int firmware_scan(FILE *out, const char * const *paths, int path_count, int workers);
+
+#endif
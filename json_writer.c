@@ -0,0 +1,234 @@
+#include "json_writer.h"
+
+#include <math.h>
+#include <string.h>
+
+static void flush_buffer(struct json_writer *writer) {
+    if (writer->length > 0 && fwrite(writer->buffer, 1, writer->length, writer->out) != writer->length) {
+        writer->failed = 1;
+    }
+    writer->length = 0;
+}
+
+static void put_bytes(struct json_writer *writer, const char *data, size_t length) {
+    while (length > 0) {
+        if (writer->length == sizeof(writer->buffer)) {
+            flush_buffer(writer);
+        }
+        size_t chunk = sizeof(writer->buffer) - writer->length;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(writer->buffer + writer->length, data, chunk);
+        writer->length += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+static void put_char(struct json_writer *writer, char c) {
+    if (writer->length == sizeof(writer->buffer)) {
+        flush_buffer(writer);
+    }
+    writer->buffer[writer->length++] = c;
+}
+
+// One byte of a string value; bytes from 0x80 up are taken as Latin-1, so the output is always valid UTF-8
+static void put_escaped(struct json_writer *writer, unsigned char c) {
+    static const char hex[] = "0123456789abcdef";
+
+    switch (c) {
+        case '"':
+            put_bytes(writer, "\\\"", 2);
+            break;
+        case '\\':
+            put_bytes(writer, "\\\\", 2);
+            break;
+        case '\n':
+            put_bytes(writer, "\\n", 2);
+            break;
+        case '\t':
+            put_bytes(writer, "\\t", 2);
+            break;
+        default:
+            if (c < 0x20 || c >= 0x7F) {
+                char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F] };
+                put_bytes(writer, escape, sizeof(escape));
+            } else {
+                put_char(writer, (char)c);
+            }
+            break;
+    }
+}
+
+static void put_quoted(struct json_writer *writer, const char *text, size_t length) {
+    put_char(writer, '"');
+    for (size_t i = 0; i < length; i++) {
+        put_escaped(writer, (unsigned char)text[i]);
+    }
+    put_char(writer, '"');
+}
+
+// Comma and key in front of a new value
+static void begin_value(struct json_writer *writer, const char *key) {
+    uint32_t bit = 1u << writer->depth;
+
+    if (writer->has_members & bit) {
+        put_char(writer, ',');
+    }
+    writer->has_members |= bit;
+    if (key) {
+        put_quoted(writer, key, strlen(key));
+        put_char(writer, ':');
+    }
+}
+
+static void begin_container(struct json_writer *writer, const char *key, char open) {
+    begin_value(writer, key);
+    put_char(writer, open);
+    if (writer->depth < JSON_MAX_DEPTH - 1) {
+        writer->depth++;
+    }
+    writer->has_members &= ~(1u << writer->depth);
+}
+
+static void end_container(struct json_writer *writer, char close) {
+    if (writer->depth > 0) {
+        writer->depth--;
+    }
+    put_char(writer, close);
+}
+
+void json_init(struct json_writer *writer, FILE *out) {
+    memset(writer, 0, sizeof(*writer));
+    writer->out = out;
+}
+
+void json_begin_object(struct json_writer *writer, const char *key) {
+    begin_container(writer, key, '{');
+}
+
+void json_end_object(struct json_writer *writer) {
+    end_container(writer, '}');
+}
+
+void json_begin_array(struct json_writer *writer, const char *key) {
+    begin_container(writer, key, '[');
+}
+
+void json_end_array(struct json_writer *writer) {
+    end_container(writer, ']');
+}
+
+void json_string(struct json_writer *writer, const char *key, const char *value) {
+    json_string_n(writer, key, value, strlen(value));
+}
+
+void json_string_n(struct json_writer *writer, const char *key, const char *value, size_t length) {
+    begin_value(writer, key);
+    put_quoted(writer, value, length);
+}
+
+void json_int(struct json_writer *writer, const char *key, long long value) {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%lld", value);
+
+    begin_value(writer, key);
+    put_bytes(writer, text, (size_t)length);
+}
+
+// NaN and infinities have no JSON representation
+void json_double(struct json_writer *writer, const char *key, double value) {
+    char text[32];
+    int length = isfinite(value) ? snprintf(text, sizeof(text), "%.6g", value) :
+                                   snprintf(text, sizeof(text), "null");
+
+    begin_value(writer, key);
+    put_bytes(writer, text, (size_t)length);
+}
+
+void json_bool(struct json_writer *writer, const char *key, int value) {
+    begin_value(writer, key);
+    if (value) {
+        put_bytes(writer, "true", 4);
+    } else {
+        put_bytes(writer, "false", 5);
+    }
+}
+
+void json_null(struct json_writer *writer, const char *key) {
+    begin_value(writer, key);
+    put_bytes(writer, "null", 4);
+}
+
+void json_hex(struct json_writer *writer, const char *key, const uint8_t *data, int length) {
+    static const char hex[] = "0123456789abcdef";
+
+    begin_value(writer, key);
+    put_char(writer, '"');
+    for (int i = 0; i < length; i++) {
+        char pair[2] = { hex[data[i] >> 4], hex[data[i] & 0x0F] };
+        put_bytes(writer, pair, 2);
+    }
+    put_char(writer, '"');
+}
+
+void json_utf16(struct json_writer *writer, const char *key, const uint8_t *data, int byte_length) {
+    begin_value(writer, key);
+    put_char(writer, '"');
+    for (int i = 0; i + 1 < byte_length; i += 2) {
+        uint32_t c = data[i] | (uint32_t)data[i + 1] << 8;
+        if (c == 0) {
+            break;
+        }
+        if (c >= 0xD800 && c <= 0xDBFF && i + 3 < byte_length) {
+            uint32_t low = data[i + 2] | (uint32_t)data[i + 3] << 8;
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            c = 0xFFFD;
+        }
+
+        char text[4];
+        int length;
+        if (c < 0x80) {
+            put_escaped(writer, (unsigned char)c);
+            continue;
+        } else if (c < 0x800) {
+            text[0] = (char)(0xC0 | c >> 6);
+            text[1] = (char)(0x80 | (c & 0x3F));
+            length = 2;
+        } else if (c < 0x10000) {
+            text[0] = (char)(0xE0 | c >> 12);
+            text[1] = (char)(0x80 | (c >> 6 & 0x3F));
+            text[2] = (char)(0x80 | (c & 0x3F));
+            length = 3;
+        } else {
+            text[0] = (char)(0xF0 | c >> 18);
+            text[1] = (char)(0x80 | (c >> 12 & 0x3F));
+            text[2] = (char)(0x80 | (c >> 6 & 0x3F));
+            text[3] = (char)(0x80 | (c & 0x3F));
+            length = 4;
+        }
+        put_bytes(writer, text, (size_t)length);
+    }
+    put_char(writer, '"');
+}
+
+int json_end_record(struct json_writer *writer) {
+    put_char(writer, '\n');
+    flush_buffer(writer);
+    if (fflush(writer->out) != 0) {
+        writer->failed = 1;
+    }
+
+    int result = writer->failed ? -1 : 0;
+    writer->depth = 0;
+    writer->has_members = 0;
+    writer->failed = 0;
+    writer->records++;
+    return result;
+}
@@ -0,0 +1,57 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Streaming NDJSON writer
+ *
+ * Values are encoded straight into a fixed buffer that is written out
+ * whenever it fills up and at the end of every record, so memory use does
+ * not depend on record size or on how many records are written. A record
+ * is one top-level object; json_end_record() terminates it with a newline
+ * and flushes it, so a reader on a pipe sees whole records as they come.
+ *
+ * Strings are expected to be ASCII; other bytes are escaped as Latin-1.
+ * Members take a key; array elements and the top-level object pass NULL.
+ * Nesting is tracked only to place commas; the caller keeps it balanced.
+ */
+
+#define JSON_BUFFER_SIZE    4096
+#define JSON_MAX_DEPTH      32
+
+struct json_writer {
+    FILE *out;
+    char buffer[JSON_BUFFER_SIZE];
+    size_t length;
+    int depth;
+    uint32_t has_members;   // Bit n: the container at depth n already holds a value
+    int records;
+    int failed;             // A write to out failed
+};
+
+void json_init(struct json_writer *writer, FILE *out);
+
+void json_begin_object(struct json_writer *writer, const char *key);
+void json_end_object(struct json_writer *writer);
+void json_begin_array(struct json_writer *writer, const char *key);
+void json_end_array(struct json_writer *writer);
+
+void json_string(struct json_writer *writer, const char *key, const char *value);
+void json_string_n(struct json_writer *writer, const char *key, const char *value, size_t length);
+void json_int(struct json_writer *writer, const char *key, long long value);
+void json_double(struct json_writer *writer, const char *key, double value);
+void json_bool(struct json_writer *writer, const char *key, int value);
+void json_null(struct json_writer *writer, const char *key);
+
+// Lowercase hex digits, two per byte
+void json_hex(struct json_writer *writer, const char *key, const uint8_t *data, int length);
+
+// UTF-16LE as UTF-8, up to the first NUL; unpaired surrogates become U+FFFD
+void json_utf16(struct json_writer *writer, const char *key, const uint8_t *data, int byte_length);
+
+// Finish the top-level object; 0, or -1 if anything in the record could not be written
+int json_end_record(struct json_writer *writer);
+
+#endif
@@ -0,0 +1,562 @@
+#define _POSIX_C_SOURCE 200809L
+
+/*
+ * End-to-end loopback harness
+ *
+ * Brings up a gadget on dummy_hcd through raw_gadget, answering ep0 like a
+ * mock device (usb_mock.h) with a configurable BOS, MS OS 2.0 descriptor
+ * set and WebUSB URL descriptor, and
+ * runs the analyzer against it as a separate process, so the whole main
+ * path (libusb open, kernel driver detach, control transfers) runs on the
+ * real host stack. The analyzer records its transfers with --record; the
+ * recording then gives the per-request result and host-side latency.
+ *
+ * The gadget's one interface is a generic HID interface, so usbhid binds
+ * to it once the host configures the gadget and the analyzer has a kernel
+ * driver to detach. The harness checks that the driver was bound before
+ * the run and is gone after it.
+ *
+ * Needs root and the dummy_hcd and raw_gadget modules:
+ *   modprobe dummy_hcd && modprobe raw_gadget
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libusb-1.0/libusb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "report.h"
+#include "request_plan.h"
+#include "usb_capture.h"
+#include "usb_descriptors.h"
+#include "usb_mock.h"
+
+/*
+ * raw_gadget interface (Documentation/usb/raw-gadget.rst). Declared here:
+ * <linux/usb/raw_gadget.h> pulls in <linux/usb/ch9.h>, whose descriptor
+ * structs clash with usb_descriptors.h, and older copies lack the reset
+ * and disconnect events.
+ */
+#define RAW_NAME_LENGTH_MAX     128
+
+struct raw_init {
+    uint8_t driver_name[RAW_NAME_LENGTH_MAX];
+    uint8_t device_name[RAW_NAME_LENGTH_MAX];
+    uint8_t speed;
+};
+
+enum raw_event_type {
+    RAW_EVENT_CONNECT = 1,
+    RAW_EVENT_CONTROL = 2,          // data holds the setup packet
+    RAW_EVENT_SUSPEND = 3,
+    RAW_EVENT_RESUME = 4,
+    RAW_EVENT_RESET = 5,
+    RAW_EVENT_DISCONNECT = 6,
+};
+
+struct raw_event {
+    uint32_t type;
+    uint32_t length;
+    uint8_t data[];
+};
+
+struct raw_ep_io {
+    uint16_t ep;
+    uint16_t flags;
+    uint32_t length;
+    uint8_t data[];
+};
+
+#define RAW_IOCTL_INIT          _IOW('U', 0, struct raw_init)
+#define RAW_IOCTL_RUN           _IO('U', 1)
+#define RAW_IOCTL_EVENT_FETCH   _IOR('U', 2, struct raw_event)
+#define RAW_IOCTL_EP0_WRITE     _IOW('U', 3, struct raw_ep_io)
+#define RAW_IOCTL_EP0_READ      _IOWR('U', 4, struct raw_ep_io)
+#define RAW_IOCTL_CONFIGURE     _IO('U', 9)
+#define RAW_IOCTL_VBUS_DRAW     _IOW('U', 10, uint32_t)
+#define RAW_IOCTL_EP0_STALL     _IO('U', 12)
+
+#define RAW_SPEED_HIGH          3       // enum usb_device_speed
+
+#define USB_REQUEST_TYPE_MASK           0x60
+#define USB_REQUEST_SET_CONFIGURATION   0x09
+#define USB_REQUEST_SET_INTERFACE       0x0B
+
+#define REQUEST_TYPE_INTERFACE_IN       0x81    // IN, STANDARD, INTERFACE
+#define REQUEST_TYPE_CLASS_INTERFACE    0x21    // OUT, CLASS, INTERFACE
+#define HID_DT_REPORT                   0x22
+#define HID_REQUEST_SET_IDLE            0x0A
+
+#define HARNESS_UDC_DRIVER      "dummy_udc"
+#define HARNESS_UDC_DEVICE      "dummy_udc.0"
+#define HARNESS_ANALYZER        "./usb_bos_webusb_msos20_analyzer"
+#define HARNESS_CAPTURE         "loopback.ucap"
+#define HARNESS_ENUM_TIMEOUT_S  10      // For the host to configure the gadget
+#define HARNESS_BIND_TIMEOUT_S  5       // For usbhid to bind to the configured gadget
+
+struct gadget {
+    int fd;
+    struct mock_profile profile;    // What ep0 answers, as for a mock device
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t configured_changed;
+    int configured;                 // Protected by lock
+    volatile sig_atomic_t stop;
+    volatile sig_atomic_t stopped;  // Set by the ep0 thread on its way out
+
+    // Written by the ep0 thread only, read after it is joined
+    int setups;
+    int stalled;
+};
+
+// ep0 buffers; the kernel structs end in flexible arrays
+union raw_event_buffer {
+    struct raw_event event;
+    uint8_t bytes[sizeof(struct raw_event) + 8];   // Setup packet
+};
+
+union raw_ep_io_buffer {
+    struct raw_ep_io io;
+    uint8_t bytes[sizeof(struct raw_ep_io) + MOCK_BLOB_MAX];
+};
+
+/*
+ * ep0
+ */
+
+// One vendor-page input report of 8 bytes; hid-generic binds, and nothing opens the device
+static const uint8_t hid_report_descriptor[] = {
+    0x06, 0x00, 0xFF,               // Usage Page (Vendor 0xFF00)
+    0x09, 0x01,                     // Usage (1)
+    0xA1, 0x01,                     // Collection (Application)
+    0x15, 0x00,                     //   Logical Minimum (0)
+    0x26, 0xFF, 0x00,               //   Logical Maximum (255)
+    0x75, 0x08,                     //   Report Size (8)
+    0x95, 0x08,                     //   Report Count (8)
+    0x09, 0x01,                     //   Usage (1)
+    0x81, 0x02,                     //   Input (Data, Variable, Absolute)
+    0xC0,                           // End Collection
+};
+
+// Replaces the mock's vendor-specific interface, which no host driver claims
+static const uint8_t hid_config[] = {
+    9, USB_DT_CONFIG, 34, 0, 1, 1, 0, 0x80, 50,
+    9, USB_DT_INTERFACE, 0, 0, 1, 0x03, 0, 0, 0,                        // HID, no boot protocol
+    9, USB_DT_HID, 0x11, 0x01, 0, 1, HID_DT_REPORT, sizeof(hid_report_descriptor), 0,
+    7, USB_DT_ENDPOINT, 0x81, 0x03, 8, 0, 10,                           // Interrupt IN, never enabled
+};
+
+// Status stage of a request without a data stage
+static int ep0_ack(struct gadget *gadget) {
+    union raw_ep_io_buffer buffer;
+
+    buffer.io.ep = 0;
+    buffer.io.flags = 0;
+    buffer.io.length = 0;
+    return ioctl(gadget->fd, RAW_IOCTL_EP0_READ, &buffer.io) < 0 ? -1 : 0;
+}
+
+static void set_configured(struct gadget *gadget, int configured) {
+    pthread_mutex_lock(&gadget->lock);
+    gadget->configured = configured;
+    pthread_cond_broadcast(&gadget->configured_changed);
+    pthread_mutex_unlock(&gadget->lock);
+}
+
+// 0 if answered, -1 to stall
+static int answer_setup(struct gadget *gadget, const struct control_request *setup) {
+    if ((setup->bmRequestType & USB_REQUEST_TYPE_MASK) == 0) {
+        switch (setup->bRequest) {
+            case USB_REQUEST_SET_CONFIGURATION:
+                if (ioctl(gadget->fd, RAW_IOCTL_VBUS_DRAW, 50) < 0 ||
+                    ioctl(gadget->fd, RAW_IOCTL_CONFIGURE, 0) < 0 || ep0_ack(gadget) < 0) {
+                    return -1;
+                }
+                set_configured(gadget, setup->wValue != 0);
+                return 0;
+            case USB_REQUEST_SET_INTERFACE:
+                return ep0_ack(gadget);
+            default:
+                break;
+        }
+    }
+
+    if (setup->bmRequestType == REQUEST_TYPE_CLASS_INTERFACE && setup->bRequest == HID_REQUEST_SET_IDLE) {
+        return ep0_ack(gadget);
+    }
+
+    union raw_ep_io_buffer buffer;
+    const uint8_t *descriptor = NULL;
+    int length;
+    if (setup->bRequest == USB_REQUEST_GET_DESCRIPTOR && setup->bmRequestType == REQUEST_TYPE_STANDARD_IN &&
+        setup->wValue >> 8 == USB_DT_CONFIG) {
+        descriptor = hid_config;
+        length = sizeof(hid_config);
+    } else if (setup->bRequest == USB_REQUEST_GET_DESCRIPTOR && setup->bmRequestType == REQUEST_TYPE_INTERFACE_IN &&
+               setup->wValue >> 8 == HID_DT_REPORT) {
+        descriptor = hid_report_descriptor;
+        length = sizeof(hid_report_descriptor);
+    }
+    if (descriptor) {
+        length = length < setup->wLength ? length : setup->wLength;
+        memcpy(buffer.io.data, descriptor, (size_t)length);
+    } else {
+        length = mock_respond(&gadget->profile, setup, buffer.io.data);
+    }
+    if (length < 0) {
+        return -1;
+    }
+    buffer.io.ep = 0;
+    buffer.io.flags = 0;
+    buffer.io.length = (uint32_t)length;
+    return ioctl(gadget->fd, RAW_IOCTL_EP0_WRITE, &buffer.io) < 0 ? -1 : 0;
+}
+
+static void *ep0_main(void *arg) {
+    struct gadget *gadget = arg;
+    union raw_event_buffer buffer;
+
+    while (!gadget->stop) {
+        buffer.event.type = 0;
+        buffer.event.length = sizeof(buffer.bytes) - sizeof(buffer.event);
+        if (ioctl(gadget->fd, RAW_IOCTL_EVENT_FETCH, &buffer.event) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf(COLOR_RED "ERROR: raw_gadget event fetch failed: %s\n" COLOR_RESET, strerror(errno));
+            break;
+        }
+
+        switch (buffer.event.type) {
+            case RAW_EVENT_CONTROL: {
+                const uint8_t *packet = buffer.event.data;
+                struct control_request setup = {
+                    .bmRequestType = packet[0],
+                    .bRequest = packet[1],
+                    .wValue = get_le16(&packet[2]),
+                    .wIndex = get_le16(&packet[4]),
+                    .wLength = get_le16(&packet[6]),
+                };
+                gadget->setups++;
+                if (answer_setup(gadget, &setup) != 0) {
+                    gadget->stalled++;
+                    ioctl(gadget->fd, RAW_IOCTL_EP0_STALL, 0);
+                }
+                break;
+            }
+            case RAW_EVENT_RESET:
+            case RAW_EVENT_DISCONNECT:
+                set_configured(gadget, 0);
+                break;
+            default:
+                break;
+        }
+    }
+    gadget->stopped = 1;
+    return NULL;
+}
+
+// Only interrupts the blocking event fetch
+static void wake_ep0(int signal_number) {
+    (void)signal_number;
+}
+
+static int gadget_start(struct gadget *gadget, const char *driver, const char *device) {
+    struct raw_init init;
+
+    gadget->fd = open("/dev/raw-gadget", O_RDWR);
+    if (gadget->fd < 0) {
+        printf(COLOR_RED "ERROR: Cannot open /dev/raw-gadget: %s\n" COLOR_RESET, strerror(errno));
+        printf("Load the modules first: modprobe dummy_hcd && modprobe raw_gadget (as root)\n");
+        return -1;
+    }
+
+    memset(&init, 0, sizeof(init));
+    snprintf((char *)init.driver_name, sizeof(init.driver_name), "%s", driver);
+    snprintf((char *)init.device_name, sizeof(init.device_name), "%s", device);
+    init.speed = RAW_SPEED_HIGH;
+    if (ioctl(gadget->fd, RAW_IOCTL_INIT, &init) < 0 || ioctl(gadget->fd, RAW_IOCTL_RUN, 0) < 0) {
+        printf(COLOR_RED "ERROR: Cannot bind to UDC %s/%s: %s\n" COLOR_RESET, driver, device, strerror(errno));
+        close(gadget->fd);
+        return -1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = wake_ep0;   // No SA_RESTART: the fetch returns EINTR
+    sigaction(SIGUSR1, &action, NULL);
+
+    pthread_mutex_init(&gadget->lock, NULL);
+    pthread_cond_init(&gadget->configured_changed, NULL);
+    if (pthread_create(&gadget->thread, NULL, ep0_main, gadget) != 0) {
+        printf(COLOR_RED "ERROR: Cannot start the ep0 thread\n" COLOR_RESET);
+        close(gadget->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int gadget_wait_configured(struct gadget *gadget, int timeout_s) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_s;
+
+    pthread_mutex_lock(&gadget->lock);
+    int result = 0;
+    while (!gadget->configured && result == 0) {
+        result = pthread_cond_timedwait(&gadget->configured_changed, &gadget->lock, &deadline);
+    }
+    int configured = gadget->configured;
+    pthread_mutex_unlock(&gadget->lock);
+    return configured ? 0 : -1;
+}
+
+static void gadget_stop(struct gadget *gadget) {
+    // The signal may arrive just before the thread blocks again, so repeat it until the thread is out
+    const struct timespec retry = { 0, 10 * 1000 * 1000 };
+    gadget->stop = 1;
+    while (!gadget->stopped) {
+        pthread_kill(gadget->thread, SIGUSR1);
+        nanosleep(&retry, NULL);
+    }
+    pthread_join(gadget->thread, NULL);
+    close(gadget->fd);
+    pthread_cond_destroy(&gadget->configured_changed);
+    pthread_mutex_destroy(&gadget->lock);
+}
+
+/*
+ * Host side
+ */
+
+// libusb_kernel_driver_active() for interface 0 of the gadget, or a LIBUSB_ERROR_* code
+static int host_driver_active(libusb_context *ctx, uint16_t vid, uint16_t pid) {
+    libusb_device_handle *handle = libusb_open_device_with_vid_pid(ctx, vid, pid);
+    if (!handle) {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+    int result = libusb_kernel_driver_active(handle, 0);
+    libusb_close(handle);
+    return result;
+}
+
+// Wait until a host driver has bound to interface 0; 1 once it has, 0 on timeout or error
+static int host_wait_driver_bound(libusb_context *ctx, uint16_t vid, uint16_t pid, int timeout_s) {
+    const struct timespec retry = { 0, 100 * 1000 * 1000 };
+    for (int i = 0; i < timeout_s * 10; i++) {
+        if (host_driver_active(ctx, vid, pid) == 1) {
+            return 1;
+        }
+        nanosleep(&retry, NULL);
+    }
+    return 0;
+}
+
+// Exit status of the analyzer, or -1 if it could not be run
+static int run_analyzer(const char *analyzer, const char *capture_path, uint16_t vid, uint16_t pid) {
+    char vid_arg[8], pid_arg[8];
+    snprintf(vid_arg, sizeof(vid_arg), "0x%04x", vid);
+    snprintf(pid_arg, sizeof(pid_arg), "0x%04x", pid);
+
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        printf(COLOR_RED "ERROR: fork failed: %s\n" COLOR_RESET, strerror(errno));
+        return -1;
+    }
+    if (child == 0) {
+        execl(analyzer, analyzer, "--record", capture_path, vid_arg, pid_arg, (char *)NULL);
+        printf(COLOR_RED "ERROR: Cannot run %s: %s\n" COLOR_RESET, analyzer, strerror(errno));
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void describe_request(char *text, size_t size, const struct control_request *setup,
+                             const struct bos_summary *summary) {
+    if (setup->bmRequestType == REQUEST_TYPE_STANDARD_IN && setup->bRequest == USB_REQUEST_GET_DESCRIPTOR) {
+        static const char * const names[] = { [USB_DT_DEVICE] = "DEVICE", [USB_DT_CONFIG] = "CONFIG",
+                                               [USB_DT_STRING] = "STRING", [USB_DT_BOS] = "BOS" };
+        uint8_t type = (uint8_t)(setup->wValue >> 8);
+        const char *name = type < sizeof(names) / sizeof(names[0]) && names[type] ? names[type] : "?";
+        snprintf(text, size, "GET_DESCRIPTOR(%s, %u)", name, setup->wValue & 0xFF);
+    } else if (setup->bmRequestType == REQUEST_TYPE_VENDOR_IN && setup->wIndex == MS_OS_20_DESCRIPTOR_INDEX &&
+               summary->has_msos20 && setup->bRequest == summary->msos20_vendor_code) {
+        snprintf(text, size, "MS OS 2.0 descriptor set");
+    } else if (setup->bmRequestType == REQUEST_TYPE_VENDOR_IN && setup->wIndex == WEBUSB_GET_URL &&
+               summary->has_webusb && setup->bRequest == summary->webusb_vendor_code) {
+        snprintf(text, size, "WebUSB GET_URL(%u)", setup->wValue);
+    } else {
+        snprintf(text, size, "%02x %02x %04x %04x", setup->bmRequestType, setup->bRequest, setup->wValue,
+                 setup->wIndex);
+    }
+}
+
+// Per-request table from the analyzer's recording; the number of failed transfers, or -1
+static int report_transfers(const char *capture_path, const struct bos_summary *summary) {
+    struct capture capture;
+    if (capture_load(&capture, capture_path) != 0) {
+        return -1;
+    }
+
+    printf("\n=== Loopback Transfers ===\n");
+    printf("%-32s %7s %9s  %s\n", "Request", "wLength", "Latency", "Result");
+
+    int failed = 0;
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+    for (int i = 0; i < capture.count; i++) {
+        const struct capture_record *record = &capture.records[i];
+        char text[48];
+
+        describe_request(text, sizeof(text), &record->setup, summary);
+        printf("%-32s %7u %6.3f ms  ", text, record->setup.wLength, record->latency_us / 1000.0);
+        if (record->result >= 0) {
+            printf("%d bytes\n", record->result);
+        } else {
+            printf(COLOR_RED "%s\n" COLOR_RESET, libusb_error_name(record->result));
+            failed++;
+        }
+        total_us += record->latency_us;
+        if (record->latency_us > max_us) {
+            max_us = record->latency_us;
+        }
+    }
+
+    printf("\n%d transfers, %d failed", capture.count, failed);
+    if (capture.count > 0) {
+        printf(", latency %.3f ms average, %.3f ms max", (double)total_us / capture.count / 1000.0, max_us / 1000.0);
+    }
+    printf("\n");
+    capture_free(&capture);
+    return failed;
+}
+
+static void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  --bos FILE        BOS descriptor to serve (default: WebUSB + MS OS 2.0)\n");
+    printf("  --msos20 FILE     MS OS 2.0 descriptor set to serve\n");
+    printf("  --url FILE        WebUSB URL descriptor to serve\n");
+    printf("  --vid ID          Gadget VID (default 0x%04x)\n", MOCK_VID);
+    printf("  --pid ID          Gadget PID (default 0x%04x)\n", MOCK_PID);
+    printf("  --udc DRIVER DEV  UDC to bind to (default %s %s)\n", HARNESS_UDC_DRIVER, HARNESS_UDC_DEVICE);
+    printf("  --analyzer PATH   Analyzer binary (default %s)\n", HARNESS_ANALYZER);
+    printf("  --record FILE     Where the analyzer records its transfers (default %s)\n", HARNESS_CAPTURE);
+    printf("Needs root and the dummy_hcd and raw_gadget modules.\n");
+}
+
+static int parse_id(const char *arg, uint16_t *id) {
+    char *endptr;
+    unsigned long value = strtoul(arg, &endptr, 0);
+    if (*endptr != '\0' || value == 0 || value > 0xFFFF) {
+        printf(COLOR_RED "ERROR: Invalid ID '%s'\n" COLOR_RESET, arg);
+        return -1;
+    }
+    *id = (uint16_t)value;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    static struct gadget gadget;    // Blobs are large
+    const char *bos_path = NULL, *msos20_path = NULL, *url_path = NULL;
+    const char *driver = HARNESS_UDC_DRIVER, *device = HARNESS_UDC_DEVICE;
+    const char *analyzer = HARNESS_ANALYZER, *capture_path = HARNESS_CAPTURE;
+
+    // Defaults first, so a custom BOS can point at the default descriptor set and URL
+    mock_profile_default(&gadget.profile);
+
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--bos") == 0 && has_value) {
+            bos_path = argv[++i];
+        } else if (strcmp(argv[i], "--msos20") == 0 && has_value) {
+            msos20_path = argv[++i];
+        } else if (strcmp(argv[i], "--url") == 0 && has_value) {
+            url_path = argv[++i];
+        } else if (strcmp(argv[i], "--vid") == 0 && has_value) {
+            if (parse_id(argv[++i], &gadget.profile.vid) != 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--pid") == 0 && has_value) {
+            if (parse_id(argv[++i], &gadget.profile.pid) != 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--udc") == 0 && i + 2 < argc) {
+            driver = argv[++i];
+            device = argv[++i];
+        } else if (strcmp(argv[i], "--analyzer") == 0 && has_value) {
+            analyzer = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && has_value) {
+            capture_path = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if ((bos_path && mock_profile_read(&gadget.profile, MOCK_BOS, bos_path) != 0) ||
+        (msos20_path && mock_profile_read(&gadget.profile, MOCK_MSOS20, msos20_path) != 0) ||
+        (url_path && mock_profile_read(&gadget.profile, MOCK_URL, url_path) != 0)) {
+        return -1;
+    }
+    mock_profile_update(&gadget.profile);
+
+    printf("Starting loopback gadget %04x:%04x on %s (BOS %d bytes, MS OS 2.0 set %d bytes, URL %d bytes)\n",
+           gadget.profile.vid, gadget.profile.pid, device, gadget.profile.blobs[MOCK_BOS].length,
+           gadget.profile.blobs[MOCK_MSOS20].length, gadget.profile.blobs[MOCK_URL].length);
+    if (gadget_start(&gadget, driver, device) != 0) {
+        return -1;
+    }
+
+    libusb_context *ctx = NULL;
+    if (libusb_init(&ctx) != 0) {
+        printf(COLOR_RED "ERROR: Failed to initialize libusb\n" COLOR_RESET);
+        gadget_stop(&gadget);
+        return -1;
+    }
+
+    int status = -1;
+    uint16_t vid = gadget.profile.vid, pid = gadget.profile.pid;
+    if (gadget_wait_configured(&gadget, HARNESS_ENUM_TIMEOUT_S) != 0) {
+        printf(COLOR_RED "ERROR: The host did not configure the gadget within %d s\n" COLOR_RESET,
+               HARNESS_ENUM_TIMEOUT_S);
+    } else if (!host_wait_driver_bound(ctx, vid, pid, HARNESS_BIND_TIMEOUT_S)) {
+        printf(COLOR_RED "ERROR: No host driver bound to the HID interface within %d s; "
+               "is usbhid available?\n" COLOR_RESET, HARNESS_BIND_TIMEOUT_S);
+    } else {
+        printf("A host driver is bound to interface 0; the analyzer has to detach it\n");
+        int analyzer_status = run_analyzer(analyzer, capture_path, vid, pid);
+        int failed = report_transfers(capture_path, &gadget.profile.summary);
+        int still_bound = host_driver_active(ctx, vid, pid) == 1;
+        printf("Analyzer exit status %d\n", analyzer_status);
+        if (still_bound) {
+            printf(COLOR_RED "ERROR: The host driver is still bound to interface 0 after the analyzer ran\n"
+                   COLOR_RESET);
+        } else {
+            printf("Kernel driver detached from interface 0\n");
+        }
+        status = analyzer_status == 0 && failed == 0 && !still_bound ? 0 : -1;
+    }
+
+    libusb_exit(ctx);
+    gadget_stop(&gadget);
+    printf("Gadget: %d setup requests, %d stalled\n", gadget.setups, gadget.stalled);
+    return status;
+}
@@ -0,0 +1,227 @@
+#include "pcap_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "report.h"
+#include "usb_descriptors.h"
+
+uint32_t pcap_swap32(uint32_t value) {
+    return (value >> 24) | ((value >> 8) & 0xFF00u) | ((value << 8) & 0xFF0000u) | (value << 24);
+}
+
+static uint32_t read32(const struct pcap_reader *reader, const uint8_t *p) {
+    uint32_t value = get_le32(p);
+    return reader->swapped ? pcap_swap32(value) : value;
+}
+
+static uint16_t read16(const struct pcap_reader *reader, const uint8_t *p) {
+    uint16_t value = get_le16(p);
+    return reader->swapped ? (uint16_t)((value >> 8) | (value << 8)) : value;
+}
+
+// 1 if length bytes were read, 0 at a clean end of file, -1 if the file ends mid-way
+static int read_exact(struct pcap_reader *reader, uint8_t *buffer, size_t length) {
+    size_t done = fread(buffer, 1, length, reader->file);
+    if (done == length) {
+        return 1;
+    }
+    return done == 0 && feof(reader->file) ? 0 : -1;
+}
+
+// Read length bytes into the reusable buffer; blocks over PCAP_MAX_BLOCK are skipped and return 0
+static int read_body(struct pcap_reader *reader, size_t length) {
+    if (length > PCAP_MAX_BLOCK) {
+        uint8_t chunk[4096];
+        while (length > 0) {
+            size_t step = length < sizeof(chunk) ? length : sizeof(chunk);
+            if (read_exact(reader, chunk, step) != 1) {
+                return -1;
+            }
+            length -= step;
+        }
+        reader->oversized++;
+        return 0;
+    }
+
+    if (length > reader->capacity) {
+        uint8_t *buffer = realloc(reader->buffer, length);
+        if (!buffer) {
+            return -1;
+        }
+        reader->buffer = buffer;
+        reader->capacity = length;
+    }
+    return read_exact(reader, reader->buffer, length) == 1 ? 1 : -1;
+}
+
+// The section header fixes the byte order of everything up to the next one
+static int read_section_header(struct pcap_reader *reader) {
+    uint8_t header[8];
+
+    if (read_exact(reader, header, sizeof(header)) != 1) {
+        return -1;
+    }
+    uint32_t byte_order = get_le32(&header[4]);
+    if (byte_order == PCAPNG_BYTE_ORDER_MAGIC) {
+        reader->swapped = 0;
+    } else if (pcap_swap32(byte_order) == PCAPNG_BYTE_ORDER_MAGIC) {
+        reader->swapped = 1;
+    } else {
+        return -1;
+    }
+
+    uint32_t total_length = read32(reader, header);
+    if (total_length < 28 || total_length % 4 != 0) {
+        return -1;
+    }
+    reader->interface_count = 0;
+    return read_body(reader, total_length - 12) >= 0 ? 0 : -1;
+}
+
+int pcap_open(struct pcap_reader *reader, FILE *file) {
+    uint8_t header[PCAP_HEADER_SIZE];
+
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+
+    if (read_exact(reader, header, 4) != 1) {
+        printf(COLOR_RED "ERROR: Capture is empty\n" COLOR_RESET);
+        return -1;
+    }
+
+    uint32_t magic = get_le32(header);
+    if (magic == PCAPNG_SECTION_HEADER) {
+        reader->pcapng = 1;
+        if (read_section_header(reader) != 0) {
+            printf(COLOR_RED "ERROR: Invalid pcapng section header\n" COLOR_RESET);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+        reader->swapped = 0;
+    } else if (pcap_swap32(magic) == PCAP_MAGIC_USEC || pcap_swap32(magic) == PCAP_MAGIC_NSEC) {
+        reader->swapped = 1;
+    } else {
+        printf(COLOR_RED "ERROR: Not a pcap or pcapng capture\n" COLOR_RESET);
+        return -1;
+    }
+
+    if (read_exact(reader, header + 4, PCAP_HEADER_SIZE - 4) != 1) {
+        printf(COLOR_RED "ERROR: Truncated pcap header\n" COLOR_RESET);
+        return -1;
+    }
+    reader->linktype = (int)(read32(reader, &header[20]) & 0xFFFF);
+    return 0;
+}
+
+static int next_pcap(struct pcap_reader *reader, struct pcap_packet *packet) {
+    uint8_t record[PCAP_RECORD_SIZE];
+
+    for (;;) {
+        int result = read_exact(reader, record, sizeof(record));
+        if (result <= 0) {
+            return result;
+        }
+
+        uint32_t captured = read32(reader, &record[8]);
+        result = read_body(reader, captured);
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            continue;
+        }
+
+        packet->linktype = reader->linktype;
+        packet->swapped = reader->swapped;
+        packet->data = reader->buffer;
+        packet->length = captured;
+        return 1;
+    }
+}
+
+static int next_pcapng(struct pcap_reader *reader, struct pcap_packet *packet) {
+    uint8_t header[8];
+
+    for (;;) {
+        int result = read_exact(reader, header, sizeof(header));
+        if (result <= 0) {
+            return result;
+        }
+
+        uint32_t type = read32(reader, header);
+        if (type == PCAPNG_SECTION_HEADER) {
+            // Re-read the length once the new section's byte order is known
+            uint8_t rest[4];
+            if (read_exact(reader, rest, sizeof(rest)) != 1) {
+                return -1;
+            }
+            uint32_t byte_order = get_le32(rest);
+            reader->swapped = pcap_swap32(byte_order) == PCAPNG_BYTE_ORDER_MAGIC;
+            uint32_t total_length = read32(reader, &header[4]);
+            if (total_length < 28 || total_length % 4 != 0 || read_body(reader, total_length - 12) < 0) {
+                return -1;
+            }
+            reader->interface_count = 0;
+            continue;
+        }
+
+        uint32_t total_length = read32(reader, &header[4]);
+        if (total_length < 12 || total_length % 4 != 0) {
+            return -1;
+        }
+        uint32_t body_length = total_length - 12;
+        result = read_body(reader, body_length + 4);     // Body and trailing length
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            continue;
+        }
+
+        const uint8_t *body = reader->buffer;
+        if (type == PCAPNG_INTERFACE && body_length >= 8) {
+            if (reader->interface_count < PCAP_MAX_INTERFACES) {
+                reader->interface_linktypes[reader->interface_count] = read16(reader, body);
+            }
+            reader->interface_count++;
+        } else if (type == PCAPNG_ENHANCED_PACKET && body_length >= 20) {
+            uint32_t interface = read32(reader, body);
+            uint32_t captured = read32(reader, &body[12]);
+            if (interface >= (uint32_t)reader->interface_count || interface >= PCAP_MAX_INTERFACES ||
+                captured > body_length - 20) {
+                continue;
+            }
+            packet->linktype = reader->interface_linktypes[interface];
+            packet->swapped = reader->swapped;
+            packet->data = &body[20];
+            packet->length = captured;
+            return 1;
+        } else if (type == PCAPNG_SIMPLE_PACKET && body_length >= 4 && reader->interface_count > 0) {
+            uint32_t original = read32(reader, body);
+            packet->linktype = reader->interface_linktypes[0];
+            packet->swapped = reader->swapped;
+            packet->data = &body[4];
+            packet->length = original < body_length - 4 ? original : body_length - 4;
+            return 1;
+        }
+        // Other block types (name resolution, statistics, ...) carry nothing we need
+    }
+}
+
+int pcap_next(struct pcap_reader *reader, struct pcap_packet *packet) {
+    int result = reader->pcapng ? next_pcapng(reader, packet) : next_pcap(reader, packet);
+    if (result == 1) {
+        reader->packets++;
+    }
+    return result;
+}
+
+void pcap_close(struct pcap_reader *reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->capacity = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef PCAP_READER_H
+#define PCAP_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Streaming pcap/pcapng reader
+ *
+ * Packets are returned one at a time from a single buffer that is reused
+ * for every block, so memory use is bounded by the largest block (capped at
+ * PCAP_MAX_BLOCK) no matter how large the capture is. Input is read
+ * sequentially and never seeked, so pipes work too.
+ */
+
+#define PCAP_MAX_BLOCK          (16 * 1024 * 1024)
+#define PCAP_MAX_INTERFACES     64
+
+#define PCAP_MAGIC_USEC         0xA1B2C3D4u
+#define PCAP_MAGIC_NSEC         0xA1B23C4Du
+#define PCAP_HEADER_SIZE        24
+#define PCAP_RECORD_SIZE        16
+
+#define PCAPNG_SECTION_HEADER   0x0A0D0D0Au
+#define PCAPNG_INTERFACE        0x00000001u
+#define PCAPNG_SIMPLE_PACKET    0x00000003u
+#define PCAPNG_ENHANCED_PACKET  0x00000006u
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4Du
+
+#define LINKTYPE_USB_LINUX          189     // usbmon, 48-byte header
+#define LINKTYPE_USB_LINUX_MMAPPED  220     // usbmon, 64-byte header
+
+struct pcap_packet {
+    int linktype;
+    int swapped;                // Capture was written on a host of the other byte order
+    const uint8_t *data;
+    uint32_t length;            // Captured bytes
+};
+
+struct pcap_reader {
+    FILE *file;
+    int pcapng;
+    int swapped;
+    int linktype;                               // pcap only
+    int interface_count;                        // pcapng, current section
+    uint16_t interface_linktypes[PCAP_MAX_INTERFACES];
+    uint8_t *buffer;
+    size_t capacity;
+    uint64_t packets;
+    uint64_t oversized;                         // Blocks skipped for exceeding PCAP_MAX_BLOCK
+};
+
+// Read the file header; prints an error and returns -1 if this is not a capture
+int pcap_open(struct pcap_reader *reader, FILE *file);
+
+// 1 with the next packet, 0 at the end of the capture, -1 if it is corrupt
+int pcap_next(struct pcap_reader *reader, struct pcap_packet *packet);
+
+void pcap_close(struct pcap_reader *reader);
+
+uint32_t pcap_swap32(uint32_t value);
+
+#endif
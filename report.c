@@ -0,0 +1,669 @@
+#include "report.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static void render_findings_summary(FILE *out, const struct finding_list *findings) {
+    if (findings->dropped > 0) {
+        fprintf(out, "(%d further finding(s) not shown)\n", findings->dropped);
+    }
+}
+
+void render_finding(FILE *out, const char *indent, const struct finding *finding) {
+    const struct rule_info *rule = &descriptor_rules[finding->rule];
+
+    fputs(indent, out);
+    fputs(rule->severity == SEVERITY_ERROR ? COLOR_RED "ERROR: " : COLOR_ORANGE "WARNING: ", out);
+    fprintf(out, rule->message, finding->value[0], finding->value[1], finding->value[2]);
+    fputs("\n" COLOR_RESET, out);
+}
+
+#define DUMP_ROW_BYTES      16
+#define DUMP_HEX_WIDTH      (DUMP_ROW_BYTES * 3)
+#define DUMP_LINE_SIZE      1024    // Hex digits and annotation of one row; longer annotations are cut short
+
+// Two lowercase hex digits for each byte of a row
+static void hex_digits(const uint8_t *data, int count, char *digits) {
+    static const char hex[] = "0123456789abcdef";
+
+#if defined(__SSE2__)
+    if (count == DUMP_ROW_BYTES) {
+        const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+        const __m128i nine = _mm_set1_epi8(9);
+        const __m128i zero = _mm_set1_epi8('0');
+        const __m128i letter_offset = _mm_set1_epi8('a' - '0' - 10);
+        __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask);
+        __m128i low = _mm_and_si128(bytes, nibble_mask);
+
+        // '0' + n, moved up to 'a' for nibbles above 9
+        high = _mm_add_epi8(_mm_add_epi8(high, zero), _mm_and_si128(_mm_cmpgt_epi8(high, nine), letter_offset));
+        low = _mm_add_epi8(_mm_add_epi8(low, zero), _mm_and_si128(_mm_cmpgt_epi8(low, nine), letter_offset));
+        _mm_storeu_si128((__m128i *)digits, _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i *)(digits + 16), _mm_unpackhi_epi8(high, low));
+        return;
+    }
+#endif
+    for (int i = 0; i < count; i++) {
+        digits[2 * i] = hex[data[i] >> 4];
+        digits[2 * i + 1] = hex[data[i] & 0x0F];
+    }
+}
+
+static size_t append_text(char *line, size_t length, const char *text) {
+    while (*text && length < DUMP_LINE_SIZE - 1) {
+        line[length++] = *text++;
+    }
+    return length;
+}
+
+/*
+ * Field names for the row starting at offset: every field that starts in
+ * it, with the descriptor in front of its first field, and the field the
+ * row starts in the middle of in parentheses.
+ */
+static size_t annotate_row(char *line, size_t length, const struct dump_annotation *annotation,
+                           int offset, int end) {
+    struct dump_field field;
+
+    for (int position = offset; position < end; position = field.offset + field.length) {
+        annotation->locate(annotation->view, position, &field);
+        if (field.length <= 0) {
+            field.offset = position;
+            field.length = 1;
+        }
+        if (!field.name) {
+            continue;
+        }
+        length = append_text(line, length, " ");
+        if (field.offset < position) {
+            length = append_text(line, length, "(");
+            length = append_text(line, length, field.name);
+            length = append_text(line, length, ")");
+            continue;
+        }
+        if (field.descriptor) {
+            length = append_text(line, length, "[");
+            length = append_text(line, length, field.descriptor);
+            length = append_text(line, length, "] ");
+        }
+        length = append_text(line, length, field.name);
+    }
+    return length;
+}
+
+// 16 bytes per row, as "xx xx ... xx", each row written in one piece
+void render_hex_dump(FILE *out, const uint8_t *data, int length, const struct dump_annotation *annotation) {
+    char digits[DUMP_ROW_BYTES * 2];
+    char line[DUMP_LINE_SIZE];
+
+    for (int offset = 0; offset < length; offset += DUMP_ROW_BYTES) {
+        int count = length - offset < DUMP_ROW_BYTES ? length - offset : DUMP_ROW_BYTES;
+        size_t line_length = 0;
+
+        hex_digits(data + offset, count, digits);
+        for (int i = 0; i < count; i++) {
+            line[line_length++] = digits[2 * i];
+            line[line_length++] = digits[2 * i + 1];
+            line[line_length++] = ' ';
+        }
+        if (annotation) {
+            size_t hex_length = line_length;
+            while (line_length < DUMP_HEX_WIDTH) {
+                line[line_length++] = ' ';
+            }
+            line_length = annotate_row(line, line_length, annotation, offset, offset + count);
+            if (line_length == DUMP_HEX_WIDTH) {
+                line_length = hex_length;   // Nothing to name: no padding either
+            }
+        }
+        line[line_length++] = '\n';
+        fwrite(line, 1, line_length, out);
+    }
+}
+
+void render_raw_data(FILE *out, const char *title, const uint8_t *data, int length,
+                     const struct dump_annotation *annotation) {
+    fprintf(out, "Raw %s data:\n", title);
+    render_hex_dump(out, data, length, annotation);
+    fprintf(out, "\n");
+}
+
+/*
+ * Field layouts for dump annotations. A size of 0 is an empty field and
+ * is skipped; DUMP_FIELD_REST takes the rest of the descriptor.
+ */
+#define DUMP_FIELD_REST     -1
+
+struct field_layout {
+    const char *name;
+    int size;
+};
+
+#define LAYOUT(fields)      fields, (int)(sizeof(fields) / sizeof(fields[0]))
+
+// The field of the descriptor spanning [start, end) that covers offset
+static void locate_in_layout(const char *descriptor, const struct field_layout *layout, int count,
+                             int start, int end, int offset, struct dump_field *field) {
+    int field_start = start;
+
+    for (int i = 0; i < count && field_start < end; i++) {
+        int size = layout[i].size == DUMP_FIELD_REST ? end - field_start : layout[i].size;
+        if (size > end - field_start) {
+            size = end - field_start;
+        }
+        if (size > 0 && offset < field_start + size) {
+            field->descriptor = field_start == start ? descriptor : NULL;
+            field->name = layout[i].name;
+            field->offset = field_start;
+            field->length = size;
+            return;
+        }
+        field_start += size;
+    }
+
+    // Bytes past the decoded fields
+    field->descriptor = NULL;
+    field->name = NULL;
+    field->offset = offset;
+    field->length = end - offset;
+}
+
+// Bytes no parsed descriptor covers, up to next
+static void unparsed_field(int offset, int next, struct dump_field *field) {
+    field->descriptor = NULL;
+    field->name = NULL;
+    field->offset = offset;
+    field->length = next - offset;
+}
+
+void bos_dump_field(const void *view_data, int offset, struct dump_field *field) {
+    static const struct field_layout header[] = {
+        { "bLength", 1 }, { "bDescriptorType", 1 }, { "wTotalLength", 2 }, { "bNumDeviceCaps", 1 },
+    };
+    static const struct field_layout capability[] = {
+        { "bLength", 1 }, { "bDescriptorType", 1 }, { "bDevCapabilityType", 1 },
+        { "CapabilityData", DUMP_FIELD_REST },
+    };
+    static const struct field_layout platform[] = {
+        { "bLength", 1 }, { "bDescriptorType", 1 }, { "bDevCapabilityType", 1 }, { "bReserved", 1 },
+        { "PlatformCapabilityUUID", 16 }, { "CapabilityData", DUMP_FIELD_REST },
+    };
+    static const struct field_layout webusb[] = {
+        { "bLength", 1 }, { "bDescriptorType", 1 }, { "bDevCapabilityType", 1 }, { "bReserved", 1 },
+        { "PlatformCapabilityUUID", 16 }, { "bcdVersion", 2 }, { "bVendorCode", 1 }, { "iLandingPage", 1 },
+    };
+    static const struct field_layout msos20[] = {
+        { "bLength", 1 }, { "bDescriptorType", 1 }, { "bDevCapabilityType", 1 }, { "bReserved", 1 },
+        { "PlatformCapabilityUUID", 16 }, { "dwWindowsVersion", 4 }, { "wMSOSDescriptorSetTotalLength", 2 },
+        { "bMS_VendorCode", 1 }, { "bAltEnumCode", 1 },
+    };
+    const struct bos_view *view = view_data;
+    int first = 0;
+    int last = view->cap_count - 1;
+
+    if (offset < USB_DT_BOS_SIZE) {
+        locate_in_layout("BOS", LAYOUT(header), 0, view->length < USB_DT_BOS_SIZE ? view->length : USB_DT_BOS_SIZE,
+                         offset, field);
+        return;
+    }
+
+    // Last capability starting at or before offset
+    while (first <= last) {
+        int middle = (first + last) / 2;
+        if ((int)view->caps[middle].offset <= offset) {
+            first = middle + 1;
+        } else {
+            last = middle - 1;
+        }
+    }
+    int next = first < view->cap_count ? (int)view->caps[first].offset : view->length;
+    if (last < 0) {
+        unparsed_field(offset, next, field);
+        return;
+    }
+
+    const struct bos_capability_view *cap = &view->caps[last];
+    int start = (int)cap->offset;
+    int end = start + cap->bLength < view->length ? start + cap->bLength : view->length;
+    if (offset >= end) {
+        unparsed_field(offset, next, field);
+    } else if (cap->platform == PLATFORM_NONE) {
+        locate_in_layout("Device Capability", LAYOUT(capability), start, end, offset, field);
+    } else if (cap->data_valid && cap->platform == PLATFORM_WEBUSB) {
+        locate_in_layout("WebUSB Platform Capability", LAYOUT(webusb), start, end, offset, field);
+    } else if (cap->data_valid && cap->platform == PLATFORM_MSOS20) {
+        locate_in_layout("MS OS 2.0 Platform Capability", LAYOUT(msos20), start, end, offset, field);
+    } else {
+        locate_in_layout("Platform Capability", LAYOUT(platform), start, end, offset, field);
+    }
+}
+
+void webusb_url_dump_field(const void *view_data, int offset, struct dump_field *field) {
+    static const struct field_layout url[] = {
+        { "bLength", 1 }, { "bDescriptorType", 1 }, { "bScheme", 1 }, { "URL", DUMP_FIELD_REST },
+    };
+    const struct webusb_url_view *view = view_data;
+    int end = view->header_valid && view->bLength < view->length ? view->bLength : view->length;
+
+    if (offset >= end) {
+        unparsed_field(offset, view->length, field);
+        return;
+    }
+    locate_in_layout("WebUSB URL", LAYOUT(url), 0, end, offset, field);
+}
+
+void msos20_dump_field(const void *view_data, int offset, struct dump_field *field) {
+    static const struct field_layout set_header[] = {
+        { "wLength", 2 }, { "wDescriptorType", 2 }, { "dwWindowsVersion", 4 }, { "wTotalLength", 2 },
+    };
+    static const struct field_layout configuration_subset[] = {
+        { "wLength", 2 }, { "wDescriptorType", 2 }, { "bConfigurationValue", 1 }, { "bReserved", 1 },
+        { "wTotalLength", 2 },
+    };
+    static const struct field_layout function_subset[] = {
+        { "wLength", 2 }, { "wDescriptorType", 2 }, { "bFirstInterface", 1 }, { "bReserved", 1 },
+        { "wSubsetLength", 2 },
+    };
+    static const struct field_layout compatible_id[] = {
+        { "wLength", 2 }, { "wDescriptorType", 2 }, { "CompatibleID", 8 }, { "SubCompatibleID", 8 },
+    };
+    static const struct field_layout other[] = {
+        { "wLength", 2 }, { "wDescriptorType", 2 },
+    };
+    const struct msos20_view *view = view_data;
+    int first = 0;
+    int last = view->entry_count - 1;
+
+    // Last descriptor starting at or before offset
+    while (first <= last) {
+        int middle = (first + last) / 2;
+        if ((int)view->entries[middle].offset <= offset) {
+            first = middle + 1;
+        } else {
+            last = middle - 1;
+        }
+    }
+    int next = first < view->entry_count ? (int)view->entries[first].offset : view->length;
+    if (last < 0) {
+        unparsed_field(offset, next, field);
+        return;
+    }
+
+    const struct msos20_entry *entry = &view->entries[last];
+    int start = (int)entry->offset;
+    int end = start + entry->wLength < view->length ? start + entry->wLength : view->length;
+    if (offset >= end) {
+        unparsed_field(offset, next, field);
+        return;
+    }
+    if (!(entry->flags & MSOS20_ENTRY_VALID)) {
+        locate_in_layout("MS OS 2.0 Descriptor", LAYOUT(other), start, end, offset, field);
+        return;
+    }
+
+    switch (entry->wDescriptorType) {
+        case MS_OS_20_SET_HEADER_DESCRIPTOR:
+            locate_in_layout("Set Header", LAYOUT(set_header), start, end, offset, field);
+            break;
+        case MS_OS_20_SUBSET_HEADER_CONFIGURATION:
+            locate_in_layout("Configuration Subset Header", LAYOUT(configuration_subset), start, end, offset, field);
+            break;
+        case MS_OS_20_SUBSET_HEADER_FUNCTION:
+            locate_in_layout("Function Subset Header", LAYOUT(function_subset), start, end, offset, field);
+            break;
+        case MS_OS_20_FEATURE_COMPATIBLE_ID:
+            locate_in_layout("Compatible ID Feature", LAYOUT(compatible_id), start, end, offset, field);
+            break;
+        case MS_OS_20_FEATURE_REG_PROPERTY: {
+            const struct field_layout property[] = {
+                { "wLength", 2 }, { "wDescriptorType", 2 }, { "wPropertyDataType", 2 },
+                { "wPropertyNameLength", 2 }, { "PropertyName", entry->name_length },
+                { "wPropertyDataLength", 2 }, { "PropertyData", entry->data_length },
+            };
+            locate_in_layout("Registry Property Feature", LAYOUT(property), start, end, offset, field);
+            break;
+        }
+        default:
+            locate_in_layout("MS OS 2.0 Descriptor", LAYOUT(other), start, end, offset, field);
+            break;
+    }
+}
+
+// Print the printable low bytes of a UTF-16LE string, stopping at its terminator
+void render_utf16_ascii(FILE *out, const uint8_t *data, int byte_length) {
+    char text[128];
+    size_t length = 0;
+
+    for (int i = 0; i < byte_length; i += 2) {
+        char c = (char)data[i];
+        if (c == 0) {
+            break; // Null terminator found early
+        }
+        text[length++] = c >= 32 && c <= 126 ? c : '?'; // Non-printable characters become '?'
+        if (length == sizeof(text)) {
+            fwrite(text, 1, length, out);
+            length = 0;
+        }
+    }
+    fwrite(text, 1, length, out);
+}
+
+void render_bos_descriptor(FILE *out, const struct bos_view *view) {
+    const struct finding_list *findings = &view->findings;
+    const uint8_t *data = view->data;
+    int next = 0;
+
+    fprintf(out, "=== BOS Descriptor Analysis ===\n");
+    fprintf(out, "Total BOS length: %d bytes\n\n", view->length);
+
+    if (!view->header_valid) {
+        for (; next < findings->count; next++) {
+            render_finding(out, "", &findings->items[next]);
+        }
+        return;
+    }
+
+    const struct usb_bos_descriptor *bos = view->header;
+
+    fprintf(out, "BOS Header:\n");
+    fprintf(out, "  bLength: %d\n", bos->bLength);
+    fprintf(out, "  bDescriptorType: 0x%02x (%s)\n", bos->bDescriptorType,
+            bos->bDescriptorType == USB_DT_BOS ? "BOS" : "UNKNOWN");
+    fprintf(out, "  wTotalLength: %d\n", bos->wTotalLength);
+    fprintf(out, "  bNumDeviceCaps: %d\n\n", bos->bNumDeviceCaps);
+
+    // Header findings come first, before any capability was recorded
+    for (; next < findings->count && findings->items[next].entry == FINDING_NO_ENTRY; next++) {
+        render_finding(out, "", &findings->items[next]);
+    }
+
+    for (int i = 0; i < view->cap_count; i++) {
+        const struct bos_capability_view *cap = &view->caps[i];
+        const uint8_t *cap_data = data + cap->offset + sizeof(struct usb_plat_dev_cap_descriptor);
+
+        fprintf(out, "Device Capability %d (offset %u):\n", i, cap->offset);
+        fprintf(out, "  bLength: %d\n", cap->bLength);
+        fprintf(out, "  bDescriptorType: 0x%02x (%s)\n", cap->bDescriptorType,
+                cap->bDescriptorType == USB_DT_DEVICE_CAPABILITY ? "DEVICE_CAPABILITY" : "UNKNOWN");
+        fprintf(out, "  bDevCapabilityType: 0x%02x\n", cap->bDevCapabilityType);
+
+        if (cap->platform != PLATFORM_NONE) {
+            const struct usb_plat_dev_cap_descriptor *plat_cap =
+                (const struct usb_plat_dev_cap_descriptor *)(data + cap->offset);
+            char uuid_str[37];
+            uuid_to_string(plat_cap->UUID, uuid_str);
+
+            fprintf(out, "  Platform Capability:\n");
+            fprintf(out, "    bReserved: %d\n", plat_cap->bReserved);
+            fprintf(out, "    UUID: %s\n", uuid_str);
+
+            switch (cap->platform) {
+                case PLATFORM_WEBUSB:
+                    fprintf(out, "    Type: WebUSB Platform Capability\n");
+                    if (cap->data_valid) {
+                        fprintf(out, "    WebUSB Data:\n");
+                        fprintf(out, "      bcdVersion: 0x%04x\n", get_le16(&cap_data[0]));
+                        fprintf(out, "      bVendorCode: 0x%02x\n", cap_data[2]);
+                        fprintf(out, "      iLandingPage: %d (%s)\n", cap_data[3],
+                                cap_data[3] == 1 ? "Present" : "Not Present");
+                    }
+                    break;
+                case PLATFORM_MSOS20:
+                    fprintf(out, "    Type: MS OS 2.0 Platform Capability\n");
+                    if (cap->data_valid) {
+                        fprintf(out, "    MS OS 2.0 Data:\n");
+                        fprintf(out, "      dwWindowsVersion: 0x%08x\n", get_le32(&cap_data[0]));
+                        fprintf(out, "      wMSOSDescriptorSetTotalLength: %d\n", get_le16(&cap_data[4]));
+                        fprintf(out, "      bMS_VendorCode: 0x%02x\n", cap_data[6]);
+                        fprintf(out, "      bAltEnumCode: %d\n", cap_data[7]);
+                    }
+                    break;
+                default:
+                    fprintf(out, "    Type: Unknown Platform Capability\n");
+                    break;
+            }
+        } else {
+            fprintf(out, "  Non-Platform Capability (type 0x%02x)\n", cap->bDevCapabilityType);
+        }
+
+        for (; next < findings->count && findings->items[next].entry == i; next++) {
+            render_finding(out, "      ", &findings->items[next]);
+        }
+
+        fprintf(out, "\n");
+    }
+
+    // Trailing findings (truncated capability list)
+    for (; next < findings->count; next++) {
+        render_finding(out, "", &findings->items[next]);
+    }
+
+    int error_count = findings->error_count;
+    int warning_count = findings->warning_count;
+
+    fprintf(out, "=== BOS Summary ===\n");
+    fprintf(out, "Parsed %d device capabilities, %d errors, %d warnings\n", view->cap_count, error_count, warning_count);
+    render_findings_summary(out, findings);
+
+    if (error_count == 0 && warning_count == 0) {
+        fprintf(out, "✓ BOS descriptor appears to be well-formed\n");
+    } else if (error_count == 0) {
+        fprintf(out, "⚠ BOS descriptor is valid but has %d warning(s)\n", warning_count);
+    } else {
+        fprintf(out, "✗ BOS descriptor has %d error(s) and %d warning(s)\n", error_count, warning_count);
+    }
+    fprintf(out, "\n");
+}
+
+void render_webusb_url_descriptor(FILE *out, const struct webusb_url_view *view) {
+    fprintf(out, "=== WebUSB URL Descriptor ===\n");
+    fprintf(out, "Length: %d bytes\n", view->length);
+
+    if (!view->header_valid) {
+        for (int i = 0; i < view->findings.count; i++) {
+            render_finding(out, "", &view->findings.items[i]);
+        }
+        return;
+    }
+
+    fprintf(out, "bLength: %d\n", view->bLength);
+    fprintf(out, "bDescriptorType: %d (%s)\n", view->bDescriptorType,
+            view->bDescriptorType == WEBUSB_URL_DESCRIPTOR_TYPE ? "WebUSB URL" : "UNKNOWN");
+    fprintf(out, "bScheme: %d (", view->bScheme);
+
+    const char *scheme_prefix;
+    switch (view->bScheme) {
+        case WEBUSB_URL_SCHEME_HTTP:
+            fprintf(out, "HTTP)\n");
+            scheme_prefix = "http://";
+            break;
+        case WEBUSB_URL_SCHEME_HTTPS:
+            fprintf(out, "HTTPS)\n");
+            scheme_prefix = "https://";
+            break;
+        case WEBUSB_URL_SCHEME_NONE:
+            fprintf(out, "None)\n");
+            scheme_prefix = "";
+            break;
+        default:
+            fprintf(out, "Unknown)\n");
+            scheme_prefix = "unknown://";
+            break;
+    }
+
+    if (view->length > 3) {
+        fprintf(out, "URL: %s", scheme_prefix);
+        fwrite(view->data + view->url_offset, 1, view->url_length, out);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "\n");
+}
+
+static void render_msos20_entry(FILE *out, const struct msos20_view *view, const struct msos20_entry *entry) {
+    const uint8_t *data = view->data;
+    int offset = (int)entry->offset;
+
+    switch (entry->wDescriptorType) {
+        case MS_OS_20_SET_HEADER_DESCRIPTOR:
+            fprintf(out, "Set Header (len=%d, winver=0x%08x, total=%d)\n",
+                    entry->wLength, get_le32(&data[offset + 4]), get_le16(&data[offset + 8]));
+            break;
+        case MS_OS_20_SUBSET_HEADER_CONFIGURATION:
+            fprintf(out, "Configuration Subset Header (len=%d, config=%d, total=%d)\n",
+                    entry->wLength, data[offset + 4], get_le16(&data[offset + 6]));
+            break;
+        case MS_OS_20_SUBSET_HEADER_FUNCTION:
+            fprintf(out, "Function Subset Header (len=%d, interface=%d, subset=%d)\n",
+                    entry->wLength, data[offset + 4], get_le16(&data[offset + 6]));
+            break;
+        case MS_OS_20_FEATURE_COMPATIBLE_ID:
+            fprintf(out, "Compatible ID Feature (len=%d, compat='%.8s', subcompat='%.8s')\n",
+                    entry->wLength, (const char *)&data[offset + 4], (const char *)&data[offset + 12]);
+            break;
+        case MS_OS_20_FEATURE_REG_PROPERTY: {
+            fprintf(out, "Registry Property Feature (len=%d, datatype=%d, namelen=%d)\n",
+                    entry->wLength, get_le16(&data[offset + 4]), entry->name_length);
+
+            if (entry->flags & MSOS20_ENTRY_NAME_VALID) {
+                fprintf(out, "  Property Name: ");
+                render_utf16_ascii(out, &data[offset + 8], entry->name_length - 2);
+                fprintf(out, "\n");
+            }
+            if (entry->flags & MSOS20_ENTRY_DATA_LEN_VALID) {
+                fprintf(out, "  Property Data Length: %d\n", entry->data_length);
+            }
+            if ((entry->flags & MSOS20_ENTRY_DATA_VALID) && entry->data_length > 0) {
+                fprintf(out, "  Property Data: ");
+                render_utf16_ascii(out, &data[offset + 8 + entry->name_length + 2], entry->data_length - 2);
+                fprintf(out, "\n");
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void render_msos20_descriptor(FILE *out, const struct msos20_view *view) {
+    const struct finding_list *findings = &view->findings;
+    int next = 0;
+
+    fprintf(out, "=== MS OS 2.0 Descriptor Analysis ===\n");
+    fprintf(out, "Total descriptor length: %d bytes\n\n", view->length);
+
+    for (int i = 0; i < view->entry_count; i++) {
+        const struct msos20_entry *entry = &view->entries[i];
+
+        fprintf(out, "Offset %u: ", entry->offset);
+
+        if (entry->flags & MSOS20_ENTRY_VALID) {
+            render_msos20_entry(out, view, entry);
+            for (; next < findings->count && findings->items[next].entry == i; next++) {
+                render_finding(out, "  ", &findings->items[next]);
+            }
+        } else {
+            // Header too short or unknown type: the finding replaces the description
+            int shown = next;
+            for (; next < findings->count && findings->items[next].entry == i; next++) {
+                render_finding(out, "", &findings->items[next]);
+            }
+            if (next == shown) {
+                fprintf(out, "\n");
+            }
+        }
+    }
+
+    if (view->entries_dropped > 0) {
+        fprintf(out, "(%d further descriptor(s) validated but not shown)\n", view->entries_dropped);
+    }
+
+    // Structural errors that stopped the walk
+    for (; next < findings->count; next++) {
+        const struct finding *finding = &findings->items[next];
+        if (finding->rule != RULE_MSOS20_TRUNCATED) {
+            fprintf(out, "Offset %u: ", finding->offset);
+        }
+        render_finding(out, "", finding);
+    }
+
+    int error_count = findings->error_count;
+    int warning_count = findings->warning_count;
+
+    fprintf(out, "\n=== Summary ===\n");
+    fprintf(out, "Parsing completed: %d errors, %d warnings\n", error_count, warning_count);
+    render_findings_summary(out, findings);
+
+    if (error_count == 0 && warning_count == 0) {
+        fprintf(out, "✓ Descriptor appears to be well-formed\n");
+    } else if (error_count == 0) {
+        fprintf(out, "⚠ Descriptor is valid but has %d warning(s)\n", warning_count);
+    } else {
+        fprintf(out, "✗ Descriptor has %d error(s) and %d warning(s)\n", error_count, warning_count);
+    }
+    fprintf(out, "\n");
+}
+
+static void render_ffs_summary(FILE *out, const struct finding_list *findings) {
+    for (int i = 0; i < findings->count; i++) {
+        fprintf(out, "Offset %u: ", findings->items[i].offset);
+        render_finding(out, "", &findings->items[i]);
+    }
+
+    if (findings->count > 0) {
+        fprintf(out, "\n");
+    }
+    fprintf(out, "=== Summary ===\n");
+    fprintf(out, "Parsing completed: %d errors, %d warnings\n", findings->error_count, findings->warning_count);
+    render_findings_summary(out, findings);
+
+    if (findings->error_count == 0 && findings->warning_count == 0) {
+        fprintf(out, "✓ FunctionFS would accept this blob\n");
+    } else if (findings->error_count == 0) {
+        fprintf(out, "⚠ FunctionFS would accept this blob but it has %d warning(s)\n", findings->warning_count);
+    } else {
+        fprintf(out, "✗ FunctionFS would reject this blob: %d error(s) and %d warning(s)\n",
+                findings->error_count, findings->warning_count);
+    }
+    fprintf(out, "\n");
+}
+
+void render_ffs_descriptors(FILE *out, const struct ffs_view *view) {
+    static const char *const speed_names[FFS_SPEED_COUNT] = { "Full speed", "High speed", "SuperSpeed" };
+
+    fprintf(out, "=== FunctionFS Descriptors ===\n");
+    fprintf(out, "Length: %d bytes\n", view->length);
+
+    if (view->header_valid) {
+        fprintf(out, "Format: %s (flags=0x%02x)\n", view->magic == FFS_DESCRIPTORS_MAGIC_V2 ? "v2" : "legacy",
+                view->flags);
+        for (int i = 0; i < FFS_SPEED_COUNT; i++) {
+            if (view->counts[i] > 0) {
+                fprintf(out, "%s descriptors: %u\n", speed_names[i], view->counts[i]);
+            }
+        }
+        fprintf(out, "Interfaces: %d, endpoints: %d, highest string index: %d\n",
+                view->interface_count, view->endpoint_count, view->strings_needed);
+        if (view->os_count > 0) {
+            fprintf(out, "MS OS descriptors: %u (%d compat ID function(s), %d extended propert%s)\n",
+                    view->os_count, view->compat_count, view->property_count,
+                    view->property_count == 1 ? "y" : "ies");
+        }
+    }
+    fprintf(out, "\n");
+
+    render_ffs_summary(out, &view->findings);
+}
+
+void render_ffs_strings(FILE *out, const struct ffs_strings_view *view) {
+    fprintf(out, "=== FunctionFS Strings ===\n");
+    fprintf(out, "Length: %d bytes\n", view->length);
+
+    if (view->header_valid) {
+        fprintf(out, "Strings per language: %u, languages: %u\n", view->str_count, view->lang_count);
+    }
+    fprintf(out, "\n");
+
+    render_ffs_summary(out, &view->findings);
+}
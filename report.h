@@ -0,0 +1,53 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+
+#include "usb_descriptors.h"
+
+// ANSI color codes
+#define COLOR_RED     "\033[31m"
+#define COLOR_ORANGE  "\033[33m"
+#define COLOR_RESET   "\033[0m"
+
+/*
+ * Raw dumps can name the descriptor field of every byte next to each row.
+ * A locate function looks the field covering an offset up in a parsed
+ * view; bytes no field covers get a NULL name.
+ */
+struct dump_field {
+    const char *descriptor;     // Set on the first field of a descriptor
+    const char *name;
+    int offset;
+    int length;
+};
+
+typedef void (*dump_locate_fn)(const void *view, int offset, struct dump_field *field);
+
+struct dump_annotation {
+    dump_locate_fn locate;
+    const void *view;
+};
+
+void bos_dump_field(const void *view, int offset, struct dump_field *field);
+void webusb_url_dump_field(const void *view, int offset, struct dump_field *field);
+void msos20_dump_field(const void *view, int offset, struct dump_field *field);
+
+/*
+ * Render stage: walk a parsed view and print the human-readable analysis.
+ * Renderers only read the view and the buffer it points into.
+ */
+void render_finding(FILE *out, const char *indent, const struct finding *finding);
+void render_hex_dump(FILE *out, const uint8_t *data, int length, const struct dump_annotation *annotation);
+
+// "Raw <title> data:", the dump, and a blank line; annotation may be NULL
+void render_raw_data(FILE *out, const char *title, const uint8_t *data, int length,
+                     const struct dump_annotation *annotation);
+void render_utf16_ascii(FILE *out, const uint8_t *data, int byte_length);
+void render_bos_descriptor(FILE *out, const struct bos_view *view);
+void render_webusb_url_descriptor(FILE *out, const struct webusb_url_view *view);
+void render_msos20_descriptor(FILE *out, const struct msos20_view *view);
+void render_ffs_descriptors(FILE *out, const struct ffs_view *view);
+void render_ffs_strings(FILE *out, const struct ffs_strings_view *view);
+
+#endif
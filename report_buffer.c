@@ -0,0 +1,63 @@
+#define _GNU_SOURCE     // __fsetlocking()
+
+#include "report_buffer.h"
+
+#include <errno.h>
+#include <stdio_ext.h>
+#include <unistd.h>
+
+FILE *report_stream_open(char **data, size_t *size) {
+    FILE *stream = open_memstream(data, size);
+    if (stream) {
+        __fsetlocking(stream, FSETLOCKING_BYCALLER);
+    }
+    return stream;
+}
+
+int report_write(FILE *out, const struct iovec *parts, int count) {
+    struct iovec pending[REPORT_WRITE_MAX_PARTS];
+    int fd = fileno(out);
+
+    if (fflush(out) != 0) {
+        return -1;
+    }
+    if (fd < 0) {
+        for (int i = 0; i < count; i++) {
+            if (fwrite(parts[i].iov_base, 1, parts[i].iov_len, out) != parts[i].iov_len) {
+                return -1;
+            }
+        }
+        return fflush(out) == 0 ? 0 : -1;
+    }
+
+    while (count > 0) {
+        int batch = count < REPORT_WRITE_MAX_PARTS ? count : REPORT_WRITE_MAX_PARTS;
+        for (int i = 0; i < batch; i++) {
+            pending[i] = parts[i];
+        }
+        parts += batch;
+        count -= batch;
+
+        // Resume after partial writes, which pipes and terminals may do
+        struct iovec *next = pending;
+        while (batch > 0) {
+            ssize_t written = writev(fd, next, batch);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            while (batch > 0 && (size_t)written >= next->iov_len) {
+                written -= (ssize_t)next->iov_len;
+                next++;
+                batch--;
+            }
+            if (batch > 0) {
+                next->iov_base = (char *)next->iov_base + written;
+                next->iov_len -= (size_t)written;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef REPORT_BUFFER_H
+#define REPORT_BUFFER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/uio.h>
+
+/*
+ * Whole reports in memory
+ *
+ * A report is rendered into a memory stream that only its owner touches,
+ * so stdio locking is switched off for it. Once complete it goes out with
+ * a single write(), or one writev() for several reports in a row, instead
+ * of one stdio call per line.
+ */
+
+#define REPORT_WRITE_MAX_PARTS  64      // Reports gathered into one writev()
+
+// open_memstream() without stdio locking; *data and *size are set when the stream is flushed or closed
+FILE *report_stream_open(char **data, size_t *size);
+
+/*
+ * Flush out, then write the parts to its file descriptor with as few
+ * system calls as it takes (one, unless the descriptor takes less). Falls
+ * back to fwrite() for streams without a descriptor. 0, or -1 on error.
+ */
+int report_write(FILE *out, const struct iovec *parts, int count);
+
+#endif
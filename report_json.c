@@ -0,0 +1,174 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "report_json.h"
+
+#include <string.h>
+
+static const char *platform_name(uint8_t platform) {
+    switch (platform) {
+        case PLATFORM_WEBUSB:
+            return "webusb";
+        case PLATFORM_MSOS20:
+            return "msos20";
+        case PLATFORM_UNKNOWN:
+            return "unknown";
+        default:
+            return NULL;
+    }
+}
+
+// Findings totals, shared by every descriptor object
+static void json_finding_counts(struct json_writer *writer, const struct finding_list *findings) {
+    json_int(writer, "errors", findings->error_count);
+    json_int(writer, "warnings", findings->warning_count);
+}
+
+void json_bos_descriptor(struct json_writer *writer, const char *key, const struct bos_view *view) {
+    const uint8_t *data = view->data;
+
+    json_begin_object(writer, key);
+    json_int(writer, "length", view->length);
+    json_hex(writer, "raw", data, view->length);
+    if (view->header_valid) {
+        json_int(writer, "wTotalLength", get_le16(&data[2]));
+        json_int(writer, "bNumDeviceCaps", data[4]);
+    }
+
+    json_begin_array(writer, "capabilities");
+    for (int i = 0; i < view->cap_count; i++) {
+        const struct bos_capability_view *cap = &view->caps[i];
+        const uint8_t *cap_data = data + cap->offset + sizeof(struct usb_plat_dev_cap_descriptor);
+
+        json_begin_object(writer, NULL);
+        json_int(writer, "offset", cap->offset);
+        json_int(writer, "bLength", cap->bLength);
+        json_int(writer, "bDevCapabilityType", cap->bDevCapabilityType);
+        if (cap->platform != PLATFORM_NONE) {
+            char uuid[37];
+            uuid_to_string(data + cap->offset + 4, uuid);
+            json_string(writer, "platform", platform_name(cap->platform));
+            json_string(writer, "uuid", uuid);
+        }
+        if (cap->data_valid && cap->platform == PLATFORM_WEBUSB) {
+            json_int(writer, "bcdVersion", get_le16(&cap_data[0]));
+            json_int(writer, "bVendorCode", cap_data[2]);
+            json_int(writer, "iLandingPage", cap_data[3]);
+        } else if (cap->data_valid && cap->platform == PLATFORM_MSOS20) {
+            json_int(writer, "dwWindowsVersion", get_le32(&cap_data[0]));
+            json_int(writer, "wMSOSDescriptorSetTotalLength", get_le16(&cap_data[4]));
+            json_int(writer, "bMS_VendorCode", cap_data[6]);
+            json_int(writer, "bAltEnumCode", cap_data[7]);
+        }
+        json_end_object(writer);
+    }
+    json_end_array(writer);
+
+    json_finding_counts(writer, &view->findings);
+    json_end_object(writer);
+}
+
+void json_webusb_url_descriptor(struct json_writer *writer, const char *key, const struct webusb_url_view *view) {
+    json_begin_object(writer, key);
+    json_int(writer, "length", view->length);
+    json_hex(writer, "raw", view->data, view->length);
+    if (view->header_valid) {
+        json_int(writer, "bScheme", view->bScheme);
+
+        const char *prefix = view->bScheme == WEBUSB_URL_SCHEME_HTTP ? "http://" :
+                             view->bScheme == WEBUSB_URL_SCHEME_HTTPS ? "https://" :
+                             view->bScheme == WEBUSB_URL_SCHEME_NONE ? "" : NULL;
+        if (prefix) {
+            char url[sizeof("https://") + 255];
+            snprintf(url, sizeof(url), "%s%.*s", prefix, (int)view->url_length,
+                     (const char *)view->data + view->url_offset);
+            json_string(writer, "url", url);
+        } else {
+            json_null(writer, "url");
+        }
+    }
+    json_finding_counts(writer, &view->findings);
+    json_end_object(writer);
+}
+
+static void json_msos20_entry(struct json_writer *writer, const struct msos20_view *view,
+                              const struct msos20_entry *entry) {
+    const uint8_t *data = view->data + entry->offset;
+
+    json_begin_object(writer, NULL);
+    json_int(writer, "offset", entry->offset);
+    json_int(writer, "wLength", entry->wLength);
+    json_int(writer, "wDescriptorType", entry->wDescriptorType);
+    if (!(entry->flags & MSOS20_ENTRY_VALID)) {
+        json_end_object(writer);
+        return;
+    }
+
+    switch (entry->wDescriptorType) {
+        case MS_OS_20_SET_HEADER_DESCRIPTOR:
+            json_string(writer, "type", "set_header");
+            json_int(writer, "dwWindowsVersion", get_le32(&data[4]));
+            json_int(writer, "wTotalLength", get_le16(&data[8]));
+            break;
+        case MS_OS_20_SUBSET_HEADER_CONFIGURATION:
+            json_string(writer, "type", "configuration_subset");
+            json_int(writer, "bConfigurationValue", data[4]);
+            json_int(writer, "wTotalLength", get_le16(&data[6]));
+            break;
+        case MS_OS_20_SUBSET_HEADER_FUNCTION:
+            json_string(writer, "type", "function_subset");
+            json_int(writer, "bFirstInterface", data[4]);
+            json_int(writer, "wSubsetLength", get_le16(&data[6]));
+            break;
+        case MS_OS_20_FEATURE_COMPATIBLE_ID:
+            json_string(writer, "type", "compatible_id");
+            json_string_n(writer, "CompatibleID", (const char *)&data[4], strnlen((const char *)&data[4], 8));
+            json_string_n(writer, "SubCompatibleID", (const char *)&data[12], strnlen((const char *)&data[12], 8));
+            break;
+        case MS_OS_20_FEATURE_REG_PROPERTY:
+            json_string(writer, "type", "registry_property");
+            json_int(writer, "wPropertyDataType", get_le16(&data[4]));
+            if (entry->flags & MSOS20_ENTRY_NAME_VALID) {
+                json_utf16(writer, "PropertyName", &data[8], entry->name_length);
+            }
+            if (entry->flags & MSOS20_ENTRY_DATA_LEN_VALID) {
+                json_int(writer, "wPropertyDataLength", entry->data_length);
+            }
+            break;
+        default:
+            break;
+    }
+    json_end_object(writer);
+}
+
+void json_msos20_descriptor(struct json_writer *writer, const char *key, const struct msos20_view *view) {
+    json_begin_object(writer, key);
+    json_int(writer, "length", view->length);
+    json_hex(writer, "raw", view->data, view->length);
+
+    json_begin_array(writer, "descriptors");
+    for (int i = 0; i < view->entry_count; i++) {
+        json_msos20_entry(writer, view, &view->entries[i]);
+    }
+    json_end_array(writer);
+    json_int(writer, "descriptors_dropped", view->entries_dropped);
+
+    json_finding_counts(writer, &view->findings);
+    json_end_object(writer);
+}
+
+void json_findings(struct json_writer *writer, const char *descriptor, const struct finding_list *findings) {
+    for (int i = 0; i < findings->count; i++) {
+        const struct finding *finding = &findings->items[i];
+        const struct rule_info *rule = &descriptor_rules[finding->rule];
+        char message[256];
+
+        snprintf(message, sizeof(message), rule->message, finding->value[0], finding->value[1], finding->value[2]);
+        json_begin_object(writer, NULL);
+        json_string(writer, "descriptor", descriptor);
+        json_string(writer, "rule", rule->id);
+        json_string(writer, "severity", rule->severity == SEVERITY_ERROR ? "error" : "warning");
+        json_int(writer, "offset", finding->offset);
+        json_string(writer, "message", message);
+        json_end_object(writer);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef REPORT_JSON_H
+#define REPORT_JSON_H
+
+#include "json_writer.h"
+#include "usb_descriptors.h"
+
+/*
+ * Structured counterpart of the render stage: each parsed view becomes a
+ * JSON object with its decoded fields and its raw bytes as hex. Findings
+ * are written separately so a record can collect those of every
+ * descriptor in one array, each tagged with the descriptor it belongs to,
+ * its stable rule ID and its byte offset.
+ */
+void json_bos_descriptor(struct json_writer *writer, const char *key, const struct bos_view *view);
+void json_webusb_url_descriptor(struct json_writer *writer, const char *key, const struct webusb_url_view *view);
+void json_msos20_descriptor(struct json_writer *writer, const char *key, const struct msos20_view *view);
+
+// Array elements for every finding in the list; call between json_begin_array() and json_end_array()
+void json_findings(struct json_writer *writer, const char *descriptor, const struct finding_list *findings);
+
+#endif
@@ -0,0 +1,58 @@
+#include "request_plan.h"
+
+#include <stddef.h>
+
+static void add_request(struct request_plan *plan, enum planned_request_kind kind,
+                        uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength) {
+    struct planned_request *request = &plan->requests[plan->count++];
+    request->kind = kind;
+    request->setup.bmRequestType = REQUEST_TYPE_VENDOR_IN;
+    request->setup.bRequest = bRequest;
+    request->setup.wValue = wValue;
+    request->setup.wIndex = wIndex;
+    request->setup.wLength = wLength;
+}
+
+struct control_request descriptor_request(uint8_t type, uint8_t index, uint16_t wIndex, uint16_t wLength) {
+    struct control_request setup;
+    setup.bmRequestType = REQUEST_TYPE_STANDARD_IN;
+    setup.bRequest = USB_REQUEST_GET_DESCRIPTOR;
+    setup.wValue = (uint16_t)((type << 8) | index);
+    setup.wIndex = wIndex;
+    setup.wLength = wLength;
+    return setup;
+}
+
+struct control_request bos_request(uint16_t wLength) {
+    return descriptor_request(USB_DT_BOS, 0, 0, wLength);
+}
+
+void plan_requests(struct request_plan *plan, const struct bos_summary *summary) {
+    plan->count = 0;
+
+    if (summary == NULL) {
+        return;
+    }
+
+    // GET_URL needs both a vendor code and a landing page to ask for
+    if (summary->has_webusb && summary->webusb_vendor_code != 0 && summary->webusb_landing_page != 0) {
+        add_request(plan, REQUEST_WEBUSB_URL, summary->webusb_vendor_code,
+                    summary->webusb_landing_page, WEBUSB_GET_URL, WEBUSB_URL_MAX_LENGTH);
+    }
+
+    // The set is requested with exactly the length the device advertises
+    if (summary->has_msos20 && summary->msos20_set_length >= 10) {
+        add_request(plan, REQUEST_MSOS20_SET, summary->msos20_vendor_code,
+                    0x0000, MS_OS_20_DESCRIPTOR_INDEX, summary->msos20_set_length);
+    }
+}
+
+const struct planned_request *find_planned_request(const struct request_plan *plan,
+                                                   enum planned_request_kind kind) {
+    for (int i = 0; i < plan->count; i++) {
+        if (plan->requests[i].kind == kind) {
+            return &plan->requests[i];
+        }
+    }
+    return NULL;
+}
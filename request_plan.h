@@ -0,0 +1,62 @@
+#ifndef REQUEST_PLAN_H
+#define REQUEST_PLAN_H
+
+#include <stdint.h>
+
+#include "usb_descriptors.h"
+
+#define REQUEST_TYPE_STANDARD_IN        0x80    // IN, STANDARD, DEVICE
+#define REQUEST_TYPE_VENDOR_IN          0xC0    // IN, VENDOR, DEVICE
+
+#define USB_REQUEST_GET_DESCRIPTOR      0x06
+#define MS_OS_20_DESCRIPTOR_INDEX       0x07
+
+// A WebUSB URL descriptor's bLength is a single byte
+#define WEBUSB_URL_MAX_LENGTH           255
+
+// Setup packet of a control IN transfer
+struct control_request {
+    uint8_t  bmRequestType;
+    uint8_t  bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+};
+
+enum planned_request_kind {
+    REQUEST_WEBUSB_URL,
+    REQUEST_MSOS20_SET,
+};
+
+struct planned_request {
+    enum planned_request_kind kind;
+    struct control_request setup;
+};
+
+#define REQUEST_PLAN_MAX    2
+
+struct request_plan {
+    int count;
+    struct planned_request requests[REQUEST_PLAN_MAX];
+};
+
+// Standard GET_DESCRIPTOR; wIndex is the LANGID for string descriptors
+struct control_request descriptor_request(uint8_t type, uint8_t index, uint16_t wIndex, uint16_t wLength);
+
+/*
+ * GET_DESCRIPTOR(BOS). The BOS is fetched in two steps: the 5-byte header
+ * first, then exactly wTotalLength bytes.
+ */
+struct control_request bos_request(uint16_t wLength);
+
+/*
+ * Build the list of follow-up transfers from a parsed BOS: one per
+ * capability that is present and usable, with the device's own vendor
+ * codes and exact lengths. A NULL summary (no BOS) yields an empty plan.
+ */
+void plan_requests(struct request_plan *plan, const struct bos_summary *summary);
+
+const struct planned_request *find_planned_request(const struct request_plan *plan,
+                                                   enum planned_request_kind kind);
+
+#endif
@@ -0,0 +1,1388 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "source_arrays.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "report.h"
+#include "report_buffer.h"
+#include "usb_descriptors.h"
+#include "usb_engine.h"
+
+#define MACRO_BUCKETS   1024
+#define ERROR_SIZE      96
+
+enum token_kind {
+    TOKEN_IDENT,
+    TOKEN_NUMBER,               // Integer or character constant, value is set
+    TOKEN_PUNCT,
+    TOKEN_OTHER,                // String and floating-point literals
+};
+
+// Two-character operators; single characters are stored as themselves
+#define PUNCT_SHL   1
+#define PUNCT_SHR   2
+#define PUNCT_LE    3
+#define PUNCT_GE    4
+#define PUNCT_EQ    5
+#define PUNCT_NE    6
+#define PUNCT_AND   7
+#define PUNCT_OR    8
+#define PUNCT_PASTE 9
+
+struct token {
+    uint8_t kind;
+    uint8_t punct;
+    uint16_t length;
+    uint32_t line;
+    const char *text;
+    int64_t value;
+};
+
+struct token_vec {
+    struct token *items;
+    int count;
+    int capacity;
+};
+
+struct macro {
+    const char *name;
+    uint16_t name_length;
+    int8_t param_count;         // -1 for object-like macros and enum constants
+    int params;                 // First parameter name in macro_tokens, followed by the body
+    int body_end;
+    int next;                   // Older macro in the same bucket, or -1
+    unsigned bucket;            // The name may point into a file that is already unmapped
+};
+
+struct source_array {
+    const char *name;
+    uint16_t name_length;
+    uint32_t line;
+    size_t offset;              // Bytes in source_context.bytes
+    int length;
+    int truncated;              // Elements that did not fit in a byte
+    int evaluated;
+    char error[ERROR_SIZE];
+};
+
+// Per-worker state, reset for every file down to the prelude
+struct source_context {
+    struct token_vec tokens;            // The file without its preprocessor lines
+    struct token_vec macro_tokens;
+    struct macro *macros;
+    int macro_count;
+    int macro_capacity;
+    int buckets[MACRO_BUCKETS];
+    int prelude_macros;
+    int prelude_macro_tokens;
+
+    struct source_array *arrays;
+    int array_count;
+    int array_capacity;
+    uint8_t *bytes;
+    size_t byte_count;
+    size_t byte_capacity;
+    char error[ERROR_SIZE];             // Why the current array could not be evaluated
+
+    struct bos_view bos_view;
+    struct msos20_view msos20_view;
+    struct webusb_url_view url_view;
+};
+
+struct source_result {
+    char *report;
+    size_t report_size;
+    int readable;
+    int arrays;
+    int not_evaluated;
+    int kinds[BLOB_KIND_COUNT];
+    int with_errors;
+    int with_warnings;
+};
+
+struct source_batch {
+    const struct file_list *files;
+    struct source_result *results;
+    pthread_mutex_t lock;
+    int next;                           // Protected by lock
+};
+
+// Byte-splitting helpers and BOS macros of common USB stacks, overridden by a file's own definitions
+static const char prelude[] =
+    "#define LE16(x) ((x) & 0xFF), (((x) >> 8) & 0xFF)\n"
+    "#define LE32(x) ((x) & 0xFF), (((x) >> 8) & 0xFF), (((x) >> 16) & 0xFF), (((x) >> 24) & 0xFF)\n"
+    "#define WBVAL(x) LE16(x)\n"
+    "#define DBVAL(x) LE32(x)\n"
+    "#define LOBYTE(x) ((x) & 0xFF)\n"
+    "#define HIBYTE(x) (((x) >> 8) & 0xFF)\n"
+    "#define LSB(x) ((x) & 0xFF)\n"
+    "#define MSB(x) (((x) >> 8) & 0xFF)\n"
+    "#define U16_TO_U8S_LE(x) LE16(x)\n"
+    "#define U32_TO_U8S_LE(x) LE32(x)\n"
+    "#define TU_U16_LOW(x) ((x) & 0xFF)\n"
+    "#define TU_U16_HIGH(x) (((x) >> 8) & 0xFF)\n"
+    "#define USB_DT_BOS 0x0F\n"
+    "#define USB_DT_DEVICE_CAPABILITY 0x10\n"
+    "#define USB_PLAT_DEV_CAP_TYPE 0x05\n"
+    "#define TUSB_DESC_BOS 0x0F\n"
+    "#define TUSB_DESC_DEVICE_CAPABILITY 0x10\n"
+    "#define DEVICE_CAPABILITY_PLATFORM 0x05\n"
+    "#define MS_OS_20_SET_HEADER_DESCRIPTOR 0x00\n"
+    "#define MS_OS_20_SUBSET_HEADER_CONFIGURATION 0x01\n"
+    "#define MS_OS_20_SUBSET_HEADER_FUNCTION 0x02\n"
+    "#define MS_OS_20_FEATURE_COMPATBLE_ID 0x03\n"
+    "#define MS_OS_20_FEATURE_COMPATIBLE_ID 0x03\n"
+    "#define MS_OS_20_FEATURE_REG_PROPERTY 0x04\n"
+    "#define MS_OS_20_FEATURE_MIN_RESUME_TIME 0x05\n"
+    "#define MS_OS_20_FEATURE_MODEL_ID 0x06\n"
+    "#define MS_OS_20_FEATURE_CCGP_DEVICE 0x07\n"
+    "#define MS_OS_20_FEATURE_VENDOR_REVISION 0x08\n"
+    "#define TUD_BOS_DESC_LEN 5\n"
+    "#define TUD_BOS_WEBUSB_DESC_LEN 24\n"
+    "#define TUD_BOS_MICROSOFT_OS_DESC_LEN 28\n"
+    "#define TUD_BOS_DESCRIPTOR(total_len, caps) 5, 0x0F, LE16(total_len), caps\n"
+    "#define TUD_BOS_WEBUSB_UUID 0x38, 0xB6, 0x08, 0x34, 0xA9, 0x09, 0xA0, 0x47, "
+    "0x8B, 0xFD, 0xA0, 0x76, 0x88, 0x15, 0xB6, 0x65\n"
+    "#define TUD_BOS_MS_OS_20_UUID 0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C, "
+    "0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F\n"
+    "#define TUD_BOS_WEBUSB_DESCRIPTOR(vendor_code, landing_page) "
+    "24, 0x10, 0x05, 0x00, TUD_BOS_WEBUSB_UUID, LE16(0x0100), vendor_code, landing_page\n"
+    "#define TUD_BOS_MS_OS_20_DESCRIPTOR(set_len, vendor_code) "
+    "28, 0x10, 0x05, 0x00, TUD_BOS_MS_OS_20_UUID, LE32(0x06030000), LE16(set_len), vendor_code, 0\n";
+
+static const char * const source_extensions[] = {
+    ".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp", ".hxx", ".inc", ".ino",
+};
+
+// Type names that may appear in a byte array declaration or a cast, with their width
+static const struct {
+    const char *name;
+    uint8_t bits;
+    uint8_t is_signed;
+} type_words[] = {
+    { "uint8_t", 8, 0 }, { "u8", 8, 0 }, { "__u8", 8, 0 }, { "U8", 8, 0 }, { "UINT8", 8, 0 },
+    { "uint8", 8, 0 }, { "u_int8_t", 8, 0 }, { "BYTE", 8, 0 }, { "UCHAR", 8, 0 },
+    { "char", 8, 1 }, { "int8_t", 8, 1 }, { "s8", 8, 1 }, { "__s8", 8, 1 }, { "INT8", 8, 1 },
+    { "uint16_t", 16, 0 }, { "u16", 16, 0 }, { "__u16", 16, 0 }, { "__le16", 16, 0 }, { "U16", 16, 0 },
+    { "UINT16", 16, 0 }, { "uint16", 16, 0 }, { "WORD", 16, 0 },
+    { "short", 16, 1 }, { "int16_t", 16, 1 }, { "s16", 16, 1 }, { "INT16", 16, 1 },
+    { "uint32_t", 32, 0 }, { "u32", 32, 0 }, { "__u32", 32, 0 }, { "__le32", 32, 0 }, { "U32", 32, 0 },
+    { "UINT32", 32, 0 }, { "uint32", 32, 0 }, { "DWORD", 32, 0 },
+    { "int", 32, 1 }, { "int32_t", 32, 1 }, { "s32", 32, 1 }, { "INT32", 32, 1 },
+    { "uint64_t", 64, 0 }, { "u64", 64, 0 }, { "long", 64, 1 }, { "int64_t", 64, 1 }, { "size_t", 64, 0 },
+};
+
+#define TYPE_WORD_COUNT (int)(sizeof(type_words) / sizeof(type_words[0]))
+
+static int token_is(const struct token *t, const char *word) {
+    return t->kind == TOKEN_IDENT && t->length == strlen(word) && memcmp(t->text, word, t->length) == 0;
+}
+
+static int is_punct(const struct token *t, int punct) {
+    return t->kind == TOKEN_PUNCT && t->punct == punct;
+}
+
+// Index in type_words, -1 if the identifier is not a type; modifiers return TYPE_WORD_COUNT
+static int type_word(const struct token *t) {
+    if (t->kind != TOKEN_IDENT) {
+        return -1;
+    }
+    if (token_is(t, "const") || token_is(t, "volatile") || token_is(t, "unsigned") || token_is(t, "signed")) {
+        return TYPE_WORD_COUNT;
+    }
+    for (int i = 0; i < TYPE_WORD_COUNT; i++) {
+        if (token_is(t, type_words[i].name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int push_token(struct token_vec *vec, const struct token *t) {
+    if (vec->count == vec->capacity) {
+        int capacity = vec->capacity ? vec->capacity * 2 : 1024;
+        struct token *items = realloc(vec->items, capacity * sizeof(*items));
+        if (!items) {
+            return -1;
+        }
+        vec->items = items;
+        vec->capacity = capacity;
+    }
+    vec->items[vec->count++] = *t;
+    return 0;
+}
+
+static unsigned hash_name(const char *name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash % MACRO_BUCKETS;
+}
+
+static const struct macro *find_macro(const struct source_context *ctx, const struct token *t) {
+    for (int i = ctx->buckets[hash_name(t->text, t->length)]; i >= 0; i = ctx->macros[i].next) {
+        const struct macro *macro = &ctx->macros[i];
+        if (macro->name_length == t->length && memcmp(macro->name, t->text, t->length) == 0) {
+            return macro;
+        }
+    }
+    return NULL;
+}
+
+static int add_macro(struct source_context *ctx, const struct token *name, int param_count, int params,
+                     int body_end) {
+    if (ctx->macro_count == ctx->macro_capacity) {
+        int capacity = ctx->macro_capacity ? ctx->macro_capacity * 2 : 256;
+        struct macro *macros = realloc(ctx->macros, capacity * sizeof(*macros));
+        if (!macros) {
+            return -1;
+        }
+        ctx->macros = macros;
+        ctx->macro_capacity = capacity;
+    }
+
+    unsigned bucket = hash_name(name->text, name->length);
+    ctx->macros[ctx->macro_count] = (struct macro){ name->text, name->length, (int8_t)param_count, params,
+                                                    body_end, ctx->buckets[bucket], bucket };
+    ctx->buckets[bucket] = ctx->macro_count++;
+    return 0;
+}
+
+// Turn the tokens of a #define line into a macro; the parameter names are packed right after the name
+static void end_define(struct source_context *ctx, int begin) {
+    struct token *t = &ctx->macro_tokens.items[begin];
+    int count = ctx->macro_tokens.count - begin;
+
+    if (count == 0 || t[0].kind != TOKEN_IDENT) {
+        ctx->macro_tokens.count = begin;
+        return;
+    }
+    struct token name = t[0];
+
+    // Function-like only if the parenthesis touches the name
+    if (count == 1 || !is_punct(&t[1], '(') || t[1].text != name.text + name.length) {
+        add_macro(ctx, &name, -1, begin + 1, ctx->macro_tokens.count);
+        return;
+    }
+
+    int param_count = 0;
+    int i = 2;
+    if (i < count && is_punct(&t[i], ')')) {
+        i++;
+    } else {
+        for (;;) {
+            if (i + 1 >= count || t[i].kind != TOKEN_IDENT || param_count == SOURCE_MACRO_PARAMS) {
+                ctx->macro_tokens.count = begin;     // Variadic or malformed: leave the name undefined
+                return;
+            }
+            t[1 + param_count++] = t[i];
+            if (is_punct(&t[i + 1], ')')) {
+                i += 2;
+                break;
+            }
+            if (!is_punct(&t[i + 1], ',')) {
+                ctx->macro_tokens.count = begin;
+                return;
+            }
+            i += 2;
+        }
+    }
+
+    memmove(&t[1 + param_count], &t[i], (count - i) * sizeof(*t));
+    ctx->macro_tokens.count = begin + 1 + param_count + (count - i);
+    add_macro(ctx, &name, param_count, begin + 1, ctx->macro_tokens.count);
+}
+
+static size_t lex_char(const char *text, size_t size, size_t i, int64_t *value) {
+    // i is just past the opening quote
+    *value = 0;
+    while (i < size && text[i] != '\'' && text[i] != '\n') {
+        int64_t c = (uint8_t)text[i++];
+        if (c == '\\' && i < size) {
+            c = (uint8_t)text[i++];
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'a': c = '\a'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'v': c = '\v'; break;
+                case 'x':
+                    c = 0;
+                    while (i < size && strchr("0123456789abcdefABCDEF", text[i]) && text[i] != '\0') {
+                        char d = text[i++];
+                        c = c * 16 + (d <= '9' ? d - '0' : (d | 0x20) - 'a' + 10);
+                    }
+                    break;
+                default:
+                    if (c >= '0' && c <= '7') {
+                        c -= '0';
+                        for (int n = 0; n < 2 && i < size && text[i] >= '0' && text[i] <= '7'; n++) {
+                            c = c * 8 + (text[i++] - '0');
+                        }
+                    }
+                    break;
+            }
+        }
+        *value = (*value << 8) | (c & 0xFF);
+    }
+    return i < size && text[i] == '\'' ? i + 1 : i;
+}
+
+// A preprocessing number; only integer constants get a value
+static size_t lex_number(const char *text, size_t size, size_t i, struct token *t) {
+    size_t start = i;
+    while (i < size && (text[i] == '.' || text[i] == '_' || (text[i] >= '0' && text[i] <= '9') ||
+                        ((text[i] | 0x20) >= 'a' && (text[i] | 0x20) <= 'z') ||
+                        ((text[i] == '+' || text[i] == '-') && strchr("eEpP", text[i - 1]) &&
+                         !((text[start + 1] | 0x20) == 'x' && (text[i - 1] | 0x20) == 'e')))) {
+        i++;
+    }
+
+    size_t p = start;
+    unsigned base = 10;
+    if (text[p] == '0' && p + 1 < i && (text[p + 1] | 0x20) == 'x') {
+        base = 16;
+        p += 2;
+    } else if (text[p] == '0' && p + 1 < i && (text[p + 1] | 0x20) == 'b') {
+        base = 2;
+        p += 2;
+    } else if (text[p] == '0') {
+        base = 8;
+    }
+
+    uint64_t value = 0;
+    for (; p < i; p++) {
+        char c = text[p];
+        unsigned digit = c >= '0' && c <= '9' ? (unsigned)(c - '0') :
+                         (c | 0x20) >= 'a' && (c | 0x20) <= 'f' && base == 16 ? (unsigned)((c | 0x20) - 'a' + 10) :
+                         c == '\'' ? 0 : 99;
+        if (digit >= base) {
+            break;
+        }
+        value = value * base + digit;
+    }
+    while (p < i && strchr("uUlL", text[p])) {
+        p++;
+    }
+
+    t->kind = p == i ? TOKEN_NUMBER : TOKEN_OTHER;
+    t->value = (int64_t)value;
+    return i;
+}
+
+static int punct_code(const char *text, size_t size, size_t i, int *length) {
+    static const struct {
+        char first;
+        char second;
+        int code;
+    } pairs[] = {
+        { '<', '<', PUNCT_SHL }, { '>', '>', PUNCT_SHR }, { '<', '=', PUNCT_LE }, { '>', '=', PUNCT_GE },
+        { '=', '=', PUNCT_EQ }, { '!', '=', PUNCT_NE }, { '&', '&', PUNCT_AND }, { '|', '|', PUNCT_OR },
+        { '#', '#', PUNCT_PASTE },
+    };
+
+    if (i + 1 < size) {
+        for (size_t k = 0; k < sizeof(pairs) / sizeof(pairs[0]); k++) {
+            if (text[i] == pairs[k].first && text[i + 1] == pairs[k].second) {
+                *length = 2;
+                return pairs[k].code;
+            }
+        }
+    }
+    *length = 1;
+    return (uint8_t)text[i];
+}
+
+/*
+ * One pass over the text: code tokens go to ctx->tokens, #define lines
+ * become macros and every other preprocessor line is skipped.
+ */
+static int tokenize(struct source_context *ctx, const char *text, size_t size) {
+    uint32_t line = 1;
+    int line_start = 1;
+    int directive = 0;              // 1 inside a #define, 2 inside another directive
+    int define_begin = 0;
+    size_t i = 0;
+
+    while (i < size) {
+        char c = text[i];
+
+        if (c == '\n') {
+            if (directive == 1) {
+                end_define(ctx, define_begin);
+            }
+            directive = 0;
+            line_start = 1;
+            line++;
+            i++;
+            continue;
+        }
+        if (c == '\\' && i + 1 < size && (text[i + 1] == '\n' || (text[i + 1] == '\r' && i + 2 < size &&
+                                                                   text[i + 2] == '\n'))) {
+            i += text[i + 1] == '\n' ? 2 : 3;
+            line++;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            i++;
+            continue;
+        }
+        if (c == '/' && i + 1 < size && text[i + 1] == '/') {
+            while (i < size && text[i] != '\n') {
+                i++;
+            }
+            continue;
+        }
+        if (c == '/' && i + 1 < size && text[i + 1] == '*') {
+            for (i += 2; i < size && !(text[i] == '*' && i + 1 < size && text[i + 1] == '/'); i++) {
+                line += text[i] == '\n';
+            }
+            i += 2;
+            continue;
+        }
+
+        if (c == '#' && line_start) {
+            size_t word = i + 1;
+            while (word < size && (text[word] == ' ' || text[word] == '\t')) {
+                word++;
+            }
+            if (size - word >= 6 && memcmp(&text[word], "define", 6) == 0) {
+                directive = 1;
+                define_begin = ctx->macro_tokens.count;
+                i = word + 6;
+            } else {
+                directive = 2;
+                i = word;
+            }
+            line_start = 0;
+            continue;
+        }
+        line_start = 0;
+        if (directive == 2) {
+            i++;
+            continue;
+        }
+
+        struct token t = { 0 };
+        t.line = line;
+        t.text = &text[i];
+        size_t start = i;
+        if (c == '_' || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')) {
+            t.kind = TOKEN_IDENT;
+            while (i < size && (text[i] == '_' || (text[i] >= '0' && text[i] <= '9') ||
+                                ((text[i] | 0x20) >= 'a' && (text[i] | 0x20) <= 'z'))) {
+                i++;
+            }
+        } else if ((c >= '0' && c <= '9') || (c == '.' && i + 1 < size && text[i + 1] >= '0' && text[i + 1] <= '9')) {
+            i = lex_number(text, size, i, &t);
+        } else if (c == '\'') {
+            t.kind = TOKEN_NUMBER;
+            i = lex_char(text, size, i + 1, &t.value);
+        } else if (c == '"') {
+            t.kind = TOKEN_OTHER;
+            for (i++; i < size && text[i] != '"' && text[i] != '\n'; i++) {
+                i += text[i] == '\\';
+            }
+            i++;
+        } else {
+            int length;
+            t.kind = TOKEN_PUNCT;
+            t.punct = (uint8_t)punct_code(text, size, i, &length);
+            i += length;
+        }
+        if (i > size) {
+            i = size;
+        }
+        t.length = (uint16_t)(i - start < 0xFFFF ? i - start : 0xFFFF);
+
+        if (push_token(directive == 1 ? &ctx->macro_tokens : &ctx->tokens, &t) != 0) {
+            return -1;
+        }
+    }
+    if (directive == 1) {
+        end_define(ctx, define_begin);
+    }
+    return 0;
+}
+
+static void set_error(struct source_context *ctx, const char *format, ...) {
+    if (ctx->error[0] != '\0') {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vsnprintf(ctx->error, sizeof(ctx->error), format, args);
+    va_end(args);
+}
+
+// Index of the bracket closing the one at open, or -1
+static int matching(const struct token *t, int count, int open, int open_punct, int close_punct) {
+    int depth = 0;
+    for (int i = open; i < count; i++) {
+        if (is_punct(&t[i], open_punct)) {
+            depth++;
+        } else if (is_punct(&t[i], close_punct) && --depth == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Append in[0..count) to out with every macro expanded
+static int expand(struct source_context *ctx, const struct token *in, int count, struct token_vec *out, int depth) {
+    for (int i = 0; i < count; i++) {
+        const struct macro *macro = in[i].kind == TOKEN_IDENT ? find_macro(ctx, &in[i]) : NULL;
+        if (!macro || (macro->param_count >= 0 && (i + 1 >= count || !is_punct(&in[i + 1], '(')))) {
+            if (push_token(out, &in[i]) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (depth >= SOURCE_MACRO_DEPTH) {
+            set_error(ctx, "macro %.*s nests too deeply", (int)macro->name_length, macro->name);
+            return -1;
+        }
+
+        const struct token *body = &ctx->macro_tokens.items[macro->params + (macro->param_count > 0 ?
+                                                                              macro->param_count : 0)];
+        int body_count = macro->body_end - macro->params - (macro->param_count > 0 ? macro->param_count : 0);
+        if (macro->param_count < 0) {
+            if (expand(ctx, body, body_count, out, depth + 1) != 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        // Split the arguments at top-level commas
+        int close = matching(in, count, i + 1, '(', ')');
+        if (close < 0) {
+            set_error(ctx, "unbalanced call of %.*s", (int)macro->name_length, macro->name);
+            return -1;
+        }
+        int arg_begin[SOURCE_MACRO_PARAMS], arg_end[SOURCE_MACRO_PARAMS];
+        int arg_count = 0, level = 0;
+        int begin = i + 2;
+        for (int k = i + 2; k <= close; k++) {
+            if (k == close || (level == 0 && is_punct(&in[k], ','))) {
+                if (arg_count == SOURCE_MACRO_PARAMS) {
+                    arg_count++;
+                    break;
+                }
+                arg_begin[arg_count] = begin;
+                arg_end[arg_count++] = k;
+                begin = k + 1;
+            } else if (is_punct(&in[k], '(')) {
+                level++;
+            } else if (is_punct(&in[k], ')')) {
+                level--;
+            }
+        }
+        if (macro->param_count == 0 && arg_count == 1 && arg_end[0] == arg_begin[0]) {
+            arg_count = 0;
+        }
+        if (arg_count != macro->param_count) {
+            set_error(ctx, "%.*s takes %d argument(s), %d given", (int)macro->name_length, macro->name,
+                      macro->param_count, arg_count);
+            return -1;
+        }
+
+        // Substitute the arguments, then rescan the result
+        struct token_vec substituted = { 0 };
+        const struct token *params = &ctx->macro_tokens.items[macro->params];
+        int result = 0;
+        for (int k = 0; k < body_count && result == 0; k++) {
+            if (is_punct(&body[k], '#') || is_punct(&body[k], PUNCT_PASTE)) {
+                set_error(ctx, "# and ## in %.*s are not supported", (int)macro->name_length, macro->name);
+                result = -1;
+                break;
+            }
+            int param = -1;
+            for (int p = 0; p < macro->param_count && body[k].kind == TOKEN_IDENT; p++) {
+                if (params[p].length == body[k].length && memcmp(params[p].text, body[k].text, body[k].length) == 0) {
+                    param = p;
+                    break;
+                }
+            }
+            if (param < 0) {
+                result = push_token(&substituted, &body[k]);
+                continue;
+            }
+            for (int a = arg_begin[param]; a < arg_end[param] && result == 0; a++) {
+                result = push_token(&substituted, &in[a]);
+            }
+        }
+        if (result == 0) {
+            result = expand(ctx, substituted.items, substituted.count, out, depth + 1);
+        }
+        free(substituted.items);
+        if (result != 0) {
+            return -1;
+        }
+        i = close;
+    }
+    return 0;
+}
+
+struct expr {
+    struct source_context *ctx;
+    const struct token *t;
+    int pos;
+    int end;
+    int failed;
+};
+
+static int64_t expr_fail(struct expr *e, const char *message, const struct token *t) {
+    if (t && t->kind == TOKEN_IDENT) {
+        set_error(e->ctx, "%s %.*s", message, (int)t->length, t->text);
+    } else {
+        set_error(e->ctx, "%s", message);
+    }
+    e->failed = 1;
+    return 0;
+}
+
+static const struct token *expr_peek(const struct expr *e) {
+    return e->pos < e->end ? &e->t[e->pos] : NULL;
+}
+
+static int expr_accept(struct expr *e, int punct) {
+    if (e->pos < e->end && is_punct(&e->t[e->pos], punct)) {
+        e->pos++;
+        return 1;
+    }
+    return 0;
+}
+
+static int64_t parse_conditional(struct expr *e);
+
+static const struct source_array *find_array(const struct source_context *ctx, const struct token *t) {
+    for (int i = ctx->array_count - 1; i >= 0; i--) {
+        const struct source_array *array = &ctx->arrays[i];
+        if (array->evaluated && array->name_length == t->length && memcmp(array->name, t->text, t->length) == 0) {
+            return array;
+        }
+    }
+    return NULL;
+}
+
+// Width and signedness of a run of type words; 0 if a token in it is not a type word
+static int type_bits(const struct token *t, int count, int *is_signed) {
+    int bits = 32, sign = 1, has_unsigned = 0;
+    for (int i = 0; i < count; i++) {
+        int word = type_word(&t[i]);
+        if (word < 0) {
+            return 0;
+        }
+        if (word < TYPE_WORD_COUNT) {
+            bits = type_words[word].bits;
+            sign = type_words[word].is_signed;
+        } else {
+            has_unsigned |= token_is(&t[i], "unsigned");
+        }
+    }
+    *is_signed = sign && !has_unsigned;
+    return bits;
+}
+
+static int64_t convert(int64_t value, int bits, int is_signed) {
+    if (bits >= 64) {
+        return value;
+    }
+    uint64_t mask = (UINT64_C(1) << bits) - 1;
+    uint64_t v = (uint64_t)value & mask;
+    if (is_signed && (v >> (bits - 1)) & 1) {
+        v |= ~mask;
+    }
+    return (int64_t)v;
+}
+
+static int64_t parse_sizeof(struct expr *e) {
+    int paren = expr_accept(e, '(');
+    const struct token *t = expr_peek(e);
+    int64_t size;
+
+    if (!t || t->kind != TOKEN_IDENT) {
+        return expr_fail(e, "unsupported sizeof", NULL);
+    }
+    if (type_word(t) >= 0) {
+        int begin = e->pos, is_signed;
+        while (e->pos < e->end && type_word(&e->t[e->pos]) >= 0) {
+            e->pos++;
+        }
+        size = type_bits(&e->t[begin], e->pos - begin, &is_signed) / 8;
+    } else {
+        const struct source_array *array = find_array(e->ctx, t);
+        if (!array) {
+            return expr_fail(e, "sizeof of unknown array", t);
+        }
+        e->pos++;
+        size = array->length;
+        if (expr_peek(e) && is_punct(expr_peek(e), '[')) {
+            int close = matching(e->t, e->end, e->pos, '[', ']');
+            if (close < 0) {
+                return expr_fail(e, "unbalanced [ in sizeof", NULL);
+            }
+            e->pos = close + 1;
+            size = 1;                   // An element of a byte array
+        }
+    }
+    if (paren && !expr_accept(e, ')')) {
+        return expr_fail(e, "unsupported sizeof", NULL);
+    }
+    return size;
+}
+
+static int64_t parse_unary(struct expr *e) {
+    const struct token *t = expr_peek(e);
+    if (!t) {
+        return expr_fail(e, "expression ends early", NULL);
+    }
+
+    if (t->kind == TOKEN_NUMBER) {
+        e->pos++;
+        return t->value;
+    }
+    if (t->kind == TOKEN_IDENT) {
+        if (token_is(t, "sizeof")) {
+            e->pos++;
+            return parse_sizeof(e);
+        }
+        return expr_fail(e, "unknown identifier", t);
+    }
+    if (t->kind != TOKEN_PUNCT) {
+        return expr_fail(e, "not an integer constant", NULL);
+    }
+
+    e->pos++;
+    switch (t->punct) {
+        case '-':
+            return (int64_t)(0 - (uint64_t)parse_unary(e));
+        case '+':
+            return parse_unary(e);
+        case '~':
+            return ~parse_unary(e);
+        case '!':
+            return !parse_unary(e);
+        case '(': {
+            // A cast if everything up to the closing parenthesis is a type name
+            int close = matching(e->t, e->end, e->pos - 1, '(', ')');
+            int is_signed;
+            int bits = close > e->pos ? type_bits(&e->t[e->pos], close - e->pos, &is_signed) : 0;
+            if (bits > 0) {
+                e->pos = close + 1;
+                return convert(parse_unary(e), bits, is_signed);
+            }
+            int64_t value = parse_conditional(e);
+            if (!expr_accept(e, ')')) {
+                return expr_fail(e, "missing )", NULL);
+            }
+            return value;
+        }
+        default:
+            return expr_fail(e, "unexpected token", NULL);
+    }
+}
+
+static int precedence(const struct token *t) {
+    if (t->kind != TOKEN_PUNCT) {
+        return 0;
+    }
+    switch (t->punct) {
+        case PUNCT_OR:  return 1;
+        case PUNCT_AND: return 2;
+        case '|':       return 3;
+        case '^':       return 4;
+        case '&':       return 5;
+        case PUNCT_EQ:
+        case PUNCT_NE:  return 6;
+        case '<':
+        case '>':
+        case PUNCT_LE:
+        case PUNCT_GE:  return 7;
+        case PUNCT_SHL:
+        case PUNCT_SHR: return 8;
+        case '+':
+        case '-':       return 9;
+        case '*':
+        case '/':
+        case '%':       return 10;
+        default:        return 0;
+    }
+}
+
+static int64_t apply(struct expr *e, int op, int64_t a, int64_t b) {
+    uint64_t ua = (uint64_t)a, ub = (uint64_t)b;
+    switch (op) {
+        case PUNCT_OR:  return a || b;
+        case PUNCT_AND: return a && b;
+        case '|':       return (int64_t)(ua | ub);
+        case '^':       return (int64_t)(ua ^ ub);
+        case '&':       return (int64_t)(ua & ub);
+        case PUNCT_EQ:  return a == b;
+        case PUNCT_NE:  return a != b;
+        case '<':       return a < b;
+        case '>':       return a > b;
+        case PUNCT_LE:  return a <= b;
+        case PUNCT_GE:  return a >= b;
+        case '+':       return (int64_t)(ua + ub);
+        case '-':       return (int64_t)(ua - ub);
+        case '*':       return (int64_t)(ua * ub);
+        default:
+            break;
+    }
+    if (op == PUNCT_SHL || op == PUNCT_SHR) {
+        if (b < 0 || b > 63) {
+            return expr_fail(e, "shift out of range", NULL);
+        }
+        return op == PUNCT_SHL ? (int64_t)(ua << b) : a >> b;
+    }
+    if (b == 0 || (a == INT64_MIN && b == -1)) {
+        return expr_fail(e, "division by zero", NULL);
+    }
+    return op == '/' ? a / b : a % b;
+}
+
+static int64_t parse_binary(struct expr *e, int min_precedence) {
+    int64_t lhs = parse_unary(e);
+    const struct token *t;
+    int p;
+
+    while (!e->failed && (t = expr_peek(e)) != NULL && (p = precedence(t)) >= min_precedence) {
+        e->pos++;
+        int64_t rhs = parse_binary(e, p + 1);
+        lhs = apply(e, t->punct, lhs, rhs);
+    }
+    return lhs;
+}
+
+static int64_t parse_conditional(struct expr *e) {
+    int64_t condition = parse_binary(e, 1);
+    if (e->failed || !expr_accept(e, '?')) {
+        return condition;
+    }
+    int64_t if_true = parse_conditional(e);
+    if (!expr_accept(e, ':')) {
+        return expr_fail(e, "missing : in conditional", NULL);
+    }
+    int64_t if_false = parse_conditional(e);
+    return condition ? if_true : if_false;
+}
+
+// Evaluate an expanded token range as one constant expression
+static int evaluate(struct source_context *ctx, const struct token *t, int count, int64_t *value) {
+    struct expr e = { ctx, t, 0, count, 0 };
+    *value = parse_conditional(&e);
+    if (!e.failed && e.pos != e.end) {
+        expr_fail(&e, "unexpected token", &t[e.pos]);
+    }
+    return e.failed ? -1 : 0;
+}
+
+static int expand_and_evaluate(struct source_context *ctx, const struct token *t, int count, int64_t *value) {
+    struct token_vec expanded = { 0 };
+    int result = expand(ctx, t, count, &expanded, 0);
+    if (result == 0) {
+        result = evaluate(ctx, expanded.items, expanded.count, value);
+    }
+    free(expanded.items);
+    return result;
+}
+
+static int push_byte(struct source_context *ctx, uint8_t byte) {
+    if (ctx->byte_count == ctx->byte_capacity) {
+        size_t capacity = ctx->byte_capacity ? ctx->byte_capacity * 2 : 4096;
+        uint8_t *bytes = realloc(ctx->bytes, capacity);
+        if (!bytes) {
+            return -1;
+        }
+        ctx->bytes = bytes;
+        ctx->byte_capacity = capacity;
+    }
+    ctx->bytes[ctx->byte_count++] = byte;
+    return 0;
+}
+
+// Expand and evaluate the initializer of name[size] = { init }
+static void evaluate_array(struct source_context *ctx, const struct token *name, const struct token *size,
+                           int size_count, const struct token *init, int init_count) {
+    struct source_array array = { 0 };
+    struct token_vec expanded = { 0 };
+
+    array.name = name->text;
+    array.name_length = name->length;
+    array.line = name->line;
+    array.offset = ctx->byte_count;
+    ctx->error[0] = '\0';
+
+    int result = expand(ctx, init, init_count, &expanded, 0);
+    const struct token *t = expanded.items;
+    int begin = 0, level = 0;
+    for (int i = 0; result == 0 && i <= expanded.count; i++) {
+        if (i < expanded.count && (is_punct(&t[i], '{') || is_punct(&t[i], '}'))) {
+            continue;
+        }
+        if (i < expanded.count && !(level == 0 && is_punct(&t[i], ','))) {
+            level += is_punct(&t[i], '(') - is_punct(&t[i], ')');
+            continue;
+        }
+
+        // One element: t[begin..i) without braces
+        struct token_vec element = { 0 };
+        for (int k = begin; k < i && result == 0; k++) {
+            if (!is_punct(&t[k], '{') && !is_punct(&t[k], '}')) {
+                result = push_token(&element, &t[k]);
+            }
+        }
+        begin = i + 1;
+        if (result == 0 && element.count > 0) {
+            int64_t value;
+            if (is_punct(&element.items[0], '[') || is_punct(&element.items[0], '.')) {
+                set_error(ctx, "designated initializers are not supported");
+                result = -1;
+            } else if (evaluate(ctx, element.items, element.count, &value) != 0) {
+                result = -1;
+            } else {
+                array.truncated += value < -128 || value > 255;
+                result = push_byte(ctx, (uint8_t)value);
+            }
+        }
+        free(element.items);
+    }
+    free(expanded.items);
+
+    // A declared size beyond the initializers is filled with zeros
+    int64_t declared;
+    int length = (int)(ctx->byte_count - array.offset);
+    if (result == 0 && size_count > 0 && expand_and_evaluate(ctx, size, size_count, &declared) == 0) {
+        if (declared < length) {
+            set_error(ctx, "%d initializers for a size of %lld", length, (long long)declared);
+            result = -1;
+        }
+        while (result == 0 && length < declared && length < 0xFFFF) {
+            result = push_byte(ctx, 0);
+            length++;
+        }
+    }
+    ctx->error[0] = result == 0 ? '\0' : ctx->error[0];
+
+    array.evaluated = result == 0;
+    array.length = array.evaluated ? length : 0;
+    memcpy(array.error, ctx->error, sizeof(array.error));
+    if (!array.evaluated) {
+        ctx->byte_count = array.offset;
+        if (array.error[0] == '\0') {
+            snprintf(array.error, sizeof(array.error), "out of memory");
+        }
+    }
+
+    if (ctx->array_count == ctx->array_capacity) {
+        int capacity = ctx->array_capacity ? ctx->array_capacity * 2 : 64;
+        struct source_array *arrays = realloc(ctx->arrays, capacity * sizeof(*arrays));
+        if (!arrays) {
+            return;
+        }
+        ctx->arrays = arrays;
+        ctx->array_capacity = capacity;
+    }
+    ctx->arrays[ctx->array_count++] = array;
+}
+
+// enum [tag] [: type] { A [= value], ... }: each constant becomes an object-like macro
+static int parse_enum(struct source_context *ctx, int i) {
+    const struct token *t = ctx->tokens.items;
+    int count = ctx->tokens.count;
+    int open = i + 1;
+
+    while (open < count && !is_punct(&t[open], '{') && !is_punct(&t[open], ';') && open - i < 8) {
+        open++;
+    }
+    if (open >= count || !is_punct(&t[open], '{')) {
+        return i;
+    }
+    int close = matching(t, count, open, '{', '}');
+    if (close < 0) {
+        return i;
+    }
+
+    int64_t next = 0;
+    for (int k = open + 1; k < close; ) {
+        if (t[k].kind != TOKEN_IDENT) {
+            break;
+        }
+        const struct token *name = &t[k];
+        int end = k + 1, level = 0;
+        while (end < close && !(level == 0 && is_punct(&t[end], ','))) {
+            level += is_punct(&t[end], '(') - is_punct(&t[end], ')');
+            end++;
+        }
+        if (end > k + 1) {
+            ctx->error[0] = '\0';
+            if (!is_punct(&t[k + 1], '=') || expand_and_evaluate(ctx, &t[k + 2], end - k - 2, &next) != 0) {
+                break;              // Later constants depend on this one
+            }
+        }
+
+        struct token value = { .kind = TOKEN_NUMBER, .line = name->line, .text = name->text,
+                               .length = name->length, .value = next };
+        int body = ctx->macro_tokens.count;
+        if (push_token(&ctx->macro_tokens, &value) != 0 || add_macro(ctx, name, -1, body, body + 1) != 0) {
+            break;
+        }
+        next++;
+        k = end + 1;
+    }
+    return close;
+}
+
+// name starts "[...] = {" with only type words and qualifiers before it
+static int byte_declaration(const struct token *t, int name) {
+    int has_byte_type = 0;
+    int k = name - 1;
+    for (; k >= 0 && t[k].kind == TOKEN_IDENT; k--) {
+        int word = type_word(&t[k]);
+        has_byte_type |= word >= 0 && word < TYPE_WORD_COUNT && type_words[word].bits == 8;
+    }
+    return has_byte_type && (k < 0 || is_punct(&t[k], ';') || is_punct(&t[k], '{') || is_punct(&t[k], '}') ||
+                             is_punct(&t[k], ')'));
+}
+
+static void find_arrays(struct source_context *ctx) {
+    const struct token *t = ctx->tokens.items;
+    int count = ctx->tokens.count;
+
+    for (int i = 0; i < count; i++) {
+        if (token_is(&t[i], "enum")) {
+            i = parse_enum(ctx, i);
+            continue;
+        }
+        if (t[i].kind != TOKEN_IDENT || i + 1 >= count || !is_punct(&t[i + 1], '[') || !byte_declaration(t, i)) {
+            continue;
+        }
+        int close = matching(t, count, i + 1, '[', ']');
+        if (close < 0) {
+            continue;
+        }
+
+        // Attributes and alignment macros may follow the declarator
+        int j = close + 1;
+        while (j < count && t[j].kind == TOKEN_IDENT) {
+            j++;
+            if (j < count && is_punct(&t[j], '(')) {
+                int end = matching(t, count, j, '(', ')');
+                j = end < 0 ? count : end + 1;
+            }
+        }
+        if (j + 1 >= count || !is_punct(&t[j], '=') || !is_punct(&t[j + 1], '{')) {
+            continue;
+        }
+        int end = matching(t, count, j + 1, '{', '}');
+        if (end < 0) {
+            continue;
+        }
+        evaluate_array(ctx, &t[i], &t[i + 2], close - i - 2, &t[j + 2], end - j - 2);
+        i = end;
+    }
+}
+
+// Names that suggest an analyzed descriptor, for reporting arrays that could not be evaluated
+static int descriptor_name(const struct source_array *array) {
+    static const char * const hints[] = { "bos", "msos", "ms_os", "webusb", "url" };
+    char lower[64];
+    int length = array->name_length < (int)sizeof(lower) - 1 ? array->name_length : (int)sizeof(lower) - 1;
+
+    for (int i = 0; i < length; i++) {
+        char c = array->name[i];
+        lower[i] = c >= 'A' && c <= 'Z' ? (char)(c | 0x20) : c;
+    }
+    lower[length] = '\0';
+    for (size_t i = 0; i < sizeof(hints) / sizeof(hints[0]); i++) {
+        if (strstr(lower, hints[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void report_array(FILE *out, struct source_context *ctx, struct source_result *result, const char *path,
+                         const struct source_array *array) {
+    if (!array->evaluated) {
+        result->not_evaluated++;
+        if (descriptor_name(array)) {
+            fprintf(out, "%s:%u %.*s: " COLOR_ORANGE "not evaluated (%s)" COLOR_RESET "\n", path, array->line,
+                    (int)array->name_length, array->name, array->error);
+        }
+        return;
+    }
+
+    const uint8_t *data = &ctx->bytes[array->offset];
+    enum blob_kind kind = blob_classify(data, array->length);
+
+    const struct finding_list *findings;
+    switch (kind) {
+        case BLOB_BOS:
+            parse_bos_descriptor(&ctx->bos_view, data, array->length, 0);
+            findings = &ctx->bos_view.findings;
+            break;
+        case BLOB_MSOS20:
+            parse_msos20_descriptor(&ctx->msos20_view, data, array->length, 0);
+            findings = &ctx->msos20_view.findings;
+            break;
+        case BLOB_WEBUSB_URL:
+            parse_webusb_url_descriptor(&ctx->url_view, data, array->length, 0);
+            findings = &ctx->url_view.findings;
+            break;
+        default:
+            return;
+    }
+
+    result->kinds[kind]++;
+    int warnings = findings->warning_count + (array->truncated > 0);
+    fprintf(out, "%s:%u %.*s: %s (%d bytes), %d errors, %d warnings\n", path, array->line,
+            (int)array->name_length, array->name, blob_kind_name(kind), array->length, findings->error_count,
+            warnings);
+    if (array->truncated > 0) {
+        fprintf(out, COLOR_ORANGE "  WARNING: %d element(s) do not fit in a byte and were truncated\n" COLOR_RESET,
+                array->truncated);
+    }
+    for (int i = 0; i < findings->count; i++) {
+        render_finding(out, "  ", &findings->items[i]);
+    }
+    if (findings->dropped > 0) {
+        fprintf(out, "  (%d further finding(s) not shown)\n", findings->dropped);
+    }
+    if (findings->error_count > 0) {
+        result->with_errors++;
+    } else if (warnings > 0) {
+        result->with_warnings++;
+    }
+}
+
+// Drop everything the previous file added on top of the prelude
+static void reset_context(struct source_context *ctx) {
+    while (ctx->macro_count > ctx->prelude_macros) {
+        const struct macro *macro = &ctx->macros[--ctx->macro_count];
+        ctx->buckets[macro->bucket] = macro->next;
+    }
+    ctx->macro_tokens.count = ctx->prelude_macro_tokens;
+    ctx->tokens.count = 0;
+    ctx->array_count = 0;
+    ctx->byte_count = 0;
+}
+
+static void scan_file(struct source_context *ctx, struct source_batch *batch, int index) {
+    struct source_result *result = &batch->results[index];
+    const char *path = batch->files->paths[index];
+    struct stat st;
+
+    FILE *out = report_stream_open(&result->report, &result->report_size);
+    if (!out) {
+        return;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size > SOURCE_MAX_SIZE) {
+        fprintf(out, "%s: " COLOR_RED "unreadable or larger than %d MiB" COLOR_RESET "\n", path,
+                SOURCE_MAX_SIZE / (1024 * 1024));
+        if (fd >= 0) {
+            close(fd);
+        }
+        fclose(out);
+        return;
+    }
+    result->readable = 1;
+    if (st.st_size == 0) {
+        close(fd);
+        fclose(out);
+        return;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        fprintf(out, "%s: " COLOR_RED "cannot be mapped" COLOR_RESET "\n", path);
+        result->readable = 0;
+        fclose(out);
+        return;
+    }
+
+    reset_context(ctx);
+    if (tokenize(ctx, text, size) != 0) {
+        fprintf(out, "%s: " COLOR_RED "out of memory" COLOR_RESET "\n", path);
+        result->readable = 0;
+    } else {
+        find_arrays(ctx);
+        result->arrays = ctx->array_count;
+        for (int i = 0; i < ctx->array_count; i++) {
+            report_array(out, ctx, result, path, &ctx->arrays[i]);
+        }
+    }
+    munmap((void *)text, size);
+    fclose(out);
+}
+
+static void *worker_main(void *arg) {
+    struct source_batch *batch = arg;
+
+    // The context holds the parser views and is large
+    struct source_context *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return NULL;
+    }
+    for (int i = 0; i < MACRO_BUCKETS; i++) {
+        ctx->buckets[i] = -1;
+    }
+    if (tokenize(ctx, prelude, sizeof(prelude) - 1) == 0) {
+        ctx->prelude_macros = ctx->macro_count;
+        ctx->prelude_macro_tokens = ctx->macro_tokens.count;
+
+        for (;;) {
+            pthread_mutex_lock(&batch->lock);
+            int index = batch->next < batch->files->count ? batch->next++ : -1;
+            pthread_mutex_unlock(&batch->lock);
+            if (index < 0) {
+                break;
+            }
+            scan_file(ctx, batch, index);
+        }
+    }
+
+    free(ctx->tokens.items);
+    free(ctx->macro_tokens.items);
+    free(ctx->macros);
+    free(ctx->arrays);
+    free(ctx->bytes);
+    free(ctx);
+    return NULL;
+}
+
+static int has_source_extension(const char *path) {
+    const char *dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(source_extensions) / sizeof(source_extensions[0]); i++) {
+        if (strcmp(dot, source_extensions[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Files named on the command line are always scanned; directories contribute their C/C++ sources
+static int collect_sources(struct file_list *files, const char * const *paths, int path_count) {
+    int status = 0;
+    for (int i = 0; i < path_count; i++) {
+        struct stat st;
+        int is_dir = stat(paths[i], &st) == 0 && S_ISDIR(st.st_mode);
+        int first = files->count;
+        if (file_list_collect(files, paths[i]) != 0) {
+            status = -1;
+        }
+        if (!is_dir) {
+            continue;
+        }
+        int kept = first;
+        for (int k = first; k < files->count; k++) {
+            if (has_source_extension(files->paths[k])) {
+                files->paths[kept++] = files->paths[k];
+            } else {
+                free(files->paths[k]);
+            }
+        }
+        files->count = kept;
+    }
+    return status;
+}
+
+int source_scan(FILE *out, const char * const *paths, int path_count, int workers) {
+    struct file_list files = { 0 };
+    struct source_batch batch = { 0 };
+    pthread_t threads[BATCH_MAX_WORKERS];
+    uint64_t start_ns = engine_now_ns();
+
+    int status = collect_sources(&files, paths, path_count);
+    file_list_sort(&files);
+
+    batch.files = &files;
+    batch.results = calloc(files.count > 0 ? files.count : 1, sizeof(*batch.results));
+    if (!batch.results) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        file_list_free(&files);
+        return -1;
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+
+    if (workers <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 0 ? (int)cores : 1;
+    }
+    if (workers > BATCH_MAX_WORKERS) {
+        workers = BATCH_MAX_WORKERS;
+    }
+    if (workers > files.count) {
+        workers = files.count > 0 ? files.count : 1;
+    }
+
+    int started = 0;
+    for (int i = 1; i < workers; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, &batch) != 0) {
+            break;
+        }
+        started = i;
+    }
+    worker_main(&batch);
+    for (int i = 1; i <= started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int arrays = 0, not_evaluated = 0, unreadable = 0, with_errors = 0, with_warnings = 0;
+    int kinds[BLOB_KIND_COUNT] = { 0 };
+    for (int i = 0; i < files.count; i++) {
+        struct source_result *result = &batch.results[i];
+        if (result->report) {
+            fwrite(result->report, 1, result->report_size, out);
+            free(result->report);
+        }
+        if (!result->readable) {
+            unreadable++;
+            status = -1;
+        }
+        arrays += result->arrays;
+        not_evaluated += result->not_evaluated;
+        with_errors += result->with_errors;
+        with_warnings += result->with_warnings;
+        for (int k = 0; k < BLOB_KIND_COUNT; k++) {
+            kinds[k] += result->kinds[k];
+        }
+    }
+    if (with_errors > 0) {
+        status = -1;
+    }
+
+    int descriptors = kinds[BLOB_BOS] + kinds[BLOB_MSOS20] + kinds[BLOB_WEBUSB_URL];
+    fprintf(out, "\nSources: %d files, %d byte arrays (%d BOS, %d MS OS 2.0, %d WebUSB URL, %d not evaluated), "
+            "%d unreadable, in %.1f ms on %d thread(s)\n", files.count, arrays, kinds[BLOB_BOS],
+            kinds[BLOB_MSOS20], kinds[BLOB_WEBUSB_URL], not_evaluated, unreadable,
+            (double)(engine_now_ns() - start_ns) / 1e6, workers);
+    fprintf(out, "%d clean, %d with warnings, %d with errors\n", descriptors - with_errors - with_warnings,
+            with_warnings, with_errors);
+
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.results);
+    file_list_free(&files);
+    return status;
+}
@@ -0,0 +1,30 @@
+#ifndef SOURCE_ARRAYS_H
+#define SOURCE_ARRAYS_H
+
+#include <stdio.h>
+
+/*
+ * Descriptor byte arrays in C/C++ firmware sources
+ *
+ * Each file is memory-mapped and tokenized in one pass. #define lines (with
+ * or without parameters) and enum constants become a per-file macro table
+ * on top of a built-in prelude of common byte-splitting helpers such as
+ * LE16/U16_TO_U8S_LE/WBVAL and the TinyUSB BOS macros. Every declaration of
+ * a byte array with an initializer is then macro-expanded and its elements
+ * are evaluated as integer constant expressions, including casts and
+ * sizeof of arrays defined earlier in the file. Headers are not followed.
+ *
+ * Arrays that hold a BOS, MS OS 2.0 descriptor set or WebUSB URL descriptor
+ * are run through the matching parser; other arrays are ignored silently.
+ * Directories are walked for C/C++ source and header files, spread over the
+ * worker threads and reported in path order.
+ */
+
+#define SOURCE_MAX_SIZE         (64 * 1024 * 1024)
+#define SOURCE_MACRO_DEPTH      32      // Nested macro expansions before giving up
+#define SOURCE_MACRO_PARAMS     16
+
+// 0 if no recognized descriptor had errors and every file could be read, -1 otherwise
+int source_scan(FILE *out, const char * const *paths, int path_count, int workers);
+
+#endif
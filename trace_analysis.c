@@ -0,0 +1,143 @@
+#include "trace_analysis.h"
+
+#include <stdlib.h>
+
+#include "pcap_reader.h"
+#include "report.h"
+
+struct trace_analyzer *trace_analyzer_create(FILE *out) {
+    struct trace_analyzer *analyzer = calloc(1, sizeof(*analyzer));
+    if (analyzer) {
+        analyzer->out = out;
+        usbmon_matcher_init(&analyzer->matcher);
+    }
+    return analyzer;
+}
+
+void trace_analyzer_destroy(struct trace_analyzer *analyzer) {
+    free(analyzer);
+}
+
+static void count_findings(struct trace_analyzer *analyzer, const struct finding_list *findings) {
+    analyzer->errors += findings->error_count;
+    analyzer->warnings += findings->warning_count;
+}
+
+void trace_analyze_exchange(struct trace_analyzer *analyzer, const struct usb_exchange *exchange) {
+    FILE *out = analyzer->out;
+    int length = (int)exchange->length;
+
+    analyzer->exchanges[exchange->kind]++;
+
+    // The 5-byte BOS header probe only carries wTotalLength
+    if (exchange->kind == EXCHANGE_BOS && exchange->status == 0 && exchange->setup.wLength <= USB_DT_BOS_SIZE) {
+        return;
+    }
+
+    fprintf(out, "=== %lld.%06d bus %d device %d: %s (bRequest 0x%02x, wValue 0x%04x, wIndex 0x%04x, wLength %d) ===\n",
+            (long long)exchange->ts_sec, (int)exchange->ts_usec, exchange->busnum, exchange->devnum,
+            exchange_kind_name(exchange->kind), exchange->setup.bRequest, exchange->setup.wValue,
+            exchange->setup.wIndex, exchange->setup.wLength);
+
+    if (exchange->status != 0) {
+        fprintf(out, COLOR_ORANGE "WARNING: Request failed with status %d%s\n\n" COLOR_RESET, (int)exchange->status,
+                exchange->status == -32 ? " (stall)" : "");
+        analyzer->failed++;
+        return;
+    }
+
+    switch (exchange->kind) {
+        case EXCHANGE_BOS:
+            parse_bos_descriptor(&analyzer->bos_view, exchange->data, length, 0);
+            usbmon_matcher_learn(&analyzer->matcher, exchange->busnum, exchange->devnum,
+                                 &analyzer->bos_view.summary);
+            render_bos_descriptor(out, &analyzer->bos_view);
+            count_findings(analyzer, &analyzer->bos_view.findings);
+            break;
+        case EXCHANGE_MSOS20:
+            parse_msos20_descriptor(&analyzer->msos20_view, exchange->data, length, 0);
+            render_msos20_descriptor(out, &analyzer->msos20_view);
+            count_findings(analyzer, &analyzer->msos20_view.findings);
+            break;
+        case EXCHANGE_WEBUSB_URL:
+            parse_webusb_url_descriptor(&analyzer->url_view, exchange->data, length, 0);
+            render_webusb_url_descriptor(out, &analyzer->url_view);
+            count_findings(analyzer, &analyzer->url_view.findings);
+            break;
+        default:
+            break;
+    }
+    fprintf(out, "\n");
+}
+
+void trace_analyzer_feed(struct trace_analyzer *analyzer, const struct usbmon_event *event) {
+    struct usb_exchange exchange;
+
+    analyzer->events++;
+    if (usbmon_matcher_feed(&analyzer->matcher, event, &exchange)) {
+        trace_analyze_exchange(analyzer, &exchange);
+    }
+}
+
+int trace_analyzer_finish(struct trace_analyzer *analyzer) {
+    fprintf(analyzer->out, "Trace: %llu usbmon events, %llu BOS, %llu MS OS 2.0, %llu WebUSB URL exchanges "
+            "(%llu failed), %llu errors, %llu warnings\n",
+            (unsigned long long)analyzer->events, (unsigned long long)analyzer->exchanges[EXCHANGE_BOS],
+            (unsigned long long)analyzer->exchanges[EXCHANGE_MSOS20],
+            (unsigned long long)analyzer->exchanges[EXCHANGE_WEBUSB_URL],
+            (unsigned long long)analyzer->failed, (unsigned long long)analyzer->errors,
+            (unsigned long long)analyzer->warnings);
+    if (analyzer->matcher.dropped > 0) {
+        fprintf(analyzer->out, COLOR_ORANGE "WARNING: %llu requests not analyzed, more than %d were outstanding\n"
+                COLOR_RESET, (unsigned long long)analyzer->matcher.dropped, USBMON_MAX_OUTSTANDING);
+    }
+    return analyzer->errors > 0 ? -1 : 0;
+}
+
+int trace_analyze_pcap(FILE *out, FILE *file) {
+    struct pcap_reader reader;
+    struct pcap_packet packet;
+    struct usbmon_event event;
+    uint64_t other_links = 0;
+    int result;
+
+    if (pcap_open(&reader, file) != 0) {
+        return -1;
+    }
+
+    struct trace_analyzer *analyzer = trace_analyzer_create(out);
+    if (!analyzer) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        pcap_close(&reader);
+        return -1;
+    }
+
+    while ((result = pcap_next(&reader, &packet)) == 1) {
+        int header_size = packet.linktype == LINKTYPE_USB_LINUX ? USBMON_HEADER_SIZE :
+                          packet.linktype == LINKTYPE_USB_LINUX_MMAPPED ? USBMON_MMAPPED_HEADER_SIZE : 0;
+        if (header_size == 0) {
+            other_links++;
+            continue;
+        }
+        if (usbmon_decode(&event, packet.data, packet.length, header_size, packet.swapped) == 0) {
+            trace_analyzer_feed(analyzer, &event);
+        }
+    }
+
+    if (result < 0) {
+        fprintf(out, COLOR_RED "ERROR: Capture is truncated or corrupt after %llu packets\n" COLOR_RESET,
+                (unsigned long long)reader.packets);
+    }
+    if (other_links > 0) {
+        fprintf(out, "Skipped %llu packets that are not Linux usbmon\n", (unsigned long long)other_links);
+    }
+    if (reader.oversized > 0) {
+        fprintf(out, COLOR_ORANGE "WARNING: Skipped %llu blocks larger than %d bytes\n" COLOR_RESET,
+                (unsigned long long)reader.oversized, PCAP_MAX_BLOCK);
+    }
+
+    int status = trace_analyzer_finish(analyzer);
+    trace_analyzer_destroy(analyzer);
+    pcap_close(&reader);
+    return result < 0 ? -1 : status;
+}
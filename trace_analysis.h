@@ -0,0 +1,48 @@
+#ifndef TRACE_ANALYSIS_H
+#define TRACE_ANALYSIS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "usb_descriptors.h"
+#include "usbmon.h"
+
+/*
+ * Analysis of descriptors seen in recorded USB traffic
+ *
+ * usbmon events go through the exchange matcher; each matched BOS, MS OS
+ * 2.0 or WebUSB URL response is parsed and rendered right away with the
+ * same renderers as a live analysis. The views are reused for every
+ * exchange, so a trace of any length is analyzed in constant memory.
+ */
+
+struct trace_analyzer {
+    FILE *out;
+    struct usbmon_matcher matcher;
+    struct bos_view bos_view;
+    struct msos20_view msos20_view;
+    struct webusb_url_view url_view;
+
+    uint64_t events;
+    uint64_t exchanges[EXCHANGE_KIND_COUNT];
+    uint64_t failed;                // Exchanges that completed with an error status
+    uint64_t errors;                // Findings over all parsed descriptors
+    uint64_t warnings;
+};
+
+// The analyzer is large; allocate it rather than putting it on the stack
+struct trace_analyzer *trace_analyzer_create(FILE *out);
+void trace_analyzer_destroy(struct trace_analyzer *analyzer);
+
+void trace_analyzer_feed(struct trace_analyzer *analyzer, const struct usbmon_event *event);
+
+// Parse and render one matched exchange to analyzer->out, updating the totals
+void trace_analyze_exchange(struct trace_analyzer *analyzer, const struct usb_exchange *exchange);
+
+// Print the totals; 0 if no descriptor had errors, -1 otherwise
+int trace_analyzer_finish(struct trace_analyzer *analyzer);
+
+// Analyze a pcap/pcapng capture read from file
+int trace_analyze_pcap(FILE *out, FILE *file);
+
+#endif
@@ -1,710 +1,749 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <libusb-1.0/libusb.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <strings.h>
-
-// ANSI color codes
-#define COLOR_RED     "\033[31m"
-#define COLOR_ORANGE  "\033[33m"
-#define COLOR_RESET   "\033[0m"
-
-#define MS_OS_20_SET_HEADER_DESCRIPTOR          0x00
-#define MS_OS_20_SUBSET_HEADER_CONFIGURATION    0x01
-#define MS_OS_20_SUBSET_HEADER_FUNCTION         0x02
-#define MS_OS_20_FEATURE_COMPATIBLE_ID          0x03
-#define MS_OS_20_FEATURE_REG_PROPERTY           0x04
-
-// BOS Descriptor Types
-#define USB_DT_BOS                              0x0F
-#define USB_DT_DEVICE_CAPABILITY                0x10
-
-// Device Capability Types  
-#define USB_PLAT_DEV_CAP_TYPE                   0x05
-
-// WebUSB Constants
-#define WEBUSB_GET_URL                          2
-#define WEBUSB_URL_DESCRIPTOR_TYPE              3
-#define WEBUSB_URL_SCHEME_HTTP                  0
-#define WEBUSB_URL_SCHEME_HTTPS                 1
-#define WEBUSB_URL_SCHEME_NONE                  255
-
-// UUIDs (in string format for comparison)
-static const char WEBUSB_UUID_STR[] = "3408b638-09a9-47a0-8bfd-a0768815b665";
-static const char MSOS20_UUID_STR[] = "d8dd60df-4589-4cc7-9cd2-659d9e648a9f";
-
-// BOS descriptor structure
-struct usb_bos_descriptor {
-    uint8_t  bLength;
-    uint8_t  bDescriptorType;
-    uint16_t wTotalLength;
-    uint8_t  bNumDeviceCaps;
-} __attribute__((packed));
-
-// Platform capability descriptor structure
-struct usb_plat_dev_cap_descriptor {
-    uint8_t  bLength;
-    uint8_t  bDescriptorType;
-    uint8_t  bDevCapabilityType;
-    uint8_t  bReserved;
-    uint8_t  UUID[16];
-    uint8_t  CapabilityData[];
-} __attribute__((packed));
-
-static void uuid_to_string(const uint8_t *uuid, char *str) {
-    sprintf(str, "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
-            uuid[3], uuid[2], uuid[1], uuid[0],  // Little-endian DWORD
-            uuid[5], uuid[4],                     // Little-endian WORD
-            uuid[7], uuid[6],                     // Little-endian WORD
-            uuid[8], uuid[9],                     // Big-endian bytes
-            uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+#include <unistd.h>
+
+#include "batch.h"
+#include "capture_scan.h"
+#include "configfs_gadget.h"
+#include "device_pool.h"
+#include "firmware_scan.h"
+#include "json_writer.h"
+#include "report.h"
+#include "report_buffer.h"
+#include "source_arrays.h"
+#include "trace_analysis.h"
+#include "usb_capture.h"
+#include "usb_engine.h"
+#include "usb_mock.h"
+#include "usb_session.h"
+#include "usbmon_live.h"
+
+#define FFS_BLOB_MAX_SIZE   (16 * 1024 * 1024)
+
+static volatile sig_atomic_t stop_requested;
+static struct json_writer *json_output;     // Set by --json: device records go here instead of text reports
+static int session_flags;                   // SESSION_* for every analyzed device
+static FILE *verdict_output;                // Set by --quiet: outcome lines go here instead of reports
+
+static void request_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
 }
 
-static void parse_bos_descriptor(unsigned char *data, int length) {
-    int offset = 0;
-    int error_count = 0;
-    int warning_count = 0;
-    
-    printf("=== BOS Descriptor Analysis ===\n");
-    printf("Total BOS length: %d bytes\n\n", length);
-    
-    if (length < 5) {
-        printf(COLOR_RED "ERROR: BOS descriptor too short (%d bytes, minimum 5)\n" COLOR_RESET, length);
-        return;
+static void print_usage(const char *program) {
+    printf("Usage: %s [options] <vid> <pid>\n", program);
+    printf("       %s --all [options]\n", program);
+    printf("       %s --watch [options] [<vid> <pid>]\n", program);
+    printf("       %s --batch [options] <file or directory>...\n", program);
+    printf("       %s --firmware [options] <ELF or raw image>...\n", program);
+    printf("       %s --source [options] <C/C++ file or directory>...\n", program);
+    printf("       %s --configfs [<gadget directory>...]\n", program);
+    printf("       %s --ffs <descriptors blob> [<strings blob>]\n", program);
+    printf("       %s --mock SPEC [options] [<descriptor dump or directory>...]\n", program);
+    printf("       %s --pcap <capture file or ->\n", program);
+    printf("       %s --scan <capture file> [options]\n", program);
+    printf("       %s --usbmon <bus>\n", program);
+    printf("Options:\n");
+    printf("  -a, --all       Analyze every matching device (every device if no VID/PID is given)\n");
+    printf("  -w, --watch     Keep running and analyze matching devices as they are attached\n");
+    printf("  -b, --batch     Validate descriptor dump files instead of a device\n");
+    printf("  --firmware      Find and validate BOS and MS OS 2.0 descriptors in firmware images\n");
+    printf("  --source        Evaluate and validate descriptor byte arrays in C/C++ firmware sources\n");
+    printf("  --configfs      Check configfs gadgets before binding (default: %s)\n", CONFIGFS_GADGET_ROOT);
+    printf("  --ffs           Check FunctionFS descriptor and strings blobs as f_fs.c would\n");
+    printf("  --pcap FILE     Analyze descriptors in a usbmon pcap/pcapng capture (- for stdin)\n");
+    printf("  --scan FILE     Like --pcap, but scan a large capture file on all cores\n");
+    printf("  --usbmon BUS    Passively analyze the host's own requests on a bus (0 = all buses)\n");
+    printf("  -j, --jobs N    Analyze at most N devices at a time (default %d),\n", POOL_DEFAULT_ACTIVE);
+    printf("                  or use N threads in batch, firmware, source and scan modes\n");
+    printf("                  (default: one per core)\n");
+    printf("  --record FILE   Save every control transfer of a single-device run to FILE\n");
+    printf("  --replay FILE   Analyze the transfers saved in FILE instead of a device\n");
+    printf("  --replay-scale S  Multiply recorded latencies by S during replay (default 1, 0 = no delay)\n");
+    printf("  --json          Write one NDJSON record per device to stdout; messages go to stderr\n");
+    printf("  --annotate      Name the descriptor field of each byte next to the rows of raw dumps\n");
+    printf("  -q, --quiet     Print one PASS, WARN or FAIL line per device instead of the report and exit\n");
+    printf("                  with a code for the outcome (see README); other messages go to stderr\n");
+    printf("  --fail-fast     With --quiet, stop at the first error finding or failed MS OS 2.0 request\n");
+    printf("  --mock SPEC     Analyze simulated devices, one profile per dump given (default: built-in);\n");
+    printf("                  SPEC is key=value,... with devices, latency, jitter (us), dist (uniform,\n");
+    printf("                  normal, exp), stall, timeout, short, disconnect (rates 0-1), timeout_ms,\n");
+    printf("                  seed and reports (1 = print every report)\n");
+    printf("Example: %s 0x361d 0x0202\n", program);
+    printf("         %s 13917 514\n", program);
+    printf("         %s --all -j 16 0x361d 0x0202\n", program);
+    printf("         %s --watch --json >> devices.ndjson\n", program);
+    printf("         %s --watch 0x361d 0x0202\n", program);
+    printf("         %s --replay board.ucap --replay-scale 0\n", program);
+    printf("         %s --mock devices=10000,latency=500,dist=exp,stall=0.01 -j 256\n", program);
+    printf("         %s --batch dumps/\n", program);
+    printf("         %s --firmware build/*.elf\n", program);
+    printf("         %s --source src/\n", program);
+    printf("         %s --configfs /sys/kernel/config/usb_gadget/g1\n", program);
+    printf("         %s --ffs descs.bin strs.bin\n", program);
+    printf("         %s --pcap field-failure.pcapng\n", program);
+    printf("         %s --scan soak-test.pcapng -j 8\n", program);
+    printf("         %s --usbmon 0\n", program);
+}
+
+static int parse_id(const char *arg, const char *name, uint16_t *id) {
+    char *endptr;
+    unsigned long value = strtoul(arg, &endptr, 0);
+    if (*endptr != '\0' || value == 0 || value > 0xFFFF) {
+        printf(COLOR_RED "ERROR: Invalid %s '%s' (must be a valid hex or decimal number)\n" COLOR_RESET, name, arg);
+        return -1;
     }
-    
-    const struct usb_bos_descriptor *bos = (const struct usb_bos_descriptor *)data;
-    
-    printf("BOS Header:\n");
-    printf("  bLength: %d\n", bos->bLength);
-    printf("  bDescriptorType: 0x%02x (%s)\n", bos->bDescriptorType, 
-           bos->bDescriptorType == USB_DT_BOS ? "BOS" : "UNKNOWN");
-    printf("  wTotalLength: %d\n", bos->wTotalLength);
-    printf("  bNumDeviceCaps: %d\n\n", bos->bNumDeviceCaps);
-    
-    if (bos->bDescriptorType != USB_DT_BOS) {
-        printf(COLOR_RED "ERROR: Invalid BOS descriptor type\n" COLOR_RESET);
-        error_count++;
-    }
-    
-    if (bos->wTotalLength != length) {
-        printf(COLOR_ORANGE "WARNING: BOS total length mismatch (reported=%d, actual=%d)\n" COLOR_RESET, 
-               bos->wTotalLength, length);
-        warning_count++;
-    }
-    
-    offset = bos->bLength;
-    int cap_count = 0;
-    
-    while (offset < length && cap_count < bos->bNumDeviceCaps) {
-        if (offset + 3 > length) {
-            printf(COLOR_RED "ERROR: Truncated device capability at offset %d\n" COLOR_RESET, offset);
-            error_count++;
-            break;
-        }
-        
-        uint8_t cap_length = data[offset];
-        uint8_t cap_type = data[offset + 1];
-        uint8_t cap_capability_type = data[offset + 2];
-        
-        printf("Device Capability %d (offset %d):\n", cap_count, offset);
-        printf("  bLength: %d\n", cap_length);
-        printf("  bDescriptorType: 0x%02x (%s)\n", cap_type,
-               cap_type == USB_DT_DEVICE_CAPABILITY ? "DEVICE_CAPABILITY" : "UNKNOWN");
-        printf("  bDevCapabilityType: 0x%02x\n", cap_capability_type);
-        
-        if (cap_capability_type == USB_PLAT_DEV_CAP_TYPE && offset + (int)sizeof(struct usb_plat_dev_cap_descriptor) <= length) {
-            const struct usb_plat_dev_cap_descriptor *plat_cap = (const struct usb_plat_dev_cap_descriptor *)(data + offset);
-            char uuid_str[37];
-            uuid_to_string(plat_cap->UUID, uuid_str);
-            
-            printf("  Platform Capability:\n");
-            printf("    bReserved: %d\n", plat_cap->bReserved);
-            printf("    UUID: %s\n", uuid_str);
-            
-            if (strcasecmp(uuid_str, WEBUSB_UUID_STR) == 0) {
-                printf("    Type: WebUSB Platform Capability\n");
-                if (cap_length >= sizeof(struct usb_plat_dev_cap_descriptor) + 4) {
-                    uint16_t bcd_version = data[offset + sizeof(struct usb_plat_dev_cap_descriptor)] | 
-                                         (data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 1] << 8);
-                    uint8_t vendor_code = data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 2];
-                    uint8_t landing_page = data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 3];
-                    
-                    printf("    WebUSB Data:\n");
-                    printf("      bcdVersion: 0x%04x\n", bcd_version);
-                    printf("      bVendorCode: 0x%02x\n", vendor_code);
-                    printf("      iLandingPage: %d (%s)\n", landing_page,
-                           landing_page == 1 ? "Present" : "Not Present");
-                    
-                    if (vendor_code == 0) {
-                        printf("      " COLOR_ORANGE "WARNING: WebUSB vendor code is 0 (invalid)\n" COLOR_RESET);
-                        warning_count++;
-                    }
-                }
-            } else if (strcasecmp(uuid_str, MSOS20_UUID_STR) == 0) {
-                printf("    Type: MS OS 2.0 Platform Capability\n");
-                if (cap_length >= sizeof(struct usb_plat_dev_cap_descriptor) + 8) {
-                    uint32_t win_version = data[offset + sizeof(struct usb_plat_dev_cap_descriptor)] |
-                                         (data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 1] << 8) |
-                                         (data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 2] << 16) |
-                                         (data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 3] << 24);
-                    uint16_t desc_set_len = data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 4] |
-                                          (data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 5] << 8);
-                    uint8_t vendor_code = data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 6];
-                    uint8_t alt_enum = data[offset + sizeof(struct usb_plat_dev_cap_descriptor) + 7];
-                    
-                    printf("    MS OS 2.0 Data:\n");
-                    printf("      dwWindowsVersion: 0x%08x\n", win_version);
-                    printf("      wMSOSDescriptorSetTotalLength: %d\n", desc_set_len);
-                    printf("      bMS_VendorCode: 0x%02x\n", vendor_code);
-                    printf("      bAltEnumCode: %d\n", alt_enum);
-                    
-                    if (win_version != 0x06030000) {
-                        printf("      " COLOR_ORANGE "WARNING: Unusual Windows version (expected 0x06030000)\n" COLOR_RESET);
-                        warning_count++;
-                    }
-                }
-            } else {
-                printf("    Type: Unknown Platform Capability\n");
-            }
-        } else {
-            printf("  Non-Platform Capability (type 0x%02x)\n", cap_capability_type);
+    *id = (uint16_t)value;
+    return 0;
+}
+
+/*
+ * Keep stdout for NDJSON records or --quiet outcome lines alone: they get
+ * the original stdout, returned here, and everything else printed from
+ * here on goes to stderr.
+ */
+static FILE *redirect_stdout(void) {
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    FILE *out = fd >= 0 && dup2(STDERR_FILENO, STDOUT_FILENO) >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        printf(COLOR_RED "ERROR: Cannot set up output\n" COLOR_RESET);
+        if (fd >= 0) {
+            close(fd);
         }
-        
-        printf("\n");
-        offset += cap_length;
-        cap_count++;
-    }
-    
-    printf("=== BOS Summary ===\n");
-    printf("Parsed %d device capabilities, %d errors, %d warnings\n", cap_count, error_count, warning_count);
-    
-    if (error_count == 0 && warning_count == 0) {
-        printf("✓ BOS descriptor appears to be well-formed\n");
-    } else if (error_count == 0) {
-        printf("⚠ BOS descriptor is valid but has %d warning(s)\n", warning_count);
-    } else {
-        printf("✗ BOS descriptor has %d error(s) and %d warning(s)\n", error_count, warning_count);
     }
-    printf("\n");
+    return out;
 }
 
-static void parse_webusb_url_descriptor(const unsigned char *data, int length) {
-    printf("=== WebUSB URL Descriptor ===\n");
-    printf("Length: %d bytes\n", length);
-    
-    if (length < 3) {
-        printf(COLOR_RED "ERROR: WebUSB URL descriptor too short\n" COLOR_RESET);
+// Render the whole report in memory and write it with one system call
+static void render_session_report(const struct usb_session *session) {
+    char *report = NULL;
+    size_t report_size = 0;
+    FILE *stream = report_stream_open(&report, &report_size);
+
+    if (!stream) {
+        session_render(stdout, session);
         return;
     }
-    
-    uint8_t bLength = data[0];
-    uint8_t bDescriptorType = data[1];
-    uint8_t bScheme = data[2];
-    
-    printf("bLength: %d\n", bLength);
-    printf("bDescriptorType: %d (%s)\n", bDescriptorType,
-           bDescriptorType == WEBUSB_URL_DESCRIPTOR_TYPE ? "WebUSB URL" : "UNKNOWN");
-    printf("bScheme: %d (", bScheme);
-    
-    const char *scheme_prefix;
-    switch (bScheme) {
-        case WEBUSB_URL_SCHEME_HTTP:
-            printf("HTTP)\n");
-            scheme_prefix = "http://";
-            break;
-        case WEBUSB_URL_SCHEME_HTTPS:
-            printf("HTTPS)\n");
-            scheme_prefix = "https://";
-            break;
-        case WEBUSB_URL_SCHEME_NONE:
-            printf("None)\n");
-            scheme_prefix = "";
-            break;
-        default:
-            printf("Unknown)\n");
-            scheme_prefix = "unknown://";
-            break;
+    session_render(stream, session);
+    fclose(stream);
+
+    struct iovec part = { report, report_size };
+    report_write(stdout, &part, 1);
+    free(report);
+}
+
+// A failure before any session ran: its outcome line and exit code in quiet runs, result otherwise
+static int quiet_failure(enum session_outcome outcome, int result) {
+    if (!verdict_output) {
+        return result;
     }
-    
-    if (length > 3) {
-        printf("URL: %s", scheme_prefix);
-        for (int i = 3; i < length && i < bLength; i++) {
-            printf("%c", data[i]);
-        }
-        printf("\n");
+    session_print_outcome(verdict_output, NULL, outcome, NULL);
+    fflush(verdict_output);
+    return outcome;
+}
+
+/*
+ * Run one session to completion and print its report. Quiet runs print
+ * the outcome line instead and return the outcome as the exit code.
+ */
+static int run_session(struct usb_engine *engine, libusb_device_handle *handle) {
+    struct usb_session *session = session_create(engine, handle);
+    if (!session) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        return quiet_failure(OUTCOME_USB_ERROR, -1);
     }
+    session->flags = session_flags;
+
+    // All requests run on one event loop; the report is printed once the last one completes
     printf("\n");
-}
+    session_start(session);
+    int result = engine_run(engine);
+    int stranded = 0;
+    if (result != 0) {
+        printf(COLOR_RED "ERROR: USB event handling failed: %s\n" COLOR_RESET, libusb_error_name(result));
+        // Transfers still in flight own buffers in the session's arena
+        int cancel_result = engine_cancel(engine);
+        if (cancel_result != 0) {
+            printf(COLOR_RED "ERROR: Could not cancel pending USB transfers: %s\n" COLOR_RESET,
+                   libusb_error_name(cancel_result));
+            stranded = 1;
+        }
+    }
 
-static void parse_msos20_descriptor(const unsigned char *data, int length) {
-    int offset = 0;
-    int error_count = 0;
-    int warning_count = 0;
-    
-    printf("=== MS OS 2.0 Descriptor Analysis ===\n");
-    printf("Total descriptor length: %d bytes\n\n", length);
-    
-    while (offset < length) {
-        // Check if we have enough bytes for basic header
-        if (offset + 4 > length) {
-            printf(COLOR_RED "ERROR: Truncated descriptor at offset %d (need 4 bytes, have %d)\n" COLOR_RESET, 
-                   offset, length - offset);
-            error_count++;
-            break;
+    if (verdict_output) {
+        const char *detail = NULL;
+        enum session_outcome outcome = result != 0 ? OUTCOME_USB_ERROR : session_outcome(session, &detail);
+        session_print_outcome(verdict_output, NULL, outcome, result != 0 ? libusb_error_name(result) : detail);
+        fflush(verdict_output);
+        if (!stranded) {
+            session_destroy(session);
         }
-        
-        uint16_t wLength = data[offset] | (data[offset + 1] << 8);
-        uint16_t wDescriptorType = data[offset + 2] | (data[offset + 3] << 8);
-        
-        printf("Offset %d: ", offset);
-        
-        // Validate basic length constraints
-        if (wLength == 0) {
-            printf(COLOR_RED "ERROR: Zero length descriptor at offset %d\n" COLOR_RESET, offset);
-            error_count++;
-            break;
+        return outcome;
+    }
+    if (stranded) {
+        // Leak the session rather than free buffers libusb may still write to
+        return -1;
+    }
+
+    if (json_output) {
+        json_begin_object(json_output, NULL);
+        session_render_json(json_output, session);
+        json_end_object(json_output);
+        json_end_record(json_output);
+    } else {
+        render_session_report(session);
+    }
+    result = session_status(session);
+    session_destroy(session);
+    return result;
+}
+
+// Exit code of a pool run: the pool's outcome in quiet runs
+static int pool_result(const struct device_pool *pool, int result) {
+    if (verdict_output) {
+        return result == 0 ? pool->outcome : OUTCOME_USB_ERROR;
+    }
+    return result < 0 ? -1 : result;
+}
+
+// Analyze the first device matching VID/PID, optionally recording its transfers
+static int analyze_single(uint16_t vid, uint16_t pid, const char *record_path) {
+    libusb_device_handle *handle;
+    struct capture_writer recorder;
+    int result;
+
+    handle = libusb_open_device_with_vid_pid(NULL, vid, pid);
+    if (!handle) {
+        printf(COLOR_RED "ERROR: Device %04x:%04x not found\n" COLOR_RESET, vid, pid);
+        printf("Make sure:\n");
+        printf("- Device is connected and powered\n");
+        printf("- You have permission to access USB devices (try with sudo)\n");
+        printf("- VID:PID values are correct (check with lsusb)\n");
+        return quiet_failure(OUTCOME_NO_DEVICE, -1);
+    }
+
+    printf("Device opened successfully\n");
+    session_detach_kernel_driver(stdout, handle);
+
+    struct usb_engine engine;
+    engine_init(&engine, NULL);
+    if (record_path) {
+        if (capture_writer_open(&recorder, record_path) != 0) {
+            libusb_close(handle);
+            return quiet_failure(OUTCOME_USB_ERROR, -1);
         }
-        
-        if (wLength < 4) {
-            printf(COLOR_RED "ERROR: Invalid descriptor length %d at offset %d (minimum is 4)\n" COLOR_RESET, 
-                   wLength, offset);
-            error_count++;
-            break;
+        engine.recorder = &recorder;
+    }
+
+    result = run_session(&engine, handle);
+
+    if (record_path) {
+        if (capture_writer_close(&recorder) != 0) {
+            printf(COLOR_RED "ERROR: Could not write capture file '%s'\n" COLOR_RESET, record_path);
+            // The outcome line is already out; the exit code still reports the failure
+            result = verdict_output ? OUTCOME_USB_ERROR : -1;
+        } else {
+            printf("Recorded %d control transfers to %s\n", recorder.records, record_path);
         }
-        
-        if (offset + wLength > length) {
-            printf(COLOR_RED "ERROR: Descriptor extends beyond buffer (offset=%d, len=%d, buffer=%d)\n" COLOR_RESET, 
-                   offset, wLength, length);
-            error_count++;
+    }
+
+    libusb_close(handle);
+    return result;
+}
+
+// Run the analysis against a capture file instead of a device
+static int analyze_replay(const char *path, double time_scale) {
+    struct capture capture;
+    struct usb_engine engine;
+
+    if (capture_load(&capture, path) != 0) {
+        return quiet_failure(OUTCOME_USB_ERROR, -1);
+    }
+    printf("Replaying %d control transfers from %s\n", capture.count, path);
+
+    capture_replay_init(&engine, &capture, time_scale);
+    int result = run_session(&engine, NULL);
+    if (capture.unmatched > 0) {
+        printf(COLOR_ORANGE "WARNING: %d request(s) were not in the capture and failed with LIBUSB_ERROR_NOT_FOUND\n"
+               COLOR_RESET, capture.unmatched);
+    }
+
+    capture_free(&capture);
+    return result;
+}
+
+// Analyze the descriptors exchanged in a usbmon capture
+static int analyze_pcap(const char *path) {
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!file) {
+        printf(COLOR_RED "ERROR: Cannot open capture '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+
+    int result = trace_analyze_pcap(stdout, file);
+    if (file != stdin) {
+        fclose(file);
+    }
+    return result;
+}
+
+// Read a whole FunctionFS blob; returns its length, or -1 after printing an error
+static int read_ffs_blob(const char *path, uint8_t **data) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf(COLOR_RED "ERROR: Cannot open '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        rewind(file);
+    }
+    *data = size >= 0 && size <= FFS_BLOB_MAX_SIZE ? malloc(size > 0 ? (size_t)size : 1) : NULL;
+    if (!*data || fread(*data, 1, (size_t)size, file) != (size_t)size) {
+        printf(COLOR_RED "ERROR: Cannot read '%s'\n" COLOR_RESET, path);
+        free(*data);
+        *data = NULL;
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    return (int)size;
+}
+
+// Check the blobs a FunctionFS daemon writes to ep0: descriptors, then optionally strings
+static int analyze_ffs(const char * const *paths, int count) {
+    struct ffs_view descriptors = { 0 };
+    struct ffs_strings_view strings = { 0 };
+    uint8_t *data[2] = { NULL, NULL };
+    int result = 0;
+
+    for (int i = 0; i < count; i++) {
+        int length = read_ffs_blob(paths[i], &data[i]);
+        if (length < 0) {
+            result = -1;
             break;
         }
-        
-        switch (wDescriptorType) {
-            case MS_OS_20_SET_HEADER_DESCRIPTOR: {
-                if (wLength < 10) {
-                    printf(COLOR_RED "ERROR: Set Header too short (len=%d, expected=10)\n" COLOR_RESET, wLength);
-                    error_count++;
-                } else {
-                    uint32_t dwWindowsVersion = data[offset + 4] | (data[offset + 5] << 8) | 
-                                               (data[offset + 6] << 16) | (data[offset + 7] << 24);
-                    uint16_t wTotalLength = data[offset + 8] | (data[offset + 9] << 8);
-                    printf("Set Header (len=%d, winver=0x%08x, total=%d)\n", 
-                           wLength, dwWindowsVersion, wTotalLength);
-                    
-                    // Validate total length matches actual length
-                    if (wTotalLength != length) {
-                        printf("  " COLOR_ORANGE "WARNING: Total length mismatch (reported=%d, actual=%d)\n" COLOR_RESET, 
-                               wTotalLength, length);
-                        warning_count++;
-                    }
-                    
-                    // Check if it's at the beginning
-                    if (offset != 0) {
-                        printf("  " COLOR_ORANGE "WARNING: Set Header not at beginning (offset=%d)\n" COLOR_RESET, offset);
-                        warning_count++;
-                    }
-                    
-                    // Validate Windows version
-                    if (dwWindowsVersion != 0x06030000) {
-                        printf("  " COLOR_ORANGE "WARNING: Unusual Windows version (expected=0x06030000 for Win 8.1)\n" COLOR_RESET);
-                        warning_count++;
-                    }
-                }
-                break;
-            }
-            case MS_OS_20_SUBSET_HEADER_CONFIGURATION: {
-                if (wLength < 8) {
-                    printf(COLOR_RED "ERROR: Configuration Subset Header too short (len=%d, expected=8)\n" COLOR_RESET, wLength);
-                    error_count++;
-                } else {
-                    uint8_t bConfigurationValue = data[offset + 4];
-                    uint8_t bReserved = data[offset + 5];
-                    uint16_t wTotalLength = data[offset + 6] | (data[offset + 7] << 8);
-                    printf("Configuration Subset Header (len=%d, config=%d, total=%d)\n", 
-                           wLength, bConfigurationValue, wTotalLength);
-                    
-                    if (bReserved != 0) {
-                        printf("  " COLOR_ORANGE "WARNING: Reserved field not zero (value=%d)\n" COLOR_RESET, bReserved);
-                        warning_count++;
-                    }
-                    
-                    // Validate subset length doesn't exceed remaining buffer
-                    if (offset + wTotalLength > length) {
-                        printf("  " COLOR_RED "ERROR: Configuration subset extends beyond buffer\n" COLOR_RESET);
-                        error_count++;
-                    }
-                }
-                break;
-            }
-            case MS_OS_20_SUBSET_HEADER_FUNCTION: {
-                if (wLength < 8) {
-                    printf(COLOR_RED "ERROR: Function Subset Header too short (len=%d, expected=8)\n" COLOR_RESET, wLength);
-                    error_count++;
-                } else {
-                    uint8_t bFirstInterface = data[offset + 4];
-                    uint8_t bReserved = data[offset + 5];
-                    uint16_t wSubsetLength = data[offset + 6] | (data[offset + 7] << 8);
-                    printf("Function Subset Header (len=%d, interface=%d, subset=%d)\n", 
-                           wLength, bFirstInterface, wSubsetLength);
-                    
-                    if (bReserved != 0) {
-                        printf("  " COLOR_ORANGE "WARNING: Reserved field not zero (value=%d)\n" COLOR_RESET, bReserved);
-                        warning_count++;
-                    }
-                    
-                    // Validate subset length
-                    if (offset + wSubsetLength > length) {
-                        printf("  " COLOR_RED "ERROR: Function subset extends beyond buffer\n" COLOR_RESET);
-                        error_count++;
-                    }
-                    
-                    if (wSubsetLength < wLength) {
-                        printf("  " COLOR_RED "ERROR: Function subset length smaller than header length\n" COLOR_RESET);
-                        error_count++;
-                    }
-                }
-                break;
+        if (i == 0) {
+            parse_ffs_descriptors(&descriptors, data[i], length);
+            render_ffs_descriptors(stdout, &descriptors);
+            if (descriptors.findings.error_count > 0) {
+                result = -1;
             }
-            case MS_OS_20_FEATURE_COMPATIBLE_ID: {
-                if (wLength < 20) {
-                    printf(COLOR_RED "ERROR: Compatible ID Feature too short (len=%d, expected=20)\n" COLOR_RESET, wLength);
-                    error_count++;
-                } else {
-                    printf("Compatible ID Feature (len=%d, compat='%.8s', subcompat='%.8s')\n", 
-                           wLength, &data[offset + 4], &data[offset + 12]);
-                    
-                    // Check for null termination and padding
-                    int has_winusb = (strncmp((char*)&data[offset + 4], "WINUSB", 6) == 0);
-                    if (!has_winusb) {
-                        printf("  " COLOR_ORANGE "WARNING: Compatible ID is not 'WINUSB'\n" COLOR_RESET);
-                        warning_count++;
-                    }
-                    
-                    // Check for proper null termination
-                    if (data[offset + 4 + 6] != 0 || data[offset + 4 + 7] != 0) {
-                        printf("  " COLOR_ORANGE "WARNING: Compatible ID not properly null-terminated\n" COLOR_RESET);
-                        warning_count++;
-                    }
-                }
-                break;
+        } else {
+            parse_ffs_strings(&strings, data[i], length);
+            if (descriptors.header_valid) {
+                check_ffs_string_count(&strings, &descriptors);
             }
-            case MS_OS_20_FEATURE_REG_PROPERTY: {
-                if (wLength < 8) {
-                    printf(COLOR_RED "ERROR: Registry Property Feature too short (len=%d, minimum=8)\n" COLOR_RESET, wLength);
-                    error_count++;
-                } else {
-                    uint16_t wPropertyDataType = data[offset + 4] | (data[offset + 5] << 8);
-                    uint16_t wPropertyNameLength = data[offset + 6] | (data[offset + 7] << 8);
-                    printf("Registry Property Feature (len=%d, datatype=%d, namelen=%d)\n", 
-                           wLength, wPropertyDataType, wPropertyNameLength);
-                    
-                    // Validate property data type
-                    if (wPropertyDataType != 1 && wPropertyDataType != 7) {
-                        printf("  " COLOR_ORANGE "WARNING: Unusual property data type (1=REG_SZ, 7=REG_MULTI_SZ)\n" COLOR_RESET);
-                        warning_count++;
-                    }
-                    
-                    // Validate name length (should be even for UTF-16LE and include null terminator)
-                    if (wPropertyNameLength == 0 || wPropertyNameLength % 2 != 0) {
-                        printf("  " COLOR_RED "ERROR: Invalid property name length (must be even and >0)\n" COLOR_RESET);
-                        error_count++;
-                    } else if (offset + 8 + wPropertyNameLength > length) {
-                        printf("  " COLOR_RED "ERROR: Property name extends beyond descriptor\n" COLOR_RESET);
-                        error_count++;
-                    } else {
-                        // Parse property name (UTF-16LE)
-                        printf("  Property Name: ");
-                        int name_chars = 0;
-                        for (int i = 0; i < wPropertyNameLength - 2; i += 2) {
-                            if (offset + 8 + i + 1 < length) {
-                                char c = data[offset + 8 + i];
-                                if (c >= 32 && c <= 126) { // Printable ASCII
-                                    printf("%c", c);
-                                    name_chars++;
-                                } else if (c == 0) {
-                                    break; // Null terminator found early
-                                } else {
-                                    printf("?"); // Non-printable character
-                                }
-                            }
-                        }
-                        printf("\n");
-                        
-                        if (name_chars == 0) {
-                            printf("  " COLOR_ORANGE "WARNING: Empty property name\n" COLOR_RESET);
-                            warning_count++;
-                        }
-                        
-                        // Parse property data length and data
-                        int data_offset = offset + 8 + wPropertyNameLength;
-                        if (data_offset + 2 > length) {
-                            printf("  " COLOR_RED "ERROR: Property data length field beyond descriptor\n" COLOR_RESET);
-                            error_count++;
-                        } else {
-                            uint16_t wPropertyDataLength = data[data_offset] | (data[data_offset + 1] << 8);
-                            printf("  Property Data Length: %d\n", wPropertyDataLength);
-                            
-                            // Validate total size
-                            int expected_total = 8 + wPropertyNameLength + 2 + wPropertyDataLength;
-                            if (expected_total != wLength) {
-                                printf("  " COLOR_RED "ERROR: Length mismatch (calculated=%d, reported=%d)\n" COLOR_RESET,
-                                       expected_total, wLength);
-                                error_count++;
-                            }
-                            
-                            if (data_offset + 2 + wPropertyDataLength > length) {
-                                printf("  " COLOR_RED "ERROR: Property data extends beyond descriptor\n" COLOR_RESET);
-                                error_count++;
-                            } else if (wPropertyDataLength > 0) {
-                                printf("  Property Data: ");
-                                for (int i = 0; i < wPropertyDataLength - 2; i += 2) {
-                                    if (data_offset + 2 + i < length) {
-                                        char c = data[data_offset + 2 + i];
-                                        if (c >= 32 && c <= 126) {
-                                            printf("%c", c);
-                                        } else if (c == 0) {
-                                            break;
-                                        } else {
-                                            printf("?");
-                                        }
-                                    }
-                                }
-                                printf("\n");
-                            }
-                        }
-                    }
-                }
-                break;
+            render_ffs_strings(stdout, &strings);
+            if (strings.findings.error_count > 0) {
+                result = -1;
             }
-            default:
-                printf(COLOR_RED "ERROR: Unknown Descriptor Type 0x%04x (len=%d)\n" COLOR_RESET, wDescriptorType, wLength);
-                error_count++;
-                break;
         }
-        
-        offset += wLength;
-    }
-    
-    printf("\n=== Summary ===\n");
-    printf("Parsing completed: %d errors, %d warnings\n", error_count, warning_count);
-    
-    if (error_count == 0 && warning_count == 0) {
-        printf("✓ Descriptor appears to be well-formed\n");
-    } else if (error_count == 0) {
-        printf("⚠ Descriptor is valid but has %d warning(s)\n", warning_count);
-    } else {
-        printf("✗ Descriptor has %d error(s) and %d warning(s)\n", error_count, warning_count);
     }
-    printf("\n");
+
+    free(data[0]);
+    free(data[1]);
+    return result;
 }
 
-int main(int argc, const char * const argv[]) {
-    libusb_device_handle *handle;
-    unsigned char buffer[512];
-    int result;
-    uint16_t vid, pid;
-    char *endptr;
+// Analyze every matching device concurrently, one report per bus/port path
+static int analyze_all(int match_all, uint16_t vid, uint16_t pid, int jobs) {
+    struct usb_engine engine;
+    struct device_pool pool;
 
-    if (argc != 3) {
-        printf("Usage: %s <vid> <pid>\n", argv[0]);
-        printf("Example: %s 0x361d 0x0202\n", argv[0]);
-        printf("         %s 13917 514\n", argv[0]);
-        return -1;
+    engine_init(&engine, NULL);
+    pool_init(&pool, &engine);
+    pool.json = json_output;
+    pool.session_flags = session_flags;
+    int count = pool_collect(&pool, match_all, vid, pid);
+    if (count < 0) {
+        printf(COLOR_RED "ERROR: Failed to list USB devices: %s\n" COLOR_RESET, libusb_error_name(count));
+        pool_free(&pool);
+        return quiet_failure(OUTCOME_USB_ERROR, -1);
+    }
+    if (count == 0) {
+        printf(COLOR_RED "ERROR: No matching devices found\n" COLOR_RESET);
+        pool_free(&pool);
+        return quiet_failure(OUTCOME_NO_DEVICE, -1);
     }
 
-    // Parse VID and PID from command line with error checking
-    vid = (uint16_t)strtoul(argv[1], &endptr, 0);
-    if (*endptr != '\0' || vid == 0) {
-        printf(COLOR_RED "ERROR: Invalid VID '%s' (must be a valid hex or decimal number)\n" COLOR_RESET, argv[1]);
-        return -1;
+    printf("Analyzing %d device(s), up to %d at a time\n\n", count, jobs);
+    fflush(stdout);
+    int result = pool_run(&pool, verdict_output ? verdict_output : stdout, jobs);
+    if (result == 0 && !verdict_output) {
+        result = pool_status(&pool);
     }
+    result = pool_result(&pool, result);
+    pool_free(&pool);
+    return result;
+}
 
-    pid = (uint16_t)strtoul(argv[2], &endptr, 0);
-    if (*endptr != '\0' || pid == 0) {
-        printf(COLOR_RED "ERROR: Invalid PID '%s' (must be a valid hex or decimal number)\n" COLOR_RESET, argv[2]);
-        return -1;
+// Stay resident and analyze devices as they arrive, until SIGINT or SIGTERM
+static int analyze_watch(int match_all, uint16_t vid, uint16_t pid, int jobs) {
+    struct usb_engine engine;
+    struct device_pool pool;
+
+    engine_init(&engine, NULL);
+    pool_init(&pool, &engine);
+    pool.json = json_output;
+    pool.session_flags = session_flags;
+
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+
+    if (match_all) {
+        printf("Waiting for devices (Ctrl+C to stop)\n\n");
+    } else {
+        printf("Waiting for %04x:%04x devices (Ctrl+C to stop)\n\n", vid, pid);
     }
-    
-    printf("Looking for USB device %04x:%04x\n", vid, pid);
+    fflush(stdout);
 
-    // Initialize libusb with error checking
-    result = libusb_init(NULL);
-    if (result != 0) {
-        printf(COLOR_RED "ERROR: Failed to initialize libusb: %s\n" COLOR_RESET, libusb_error_name(result));
-        return -1;
+    int result = pool_watch(&pool, verdict_output ? verdict_output : stdout, jobs, match_all, vid, pid,
+                            &stop_requested);
+    printf("Watched %d device(s): %d ok, %d failed\n", pool.analyzed, pool.analyzed - pool.failed, pool.failed);
+    if (result == 0 && pool.failed > 0 && !verdict_output) {
+        result = -1;
     }
+    result = pool_result(&pool, result);
+    pool_free(&pool);
+    return result;
+}
 
-    handle = libusb_open_device_with_vid_pid(NULL, vid, pid);
-    if (!handle) {
-        printf(COLOR_RED "ERROR: Device %04x:%04x not found\n" COLOR_RESET, vid, pid);
-        printf("Make sure:\n");
-        printf("- Device is connected and powered\n");
-        printf("- You have permission to access USB devices (try with sudo)\n");
-        printf("- VID:PID values are correct (check with lsusb)\n");
-        libusb_exit(NULL);
+// Run the device pool against a farm of simulated devices and report how it kept up
+static int analyze_mock(const char *spec, const char * const *paths, int path_count, int jobs) {
+    struct mock_config config;
+    if (mock_parse_config(&config, spec) != 0) {
         return -1;
     }
 
-    printf("Device opened successfully\n");
+    int profile_count = path_count > 0 ? path_count : 1;
+    struct mock_profile *profiles = malloc(profile_count * sizeof(*profiles));
+    if (!profiles) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        return quiet_failure(OUTCOME_USB_ERROR, -1);
+    }
+    for (int i = 0; i < profile_count; i++) {
+        mock_profile_default(&profiles[i]);
+        if (path_count > 0 && mock_profile_load(&profiles[i], paths[i]) != 0) {
+            free(profiles);
+            return quiet_failure(OUTCOME_USB_ERROR, -1);
+        }
+    }
 
-    // Check if we need to detach kernel driver
-    if (libusb_kernel_driver_active(handle, 0) == 1) {
-        printf("Kernel driver is active on interface 0, attempting to detach...\n");
-        result = libusb_detach_kernel_driver(handle, 0);
-        if (result != 0 && result != LIBUSB_ERROR_NOT_FOUND) {
-            printf(COLOR_ORANGE "WARNING: Could not detach kernel driver: %s\n" COLOR_RESET, libusb_error_name(result));
+    // Reports are still rendered when they are not shown: that is part of the load
+    FILE *shown = verdict_output ? verdict_output : stdout;
+    FILE *reports = config.reports ? shown : fopen("/dev/null", "w");
+    static struct json_writer discarded_records;
+    struct usb_engine engine;
+    struct mock_farm farm;
+    struct device_pool pool;
+    int result = -1;
+
+    pool_init(&pool, &engine);
+    pool.session_flags = session_flags;
+    if (json_output && reports) {
+        json_init(&discarded_records, reports);
+        pool.json = config.reports ? json_output : &discarded_records;
+    }
+    if (!reports || mock_farm_init(&farm, &engine, &config, profiles, profile_count) != 0) {
+        printf(COLOR_RED "ERROR: Could not set up %d simulated devices\n" COLOR_RESET, config.devices);
+        if (reports && reports != shown) {
+            fclose(reports);
+        }
+        free(profiles);
+        return quiet_failure(OUTCOME_USB_ERROR, -1);
+    }
+    for (int i = 0; i < config.devices; i++) {
+        const struct mock_profile *profile = farm.devices[i].profile;
+        result = pool_add_virtual(&pool, mock_farm_handle(&farm, i), profile->vid, profile->pid);
+        if (result != 0) {
+            printf(COLOR_RED "ERROR: Could not queue simulated device: %s\n" COLOR_RESET, libusb_error_name(result));
+            break;
         }
     }
 
-    // Clear buffer to ensure clean data
-    memset(buffer, 0, sizeof(buffer));
-
-    // First, fetch the BOS descriptor
-    printf("=== Fetching BOS Descriptor ===\n");
-    result = libusb_control_transfer(handle, LIBUSB_ENDPOINT_IN, LIBUSB_REQUEST_GET_DESCRIPTOR, 
-                                   (USB_DT_BOS << 8), 0, buffer, sizeof(buffer), 5000);
-    
-    if (result > 0) {
-        printf("SUCCESS: BOS descriptor retrieved (%d bytes)\n\n", result);
-        
-        // Raw hex dump of BOS
-        printf("Raw BOS data:\n");
-        for (int i = 0; i < result; i++) {
-            printf("%02x ", buffer[i]);
-            if ((i + 1) % 16 == 0) printf("\n");
+    if (result == 0) {
+        printf("Simulating %d device(s) from %d profile(s), up to %d at a time\n\n", config.devices, profile_count,
+               jobs);
+        fflush(stdout);
+        uint64_t start_ns = engine_now_ns();
+        result = pool_run(&pool, reports, jobs);
+        double elapsed_ms = (double)(engine_now_ns() - start_ns) / 1e6;
+
+        if (config.reports) {
+            printf("\n");
         }
-        if (result % 16 != 0) printf("\n");
-        printf("\n");
-        
-        // Parse BOS descriptor
-        parse_bos_descriptor(buffer, result);
-        
-        // Extract WebUSB vendor code and landing page index for later use
-        uint8_t webusb_vendor_code = 0;
-        uint8_t webusb_landing_page_index = 0;
-        int bos_offset = 5; // Skip BOS header
-        for (int cap = 0; cap < buffer[4] && bos_offset < result; cap++) {
-            if (bos_offset + 3 > result) break;
-            
-            uint8_t cap_length = buffer[bos_offset];
-            uint8_t cap_capability_type = buffer[bos_offset + 2];
-            
-            if (cap_capability_type == USB_PLAT_DEV_CAP_TYPE && 
-                bos_offset + (int)sizeof(struct usb_plat_dev_cap_descriptor) <= result) {
-                char uuid_str[37];
-                uuid_to_string(&buffer[bos_offset + 4], uuid_str);
-                
-                if (strcasecmp(uuid_str, WEBUSB_UUID_STR) == 0 && 
-                    cap_length >= sizeof(struct usb_plat_dev_cap_descriptor) + 4) {
-                    webusb_vendor_code = buffer[bos_offset + sizeof(struct usb_plat_dev_cap_descriptor) + 2];
-                    webusb_landing_page_index = buffer[bos_offset + sizeof(struct usb_plat_dev_cap_descriptor) + 3];
-                    break;
-                }
-            }
-            bos_offset += cap_length;
+        mock_farm_render(stdout, &farm);
+        printf("Analyzed %d device(s) in %.1f ms (%.0f transfers/s): %d ok, %d failed\n", pool.analyzed,
+               elapsed_ms, elapsed_ms > 0 ? farm.transfers / (elapsed_ms / 1e3) : 0.0,
+               pool.analyzed - pool.failed, pool.failed);
+        if (result == 0 && !verdict_output) {
+            result = pool_status(&pool);
         }
-        
-        // Try to fetch WebUSB URL if we found a WebUSB capability
-        if (webusb_vendor_code != 0 && webusb_landing_page_index != 0) {
-            printf("=== Fetching WebUSB URL ===\n");
-            printf("Using WebUSB vendor code: 0x%02x\n", webusb_vendor_code);
-            printf("Using landing page index: %d\n", webusb_landing_page_index);
-            
-            memset(buffer, 0, sizeof(buffer));
-            result = libusb_control_transfer(handle, LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR,
-                                           webusb_vendor_code, webusb_landing_page_index, WEBUSB_GET_URL, 
-                                           buffer, sizeof(buffer), 5000);
-            
-            if (result > 0) {
-                printf("SUCCESS: WebUSB URL descriptor retrieved (%d bytes)\n\n", result);
-                
-                printf("Raw WebUSB URL data:\n");
-                for (int i = 0; i < result; i++) {
-                    printf("%02x ", buffer[i]);
-                    if ((i + 1) % 16 == 0) printf("\n");
-                }
-                if (result % 16 != 0) printf("\n");
-                printf("\n");
-                
-                parse_webusb_url_descriptor(buffer, result);
+    }
+
+    result = pool_result(&pool, result);
+    pool_free(&pool);
+    mock_farm_free(&farm);
+    if (reports != shown) {
+        fclose(reports);
+    }
+    free(profiles);
+    return result;
+}
+
+// Watch the host's own traffic on a bus without sending anything, until SIGINT or SIGTERM
+static int analyze_usbmon(int bus) {
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+    return usbmon_live_run(stdout, bus, &stop_requested);
+}
+
+int main(int argc, const char * const argv[]) {
+    int all = 0;
+    int batch = 0;
+    int firmware = 0;
+    int source = 0;
+    int configfs = 0;
+    int ffs = 0;
+    int watch = 0;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *pcap_path = NULL;
+    const char *scan_path = NULL;
+    const char *mock_spec = NULL;
+    int json = 0;
+    double replay_scale = 1.0;
+    int usbmon_bus = -1;
+    int jobs = 0;
+    uint16_t vid = 0, pid = 0;
+    int result;
+
+    // VID/PID, or the files of a batch, firmware or source run, or the gadgets of a configfs check
+    const char *args[argc];
+    int arg_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--all") == 0) {
+            all = 1;
+        } else if (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--watch") == 0) {
+            watch = 1;
+        } else if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+        } else if (strcmp(argv[i], "--firmware") == 0) {
+            firmware = 1;
+        } else if (strcmp(argv[i], "--source") == 0) {
+            source = 1;
+        } else if (strcmp(argv[i], "--configfs") == 0) {
+            configfs = 1;
+        } else if (strcmp(argv[i], "--ffs") == 0) {
+            ffs = 1;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else if (strcmp(argv[i], "--annotate") == 0) {
+            session_flags |= SESSION_ANNOTATE_DUMPS;
+        } else if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+            session_flags |= SESSION_QUIET;
+        } else if (strcmp(argv[i], "--fail-fast") == 0) {
+            session_flags |= SESSION_FAIL_FAST;
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            char *endptr;
+            if (i + 1 >= argc || (jobs = (int)strtol(argv[++i], &endptr, 10)) <= 0 || *endptr != '\0') {
+                printf(COLOR_RED "ERROR: %s needs a positive number\n" COLOR_RESET, argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--replay") == 0 ||
+                   strcmp(argv[i], "--pcap") == 0 || strcmp(argv[i], "--scan") == 0) {
+            if (i + 1 >= argc) {
+                printf(COLOR_RED "ERROR: %s needs a file name\n" COLOR_RESET, argv[i]);
+                return -1;
+            }
+            if (strcmp(argv[i], "--record") == 0) {
+                record_path = argv[++i];
+            } else if (strcmp(argv[i], "--replay") == 0) {
+                replay_path = argv[++i];
+            } else if (strcmp(argv[i], "--pcap") == 0) {
+                pcap_path = argv[++i];
             } else {
-                printf("INFO: WebUSB URL request failed (%d): %s\n", result, libusb_error_name(result));
-                if (result == LIBUSB_ERROR_PIPE) {
-                    printf("  This may indicate no landing page is configured\n");
-                }
-                printf("\n");
+                scan_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--mock") == 0) {
+            if (i + 1 >= argc) {
+                printf(COLOR_RED "ERROR: --mock needs a spec, e.g. devices=1000\n" COLOR_RESET);
+                return -1;
+            }
+            mock_spec = argv[++i];
+        } else if (strcmp(argv[i], "--usbmon") == 0) {
+            char *endptr;
+            if (i + 1 >= argc || (usbmon_bus = (int)strtol(argv[++i], &endptr, 10)) < 0 || *endptr != '\0') {
+                printf(COLOR_RED "ERROR: --usbmon needs a bus number (0 for every bus)\n" COLOR_RESET);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--replay-scale") == 0) {
+            char *endptr;
+            if (i + 1 >= argc || (replay_scale = strtod(argv[++i], &endptr)) < 0 || *endptr != '\0') {
+                printf(COLOR_RED "ERROR: --replay-scale needs a non-negative number\n" COLOR_RESET);
+                return -1;
             }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0' && (argv[i][1] < '0' || argv[i][1] > '9')) {
+            printf(COLOR_RED "ERROR: Unknown option '%s'\n" COLOR_RESET, argv[i]);
+            print_usage(argv[0]);
+            return -1;
         } else {
-            printf("INFO: No WebUSB capability found in BOS descriptor\n\n");
+            args[arg_count++] = argv[i];
         }
-    } else {
-        printf("INFO: BOS descriptor request failed (%d): %s\n", result, libusb_error_name(result));
-        printf("Device may not support BOS descriptors (USB 2.0 device?)\n\n");
-    }
-
-    // Now test MS OS 2.0 descriptor
-    printf("=== Fetching MS OS 2.0 Descriptor ===\n");
-    memset(buffer, 0, sizeof(buffer));
-    printf("Sending MS OS 2.0 descriptor request...\n");
-    printf("  bmRequestType: 0xC0 (IN, VENDOR, DEVICE)\n");
-    printf("  bRequest: 0x02 (MS OS vendor code)\n");
-    printf("  wValue: 0x0000\n");
-    printf("  wIndex: 0x0007 (MS_OS_20_DESCRIPTOR_INDEX)\n");
-    printf("  wLength: %zu (buffer size)\n\n", sizeof(buffer));
-
-    // Test MS OS 2.0 descriptor request
-    result = libusb_control_transfer(handle, 0xC0, 0x02, 0x0000, 0x0007, buffer, sizeof(buffer), 5000);
-
-    if (result > 0) {
-        printf("SUCCESS: MS OS 2.0 descriptor retrieved (%d bytes)\n\n", result);
-        
-        // Validate minimum expected size
-        if (result < 10) {
-            printf(COLOR_ORANGE "WARNING: Descriptor very short (%d bytes), may be truncated\n" COLOR_RESET, result);
+    }
+
+    if (json && (usbmon_bus >= 0 || pcap_path || scan_path || batch || firmware || source || configfs || ffs)) {
+        printf(COLOR_RED "ERROR: --json works with device, --all, --watch, --replay and --mock runs only\n" COLOR_RESET);
+        return -1;
+    }
+    if ((session_flags & (SESSION_ANNOTATE_DUMPS | SESSION_QUIET)) &&
+        (json || usbmon_bus >= 0 || pcap_path || scan_path || batch || firmware || source || configfs || ffs)) {
+        printf(COLOR_RED "ERROR: --annotate and --quiet work with text reports of device, --all, --watch, --replay "
+               "and --mock runs only\n" COLOR_RESET);
+        return -1;
+    }
+    if ((session_flags & SESSION_FAIL_FAST) && !(session_flags & SESSION_QUIET)) {
+        printf(COLOR_RED "ERROR: --fail-fast needs --quiet\n" COLOR_RESET);
+        return -1;
+    }
+
+    // Batch, capture, replay and passive runs open no device
+    if (usbmon_bus >= 0) {
+        if (arg_count != 0 || batch || firmware || source || configfs || ffs || all || watch || record_path ||
+            replay_path || pcap_path || scan_path || mock_spec) {
+            print_usage(argv[0]);
+            return -1;
         }
-        
-        // Raw hex dump
-        printf("Raw MS OS 2.0 data:\n");
-        for (int i = 0; i < result; i++) {
-            printf("%02x ", buffer[i]);
-            if ((i + 1) % 16 == 0) printf("\n");
+        return analyze_usbmon(usbmon_bus);
+    }
+    if (pcap_path) {
+        if (arg_count != 0 || batch || firmware || source || configfs || ffs || all || watch || record_path ||
+            replay_path || scan_path || mock_spec) {
+            print_usage(argv[0]);
+            return -1;
         }
-        if (result % 16 != 0) printf("\n");
-        printf("\n");
-        
-        // Parse the descriptor
-        parse_msos20_descriptor(buffer, result);
-    } else if (result == 0) {
-        printf(COLOR_ORANGE "WARNING: Device returned 0 bytes (empty response)\n" COLOR_RESET);
-        printf("This may indicate the device doesn't support MS OS 2.0 descriptors\n");
-    } else {
-        printf(COLOR_RED "ERROR: Failed to get MS OS 2.0 descriptor (%d): %s\n" COLOR_RESET, result, libusb_error_name(result));
-        
-        switch (result) {
-            case LIBUSB_ERROR_PIPE:
-                printf("  Device returned STALL - likely doesn't support MS OS 2.0 descriptors\n");
-                printf("  or the vendor code (0x02) is incorrect\n");
-                break;
-            case LIBUSB_ERROR_TIMEOUT:
-                printf("  Request timed out - device may be unresponsive\n");
-                break;
-            case LIBUSB_ERROR_NO_DEVICE:
-                printf("  Device was disconnected during request\n");
-                break;
-            case LIBUSB_ERROR_ACCESS:
-                printf("  Access denied - try running with sudo\n");
-                break;
-            case LIBUSB_ERROR_NOT_SUPPORTED:
-                printf("  Control transfer not supported by device or host controller\n");
-                break;
-            default:
-                printf("  Check device documentation for supported vendor requests\n");
-                break;
+        return analyze_pcap(pcap_path);
+    }
+    if (scan_path) {
+        if (arg_count != 0 || batch || firmware || source || configfs || ffs || all || watch || record_path ||
+            replay_path || mock_spec) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return capture_scan(stdout, scan_path, jobs);
+    }
+    if (batch) {
+        if (arg_count == 0 || firmware || source || configfs || ffs || all || watch || record_path || replay_path ||
+            mock_spec) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return batch_run(stdout, args, arg_count, jobs);
+    }
+    if (firmware) {
+        if (arg_count == 0 || source || configfs || ffs || all || watch || record_path || replay_path || mock_spec) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return firmware_scan(stdout, args, arg_count, jobs);
+    }
+    if (source) {
+        if (arg_count == 0 || configfs || ffs || all || watch || record_path || replay_path || mock_spec) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return source_scan(stdout, args, arg_count, jobs);
+    }
+    if (configfs) {
+        if (ffs || all || watch || record_path || replay_path || mock_spec || jobs) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return configfs_check(stdout, args, arg_count);
+    }
+    if (ffs) {
+        if (arg_count < 1 || arg_count > 2 || all || watch || record_path || replay_path || mock_spec || jobs) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return analyze_ffs(args, arg_count);
+    }
+    static struct json_writer records;
+    if (json) {
+        FILE *out = redirect_stdout();
+        if (!out) {
+            return -1;
+        }
+        json_init(&records, out);
+        json_output = &records;
+    }
+    if (session_flags & SESSION_QUIET) {
+        verdict_output = redirect_stdout();
+        if (!verdict_output) {
+            return -1;
         }
     }
 
-    libusb_close(handle);
+    if (replay_path) {
+        if (arg_count != 0 || all || watch || record_path || mock_spec) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return analyze_replay(replay_path, replay_scale);
+    }
+    if (mock_spec) {
+        if (all || watch || record_path) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return analyze_mock(mock_spec, args, arg_count, jobs ? jobs : POOL_DEFAULT_ACTIVE);
+    }
+
+    // VID and PID are required unless every device is selected
+    if (!(arg_count == 2 || ((all || watch) && arg_count == 0))) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (record_path && (all || watch)) {
+        printf(COLOR_RED "ERROR: --record works on a single device only\n" COLOR_RESET);
+        return -1;
+    }
+
+    if (arg_count == 2) {
+        if (parse_id(args[0], "VID", &vid) != 0 || parse_id(args[1], "PID", &pid) != 0) {
+            return -1;
+        }
+        printf("Looking for USB device %04x:%04x\n", vid, pid);
+    }
+    if (jobs == 0) {
+        jobs = POOL_DEFAULT_ACTIVE;
+    }
+
+    // Initialize libusb with error checking
+    result = libusb_init(NULL);
+    if (result != 0) {
+        printf(COLOR_RED "ERROR: Failed to initialize libusb: %s\n" COLOR_RESET, libusb_error_name(result));
+        return quiet_failure(OUTCOME_USB_ERROR, -1);
+    }
+
+    if (watch) {
+        result = analyze_watch(arg_count == 0, vid, pid, jobs);
+    } else if (all) {
+        result = analyze_all(arg_count == 0, vid, pid, jobs);
+    } else {
+        result = analyze_single(vid, pid, record_path);
+    }
+
     libusb_exit(NULL);
-    return (result > 0) ? 0 : -1;
+    return result;
 }
@@ -0,0 +1,299 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "usb_capture.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "report.h"
+
+#define REPLAY_BATCH    64      // Transfers completed per replay_handle_events() call
+
+struct replay_transfer {
+    struct control_transfer *xfer;
+    const struct capture_record *record;    // NULL if the request was not captured
+    uint64_t due_ns;
+    int cancelled;
+};
+
+static void put_le16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t value) {
+    put_le16(p, value & 0xFFFF);
+    put_le16(p + 2, value >> 16);
+}
+
+int capture_writer_open(struct capture_writer *writer, const char *path) {
+    uint8_t header[CAPTURE_HEADER_SIZE];
+
+    writer->records = 0;
+    writer->failed = 0;
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        printf(COLOR_RED "ERROR: Cannot create capture file '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+
+    memcpy(header, CAPTURE_MAGIC, 4);
+    put_le16(&header[4], CAPTURE_VERSION);
+    put_le16(&header[6], 0);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+        writer->failed = 1;
+    }
+    return 0;
+}
+
+void capture_write(struct capture_writer *writer, const struct control_transfer *xfer) {
+    uint8_t record[CAPTURE_RECORD_SIZE];
+    const struct control_request *setup = &xfer->setup;
+    uint64_t latency_us = (xfer->complete_ns - xfer->submit_ns) / 1000;
+
+    record[0] = setup->bmRequestType;
+    record[1] = setup->bRequest;
+    put_le16(&record[2], setup->wValue);
+    put_le16(&record[4], setup->wIndex);
+    put_le16(&record[6], setup->wLength);
+    put_le32(&record[8], (uint32_t)xfer->result);
+    put_le32(&record[12], latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us);
+
+    size_t data_length = xfer->result > 0 ? (size_t)xfer->result : 0;
+    if (fwrite(record, 1, sizeof(record), writer->file) != sizeof(record) ||
+        fwrite(xfer->data, 1, data_length, writer->file) != data_length) {
+        writer->failed = 1;
+    }
+    writer->records++;
+}
+
+int capture_writer_close(struct capture_writer *writer) {
+    if (fclose(writer->file) != 0) {
+        writer->failed = 1;
+    }
+    writer->file = NULL;
+    return writer->failed ? -1 : 0;
+}
+
+// Walk the records; fills capture->records when it is allocated, returns the count or -1
+static int index_records(struct capture *capture) {
+    size_t offset = CAPTURE_HEADER_SIZE;
+    int count = 0;
+
+    while (offset < capture->size) {
+        if (capture->size - offset < CAPTURE_RECORD_SIZE) {
+            return -1;
+        }
+        const uint8_t *p = &capture->buffer[offset];
+        int32_t result = (int32_t)get_le32(&p[8]);
+        uint16_t wLength = get_le16(&p[6]);
+        size_t data_length = result > 0 ? (size_t)result : 0;
+        if (data_length > wLength || capture->size - offset - CAPTURE_RECORD_SIZE < data_length) {
+            return -1;
+        }
+
+        if (capture->records) {
+            struct capture_record *record = &capture->records[count];
+            record->setup.bmRequestType = p[0];
+            record->setup.bRequest = p[1];
+            record->setup.wValue = get_le16(&p[2]);
+            record->setup.wIndex = get_le16(&p[4]);
+            record->setup.wLength = wLength;
+            record->result = result;
+            record->latency_us = get_le32(&p[12]);
+            record->data = p + CAPTURE_RECORD_SIZE;
+            record->used = 0;
+        }
+        offset += CAPTURE_RECORD_SIZE + data_length;
+        count++;
+    }
+    return count;
+}
+
+int capture_load(struct capture *capture, const char *path) {
+    memset(capture, 0, sizeof(*capture));
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf(COLOR_RED "ERROR: Cannot open capture file '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+
+    int read_ok = fseek(file, 0, SEEK_END) == 0;
+    long size = read_ok ? ftell(file) : -1;
+    if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        capture->buffer = malloc(size);
+        capture->size = (size_t)size;
+        read_ok = capture->buffer && fread(capture->buffer, 1, capture->size, file) == capture->size;
+    } else {
+        read_ok = 0;
+    }
+    fclose(file);
+
+    if (!read_ok) {
+        printf(COLOR_RED "ERROR: Cannot read capture file '%s'\n" COLOR_RESET, path);
+        capture_free(capture);
+        return -1;
+    }
+
+    if (capture->size < CAPTURE_HEADER_SIZE || memcmp(capture->buffer, CAPTURE_MAGIC, 4) != 0 ||
+        get_le16(&capture->buffer[4]) != CAPTURE_VERSION) {
+        printf(COLOR_RED "ERROR: '%s' is not a version %d capture file\n" COLOR_RESET, path, CAPTURE_VERSION);
+        capture_free(capture);
+        return -1;
+    }
+
+    int count = index_records(capture);
+    if (count >= 0) {
+        capture->records = calloc(count > 0 ? count : 1, sizeof(*capture->records));
+        if (capture->records) {
+            capture->count = index_records(capture);
+        }
+    }
+    if (count < 0 || !capture->records) {
+        printf(COLOR_RED "ERROR: Capture file '%s' is truncated or corrupt\n" COLOR_RESET, path);
+        capture_free(capture);
+        return -1;
+    }
+    return 0;
+}
+
+void capture_free(struct capture *capture) {
+    free(capture->buffer);
+    free(capture->records);
+    free(capture->in_flight);
+    memset(capture, 0, sizeof(*capture));
+}
+
+static int same_setup(const struct control_request *a, const struct control_request *b) {
+    return a->bmRequestType == b->bmRequestType && a->bRequest == b->bRequest &&
+           a->wValue == b->wValue && a->wIndex == b->wIndex && a->wLength == b->wLength;
+}
+
+// Repeated requests are answered in recording order
+static const struct capture_record *find_record(struct capture *capture, const struct control_request *setup) {
+    for (int i = 0; i < capture->count; i++) {
+        struct capture_record *record = &capture->records[i];
+        if (!record->used && same_setup(&record->setup, setup)) {
+            record->used = 1;
+            return record;
+        }
+    }
+    return NULL;
+}
+
+static int replay_submit(struct usb_engine *engine, libusb_device_handle *handle,
+                         struct control_transfer *xfer, unsigned char *buffer) {
+    struct capture *capture = engine->backend_data;
+    (void)handle;
+    (void)buffer;
+
+    if (capture->in_flight_count == capture->in_flight_capacity) {
+        int capacity = capture->in_flight_capacity ? capture->in_flight_capacity * 2 : 16;
+        struct replay_transfer *in_flight = realloc(capture->in_flight, capacity * sizeof(*in_flight));
+        if (!in_flight) {
+            return LIBUSB_ERROR_NO_MEM;
+        }
+        capture->in_flight = in_flight;
+        capture->in_flight_capacity = capacity;
+    }
+
+    struct replay_transfer *t = &capture->in_flight[capture->in_flight_count++];
+    t->xfer = xfer;
+    t->record = find_record(capture, &xfer->setup);
+    t->due_ns = xfer->submit_ns;
+    t->cancelled = 0;
+    if (t->record) {
+        t->due_ns += (uint64_t)(t->record->latency_us * 1000.0 * capture->time_scale);
+    } else {
+        capture->unmatched++;
+    }
+    return 0;
+}
+
+static void sleep_until(uint64_t deadline_ns) {
+    uint64_t now = engine_now_ns();
+    if (deadline_ns > now) {
+        uint64_t delay = deadline_ns - now;
+        struct timespec ts = { (time_t)(delay / 1000000000u), (long)(delay % 1000000000u) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static int replay_handle_events(struct usb_engine *engine, int timeout_ms) {
+    struct capture *capture = engine->backend_data;
+
+    if (capture->in_flight_count == 0) {
+        return 0;
+    }
+
+    uint64_t earliest = capture->in_flight[0].due_ns;
+    for (int i = 1; i < capture->in_flight_count; i++) {
+        if (capture->in_flight[i].due_ns < earliest) {
+            earliest = capture->in_flight[i].due_ns;
+        }
+    }
+    uint64_t deadline = engine_now_ns() + (uint64_t)timeout_ms * 1000000u;
+    sleep_until(earliest < deadline ? earliest : deadline);
+
+    // Take the due transfers out first: their callbacks may submit new ones
+    uint64_t now = engine_now_ns();
+    struct replay_transfer due[REPLAY_BATCH];
+    int due_count = 0;
+    int kept = 0;
+    for (int i = 0; i < capture->in_flight_count; i++) {
+        if (capture->in_flight[i].due_ns <= now && due_count < REPLAY_BATCH) {
+            due[due_count++] = capture->in_flight[i];
+        } else {
+            capture->in_flight[kept++] = capture->in_flight[i];
+        }
+    }
+    capture->in_flight_count = kept;
+
+    for (int i = 0; i < due_count; i++) {
+        struct control_transfer *xfer = due[i].xfer;
+        const struct capture_record *record = due[i].record;
+        if (due[i].cancelled) {
+            engine_complete(engine, xfer, LIBUSB_ERROR_INTERRUPTED);
+            continue;
+        }
+        if (!record) {
+            engine_complete(engine, xfer, LIBUSB_ERROR_NOT_FOUND);
+            continue;
+        }
+        if (record->result > 0) {
+            memcpy(xfer->data, record->data, record->result);
+        }
+        engine_complete(engine, xfer, record->result);
+    }
+    return 0;
+}
+
+static void replay_cancel(struct usb_engine *engine) {
+    struct capture *capture = engine->backend_data;
+    uint64_t now = engine_now_ns();
+
+    for (int i = 0; i < capture->in_flight_count; i++) {
+        capture->in_flight[i].due_ns = now;
+        capture->in_flight[i].cancelled = 1;
+    }
+}
+
+static const struct engine_backend replay_backend = {
+    .submit = replay_submit,
+    .handle_events = replay_handle_events,
+    .cancel = replay_cancel,
+};
+
+void capture_replay_init(struct usb_engine *engine, struct capture *capture, double time_scale) {
+    engine_init(engine, NULL);
+    engine->backend = &replay_backend;
+    engine->backend_data = capture;
+    capture->time_scale = time_scale;
+    capture->in_flight_count = 0;
+    capture->unmatched = 0;
+    for (int i = 0; i < capture->count; i++) {
+        capture->records[i].used = 0;
+    }
+}
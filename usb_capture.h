@@ -0,0 +1,71 @@
+#ifndef USB_CAPTURE_H
+#define USB_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "request_plan.h"
+#include "usb_engine.h"
+
+/*
+ * Control transfer capture files
+ *
+ * Recording writes one record per completed transfer: the setup packet,
+ * the result (bytes received or a LIBUSB_ERROR_* code), the latency and the
+ * response bytes. Replay serves those responses to the engine in place of
+ * a device, so the whole analysis runs without hardware.
+ *
+ * File layout, all fields little-endian:
+ *   header   "UCAP" version:u16 reserved:u16
+ *   record   bmRequestType:u8 bRequest:u8 wValue:u16 wIndex:u16 wLength:u16
+ *            result:i32 latency_us:u32 data[max(result, 0)]
+ */
+
+#define CAPTURE_MAGIC           "UCAP"
+#define CAPTURE_VERSION         1
+#define CAPTURE_HEADER_SIZE     8
+#define CAPTURE_RECORD_SIZE     16      // Without the response bytes
+
+struct capture_writer {
+    FILE *file;
+    int records;
+    int failed;                 // Set once a write fails
+};
+
+int capture_writer_open(struct capture_writer *writer, const char *path);
+void capture_write(struct capture_writer *writer, const struct control_transfer *xfer);
+int capture_writer_close(struct capture_writer *writer);    // -1 if any write failed
+
+struct capture_record {
+    struct control_request setup;
+    int32_t result;
+    uint32_t latency_us;
+    const uint8_t *data;        // max(result, 0) bytes
+    int used;                   // Served during this replay
+};
+
+struct replay_transfer;
+
+struct capture {
+    uint8_t *buffer;
+    size_t size;
+    struct capture_record *records;
+    int count;
+
+    // Replay state
+    double time_scale;          // Recorded latency multiplier, 0 serves immediately
+    struct replay_transfer *in_flight;
+    int in_flight_count;
+    int in_flight_capacity;
+    int unmatched;              // Requests the capture had no response for
+};
+
+// Read and validate a capture file; prints an error and returns -1 on failure
+int capture_load(struct capture *capture, const char *path);
+void capture_free(struct capture *capture);
+
+// Serve transfers submitted to engine from capture
+void capture_replay_init(struct usb_engine *engine, struct capture *capture, double time_scale);
+
+#endif
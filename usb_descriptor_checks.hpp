@@ -0,0 +1,370 @@
+#ifndef USB_DESCRIPTOR_CHECKS_HPP
+#define USB_DESCRIPTOR_CHECKS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Compile-time descriptor validation for C++14 firmware builds
+ *
+ * A header-only constexpr port of the BOS, WebUSB URL and MS OS 2.0 checks
+ * in usb_descriptors.c, so descriptor arrays can be checked with
+ * static_assert before anything is flashed:
+ *
+ *     constexpr uint8_t desc_ms_os_20[] = { ... };
+ *     static_assert(usb_descriptor_checks::check_msos20(desc_ms_os_20).ok(),
+ *                   "MS OS 2.0 descriptor set has errors");
+ *
+ * The rules, their order and their severities are the same as in
+ * descriptor_rules[]; keep the two in step. The arrays must be constexpr
+ * (a plain const array cannot be read in a constant expression). Nothing
+ * here generates code unless it is called at run time.
+ */
+
+namespace usb_descriptor_checks {
+
+// Same order as enum descriptor_rule
+enum class rule : int {
+    none = -1,
+    bos_too_short,
+    bos_type,
+    bos_total_length,
+    bos_cap_truncated,
+    webusb_vendor_code_zero,
+    msos20_cap_windows_version,
+    msos20_cap_set_length,
+    url_too_short,
+    msos20_truncated,
+    msos20_zero_length,
+    msos20_bad_length,
+    msos20_overrun,
+    msos20_set_header_short,
+    msos20_total_length,
+    msos20_set_header_offset,
+    msos20_windows_version,
+    msos20_config_short,
+    msos20_config_reserved,
+    msos20_config_overrun,
+    msos20_function_short,
+    msos20_function_reserved,
+    msos20_function_overrun,
+    msos20_function_underrun,
+    msos20_compat_id_short,
+    msos20_compat_id_not_winusb,
+    msos20_compat_id_padding,
+    msos20_reg_property_short,
+    msos20_reg_property_type,
+    msos20_reg_property_name_length,
+    msos20_reg_property_name_overrun,
+    msos20_reg_property_name_empty,
+    msos20_reg_property_data_length_overrun,
+    msos20_reg_property_length,
+    msos20_reg_property_data_overrun,
+    msos20_unknown_type,
+};
+
+constexpr bool is_error(rule r) {
+    switch (r) {
+        case rule::bos_total_length:
+        case rule::webusb_vendor_code_zero:
+        case rule::msos20_cap_windows_version:
+        case rule::msos20_total_length:
+        case rule::msos20_set_header_offset:
+        case rule::msos20_windows_version:
+        case rule::msos20_config_reserved:
+        case rule::msos20_function_reserved:
+        case rule::msos20_compat_id_not_winusb:
+        case rule::msos20_compat_id_padding:
+        case rule::msos20_reg_property_type:
+        case rule::msos20_reg_property_name_empty:
+        case rule::none:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Counts plus the first error and warning, with the byte offset each refers to
+struct check_result {
+    int errors = 0;
+    int warnings = 0;
+    rule first_error = rule::none;
+    int first_error_offset = 0;
+    rule first_warning = rule::none;
+    int first_warning_offset = 0;
+
+    constexpr bool ok() const { return errors == 0; }
+    constexpr bool clean() const { return errors == 0 && warnings == 0; }
+};
+
+namespace detail {
+
+constexpr void add(check_result &result, rule r, int offset) {
+    if (is_error(r)) {
+        if (result.errors++ == 0) {
+            result.first_error = r;
+            result.first_error_offset = offset;
+        }
+    } else if (result.warnings++ == 0) {
+        result.first_warning = r;
+        result.first_warning_offset = offset;
+    }
+}
+
+constexpr int le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+constexpr uint32_t le32(const uint8_t *p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+// 1 for the WebUSB UUID, 2 for the MS OS 2.0 UUID, 0 otherwise (wire order)
+constexpr int platform(const uint8_t *uuid) {
+    const uint8_t webusb[16] = { 0x38, 0xb6, 0x08, 0x34, 0xa9, 0x09, 0xa0, 0x47,
+                                 0x8b, 0xfd, 0xa0, 0x76, 0x88, 0x15, 0xb6, 0x65 };
+    const uint8_t msos20[16] = { 0xdf, 0x60, 0xdd, 0xd8, 0x89, 0x45, 0xc7, 0x4c,
+                                 0x9c, 0xd2, 0x65, 0x9d, 0x9e, 0x64, 0x8a, 0x9f };
+    bool is_webusb = true, is_msos20 = true;
+    for (int i = 0; i < 16; i++) {
+        is_webusb = is_webusb && uuid[i] == webusb[i];
+        is_msos20 = is_msos20 && uuid[i] == msos20[i];
+    }
+    return is_webusb ? 1 : is_msos20 ? 2 : 0;
+}
+
+constexpr void check_reg_property(check_result &result, const uint8_t *data, int length, int offset,
+                                  int wLength) {
+    int wPropertyDataType = le16(&data[offset + 4]);
+    int wPropertyNameLength = le16(&data[offset + 6]);
+
+    if (wPropertyDataType != 1 && wPropertyDataType != 7) {
+        add(result, rule::msos20_reg_property_type, offset + 4);
+    }
+    if (wPropertyNameLength == 0 || wPropertyNameLength % 2 != 0) {
+        add(result, rule::msos20_reg_property_name_length, offset + 6);
+        return;
+    }
+    if (offset + 8 + wPropertyNameLength > length) {
+        add(result, rule::msos20_reg_property_name_overrun, offset + 8);
+        return;
+    }
+
+    int name_chars = 0;
+    for (int i = 0; i < wPropertyNameLength - 2; i += 2) {
+        uint8_t c = data[offset + 8 + i];
+        if (c >= 32 && c <= 126) {
+            name_chars++;
+        } else if (c == 0) {
+            break;
+        }
+    }
+    if (name_chars == 0) {
+        add(result, rule::msos20_reg_property_name_empty, offset + 8);
+    }
+
+    int data_offset = offset + 8 + wPropertyNameLength;
+    if (data_offset + 2 > length) {
+        add(result, rule::msos20_reg_property_data_length_overrun, data_offset);
+        return;
+    }
+    int wPropertyDataLength = le16(&data[data_offset]);
+    if (8 + wPropertyNameLength + 2 + wPropertyDataLength != wLength) {
+        add(result, rule::msos20_reg_property_length, offset);
+    }
+    if (data_offset + 2 + wPropertyDataLength > length) {
+        add(result, rule::msos20_reg_property_data_overrun, data_offset + 2);
+    }
+}
+
+} // namespace detail
+
+constexpr check_result check_bos(const uint8_t *data, int length) {
+    check_result result;
+
+    if (length < 5) {
+        detail::add(result, rule::bos_too_short, 0);
+        return result;
+    }
+    if (data[1] != 0x0F) {
+        detail::add(result, rule::bos_type, 1);
+    }
+    if (detail::le16(&data[2]) != length) {
+        detail::add(result, rule::bos_total_length, 2);
+    }
+
+    int offset = data[0];
+    for (int caps = 0; offset < length && caps < data[4]; caps++) {
+        if (offset + 3 > length) {
+            detail::add(result, rule::bos_cap_truncated, offset);
+            break;
+        }
+        int bLength = data[offset];
+
+        // Platform capabilities: 20-byte header, then the capability data
+        if (data[offset + 2] == 0x05 && offset + 20 <= length) {
+            int kind = detail::platform(&data[offset + 4]);
+            if (kind == 1 && bLength >= 24 && offset + 24 <= length && data[offset + 22] == 0) {
+                detail::add(result, rule::webusb_vendor_code_zero, offset + 22);
+            }
+            if (kind == 2 && bLength >= 28 && offset + 28 <= length) {
+                if (detail::le32(&data[offset + 20]) != 0x06030000) {
+                    detail::add(result, rule::msos20_cap_windows_version, offset + 20);
+                }
+                if (detail::le16(&data[offset + 24]) < 10) {
+                    detail::add(result, rule::msos20_cap_set_length, offset + 24);
+                }
+            }
+        }
+        offset += bLength;
+    }
+    return result;
+}
+
+constexpr check_result check_webusb_url(const uint8_t *data, int length) {
+    check_result result;
+    (void)data;
+    if (length < 3) {
+        detail::add(result, rule::url_too_short, 0);
+    }
+    return result;
+}
+
+constexpr check_result check_msos20(const uint8_t *data, int length) {
+    check_result result;
+
+    for (int offset = 0; offset < length; ) {
+        if (offset + 4 > length) {
+            detail::add(result, rule::msos20_truncated, offset);
+            break;
+        }
+        int wLength = detail::le16(&data[offset]);
+        int wDescriptorType = detail::le16(&data[offset + 2]);
+        if (wLength == 0) {
+            detail::add(result, rule::msos20_zero_length, offset);
+            break;
+        }
+        if (wLength < 4) {
+            detail::add(result, rule::msos20_bad_length, offset);
+            break;
+        }
+        if (offset + wLength > length) {
+            detail::add(result, rule::msos20_overrun, offset);
+            break;
+        }
+
+        switch (wDescriptorType) {
+            case 0x00:                          // Set header
+                if (wLength < 10) {
+                    detail::add(result, rule::msos20_set_header_short, offset);
+                    break;
+                }
+                if (detail::le16(&data[offset + 8]) != length) {
+                    detail::add(result, rule::msos20_total_length, offset + 8);
+                }
+                if (offset != 0) {
+                    detail::add(result, rule::msos20_set_header_offset, offset);
+                }
+                if (detail::le32(&data[offset + 4]) != 0x06030000) {
+                    detail::add(result, rule::msos20_windows_version, offset + 4);
+                }
+                break;
+            case 0x01:                          // Configuration subset header
+                if (wLength < 8) {
+                    detail::add(result, rule::msos20_config_short, offset);
+                    break;
+                }
+                if (data[offset + 5] != 0) {
+                    detail::add(result, rule::msos20_config_reserved, offset + 5);
+                }
+                if (offset + detail::le16(&data[offset + 6]) > length) {
+                    detail::add(result, rule::msos20_config_overrun, offset + 6);
+                }
+                break;
+            case 0x02:                          // Function subset header
+                if (wLength < 8) {
+                    detail::add(result, rule::msos20_function_short, offset);
+                    break;
+                }
+                if (data[offset + 5] != 0) {
+                    detail::add(result, rule::msos20_function_reserved, offset + 5);
+                }
+                if (offset + detail::le16(&data[offset + 6]) > length) {
+                    detail::add(result, rule::msos20_function_overrun, offset + 6);
+                }
+                if (detail::le16(&data[offset + 6]) < wLength) {
+                    detail::add(result, rule::msos20_function_underrun, offset + 6);
+                }
+                break;
+            case 0x03: {                        // Compatible ID
+                if (wLength < 20) {
+                    detail::add(result, rule::msos20_compat_id_short, offset);
+                    break;
+                }
+                const char winusb[] = "WINUSB";
+                bool is_winusb = true;
+                for (int i = 0; i < 6; i++) {
+                    is_winusb = is_winusb && data[offset + 4 + i] == uint8_t(winusb[i]);
+                }
+                if (!is_winusb) {
+                    detail::add(result, rule::msos20_compat_id_not_winusb, offset + 4);
+                }
+                if (data[offset + 4 + 6] != 0 || data[offset + 4 + 7] != 0) {
+                    detail::add(result, rule::msos20_compat_id_padding, offset + 4 + 6);
+                }
+                break;
+            }
+            case 0x04:                          // Registry property
+                if (wLength < 8) {
+                    detail::add(result, rule::msos20_reg_property_short, offset);
+                    break;
+                }
+                detail::check_reg_property(result, data, length, offset, wLength);
+                break;
+            default:
+                detail::add(result, rule::msos20_unknown_type, offset + 2);
+                break;
+        }
+        offset += wLength;
+    }
+    return result;
+}
+
+template <std::size_t N>
+constexpr check_result check_bos(const uint8_t (&data)[N]) {
+    return check_bos(data, int(N));
+}
+
+template <std::size_t N>
+constexpr check_result check_webusb_url(const uint8_t (&data)[N]) {
+    return check_webusb_url(data, int(N));
+}
+
+template <std::size_t N>
+constexpr check_result check_msos20(const uint8_t (&data)[N]) {
+    return check_msos20(data, int(N));
+}
+
+// The set length a BOS announces in its MS OS 2.0 capability, 0 if it has none
+constexpr int bos_msos20_set_length(const uint8_t *data, int length) {
+    int offset = length >= 5 ? data[0] : length;
+    for (int caps = 0; offset + 28 <= length && caps < data[4]; caps++) {
+        if (data[offset + 2] == 0x05 && data[offset] >= 28 && detail::platform(&data[offset + 4]) == 2) {
+            return detail::le16(&data[offset + 24]);
+        }
+        if (data[offset] == 0) {
+            break;
+        }
+        offset += data[offset];
+    }
+    return 0;
+}
+
+template <std::size_t N>
+constexpr int bos_msos20_set_length(const uint8_t (&data)[N]) {
+    return bos_msos20_set_length(data, int(N));
+}
+
+} // namespace usb_descriptor_checks
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * Compile-time tests for usb_descriptor_checks.hpp
+ *
+ * Nothing here runs: every check is a static_assert, so "make check-hpp"
+ * fails to compile if a rule stops firing on a known-bad descriptor or
+ * starts firing on a known-good one.
+ */
+
+#include "usb_descriptor_checks.hpp"
+
+namespace checks = usb_descriptor_checks;
+using checks::rule;
+
+namespace {
+
+// BOS with a WebUSB (vendor code 0x01) and an MS OS 2.0 (set length 30) platform capability
+constexpr uint8_t good_bos[] = {
+    0x05, 0x0F, 0x39, 0x00, 0x02,
+    0x18, 0x10, 0x05, 0x00,
+    0x38, 0xB6, 0x08, 0x34, 0xA9, 0x09, 0xA0, 0x47, 0x8B, 0xFD, 0xA0, 0x76, 0x88, 0x15, 0xB6, 0x65,
+    0x00, 0x01, 0x01, 0x01,
+    0x1C, 0x10, 0x05, 0x00,
+    0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C, 0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F,
+    0x00, 0x00, 0x03, 0x06, 0x1E, 0x00, 0x02, 0x00,
+};
+
+// Set header and a WINUSB Compatible ID
+constexpr uint8_t good_msos20[] = {
+    0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x06, 0x1E, 0x00,
+    0x14, 0x00, 0x03, 0x00, 'W', 'I', 'N', 'U', 'S', 'B', 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+constexpr uint8_t good_url[] = { 0x0E, 0x03, 0x01, 'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm' };
+
+static_assert(checks::check_bos(good_bos).clean(), "good BOS has findings");
+static_assert(checks::check_msos20(good_msos20).clean(), "good MS OS 2.0 set has findings");
+static_assert(checks::check_webusb_url(good_url).clean(), "good WebUSB URL has findings");
+static_assert(checks::bos_msos20_set_length(good_bos) == sizeof(good_msos20), "wrong announced set length");
+
+// wTotalLength one short, WebUSB vendor code 0
+constexpr uint8_t bad_bos[] = {
+    0x05, 0x0F, 0x1C, 0x00, 0x01,
+    0x18, 0x10, 0x05, 0x00,
+    0x38, 0xB6, 0x08, 0x34, 0xA9, 0x09, 0xA0, 0x47, 0x8B, 0xFD, 0xA0, 0x76, 0x88, 0x15, 0xB6, 0x65,
+    0x00, 0x01, 0x00, 0x01,
+};
+
+static_assert(checks::check_bos(bad_bos).ok(), "bad BOS has only warnings");
+static_assert(checks::check_bos(bad_bos).warnings == 2, "bad BOS warnings");
+static_assert(checks::check_bos(bad_bos).first_warning == rule::bos_total_length, "bad BOS first warning");
+static_assert(checks::check_bos(bad_bos).first_warning_offset == 2, "bad BOS first warning offset");
+static_assert(checks::bos_msos20_set_length(bad_bos) == 0, "bad BOS has no MS OS 2.0 capability");
+
+// Capability count promises a second capability that is cut off
+constexpr uint8_t truncated_bos[] = { 0x05, 0x0F, 0x07, 0x00, 0x01, 0x03, 0x10 };
+
+static_assert(!checks::check_bos(truncated_bos).ok(), "truncated BOS passes");
+static_assert(checks::check_bos(truncated_bos).first_error == rule::bos_cap_truncated, "truncated BOS error");
+static_assert(checks::check_bos(truncated_bos).first_error_offset == 5, "truncated BOS error offset");
+
+constexpr uint8_t short_bos[] = { 0x05, 0x0F, 0x05, 0x00 };
+
+static_assert(checks::check_bos(short_bos).first_error == rule::bos_too_short, "short BOS error");
+
+// Compatible ID overruns the set
+constexpr uint8_t overrun_msos20[] = {
+    0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x06, 0x14, 0x00,
+    0x14, 0x00, 0x03, 0x00, 'W', 'I', 'N', 'U', 'S', 'B',
+};
+
+static_assert(!checks::check_msos20(overrun_msos20).ok(), "overrunning MS OS 2.0 set passes");
+static_assert(checks::check_msos20(overrun_msos20).first_error == rule::msos20_overrun, "overrun error");
+static_assert(checks::check_msos20(overrun_msos20).first_error_offset == 10, "overrun error offset");
+
+// Not WINUSB, wTotalLength wrong, Windows version wrong: warnings only
+constexpr uint8_t odd_msos20[] = {
+    0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x06, 0x20, 0x00,
+    0x14, 0x00, 0x03, 0x00, 'L', 'I', 'B', 'U', 'S', 'B', 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static_assert(checks::check_msos20(odd_msos20).ok(), "odd MS OS 2.0 set has only warnings");
+static_assert(checks::check_msos20(odd_msos20).warnings == 3, "odd MS OS 2.0 set warnings");
+static_assert(checks::check_msos20(odd_msos20).first_warning == rule::msos20_total_length, "odd set first warning");
+
+constexpr uint8_t short_url[] = { 0x02, 0x03 };
+
+static_assert(checks::check_webusb_url(short_url).first_error == rule::url_too_short, "short URL error");
+
+} // namespace
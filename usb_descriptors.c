@@ -0,0 +1,1071 @@
+#include "usb_descriptors.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// usb_descriptor_checks.hpp mirrors these rules for compile-time checks; keep the two in step
+const struct rule_info descriptor_rules[RULE_COUNT] = {
+    [RULE_BOS_TOO_SHORT]              = { "bos-too-short", SEVERITY_ERROR,
+                                          "BOS descriptor too short (%d bytes, minimum 5)" },
+    [RULE_BOS_TYPE]                   = { "bos-type", SEVERITY_ERROR,
+                                          "Invalid BOS descriptor type" },
+    [RULE_BOS_TOTAL_LENGTH]           = { "bos-total-length", SEVERITY_WARNING,
+                                          "BOS total length mismatch (reported=%d, actual=%d)" },
+    [RULE_BOS_CAP_TRUNCATED]          = { "bos-cap-truncated", SEVERITY_ERROR,
+                                          "Truncated device capability at offset %d" },
+    [RULE_WEBUSB_VENDOR_CODE_ZERO]    = { "webusb-vendor-code-zero", SEVERITY_WARNING,
+                                          "WebUSB vendor code is 0 (invalid)" },
+    [RULE_MSOS20_CAP_WINDOWS_VERSION] = { "msos20-cap-windows-version", SEVERITY_WARNING,
+                                          "Unusual Windows version (expected 0x06030000)" },
+    [RULE_MSOS20_CAP_SET_LENGTH]      = { "msos20-cap-set-length", SEVERITY_ERROR,
+                                          "Descriptor set length %d is shorter than a Set Header (10)" },
+    [RULE_URL_TOO_SHORT]              = { "url-too-short", SEVERITY_ERROR,
+                                          "WebUSB URL descriptor too short" },
+    [RULE_MSOS20_TRUNCATED]           = { "msos20-truncated", SEVERITY_ERROR,
+                                          "Truncated descriptor at offset %d (need 4 bytes, have %d)" },
+    [RULE_MSOS20_ZERO_LENGTH]         = { "msos20-zero-length", SEVERITY_ERROR,
+                                          "Zero length descriptor at offset %d" },
+    [RULE_MSOS20_BAD_LENGTH]          = { "msos20-bad-length", SEVERITY_ERROR,
+                                          "Invalid descriptor length %d at offset %d (minimum is 4)" },
+    [RULE_MSOS20_OVERRUN]             = { "msos20-overrun", SEVERITY_ERROR,
+                                          "Descriptor extends beyond buffer (offset=%d, len=%d, buffer=%d)" },
+    [RULE_MSOS20_SET_HEADER_SHORT]    = { "msos20-set-header-short", SEVERITY_ERROR,
+                                          "Set Header too short (len=%d, expected=10)" },
+    [RULE_MSOS20_TOTAL_LENGTH]        = { "msos20-total-length", SEVERITY_WARNING,
+                                          "Total length mismatch (reported=%d, actual=%d)" },
+    [RULE_MSOS20_SET_HEADER_OFFSET]   = { "msos20-set-header-offset", SEVERITY_WARNING,
+                                          "Set Header not at beginning (offset=%d)" },
+    [RULE_MSOS20_WINDOWS_VERSION]     = { "msos20-windows-version", SEVERITY_WARNING,
+                                          "Unusual Windows version (expected=0x06030000 for Win 8.1)" },
+    [RULE_MSOS20_CONFIG_SHORT]        = { "msos20-config-short", SEVERITY_ERROR,
+                                          "Configuration Subset Header too short (len=%d, expected=8)" },
+    [RULE_MSOS20_CONFIG_RESERVED]     = { "msos20-config-reserved", SEVERITY_WARNING,
+                                          "Reserved field not zero (value=%d)" },
+    [RULE_MSOS20_CONFIG_OVERRUN]      = { "msos20-config-overrun", SEVERITY_ERROR,
+                                          "Configuration subset extends beyond buffer" },
+    [RULE_MSOS20_FUNCTION_SHORT]      = { "msos20-function-short", SEVERITY_ERROR,
+                                          "Function Subset Header too short (len=%d, expected=8)" },
+    [RULE_MSOS20_FUNCTION_RESERVED]   = { "msos20-function-reserved", SEVERITY_WARNING,
+                                          "Reserved field not zero (value=%d)" },
+    [RULE_MSOS20_FUNCTION_OVERRUN]    = { "msos20-function-overrun", SEVERITY_ERROR,
+                                          "Function subset extends beyond buffer" },
+    [RULE_MSOS20_FUNCTION_UNDERRUN]   = { "msos20-function-underrun", SEVERITY_ERROR,
+                                          "Function subset length smaller than header length" },
+    [RULE_MSOS20_COMPAT_ID_SHORT]     = { "msos20-compat-id-short", SEVERITY_ERROR,
+                                          "Compatible ID Feature too short (len=%d, expected=20)" },
+    [RULE_MSOS20_COMPAT_ID_NOT_WINUSB] = { "msos20-compat-id-not-winusb", SEVERITY_WARNING,
+                                          "Compatible ID is not 'WINUSB'" },
+    [RULE_MSOS20_COMPAT_ID_PADDING]   = { "msos20-compat-id-padding", SEVERITY_WARNING,
+                                          "Compatible ID not properly null-terminated" },
+    [RULE_MSOS20_REG_PROPERTY_SHORT]  = { "msos20-reg-property-short", SEVERITY_ERROR,
+                                          "Registry Property Feature too short (len=%d, minimum=8)" },
+    [RULE_MSOS20_REG_PROPERTY_TYPE]   = { "msos20-reg-property-type", SEVERITY_WARNING,
+                                          "Unusual property data type (1=REG_SZ, 7=REG_MULTI_SZ)" },
+    [RULE_MSOS20_REG_PROPERTY_NAME_LENGTH] = { "msos20-reg-property-name-length", SEVERITY_ERROR,
+                                          "Invalid property name length (must be even and >0)" },
+    [RULE_MSOS20_REG_PROPERTY_NAME_OVERRUN] = { "msos20-reg-property-name-overrun", SEVERITY_ERROR,
+                                          "Property name extends beyond descriptor" },
+    [RULE_MSOS20_REG_PROPERTY_NAME_EMPTY] = { "msos20-reg-property-name-empty", SEVERITY_WARNING,
+                                          "Empty property name" },
+    [RULE_MSOS20_REG_PROPERTY_DATA_LENGTH_OVERRUN] = { "msos20-reg-property-data-length-overrun", SEVERITY_ERROR,
+                                          "Property data length field beyond descriptor" },
+    [RULE_MSOS20_REG_PROPERTY_LENGTH] = { "msos20-reg-property-length", SEVERITY_ERROR,
+                                          "Length mismatch (calculated=%d, reported=%d)" },
+    [RULE_MSOS20_REG_PROPERTY_DATA_OVERRUN] = { "msos20-reg-property-data-overrun", SEVERITY_ERROR,
+                                          "Property data extends beyond descriptor" },
+    [RULE_MSOS20_UNKNOWN_TYPE]        = { "msos20-unknown-type", SEVERITY_ERROR,
+                                          "Unknown Descriptor Type 0x%04x (len=%d)" },
+    [RULE_FFS_TOO_SHORT]              = { "ffs-too-short", SEVERITY_ERROR,
+                                          "FunctionFS blob too short (%d bytes, minimum %d)" },
+    [RULE_FFS_MAGIC]                  = { "ffs-magic", SEVERITY_ERROR,
+                                          "Unknown FunctionFS magic %d" },
+    [RULE_FFS_LENGTH]                 = { "ffs-length", SEVERITY_ERROR,
+                                          "FunctionFS length mismatch (reported=%d, actual=%d)" },
+    [RULE_FFS_FLAGS]                  = { "ffs-flags", SEVERITY_ERROR,
+                                          "Unknown FunctionFS flags 0x%x" },
+    [RULE_FFS_NO_DESCRIPTORS]         = { "ffs-no-descriptors", SEVERITY_ERROR,
+                                          "No descriptors for any speed" },
+    [RULE_FFS_DESC_TRUNCATED]         = { "ffs-desc-truncated", SEVERITY_ERROR,
+                                          "Descriptor is truncated (bLength=%d, %d bytes left)" },
+    [RULE_FFS_DESC_RESERVED]          = { "ffs-desc-reserved", SEVERITY_ERROR,
+                                          "Descriptor type 0x%02x is reserved for the gadget" },
+    [RULE_FFS_DESC_UNSUPPORTED]       = { "ffs-desc-unsupported", SEVERITY_ERROR,
+                                          "Descriptor type 0x%02x is not accepted by FunctionFS" },
+    [RULE_FFS_DESC_LENGTH]            = { "ffs-desc-length", SEVERITY_ERROR,
+                                          "Descriptor type 0x%02x has invalid bLength %d" },
+    [RULE_FFS_TOO_MANY_ENDPOINTS]     = { "ffs-too-many-endpoints", SEVERITY_ERROR,
+                                          "More than %d endpoints" },
+    [RULE_FFS_INTERFACE_COUNT]        = { "ffs-interface-count", SEVERITY_ERROR,
+                                          "%d interfaces, but %d at the first speed" },
+    [RULE_FFS_ENDPOINT_COUNT]         = { "ffs-endpoint-count", SEVERITY_ERROR,
+                                          "%d endpoints, but %d at the first speed" },
+    [RULE_FFS_ENDPOINT_ADDRESS]       = { "ffs-endpoint-address", SEVERITY_ERROR,
+                                          "Endpoint %d has address 0x%02x here and 0x%02x at the first speed" },
+    [RULE_FFS_OS_HEADER_TRUNCATED]    = { "ffs-os-header-truncated", SEVERITY_ERROR,
+                                          "MS OS descriptor header is truncated" },
+    [RULE_FFS_OS_LENGTH]              = { "ffs-os-length", SEVERITY_ERROR,
+                                          "MS OS descriptor dwLength %d is invalid (%d bytes left)" },
+    [RULE_FFS_OS_VERSION_COMPAT]      = { "ffs-os-version-compat", SEVERITY_WARNING,
+                                          "MS OS descriptor bcdVersion is 0x0001 instead of 0x0100 (accepted)" },
+    [RULE_FFS_OS_VERSION]             = { "ffs-os-version", SEVERITY_ERROR,
+                                          "Unsupported MS OS descriptor bcdVersion 0x%04x" },
+    [RULE_FFS_OS_INDEX]               = { "ffs-os-index", SEVERITY_ERROR,
+                                          "Unknown MS OS descriptor wIndex %d (4=compat ID, 5=properties)" },
+    [RULE_FFS_OS_RESERVED]            = { "ffs-os-reserved", SEVERITY_ERROR,
+                                          "Extended compat ID header Reserved byte is %d, must be 0" },
+    [RULE_FFS_OS_INTERFACE]           = { "ffs-os-interface", SEVERITY_ERROR,
+                                          "MS OS descriptor for interface %d, but only %d interfaces exist" },
+    [RULE_FFS_COMPAT_TRUNCATED]       = { "ffs-compat-truncated", SEVERITY_ERROR,
+                                          "Extended compat ID function is truncated" },
+    [RULE_FFS_COMPAT_RESERVED1]       = { "ffs-compat-reserved1", SEVERITY_WARNING,
+                                          "Reserved1 is %d, must be 1 (the kernel forces it)" },
+    [RULE_FFS_COMPAT_RESERVED2]       = { "ffs-compat-reserved2", SEVERITY_ERROR,
+                                          "Reserved2 bytes are not zero" },
+    [RULE_FFS_PROP_TRUNCATED]         = { "ffs-prop-truncated", SEVERITY_ERROR,
+                                          "Extended property is truncated (dwSize=%d)" },
+    [RULE_FFS_PROP_TYPE]              = { "ffs-prop-type", SEVERITY_ERROR,
+                                          "Unsupported property data type %d (1 to 7)" },
+    [RULE_FFS_TRAILING]               = { "ffs-trailing", SEVERITY_ERROR,
+                                          "%d unexpected trailing bytes" },
+    [RULE_FFS_STRINGS_COUNTS]         = { "ffs-strings-counts", SEVERITY_ERROR,
+                                          "str_count %d and lang_count %d must both be zero or both non-zero" },
+    [RULE_FFS_STRINGS_LANGUAGE]       = { "ffs-strings-language", SEVERITY_ERROR,
+                                          "Language %d is truncated (%d bytes left)" },
+    [RULE_FFS_STRINGS_TRUNCATED]      = { "ffs-strings-truncated", SEVERITY_ERROR,
+                                          "String %d of language %d is not terminated" },
+    [RULE_FFS_STRINGS_COUNT]          = { "ffs-strings-count", SEVERITY_ERROR,
+                                          "Descriptors use string %d, but only %d strings are given" },
+};
+
+void uuid_to_string(const uint8_t *uuid, char *str) {
+    sprintf(str, "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+            uuid[3], uuid[2], uuid[1], uuid[0],  // Little-endian DWORD
+            uuid[5], uuid[4],                     // Little-endian WORD
+            uuid[7], uuid[6],                     // Little-endian WORD
+            uuid[8], uuid[9],                     // Big-endian bytes
+            uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+}
+
+static int stopped_at_error(const struct finding_list *list) {
+    return list->stop_at_error && list->error_count > 0;
+}
+
+static void add_finding(struct finding_list *list, enum descriptor_rule rule, int entry, int offset,
+                        int v0, int v1, int v2) {
+    if (stopped_at_error(list)) {
+        return;
+    }
+    if (descriptor_rules[rule].severity == SEVERITY_ERROR) {
+        list->error_count++;
+    } else {
+        list->warning_count++;
+    }
+
+    if (list->count >= FINDINGS_MAX) {
+        list->dropped++;
+        return;
+    }
+
+    struct finding *f = &list->items[list->count++];
+    f->rule = (uint16_t)rule;
+    f->entry = (uint16_t)entry;
+    f->offset = (uint32_t)offset;
+    f->value[0] = v0;
+    f->value[1] = v1;
+    f->value[2] = v2;
+}
+
+static void init_findings(struct finding_list *list, int flags) {
+    list->error_count = 0;
+    list->warning_count = 0;
+    list->count = 0;
+    list->dropped = 0;
+    list->stop_at_error = (flags & PARSE_STOP_AT_ERROR) != 0;
+}
+
+static void decode_webusb_capability(struct bos_view *view, struct bos_capability_view *cap, int index) {
+    const int plat_size = (int)sizeof(struct usb_plat_dev_cap_descriptor);
+    int offset = (int)cap->offset;
+
+    if (cap->bLength < plat_size + 4 || offset + plat_size + 4 > view->length) {
+        return;
+    }
+    cap->data_valid = 1;
+
+    const uint8_t *cap_data = view->data + offset + plat_size;
+    struct bos_summary *summary = &view->summary;
+    if (!summary->has_webusb) {
+        summary->has_webusb = 1;
+        summary->webusb_bcd_version = get_le16(&cap_data[0]);
+        summary->webusb_vendor_code = cap_data[2];
+        summary->webusb_landing_page = cap_data[3];
+    }
+
+    if (cap_data[2] == 0) {
+        add_finding(&view->findings, RULE_WEBUSB_VENDOR_CODE_ZERO, index, offset + plat_size + 2, 0, 0, 0);
+    }
+}
+
+static void decode_msos20_capability(struct bos_view *view, struct bos_capability_view *cap, int index) {
+    const int plat_size = (int)sizeof(struct usb_plat_dev_cap_descriptor);
+    int offset = (int)cap->offset;
+
+    if (cap->bLength < plat_size + 8 || offset + plat_size + 8 > view->length) {
+        return;
+    }
+    cap->data_valid = 1;
+
+    const uint8_t *cap_data = view->data + offset + plat_size;
+    struct bos_summary *summary = &view->summary;
+    if (!summary->has_msos20) {
+        summary->has_msos20 = 1;
+        summary->msos20_windows_version = get_le32(&cap_data[0]);
+        summary->msos20_set_length = get_le16(&cap_data[4]);
+        summary->msos20_vendor_code = cap_data[6];
+        summary->msos20_alt_enum_code = cap_data[7];
+    }
+
+    if (get_le32(cap_data) != 0x06030000) {
+        add_finding(&view->findings, RULE_MSOS20_CAP_WINDOWS_VERSION, index, offset + plat_size, 0, 0, 0);
+    }
+
+    if (get_le16(&cap_data[4]) < 10) {
+        add_finding(&view->findings, RULE_MSOS20_CAP_SET_LENGTH, index, offset + plat_size + 4,
+                    get_le16(&cap_data[4]), 0, 0);
+    }
+}
+
+/*
+ * Known platform capabilities. UUIDs are stored in wire order (the first
+ * three fields little-endian), so a descriptor's UUID bytes can be compared
+ * directly as two 64-bit words without any conversion.
+ */
+static const struct {
+    union {
+        uint8_t  bytes[16];
+        uint64_t words[2];
+    } uuid;
+    enum platform_capability kind;
+    void (*decode)(struct bos_view *view, struct bos_capability_view *cap, int index);
+} platform_capabilities[] = {
+    // {3408B638-09A9-47A0-8BFD-A0768815B665}
+    { { { 0x38, 0xb6, 0x08, 0x34, 0xa9, 0x09, 0xa0, 0x47,
+          0x8b, 0xfd, 0xa0, 0x76, 0x88, 0x15, 0xb6, 0x65 } },
+      PLATFORM_WEBUSB, decode_webusb_capability },
+    // {D8DD60DF-4589-4CC7-9CD2-659D9E648A9F}
+    { { { 0xdf, 0x60, 0xdd, 0xd8, 0x89, 0x45, 0xc7, 0x4c,
+          0x9c, 0xd2, 0x65, 0x9d, 0x9e, 0x64, 0x8a, 0x9f } },
+      PLATFORM_MSOS20, decode_msos20_capability },
+};
+
+#define PLATFORM_CAPABILITY_COUNT (int)(sizeof(platform_capabilities) / sizeof(platform_capabilities[0]))
+
+static int find_platform_capability(const uint8_t *uuid) {
+    uint64_t words[2];
+    memcpy(words, uuid, sizeof(words));
+
+    for (int i = 0; i < PLATFORM_CAPABILITY_COUNT; i++) {
+        if (platform_capabilities[i].uuid.words[0] == words[0] &&
+            platform_capabilities[i].uuid.words[1] == words[1]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+enum platform_capability lookup_platform_capability(const uint8_t *uuid) {
+    int i = find_platform_capability(uuid);
+    return i < 0 ? PLATFORM_UNKNOWN : platform_capabilities[i].kind;
+}
+
+int parse_bos_descriptor(struct bos_view *view, const uint8_t *data, int length, int flags) {
+    struct finding_list *findings = &view->findings;
+
+    view->data = data;
+    view->length = length;
+    view->header_valid = 0;
+    view->header = NULL;
+    view->cap_count = 0;
+    memset(&view->summary, 0, sizeof(view->summary));
+    init_findings(findings, flags);
+
+    if (length < 5) {
+        add_finding(findings, RULE_BOS_TOO_SHORT, FINDING_NO_ENTRY, 0, length, 0, 0);
+        return findings->error_count;
+    }
+
+    const struct usb_bos_descriptor *bos = (const struct usb_bos_descriptor *)data;
+    view->header_valid = 1;
+    view->header = bos;
+
+    if (bos->bDescriptorType != USB_DT_BOS) {
+        add_finding(findings, RULE_BOS_TYPE, FINDING_NO_ENTRY, 1, 0, 0, 0);
+    }
+
+    if (bos->wTotalLength != length) {
+        add_finding(findings, RULE_BOS_TOTAL_LENGTH, FINDING_NO_ENTRY, 2, bos->wTotalLength, length, 0);
+    }
+
+    int offset = bos->bLength;
+
+    while (offset < length && view->cap_count < bos->bNumDeviceCaps && !stopped_at_error(findings)) {
+        if (offset + 3 > length) {
+            add_finding(findings, RULE_BOS_CAP_TRUNCATED, FINDING_NO_ENTRY, offset, offset, 0, 0);
+            break;
+        }
+
+        int index = view->cap_count;
+        struct bos_capability_view *cap = &view->caps[index];
+        cap->offset = (uint32_t)offset;
+        cap->bLength = data[offset];
+        cap->bDescriptorType = data[offset + 1];
+        cap->bDevCapabilityType = data[offset + 2];
+        cap->platform = PLATFORM_NONE;
+        cap->data_valid = 0;
+
+        if (cap->bDevCapabilityType < 32) {
+            view->summary.capability_types |= 1u << cap->bDevCapabilityType;
+        }
+
+        if (cap->bDevCapabilityType == USB_PLAT_DEV_CAP_TYPE &&
+            offset + (int)sizeof(struct usb_plat_dev_cap_descriptor) <= length) {
+            const struct usb_plat_dev_cap_descriptor *plat_cap =
+                (const struct usb_plat_dev_cap_descriptor *)(data + offset);
+            int known = find_platform_capability(plat_cap->UUID);
+
+            if (known >= 0) {
+                cap->platform = (uint8_t)platform_capabilities[known].kind;
+                platform_capabilities[known].decode(view, cap, index);
+            } else {
+                cap->platform = PLATFORM_UNKNOWN;
+            }
+        }
+
+        if (cap->platform != PLATFORM_WEBUSB && cap->platform != PLATFORM_MSOS20) {
+            view->summary.other_count++;
+        }
+
+        view->cap_count++;
+        offset += cap->bLength;
+    }
+
+    return findings->error_count;
+}
+
+int parse_webusb_url_descriptor(struct webusb_url_view *view, const uint8_t *data, int length, int flags) {
+    view->data = data;
+    view->length = length;
+    view->header_valid = 0;
+    view->url_offset = 3;
+    view->url_length = 0;
+    init_findings(&view->findings, flags);
+
+    if (length < 3) {
+        add_finding(&view->findings, RULE_URL_TOO_SHORT, FINDING_NO_ENTRY, 0, length, 0, 0);
+        return view->findings.error_count;
+    }
+
+    view->header_valid = 1;
+    view->bLength = data[0];
+    view->bDescriptorType = data[1];
+    view->bScheme = data[2];
+
+    int end = length < view->bLength ? length : view->bLength;
+    if (end > 3) {
+        view->url_length = (uint16_t)(end - 3);
+    }
+
+    return view->findings.error_count;
+}
+
+/*
+ * Registry property checks shared by MS OS 2.0 registry property features
+ * and MS OS 1.0 extended properties, which differ only in field widths.
+ */
+struct reg_property {
+    int offset;             // Start of the feature or property
+    int total_length;       // wLength or dwSize
+    int name_offset;        // First byte of the property name
+    int name_length;        // wPropertyNameLength
+    int length_size;        // Width of the data length field: 2 in MS OS 2.0, 4 in MS OS 1.0
+    uint32_t data_length;   // Set once the data length field was found
+    uint8_t flags;          // MSOS20_ENTRY_* bits
+};
+
+static void check_reg_property(struct finding_list *findings, int index, const uint8_t *data, int limit,
+                               struct reg_property *property) {
+    int name_offset = property->name_offset;
+    int name_length = property->name_length;
+
+    // Validate name length (should be even for UTF-16LE and include null terminator)
+    if (name_length == 0 || name_length % 2 != 0) {
+        add_finding(findings, RULE_MSOS20_REG_PROPERTY_NAME_LENGTH, index, name_offset - 2, name_length, 0, 0);
+        return;
+    }
+    if (name_offset + name_length > limit) {
+        add_finding(findings, RULE_MSOS20_REG_PROPERTY_NAME_OVERRUN, index, name_offset, 0, 0, 0);
+        return;
+    }
+
+    property->flags |= MSOS20_ENTRY_NAME_VALID;
+
+    // Property name must contain at least one character before its terminator
+    int name_chars = 0;
+    for (int i = 0; i < name_length - 2; i += 2) {
+        uint8_t c = data[name_offset + i];
+        if (c >= 32 && c <= 126) { // Printable ASCII
+            name_chars++;
+        } else if (c == 0) {
+            break; // Null terminator found early
+        }
+    }
+    if (name_chars == 0) {
+        add_finding(findings, RULE_MSOS20_REG_PROPERTY_NAME_EMPTY, index, name_offset, 0, 0, 0);
+    }
+
+    // Parse property data length and data
+    int data_offset = name_offset + name_length;
+    if (data_offset + property->length_size > limit) {
+        add_finding(findings, RULE_MSOS20_REG_PROPERTY_DATA_LENGTH_OVERRUN, index, data_offset, 0, 0, 0);
+        return;
+    }
+
+    property->data_length = property->length_size == 2 ? get_le16(&data[data_offset]) : get_le32(&data[data_offset]);
+    property->flags |= MSOS20_ENTRY_DATA_LEN_VALID;
+
+    // Validate total size: fixed fields, name, data length field and data
+    long long expected_total = (long long)(name_offset - property->offset) + name_length + property->length_size +
+                               property->data_length;
+    if (expected_total != property->total_length) {
+        add_finding(findings, RULE_MSOS20_REG_PROPERTY_LENGTH, index, property->offset,
+                    expected_total > INT32_MAX ? INT32_MAX : (int)expected_total, property->total_length, 0);
+    }
+
+    if (data_offset + property->length_size + (long long)property->data_length > limit) {
+        add_finding(findings, RULE_MSOS20_REG_PROPERTY_DATA_OVERRUN, index, data_offset + property->length_size,
+                    0, 0, 0);
+    } else {
+        property->flags |= MSOS20_ENTRY_DATA_VALID;
+    }
+}
+
+// Compatible ID checks shared by MS OS 2.0 features and MS OS 1.0 function sections
+static void check_compatible_id(struct finding_list *findings, int index, const uint8_t *data, int offset) {
+    if (strncmp((const char *)&data[offset], "WINUSB", 6) != 0) {
+        add_finding(findings, RULE_MSOS20_COMPAT_ID_NOT_WINUSB, index, offset, 0, 0, 0);
+    }
+
+    // Check for proper null termination
+    if (data[offset + 6] != 0 || data[offset + 7] != 0) {
+        add_finding(findings, RULE_MSOS20_COMPAT_ID_PADDING, index, offset + 6, 0, 0, 0);
+    }
+}
+
+static void parse_msos20_reg_property(struct msos20_view *view, struct msos20_entry *entry, int index) {
+    struct finding_list *findings = &view->findings;
+    const uint8_t *data = view->data;
+    int offset = (int)entry->offset;
+
+    uint16_t wPropertyDataType = get_le16(&data[offset + 4]);
+    struct reg_property property = {
+        .offset = offset,
+        .total_length = entry->wLength,
+        .name_offset = offset + 8,
+        .name_length = get_le16(&data[offset + 6]),
+        .length_size = 2,
+    };
+    entry->name_length = (uint16_t)property.name_length;
+
+    // Validate property data type
+    if (wPropertyDataType != 1 && wPropertyDataType != 7) {
+        add_finding(findings, RULE_MSOS20_REG_PROPERTY_TYPE, index, offset + 4, wPropertyDataType, 0, 0);
+    }
+
+    check_reg_property(findings, index, data, view->length, &property);
+    entry->data_length = (uint16_t)property.data_length;
+    entry->flags |= property.flags;
+}
+
+int parse_msos20_descriptor(struct msos20_view *view, const uint8_t *data, int length, int flags) {
+    struct finding_list *findings = &view->findings;
+    struct msos20_entry overflow_entry;
+    int offset = 0;
+
+    view->data = data;
+    view->length = length;
+    view->entry_count = 0;
+    view->entries_dropped = 0;
+    init_findings(findings, flags);
+
+    while (offset < length && !stopped_at_error(findings)) {
+        // Check if we have enough bytes for basic header
+        if (offset + 4 > length) {
+            add_finding(findings, RULE_MSOS20_TRUNCATED, FINDING_NO_ENTRY, offset, offset, length - offset, 0);
+            break;
+        }
+
+        uint16_t wLength = get_le16(&data[offset]);
+        uint16_t wDescriptorType = get_le16(&data[offset + 2]);
+
+        // Validate basic length constraints
+        if (wLength == 0) {
+            add_finding(findings, RULE_MSOS20_ZERO_LENGTH, FINDING_NO_ENTRY, offset, offset, 0, 0);
+            break;
+        }
+
+        if (wLength < 4) {
+            add_finding(findings, RULE_MSOS20_BAD_LENGTH, FINDING_NO_ENTRY, offset, wLength, offset, 0);
+            break;
+        }
+
+        if (offset + wLength > length) {
+            add_finding(findings, RULE_MSOS20_OVERRUN, FINDING_NO_ENTRY, offset, offset, wLength, length);
+            break;
+        }
+
+        // Once the view is full, keep validating into a scratch entry
+        int index;
+        struct msos20_entry *entry;
+        if (view->entry_count < MSOS20_MAX_ENTRIES) {
+            index = view->entry_count++;
+            entry = &view->entries[index];
+        } else {
+            index = FINDING_NO_ENTRY;
+            entry = &overflow_entry;
+            view->entries_dropped++;
+        }
+        entry->offset = (uint32_t)offset;
+        entry->wLength = wLength;
+        entry->wDescriptorType = wDescriptorType;
+        entry->name_length = 0;
+        entry->data_length = 0;
+        entry->flags = 0;
+
+        switch (wDescriptorType) {
+            case MS_OS_20_SET_HEADER_DESCRIPTOR: {
+                if (wLength < 10) {
+                    add_finding(findings, RULE_MSOS20_SET_HEADER_SHORT, index, offset, wLength, 0, 0);
+                    break;
+                }
+                entry->flags |= MSOS20_ENTRY_VALID;
+
+                uint32_t dwWindowsVersion = get_le32(&data[offset + 4]);
+                uint16_t wTotalLength = get_le16(&data[offset + 8]);
+
+                // Validate total length matches actual length
+                if (wTotalLength != length) {
+                    add_finding(findings, RULE_MSOS20_TOTAL_LENGTH, index, offset + 8, wTotalLength, length, 0);
+                }
+
+                // Check if it's at the beginning
+                if (offset != 0) {
+                    add_finding(findings, RULE_MSOS20_SET_HEADER_OFFSET, index, offset, offset, 0, 0);
+                }
+
+                // Validate Windows version
+                if (dwWindowsVersion != 0x06030000) {
+                    add_finding(findings, RULE_MSOS20_WINDOWS_VERSION, index, offset + 4, 0, 0, 0);
+                }
+                break;
+            }
+            case MS_OS_20_SUBSET_HEADER_CONFIGURATION: {
+                if (wLength < 8) {
+                    add_finding(findings, RULE_MSOS20_CONFIG_SHORT, index, offset, wLength, 0, 0);
+                    break;
+                }
+                entry->flags |= MSOS20_ENTRY_VALID;
+
+                uint8_t bReserved = data[offset + 5];
+                uint16_t wTotalLength = get_le16(&data[offset + 6]);
+
+                if (bReserved != 0) {
+                    add_finding(findings, RULE_MSOS20_CONFIG_RESERVED, index, offset + 5, bReserved, 0, 0);
+                }
+
+                // Validate subset length doesn't exceed remaining buffer
+                if (offset + wTotalLength > length) {
+                    add_finding(findings, RULE_MSOS20_CONFIG_OVERRUN, index, offset + 6, 0, 0, 0);
+                }
+                break;
+            }
+            case MS_OS_20_SUBSET_HEADER_FUNCTION: {
+                if (wLength < 8) {
+                    add_finding(findings, RULE_MSOS20_FUNCTION_SHORT, index, offset, wLength, 0, 0);
+                    break;
+                }
+                entry->flags |= MSOS20_ENTRY_VALID;
+
+                uint8_t bReserved = data[offset + 5];
+                uint16_t wSubsetLength = get_le16(&data[offset + 6]);
+
+                if (bReserved != 0) {
+                    add_finding(findings, RULE_MSOS20_FUNCTION_RESERVED, index, offset + 5, bReserved, 0, 0);
+                }
+
+                // Validate subset length
+                if (offset + wSubsetLength > length) {
+                    add_finding(findings, RULE_MSOS20_FUNCTION_OVERRUN, index, offset + 6, 0, 0, 0);
+                }
+
+                if (wSubsetLength < wLength) {
+                    add_finding(findings, RULE_MSOS20_FUNCTION_UNDERRUN, index, offset + 6, 0, 0, 0);
+                }
+                break;
+            }
+            case MS_OS_20_FEATURE_COMPATIBLE_ID: {
+                if (wLength < 20) {
+                    add_finding(findings, RULE_MSOS20_COMPAT_ID_SHORT, index, offset, wLength, 0, 0);
+                    break;
+                }
+                entry->flags |= MSOS20_ENTRY_VALID;
+
+                check_compatible_id(findings, index, data, offset + 4);
+                break;
+            }
+            case MS_OS_20_FEATURE_REG_PROPERTY: {
+                if (wLength < 8) {
+                    add_finding(findings, RULE_MSOS20_REG_PROPERTY_SHORT, index, offset, wLength, 0, 0);
+                    break;
+                }
+                entry->flags |= MSOS20_ENTRY_VALID;
+                parse_msos20_reg_property(view, entry, index);
+                break;
+            }
+            default:
+                add_finding(findings, RULE_MSOS20_UNKNOWN_TYPE, index, offset + 2, wDescriptorType, wLength, 0);
+                break;
+        }
+
+        offset += wLength;
+    }
+
+    return findings->error_count;
+}
+
+/*
+ * FunctionFS descriptor and strings blobs, checked in the order f_fs.c
+ * checks them when they are written to ep0.
+ */
+
+#define FFS_OS_HEADER_SIZE      11      // interface, dwLength, bcdVersion, wIndex, wCount
+#define FFS_EXT_COMPAT_SIZE     24
+#define FFS_EXT_PROP_SIZE       10      // dwSize, dwPropertyDataType, wPropertyNameLength
+
+// Counts of one speed's descriptors, compared against the first speed afterwards
+struct ffs_speed_state {
+    int interface_count;
+    int endpoint_count;
+    int interface_class;    // bInterfaceClass of the last interface, selects the 0x21 descriptor size
+    int record;             // First speed with descriptors: record endpoint addresses
+};
+
+static void ffs_need_string(struct ffs_view *view, uint8_t index) {
+    if (index > view->strings_needed) {
+        view->strings_needed = index;
+    }
+}
+
+// Returns the descriptor length, or -1 if the rest of the blob cannot be walked
+static int parse_ffs_descriptor(struct ffs_view *view, struct ffs_speed_state *speed, int offset) {
+    struct finding_list *findings = &view->findings;
+    const uint8_t *data = view->data;
+    int remaining = view->length - offset;
+
+    if (remaining < 2 || data[offset] < 2 || data[offset] > remaining) {
+        add_finding(findings, RULE_FFS_DESC_TRUNCATED, FINDING_NO_ENTRY, offset, remaining > 0 ? data[offset] : 0,
+                    remaining, 0);
+        return -1;
+    }
+
+    int bLength = data[offset];
+    uint8_t bDescriptorType = data[offset + 1];
+    int length_ok;
+
+    switch (bDescriptorType) {
+        case USB_DT_DEVICE:
+        case USB_DT_CONFIG:
+        case USB_DT_STRING:
+        case USB_DT_DEVICE_QUALIFIER:
+        case USB_DT_OTHER_SPEED_CONFIG:
+            add_finding(findings, RULE_FFS_DESC_RESERVED, FINDING_NO_ENTRY, offset, bDescriptorType, 0, 0);
+            return bLength;
+        case USB_DT_INTERFACE:
+            length_ok = bLength == 9;
+            if (length_ok) {
+                if (data[offset + 2] + 1 > speed->interface_count) {
+                    speed->interface_count = data[offset + 2] + 1;
+                }
+                speed->interface_class = data[offset + 5];
+                ffs_need_string(view, data[offset + 8]);
+            }
+            break;
+        case USB_DT_ENDPOINT:
+            length_ok = bLength == 7 || bLength == 9; // 9 for audio endpoints
+            if (!length_ok) {
+                break;
+            }
+            if (speed->endpoint_count == FFS_MAX_ENDPOINTS) {
+                add_finding(findings, RULE_FFS_TOO_MANY_ENDPOINTS, FINDING_NO_ENTRY, offset, FFS_MAX_ENDPOINTS, 0, 0);
+                return -1;
+            }
+            if (speed->record) {
+                view->endpoint_addresses[speed->endpoint_count] = data[offset + 2];
+            } else if (speed->endpoint_count < view->endpoint_count &&
+                       view->endpoint_addresses[speed->endpoint_count] != data[offset + 2]) {
+                add_finding(findings, RULE_FFS_ENDPOINT_ADDRESS, FINDING_NO_ENTRY, offset + 2,
+                            speed->endpoint_count + 1, data[offset + 2],
+                            view->endpoint_addresses[speed->endpoint_count]);
+            }
+            speed->endpoint_count++;
+            break;
+        case USB_DT_OTG:
+            length_ok = bLength == 3 || bLength == 5;
+            break;
+        case USB_DT_INTERFACE_ASSOCIATION:
+            length_ok = bLength == 8;
+            if (length_ok) {
+                ffs_need_string(view, data[offset + 7]);
+            }
+            break;
+        case USB_DT_HID:
+            if (speed->interface_class == USB_CLASS_HID) {
+                length_ok = bLength == 9;
+            } else if (speed->interface_class == USB_CLASS_CSCID) {
+                length_ok = bLength == 54;
+            } else {
+                add_finding(findings, RULE_FFS_DESC_UNSUPPORTED, FINDING_NO_ENTRY, offset, bDescriptorType, 0, 0);
+                return bLength;
+            }
+            break;
+        case USB_DT_SS_ENDPOINT_COMP:
+            length_ok = bLength == 6;
+            break;
+        default:
+            add_finding(findings, RULE_FFS_DESC_UNSUPPORTED, FINDING_NO_ENTRY, offset, bDescriptorType, 0, 0);
+            return bLength;
+    }
+
+    if (!length_ok) {
+        add_finding(findings, RULE_FFS_DESC_LENGTH, FINDING_NO_ENTRY, offset, bDescriptorType, bLength, 0);
+    }
+    return bLength;
+}
+
+// Returns the offset after the extended compat ID section
+static int parse_ffs_ext_compat(struct ffs_view *view, int offset, int end, int count) {
+    struct finding_list *findings = &view->findings;
+    const uint8_t *data = view->data;
+
+    for (int i = 0; i < count; i++) {
+        if (end - offset < FFS_EXT_COMPAT_SIZE) {
+            add_finding(findings, RULE_FFS_COMPAT_TRUNCATED, FINDING_NO_ENTRY, offset, 0, 0, 0);
+            return end;
+        }
+        view->compat_count++;
+
+        if (data[offset] >= view->interface_count) {
+            add_finding(findings, RULE_FFS_OS_INTERFACE, FINDING_NO_ENTRY, offset, data[offset],
+                        view->interface_count, 0);
+        }
+        if (data[offset + 1] != 1) {
+            add_finding(findings, RULE_FFS_COMPAT_RESERVED1, FINDING_NO_ENTRY, offset + 1, data[offset + 1], 0, 0);
+        }
+        check_compatible_id(findings, FINDING_NO_ENTRY, data, offset + 2);
+        for (int j = 18; j < FFS_EXT_COMPAT_SIZE; j++) {
+            if (data[offset + j] != 0) {
+                add_finding(findings, RULE_FFS_COMPAT_RESERVED2, FINDING_NO_ENTRY, offset + 18, 0, 0, 0);
+                break;
+            }
+        }
+        offset += FFS_EXT_COMPAT_SIZE;
+    }
+    return offset;
+}
+
+// Returns the offset after the extended properties section
+static int parse_ffs_ext_props(struct ffs_view *view, int offset, int end, int count) {
+    struct finding_list *findings = &view->findings;
+    const uint8_t *data = view->data;
+
+    for (int i = 0; i < count; i++) {
+        uint32_t dwSize = end - offset >= 4 ? get_le32(&data[offset]) : 0;
+        if (dwSize < FFS_EXT_PROP_SIZE || dwSize > (uint32_t)(end - offset)) {
+            add_finding(findings, RULE_FFS_PROP_TRUNCATED, FINDING_NO_ENTRY, offset,
+                        dwSize > INT32_MAX ? INT32_MAX : (int)dwSize, 0, 0);
+            return end;
+        }
+        view->property_count++;
+
+        uint32_t dwPropertyDataType = get_le32(&data[offset + 4]);
+        if (dwPropertyDataType < 1 || dwPropertyDataType > 7) {
+            add_finding(findings, RULE_FFS_PROP_TYPE, FINDING_NO_ENTRY, offset + 4,
+                        dwPropertyDataType > INT32_MAX ? INT32_MAX : (int)dwPropertyDataType, 0, 0);
+        } else if (dwPropertyDataType != 1 && dwPropertyDataType != 7) {
+            add_finding(findings, RULE_MSOS20_REG_PROPERTY_TYPE, FINDING_NO_ENTRY, offset + 4,
+                        (int)dwPropertyDataType, 0, 0);
+        }
+
+        struct reg_property property = {
+            .offset = offset,
+            .total_length = (int)dwSize,
+            .name_offset = offset + FFS_EXT_PROP_SIZE,
+            .name_length = get_le16(&data[offset + 8]),
+            .length_size = 4,
+        };
+        check_reg_property(findings, FINDING_NO_ENTRY, data, offset + (int)dwSize, &property);
+        offset += (int)dwSize;
+    }
+    return offset;
+}
+
+// Returns the offset after the section, or -1 if the rest of the blob cannot be walked
+static int parse_ffs_os_section(struct ffs_view *view, int offset) {
+    struct finding_list *findings = &view->findings;
+    const uint8_t *data = view->data;
+    int remaining = view->length - offset;
+
+    if (remaining < FFS_OS_HEADER_SIZE) {
+        add_finding(findings, RULE_FFS_OS_HEADER_TRUNCATED, FINDING_NO_ENTRY, offset, 0, 0, 0);
+        return -1;
+    }
+
+    uint8_t interface = data[offset];
+    uint32_t dwLength = get_le32(&data[offset + 1]);
+    uint16_t bcdVersion = get_le16(&data[offset + 5]);
+    uint16_t wIndex = get_le16(&data[offset + 7]);
+
+    if (dwLength < FFS_OS_HEADER_SIZE || dwLength > (uint32_t)remaining) {
+        add_finding(findings, RULE_FFS_OS_LENGTH, FINDING_NO_ENTRY, offset + 1,
+                    dwLength > INT32_MAX ? INT32_MAX : (int)dwLength, remaining, 0);
+        return -1;
+    }
+
+    // Early userspace wrote 0x0001; the kernel still accepts it
+    if (bcdVersion == 0x0001) {
+        add_finding(findings, RULE_FFS_OS_VERSION_COMPAT, FINDING_NO_ENTRY, offset + 5, 0, 0, 0);
+    } else if (bcdVersion != 0x0100) {
+        add_finding(findings, RULE_FFS_OS_VERSION, FINDING_NO_ENTRY, offset + 5, bcdVersion, 0, 0);
+    }
+
+    int end = offset + (int)dwLength;
+    int next;
+    if (wIndex == 4) {
+        uint8_t bCount = data[offset + 9];
+        uint8_t reserved = data[offset + 10];
+        if (reserved != 0) {
+            add_finding(findings, RULE_FFS_OS_RESERVED, FINDING_NO_ENTRY, offset + 10, reserved, 0, 0);
+        }
+        next = parse_ffs_ext_compat(view, offset + FFS_OS_HEADER_SIZE, end, bCount);
+    } else if (wIndex == 5) {
+        if (interface >= view->interface_count) {
+            add_finding(findings, RULE_FFS_OS_INTERFACE, FINDING_NO_ENTRY, offset, interface,
+                        view->interface_count, 0);
+        }
+        next = parse_ffs_ext_props(view, offset + FFS_OS_HEADER_SIZE, end, get_le16(&data[offset + 9]));
+    } else {
+        add_finding(findings, RULE_FFS_OS_INDEX, FINDING_NO_ENTRY, offset + 7, wIndex, 0, 0);
+        next = end;
+    }
+
+    if (next < end) {
+        add_finding(findings, RULE_FFS_TRAILING, FINDING_NO_ENTRY, next, end - next, 0, 0);
+    }
+    return end;
+}
+
+int parse_ffs_descriptors(struct ffs_view *view, const uint8_t *data, int length) {
+    struct finding_list *findings = &view->findings;
+
+    view->data = data;
+    view->length = length;
+    view->header_valid = 0;
+    view->magic = 0;
+    view->flags = 0;
+    view->os_count = 0;
+    view->interface_count = 0;
+    view->endpoint_count = 0;
+    view->strings_needed = 0;
+    view->compat_count = 0;
+    view->property_count = 0;
+    memset(view->counts, 0, sizeof(view->counts));
+    init_findings(findings, 0);
+
+    if (length < 12) {
+        add_finding(findings, RULE_FFS_TOO_SHORT, FINDING_NO_ENTRY, 0, length, 12, 0);
+        return findings->error_count;
+    }
+
+    view->magic = get_le32(&data[0]);
+    uint32_t reported = get_le32(&data[4]);
+    if (reported != (uint32_t)length) {
+        add_finding(findings, RULE_FFS_LENGTH, FINDING_NO_ENTRY, 4,
+                    reported > INT32_MAX ? INT32_MAX : (int)reported, length, 0);
+    }
+
+    int offset;
+    if (view->magic == FFS_DESCRIPTORS_MAGIC_V2) {
+        view->flags = get_le32(&data[8]);
+        offset = 12;
+        uint32_t known = FFS_HAS_FS_DESC | FFS_HAS_HS_DESC | FFS_HAS_SS_DESC | FFS_HAS_MS_OS_DESC |
+                         FFS_VIRTUAL_ADDR | FFS_EVENTFD | FFS_ALL_CTRL_RECIP | FFS_CONFIG0_SETUP;
+        if (view->flags & ~known) {
+            add_finding(findings, RULE_FFS_FLAGS, FINDING_NO_ENTRY, 8, (int)(view->flags & ~known), 0, 0);
+            return findings->error_count;
+        }
+        if (view->flags & FFS_EVENTFD) {
+            offset += 4;
+        }
+    } else if (view->magic == FFS_DESCRIPTORS_MAGIC) {
+        view->flags = FFS_HAS_FS_DESC | FFS_HAS_HS_DESC;
+        offset = 8;
+    } else {
+        add_finding(findings, RULE_FFS_MAGIC, FINDING_NO_ENTRY, 0,
+                    view->magic > INT32_MAX ? INT32_MAX : (int)view->magic, 0, 0);
+        return findings->error_count;
+    }
+
+    // Counts follow in flag order; speeds without their flag have none
+    uint32_t header_flags[FFS_SPEED_COUNT + 1] = { FFS_HAS_FS_DESC, FFS_HAS_HS_DESC, FFS_HAS_SS_DESC,
+                                                   FFS_HAS_MS_OS_DESC };
+    for (int i = 0; i <= FFS_SPEED_COUNT; i++) {
+        if (!(view->flags & header_flags[i])) {
+            continue;
+        }
+        if (offset + 4 > length) {
+            add_finding(findings, RULE_FFS_TOO_SHORT, FINDING_NO_ENTRY, 0, length, offset + 4, 0);
+            return findings->error_count;
+        }
+        if (i < FFS_SPEED_COUNT) {
+            view->counts[i] = get_le32(&data[offset]);
+        } else {
+            view->os_count = get_le32(&data[offset]);
+        }
+        offset += 4;
+    }
+    view->header_valid = 1;
+
+    if (view->counts[FFS_FULL_SPEED] + view->counts[FFS_HIGH_SPEED] + view->counts[FFS_SUPER_SPEED] == 0 &&
+        view->os_count == 0) {
+        add_finding(findings, RULE_FFS_NO_DESCRIPTORS, FINDING_NO_ENTRY, 0, 0, 0, 0);
+    }
+
+    for (int i = 0; i < FFS_SPEED_COUNT; i++) {
+        if (view->counts[i] == 0) {
+            continue;
+        }
+
+        int start = offset;
+        struct ffs_speed_state speed = {
+            .record = view->interface_count == 0 && view->endpoint_count == 0,
+        };
+        for (uint32_t n = 0; n < view->counts[i]; n++) {
+            int consumed = parse_ffs_descriptor(view, &speed, offset);
+            if (consumed < 0) {
+                return findings->error_count;
+            }
+            offset += consumed;
+        }
+
+        if (speed.record) {
+            view->interface_count = speed.interface_count;
+            view->endpoint_count = speed.endpoint_count;
+            continue;
+        }
+        if (speed.interface_count != view->interface_count) {
+            add_finding(findings, RULE_FFS_INTERFACE_COUNT, FINDING_NO_ENTRY, start, speed.interface_count,
+                        view->interface_count, 0);
+        }
+        if (speed.endpoint_count != view->endpoint_count) {
+            add_finding(findings, RULE_FFS_ENDPOINT_COUNT, FINDING_NO_ENTRY, start, speed.endpoint_count,
+                        view->endpoint_count, 0);
+        }
+    }
+
+    for (uint32_t n = 0; n < view->os_count; n++) {
+        offset = parse_ffs_os_section(view, offset);
+        if (offset < 0) {
+            return findings->error_count;
+        }
+    }
+
+    if (offset < length) {
+        add_finding(findings, RULE_FFS_TRAILING, FINDING_NO_ENTRY, offset, length - offset, 0, 0);
+    }
+
+    return findings->error_count;
+}
+
+int parse_ffs_strings(struct ffs_strings_view *view, const uint8_t *data, int length) {
+    struct finding_list *findings = &view->findings;
+
+    view->data = data;
+    view->length = length;
+    view->header_valid = 0;
+    view->str_count = 0;
+    view->lang_count = 0;
+    init_findings(findings, 0);
+
+    if (length < 16) {
+        add_finding(findings, RULE_FFS_TOO_SHORT, FINDING_NO_ENTRY, 0, length, 16, 0);
+        return findings->error_count;
+    }
+
+    uint32_t magic = get_le32(&data[0]);
+    if (magic != FFS_STRINGS_MAGIC) {
+        add_finding(findings, RULE_FFS_MAGIC, FINDING_NO_ENTRY, 0, magic > INT32_MAX ? INT32_MAX : (int)magic, 0, 0);
+        return findings->error_count;
+    }
+
+    uint32_t reported = get_le32(&data[4]);
+    if (reported != (uint32_t)length) {
+        add_finding(findings, RULE_FFS_LENGTH, FINDING_NO_ENTRY, 4,
+                    reported > INT32_MAX ? INT32_MAX : (int)reported, length, 0);
+    }
+
+    view->str_count = get_le32(&data[8]);
+    view->lang_count = get_le32(&data[12]);
+    view->header_valid = 1;
+
+    if ((view->str_count == 0) != (view->lang_count == 0)) {
+        add_finding(findings, RULE_FFS_STRINGS_COUNTS, FINDING_NO_ENTRY, 8,
+                    view->str_count > INT32_MAX ? INT32_MAX : (int)view->str_count,
+                    view->lang_count > INT32_MAX ? INT32_MAX : (int)view->lang_count, 0);
+        return findings->error_count;
+    }
+
+    // Each language: wLANGID, then str_count NUL-terminated UTF-8 strings
+    int offset = 16;
+    for (uint32_t lang = 0; lang < view->lang_count && view->str_count > 0; lang++) {
+        if (length - offset < 3) {
+            add_finding(findings, RULE_FFS_STRINGS_LANGUAGE, FINDING_NO_ENTRY, offset, (int)lang + 1,
+                        length - offset, 0);
+            return findings->error_count;
+        }
+        offset += 2;
+
+        for (uint32_t str = 0; str < view->str_count; str++) {
+            const uint8_t *end = memchr(&data[offset], 0, (size_t)(length - offset));
+            if (!end) {
+                add_finding(findings, RULE_FFS_STRINGS_TRUNCATED, FINDING_NO_ENTRY, offset, (int)str + 1,
+                            (int)lang + 1, 0);
+                return findings->error_count;
+            }
+            offset = (int)(end - data) + 1;
+        }
+    }
+
+    if (offset < length) {
+        add_finding(findings, RULE_FFS_TRAILING, FINDING_NO_ENTRY, offset, length - offset, 0, 0);
+    }
+
+    return findings->error_count;
+}
+
+int check_ffs_string_count(struct ffs_strings_view *strings, const struct ffs_view *descriptors) {
+    if (strings->header_valid && (uint32_t)descriptors->strings_needed > strings->str_count) {
+        add_finding(&strings->findings, RULE_FFS_STRINGS_COUNT, FINDING_NO_ENTRY, 8, descriptors->strings_needed,
+                    (int)strings->str_count, 0);
+        return -1;
+    }
+    return 0;
+}
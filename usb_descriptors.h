@@ -0,0 +1,366 @@
+#ifndef USB_DESCRIPTORS_H
+#define USB_DESCRIPTORS_H
+
+#include <stdint.h>
+
+#define MS_OS_20_SET_HEADER_DESCRIPTOR          0x00
+#define MS_OS_20_SUBSET_HEADER_CONFIGURATION    0x01
+#define MS_OS_20_SUBSET_HEADER_FUNCTION         0x02
+#define MS_OS_20_FEATURE_COMPATIBLE_ID          0x03
+#define MS_OS_20_FEATURE_REG_PROPERTY           0x04
+
+// Standard Descriptor Types
+#define USB_DT_DEVICE                           0x01
+#define USB_DT_CONFIG                           0x02
+#define USB_DT_STRING                           0x03
+#define USB_DT_INTERFACE                        0x04
+#define USB_DT_ENDPOINT                         0x05
+#define USB_DT_DEVICE_QUALIFIER                 0x06
+#define USB_DT_OTHER_SPEED_CONFIG               0x07
+#define USB_DT_OTG                              0x09
+#define USB_DT_INTERFACE_ASSOCIATION            0x0B
+#define USB_DT_HID                              0x21    // Also the CCID class descriptor
+#define USB_DT_SS_ENDPOINT_COMP                 0x30
+#define USB_DT_DEVICE_SIZE                      18
+#define USB_DT_CONFIG_SIZE                      9
+
+// Interface classes with a class descriptor of type 0x21
+#define USB_CLASS_HID                           0x03
+#define USB_CLASS_CSCID                         0x0B
+
+// BOS Descriptor Types
+#define USB_DT_BOS                              0x0F
+#define USB_DT_DEVICE_CAPABILITY                0x10
+
+// Device Capability Types
+#define USB_PLAT_DEV_CAP_TYPE                   0x05
+
+// WebUSB Constants
+#define WEBUSB_GET_URL                          2
+#define WEBUSB_URL_DESCRIPTOR_TYPE              3
+#define WEBUSB_URL_SCHEME_HTTP                  0
+#define WEBUSB_URL_SCHEME_HTTPS                 1
+#define WEBUSB_URL_SCHEME_NONE                  255
+
+#define USB_DT_BOS_SIZE                         5
+
+// BOS descriptor structure
+struct usb_bos_descriptor {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint16_t wTotalLength;
+    uint8_t  bNumDeviceCaps;
+} __attribute__((packed));
+
+// Platform capability descriptor structure
+struct usb_plat_dev_cap_descriptor {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDevCapabilityType;
+    uint8_t  bReserved;
+    uint8_t  UUID[16];
+    uint8_t  CapabilityData[];
+} __attribute__((packed));
+
+static inline uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void uuid_to_string(const uint8_t *uuid, char *str);
+
+/*
+ * Findings
+ *
+ * The parsers never print. Every problem they detect is recorded as a
+ * finding: a rule, the buffer offset it refers to, and up to three values
+ * used to format its message. The rule table gives each rule a stable ID,
+ * a severity and a printf-style message.
+ */
+
+enum finding_severity {
+    SEVERITY_WARNING = 1,
+    SEVERITY_ERROR   = 2,
+};
+
+enum descriptor_rule {
+    RULE_BOS_TOO_SHORT,
+    RULE_BOS_TYPE,
+    RULE_BOS_TOTAL_LENGTH,
+    RULE_BOS_CAP_TRUNCATED,
+    RULE_WEBUSB_VENDOR_CODE_ZERO,
+    RULE_MSOS20_CAP_WINDOWS_VERSION,
+    RULE_MSOS20_CAP_SET_LENGTH,
+    RULE_URL_TOO_SHORT,
+    RULE_MSOS20_TRUNCATED,
+    RULE_MSOS20_ZERO_LENGTH,
+    RULE_MSOS20_BAD_LENGTH,
+    RULE_MSOS20_OVERRUN,
+    RULE_MSOS20_SET_HEADER_SHORT,
+    RULE_MSOS20_TOTAL_LENGTH,
+    RULE_MSOS20_SET_HEADER_OFFSET,
+    RULE_MSOS20_WINDOWS_VERSION,
+    RULE_MSOS20_CONFIG_SHORT,
+    RULE_MSOS20_CONFIG_RESERVED,
+    RULE_MSOS20_CONFIG_OVERRUN,
+    RULE_MSOS20_FUNCTION_SHORT,
+    RULE_MSOS20_FUNCTION_RESERVED,
+    RULE_MSOS20_FUNCTION_OVERRUN,
+    RULE_MSOS20_FUNCTION_UNDERRUN,
+    RULE_MSOS20_COMPAT_ID_SHORT,
+    RULE_MSOS20_COMPAT_ID_NOT_WINUSB,
+    RULE_MSOS20_COMPAT_ID_PADDING,
+    RULE_MSOS20_REG_PROPERTY_SHORT,
+    RULE_MSOS20_REG_PROPERTY_TYPE,
+    RULE_MSOS20_REG_PROPERTY_NAME_LENGTH,
+    RULE_MSOS20_REG_PROPERTY_NAME_OVERRUN,
+    RULE_MSOS20_REG_PROPERTY_NAME_EMPTY,
+    RULE_MSOS20_REG_PROPERTY_DATA_LENGTH_OVERRUN,
+    RULE_MSOS20_REG_PROPERTY_LENGTH,
+    RULE_MSOS20_REG_PROPERTY_DATA_OVERRUN,
+    RULE_MSOS20_UNKNOWN_TYPE,
+    RULE_FFS_TOO_SHORT,
+    RULE_FFS_MAGIC,
+    RULE_FFS_LENGTH,
+    RULE_FFS_FLAGS,
+    RULE_FFS_NO_DESCRIPTORS,
+    RULE_FFS_DESC_TRUNCATED,
+    RULE_FFS_DESC_RESERVED,
+    RULE_FFS_DESC_UNSUPPORTED,
+    RULE_FFS_DESC_LENGTH,
+    RULE_FFS_TOO_MANY_ENDPOINTS,
+    RULE_FFS_INTERFACE_COUNT,
+    RULE_FFS_ENDPOINT_COUNT,
+    RULE_FFS_ENDPOINT_ADDRESS,
+    RULE_FFS_OS_HEADER_TRUNCATED,
+    RULE_FFS_OS_LENGTH,
+    RULE_FFS_OS_VERSION_COMPAT,
+    RULE_FFS_OS_VERSION,
+    RULE_FFS_OS_INDEX,
+    RULE_FFS_OS_RESERVED,
+    RULE_FFS_OS_INTERFACE,
+    RULE_FFS_COMPAT_TRUNCATED,
+    RULE_FFS_COMPAT_RESERVED1,
+    RULE_FFS_COMPAT_RESERVED2,
+    RULE_FFS_PROP_TRUNCATED,
+    RULE_FFS_PROP_TYPE,
+    RULE_FFS_TRAILING,
+    RULE_FFS_STRINGS_COUNTS,
+    RULE_FFS_STRINGS_LANGUAGE,
+    RULE_FFS_STRINGS_TRUNCATED,
+    RULE_FFS_STRINGS_COUNT,
+    RULE_COUNT
+};
+
+struct rule_info {
+    const char *id;         // Stable identifier, e.g. "msos20-total-length"
+    uint8_t     severity;
+    const char *message;    // printf format, consumes finding.value[0..2]
+};
+
+extern const struct rule_info descriptor_rules[RULE_COUNT];
+
+// Findings that do not belong to any recorded entry (headers, trailers)
+#define FINDING_NO_ENTRY    0xFFFF
+
+#define FINDINGS_MAX        128
+
+struct finding {
+    uint16_t rule;
+    uint16_t entry;         // Index into the view's entries, or FINDING_NO_ENTRY
+    uint32_t offset;        // Byte offset into the parsed buffer
+    int32_t  value[3];
+};
+
+struct finding_list {
+    int error_count;
+    int warning_count;
+    int count;              // Findings stored in items[]
+    int dropped;            // Findings counted but not stored (list full)
+    int stop_at_error;      // From PARSE_STOP_AT_ERROR: nothing is parsed or counted after an error
+    struct finding items[FINDINGS_MAX];
+};
+
+/*
+ * Descriptor views
+ *
+ * A view never copies descriptor bytes: it keeps a pointer to the parsed
+ * buffer plus the offsets and lengths of everything it found. The buffer
+ * must outlive the view. Views have fixed capacity so parsing never
+ * allocates.
+ */
+
+enum platform_capability {
+    PLATFORM_NONE = 0,      // Not a platform capability (or too short to hold a UUID)
+    PLATFORM_UNKNOWN,
+    PLATFORM_WEBUSB,
+    PLATFORM_MSOS20,
+};
+
+/*
+ * Look up a PlatformCapabilityUUID (16 bytes, as sent on the wire) in the
+ * table of known platform capabilities. Matching is two 64-bit compares
+ * per table entry. Returns PLATFORM_UNKNOWN if the UUID is not listed.
+ */
+enum platform_capability lookup_platform_capability(const uint8_t *uuid);
+
+struct bos_capability_view {
+    uint32_t offset;
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDevCapabilityType;
+    uint8_t  platform;      // enum platform_capability
+    uint8_t  data_valid;    // Capability-specific data fits bLength and the buffer
+};
+
+#define BOS_MAX_CAPABILITIES    255
+
+/*
+ * Decoded values every later stage needs from the BOS, filled in by the same
+ * walk that validates it. Values are copied out of the buffer, so the
+ * summary stays usable after the BOS buffer is reused. Only the first
+ * WebUSB and MS OS 2.0 capabilities are taken into account.
+ */
+struct bos_summary {
+    int      has_webusb;
+    uint16_t webusb_bcd_version;
+    uint8_t  webusb_vendor_code;
+    uint8_t  webusb_landing_page;
+
+    int      has_msos20;
+    uint32_t msos20_windows_version;
+    uint16_t msos20_set_length;         // wMSOSDescriptorSetTotalLength
+    uint8_t  msos20_vendor_code;        // bMS_VendorCode
+    uint8_t  msos20_alt_enum_code;
+
+    int      other_count;               // Capabilities other than the two above
+    uint32_t capability_types;          // Bit n set if bDevCapabilityType n (< 32) was seen
+};
+
+struct bos_view {
+    const uint8_t *data;
+    int length;
+    int header_valid;       // At least the 5-byte BOS header is present
+    const struct usb_bos_descriptor *header;
+    int cap_count;
+    struct bos_capability_view caps[BOS_MAX_CAPABILITIES];
+    struct bos_summary summary;
+    struct finding_list findings;
+};
+
+struct webusb_url_view {
+    const uint8_t *data;
+    int length;
+    int header_valid;
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bScheme;
+    uint32_t url_offset;
+    uint16_t url_length;
+    struct finding_list findings;
+};
+
+// msos20_entry.flags
+#define MSOS20_ENTRY_VALID          0x01    // Long enough for its fixed fields
+#define MSOS20_ENTRY_NAME_VALID     0x02    // Registry property name lies inside the buffer
+#define MSOS20_ENTRY_DATA_LEN_VALID 0x04    // wPropertyDataLength lies inside the buffer
+#define MSOS20_ENTRY_DATA_VALID     0x08    // Registry property data lies inside the buffer
+
+struct msos20_entry {
+    uint32_t offset;
+    uint16_t wLength;
+    uint16_t wDescriptorType;
+    uint16_t name_length;   // Registry property only
+    uint16_t data_length;   // Registry property only
+    uint8_t  flags;
+};
+
+#define MSOS20_MAX_ENTRIES      1024
+
+struct msos20_view {
+    const uint8_t *data;
+    int length;
+    int entry_count;
+    int entries_dropped;    // Descriptors validated but not stored (view full)
+    struct msos20_entry entries[MSOS20_MAX_ENTRIES];
+    struct finding_list findings;
+};
+
+/*
+ * FunctionFS blobs
+ *
+ * The descriptor and strings blobs a userspace function writes to ep0 of
+ * its FunctionFS mount, checked the way f_fs.c checks them before it
+ * accepts them. The MS OS extended compat ID and extended property
+ * sections of a descriptor blob also go through the Compatible ID and
+ * registry property checks of the MS OS 2.0 parser. Parsing does not
+ * allocate, so a function daemon can check its own blobs at startup.
+ */
+
+#define FFS_DESCRIPTORS_MAGIC       1       // Legacy format: fs_count and hs_count only
+#define FFS_STRINGS_MAGIC           2
+#define FFS_DESCRIPTORS_MAGIC_V2    3
+
+// ffs_view.flags (v2 only)
+#define FFS_HAS_FS_DESC             0x01
+#define FFS_HAS_HS_DESC             0x02
+#define FFS_HAS_SS_DESC             0x04
+#define FFS_HAS_MS_OS_DESC          0x08
+#define FFS_VIRTUAL_ADDR            0x10
+#define FFS_EVENTFD                 0x20
+#define FFS_ALL_CTRL_RECIP          0x40
+#define FFS_CONFIG0_SETUP           0x80
+
+#define FFS_MAX_ENDPOINTS           30      // FFS_MAX_EPS_COUNT - 1 in f_fs.c (ep0 is not counted)
+
+enum ffs_speed {
+    FFS_FULL_SPEED,
+    FFS_HIGH_SPEED,
+    FFS_SUPER_SPEED,
+    FFS_SPEED_COUNT
+};
+
+struct ffs_view {
+    const uint8_t *data;
+    int length;
+    int header_valid;       // Magic, length and every count field are present
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t counts[FFS_SPEED_COUNT];   // Descriptors per speed
+    uint32_t os_count;                  // MS OS descriptor headers
+    int interface_count;    // Highest bInterfaceNumber + 1, the same at every speed
+    int endpoint_count;
+    int strings_needed;     // Highest string index the descriptors refer to
+    int compat_count;       // Extended compat ID functions
+    int property_count;     // Extended properties
+    uint8_t endpoint_addresses[FFS_MAX_ENDPOINTS];
+    struct finding_list findings;
+};
+
+struct ffs_strings_view {
+    const uint8_t *data;
+    int length;
+    int header_valid;
+    uint32_t str_count;     // Strings per language
+    uint32_t lang_count;
+    struct finding_list findings;
+};
+
+/*
+ * Parse stage: validate and build the view. Returns the number of errors
+ * found; warnings are available in view->findings.
+ */
+#define PARSE_STOP_AT_ERROR     0x01    // Stop parsing at the first error finding
+int parse_bos_descriptor(struct bos_view *view, const uint8_t *data, int length, int flags);
+int parse_webusb_url_descriptor(struct webusb_url_view *view, const uint8_t *data, int length, int flags);
+int parse_msos20_descriptor(struct msos20_view *view, const uint8_t *data, int length, int flags);
+int parse_ffs_descriptors(struct ffs_view *view, const uint8_t *data, int length);
+int parse_ffs_strings(struct ffs_strings_view *view, const uint8_t *data, int length);
+
+// Report in the strings view if it has fewer strings than the descriptors refer to
+int check_ffs_string_count(struct ffs_strings_view *strings, const struct ffs_view *descriptors);
+
+#endif
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "usb_engine.h"
+
+#include <time.h>
+
+#include "usb_capture.h"
+
+uint64_t engine_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static const struct engine_backend libusb_backend;
+
+void engine_init(struct usb_engine *engine, libusb_context *ctx) {
+    engine->ctx = ctx;
+    engine->backend = &libusb_backend;
+    engine->backend_data = NULL;
+    engine->recorder = NULL;
+    engine->in_flight = NULL;
+    engine->pending = 0;
+    engine->submitted = 0;
+    engine->cancelling = 0;
+}
+
+void engine_complete(struct usb_engine *engine, struct control_transfer *xfer, int result) {
+    xfer->result = result;
+    xfer->complete_ns = engine_now_ns();
+    xfer->state = TRANSFER_DONE;
+    xfer->backend_transfer = NULL;
+    engine->pending--;
+
+    if (xfer->prev_in_flight) {
+        xfer->prev_in_flight->next_in_flight = xfer->next_in_flight;
+    } else {
+        engine->in_flight = xfer->next_in_flight;
+    }
+    if (xfer->next_in_flight) {
+        xfer->next_in_flight->prev_in_flight = xfer->prev_in_flight;
+    }
+    xfer->prev_in_flight = xfer->next_in_flight = NULL;
+
+    if (engine->recorder) {
+        capture_write(engine->recorder, xfer);
+    }
+    xfer->callback(xfer);
+}
+
+// Map a libusb transfer status onto the error codes libusb_control_transfer returns
+static int transfer_status_to_result(const struct libusb_transfer *transfer) {
+    switch (transfer->status) {
+        case LIBUSB_TRANSFER_COMPLETED:
+            return transfer->actual_length;
+        case LIBUSB_TRANSFER_STALL:
+            return LIBUSB_ERROR_PIPE;
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            return LIBUSB_ERROR_TIMEOUT;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            return LIBUSB_ERROR_NO_DEVICE;
+        case LIBUSB_TRANSFER_OVERFLOW:
+            return LIBUSB_ERROR_OVERFLOW;
+        case LIBUSB_TRANSFER_CANCELLED:
+            return LIBUSB_ERROR_INTERRUPTED;
+        default:
+            return LIBUSB_ERROR_IO;
+    }
+}
+
+static void LIBUSB_CALL transfer_complete(struct libusb_transfer *transfer) {
+    struct control_transfer *xfer = transfer->user_data;
+    int result = transfer_status_to_result(transfer);
+
+    libusb_free_transfer(transfer);
+    engine_complete(xfer->engine, xfer, result);
+}
+
+static int libusb_submit(struct usb_engine *engine, libusb_device_handle *handle,
+                         struct control_transfer *xfer, unsigned char *buffer) {
+    const struct control_request *setup = &xfer->setup;
+    (void)engine;
+
+    struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+    if (!transfer) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+
+    libusb_fill_control_setup(buffer, setup->bmRequestType, setup->bRequest, setup->wValue,
+                              setup->wIndex, setup->wLength);
+    libusb_fill_control_transfer(transfer, handle, buffer, transfer_complete, xfer, CONTROL_TIMEOUT_MS);
+
+    int result = libusb_submit_transfer(transfer);
+    if (result != 0) {
+        libusb_free_transfer(transfer);
+        return result;
+    }
+    xfer->backend_transfer = transfer;
+    return 0;
+}
+
+static int libusb_handle_events(struct usb_engine *engine, int timeout_ms) {
+    struct timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    return libusb_handle_events_timeout_completed(engine->ctx, &timeout, NULL);
+}
+
+// Cancelled transfers complete through transfer_complete() with LIBUSB_TRANSFER_CANCELLED
+static void libusb_cancel(struct usb_engine *engine) {
+    for (struct control_transfer *xfer = engine->in_flight; xfer; xfer = xfer->next_in_flight) {
+        // NOT_FOUND means the transfer already finished and its callback is on the way
+        libusb_cancel_transfer(xfer->backend_transfer);
+    }
+}
+
+static const struct engine_backend libusb_backend = {
+    .submit = libusb_submit,
+    .handle_events = libusb_handle_events,
+    .cancel = libusb_cancel,
+};
+
+int engine_submit(struct usb_engine *engine, libusb_device_handle *handle,
+                  struct control_transfer *xfer, struct arena *arena) {
+    // The setup packet precedes the data in the transfer buffer
+    unsigned char *buffer = arena_alloc(arena, LIBUSB_CONTROL_SETUP_SIZE + xfer->setup.wLength);
+    if (!buffer) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+
+    xfer->data = buffer + LIBUSB_CONTROL_SETUP_SIZE;
+    xfer->result = 0;
+    xfer->engine = engine;
+    xfer->submit_ns = engine_now_ns();
+    xfer->complete_ns = 0;
+    xfer->backend_transfer = NULL;
+
+    if (engine->cancelling) {
+        return LIBUSB_ERROR_INTERRUPTED;
+    }
+
+    int result = engine->backend->submit(engine, handle, xfer, buffer);
+    if (result != 0) {
+        return result;
+    }
+
+    xfer->state = TRANSFER_PENDING;
+    xfer->prev_in_flight = NULL;
+    xfer->next_in_flight = engine->in_flight;
+    if (engine->in_flight) {
+        engine->in_flight->prev_in_flight = xfer;
+    }
+    engine->in_flight = xfer;
+    engine->pending++;
+    engine->submitted++;
+    return 0;
+}
+
+int engine_handle_events(struct usb_engine *engine, int timeout_ms) {
+    int result = engine->backend->handle_events(engine, timeout_ms);
+    return result == LIBUSB_ERROR_INTERRUPTED ? 0 : result;
+}
+
+int engine_run(struct usb_engine *engine) {
+    while (engine->pending > 0) {
+        int result = engine_handle_events(engine, ENGINE_POLL_MS);
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+int engine_cancel(struct usb_engine *engine) {
+    int failures = 0;
+    int result = 0;
+
+    engine->cancelling = 1;
+    if (engine->pending > 0) {
+        engine->backend->cancel(engine);
+    }
+    // A broken event loop may never drain; give up rather than spin
+    while (engine->pending > 0 && failures < ENGINE_DRAIN_ATTEMPTS) {
+        result = engine_handle_events(engine, ENGINE_POLL_MS);
+        failures = result != 0 ? failures + 1 : 0;
+    }
+    engine->cancelling = 0;
+    return engine->pending > 0 ? result : 0;
+}
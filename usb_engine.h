@@ -0,0 +1,107 @@
+#ifndef USB_ENGINE_H
+#define USB_ENGINE_H
+
+#include <libusb-1.0/libusb.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "request_plan.h"
+
+#define CONTROL_TIMEOUT_MS  5000
+#define ENGINE_POLL_MS      1000    // Upper bound for one engine_handle_events() wait
+#define ENGINE_DRAIN_ATTEMPTS   3   // Failed event waits engine_cancel() tolerates in a row
+
+/*
+ * Asynchronous control transfer engine
+ *
+ * All descriptor requests go through one libusb event loop. A request is
+ * described by a control_transfer; its callback runs from engine_run() when
+ * the transfer completes and may submit further requests, so dependent
+ * requests are chained as completions while independent ones are in
+ * flight together.
+ *
+ * Transfers are carried by a backend: libusb by default, or a capture file
+ * replay (see usb_capture.h). A recorder, if set, sees every completion.
+ */
+
+struct control_transfer;
+typedef void (*control_transfer_cb)(struct control_transfer *xfer);
+
+enum control_transfer_state {
+    TRANSFER_IDLE = 0,      // Never submitted
+    TRANSFER_PENDING,
+    TRANSFER_DONE,
+};
+
+struct control_transfer {
+    struct control_request setup;
+    unsigned char *data;        // wLength bytes, valid until the session is reset or destroyed
+    int result;                 // Bytes received, or a LIBUSB_ERROR_* code
+    int state;                  // enum control_transfer_state
+    int tag;                    // Free for the submitter
+    uint64_t submit_ns;
+    uint64_t complete_ns;
+    control_transfer_cb callback;
+    void *user_data;
+    struct usb_engine *engine;  // Set while the transfer is in flight
+    void *backend_transfer;     // The backend's object for the transfer, if it keeps one
+    struct control_transfer *prev_in_flight;
+    struct control_transfer *next_in_flight;
+};
+
+struct usb_engine;
+struct capture_writer;
+
+struct engine_backend {
+    // Start the transfer; buffer holds the setup packet followed by xfer->data
+    int (*submit)(struct usb_engine *engine, libusb_device_handle *handle,
+                  struct control_transfer *xfer, unsigned char *buffer);
+    int (*handle_events)(struct usb_engine *engine, int timeout_ms);
+    // Ask every in-flight transfer to complete soon with LIBUSB_ERROR_INTERRUPTED
+    void (*cancel)(struct usb_engine *engine);
+};
+
+struct usb_engine {
+    libusb_context *ctx;
+    const struct engine_backend *backend;
+    void *backend_data;
+    struct capture_writer *recorder;    // NULL unless recording
+    struct control_transfer *in_flight;     // Transfers submitted and not yet completed
+    int pending;                // Length of the in_flight list
+    int submitted;              // Total transfers submitted
+    int cancelling;             // Set by engine_cancel(); new submissions fail
+};
+
+// Use libusb as the backend
+void engine_init(struct usb_engine *engine, libusb_context *ctx);
+
+// Called by backends when a transfer finishes with result bytes or a LIBUSB_ERROR_* code
+void engine_complete(struct usb_engine *engine, struct control_transfer *xfer, int result);
+
+/*
+ * Submit xfer->setup on the device's default control pipe. The data buffer
+ * is taken from arena. On failure the callback is not called and the error
+ * is returned.
+ */
+int engine_submit(struct usb_engine *engine, libusb_device_handle *handle,
+                  struct control_transfer *xfer, struct arena *arena);
+
+// Handle one batch of events, waiting at most timeout_ms; completion callbacks run from here
+int engine_handle_events(struct usb_engine *engine, int timeout_ms);
+
+// Run the event loop until no transfer is pending
+int engine_run(struct usb_engine *engine);
+
+/*
+ * Cancel every pending transfer and handle events until all of them have
+ * completed, so their buffers and sessions can be freed. Completion
+ * callbacks still run, with LIBUSB_ERROR_INTERRUPTED for cancelled
+ * transfers, and any transfer they submit fails right away. Returns 0 once
+ * nothing is in flight, or the event error that kept the loop from
+ * draining; in that case the transfers' memory must not be freed.
+ */
+int engine_cancel(struct usb_engine *engine);
+
+uint64_t engine_now_ns(void);
+
+#endif
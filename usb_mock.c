@@ -0,0 +1,609 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "usb_mock.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "batch.h"
+#include "report.h"
+
+#define MOCK_WEBUSB_CODE    0x01
+#define MOCK_MSOS20_CODE    0x02
+#define MOCK_MAX_DEVICES    1000000
+#define MOCK_PI             3.14159265358979323846
+
+struct mock_pending {
+    uint64_t due_ns;
+    struct control_transfer *xfer;
+    int result;
+};
+
+static const char * const mock_strings[] = { "Mock Devices", "Mock Device", "0001" };
+#define MOCK_STRING_COUNT   (int)(sizeof(mock_strings) / sizeof(mock_strings[0]))
+
+static const char * const blob_names[MOCK_BLOB_COUNT] = { "BOS", "MS OS 2.0 set", "WebUSB URL" };
+
+static void put_le16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t value) {
+    put_le16(p, value & 0xFFFF);
+    put_le16(p + 2, value >> 16);
+}
+
+// ASCII as UTF-16LE with a terminator; returns the bytes written
+static int put_utf16(uint8_t *p, const char *text) {
+    int length = 0;
+    for (; *text; text++, length += 2) {
+        put_le16(p + length, (uint8_t)*text);
+    }
+    put_le16(p + length, 0);
+    return length + 2;
+}
+
+/*
+ * Profiles
+ */
+
+static int default_msos20(uint8_t *p) {
+    put_le16(&p[0], 10);
+    put_le16(&p[2], MS_OS_20_SET_HEADER_DESCRIPTOR);
+    put_le32(&p[4], 0x06030000);
+    int length = 10;
+
+    put_le16(&p[length], 20);
+    put_le16(&p[length + 2], MS_OS_20_FEATURE_COMPATIBLE_ID);
+    memset(&p[length + 4], 0, 16);
+    memcpy(&p[length + 4], "WINUSB", 6);
+    length += 20;
+
+    int property = length;
+    put_le16(&p[property + 2], MS_OS_20_FEATURE_REG_PROPERTY);
+    put_le16(&p[property + 4], 7);  // REG_MULTI_SZ
+    int name_length = put_utf16(&p[property + 8], "DeviceInterfaceGUIDs");
+    put_le16(&p[property + 6], (uint16_t)name_length);
+    int data_offset = property + 8 + name_length + 2;
+    int data_length = put_utf16(&p[data_offset], "{6B3AAB04-0D1F-4F1E-9C31-5E5F3C3B2A10}");
+    put_le16(&p[data_offset + data_length], 0);    // Second terminator ends the list
+    data_length += 2;
+    put_le16(&p[data_offset - 2], (uint16_t)data_length);
+    length = data_offset + data_length;
+    put_le16(&p[property], (uint16_t)(length - property));
+
+    put_le16(&p[8], (uint16_t)length);
+    return length;
+}
+
+static int default_bos(uint8_t *p, uint16_t msos20_length) {
+    static const uint8_t webusb_uuid[16] = { 0x38, 0xb6, 0x08, 0x34, 0xa9, 0x09, 0xa0, 0x47,
+                                             0x8b, 0xfd, 0xa0, 0x76, 0x88, 0x15, 0xb6, 0x65 };
+    static const uint8_t msos20_uuid[16] = { 0xdf, 0x60, 0xdd, 0xd8, 0x89, 0x45, 0xc7, 0x4c,
+                                             0x9c, 0xd2, 0x65, 0x9d, 0x9e, 0x64, 0x8a, 0x9f };
+    int length = USB_DT_BOS_SIZE + 24 + 28;
+
+    p[0] = USB_DT_BOS_SIZE;
+    p[1] = USB_DT_BOS;
+    put_le16(&p[2], (uint16_t)length);
+    p[4] = 2;
+
+    uint8_t *cap = &p[USB_DT_BOS_SIZE];
+    cap[0] = 24;
+    cap[1] = USB_DT_DEVICE_CAPABILITY;
+    cap[2] = USB_PLAT_DEV_CAP_TYPE;
+    cap[3] = 0;
+    memcpy(&cap[4], webusb_uuid, 16);
+    put_le16(&cap[20], 0x0100);
+    cap[22] = MOCK_WEBUSB_CODE;
+    cap[23] = 1;                    // iLandingPage
+
+    cap += 24;
+    cap[0] = 28;
+    cap[1] = USB_DT_DEVICE_CAPABILITY;
+    cap[2] = USB_PLAT_DEV_CAP_TYPE;
+    cap[3] = 0;
+    memcpy(&cap[4], msos20_uuid, 16);
+    put_le32(&cap[20], 0x06030000);
+    put_le16(&cap[24], msos20_length);
+    cap[26] = MOCK_MSOS20_CODE;
+    cap[27] = 0;
+    return length;
+}
+
+static int default_url(uint8_t *p) {
+    static const char host[] = "example.com/mock";
+
+    p[0] = (uint8_t)(3 + sizeof(host) - 1);
+    p[1] = WEBUSB_URL_DESCRIPTOR_TYPE;
+    p[2] = WEBUSB_URL_SCHEME_HTTPS;
+    memcpy(&p[3], host, sizeof(host) - 1);
+    return p[0];
+}
+
+void mock_profile_default(struct mock_profile *profile) {
+    profile->vid = MOCK_VID;
+    profile->pid = MOCK_PID;
+    profile->blobs[MOCK_MSOS20].length = default_msos20(profile->blobs[MOCK_MSOS20].data);
+    profile->blobs[MOCK_BOS].length = default_bos(profile->blobs[MOCK_BOS].data,
+                                                  (uint16_t)profile->blobs[MOCK_MSOS20].length);
+    profile->blobs[MOCK_URL].length = default_url(profile->blobs[MOCK_URL].data);
+    mock_profile_update(profile);
+}
+
+// Whole file into data; its length, or -1 if it cannot be read or is longer than MOCK_BLOB_MAX
+static int read_file(const char *path, uint8_t *data) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    int length = (int)fread(data, 1, MOCK_BLOB_MAX, file);
+    int failed = ferror(file) || fgetc(file) != EOF;
+    fclose(file);
+    return failed ? -1 : length;
+}
+
+int mock_profile_read(struct mock_profile *profile, enum mock_blob blob, const char *path) {
+    int length = read_file(path, profile->blobs[blob].data);
+    if (length < 0) {
+        printf(COLOR_RED "ERROR: Cannot read %s '%s' (at most %d bytes)\n" COLOR_RESET, blob_names[blob], path,
+               MOCK_BLOB_MAX);
+        return -1;
+    }
+    profile->blobs[blob].length = length;
+    return 0;
+}
+
+int mock_profile_load(struct mock_profile *profile, const char *path) {
+    struct file_list files = { 0 };
+    uint8_t *data = malloc(MOCK_BLOB_MAX);
+    int found = 0;
+
+    if (!data || file_list_collect(&files, path) != 0) {
+        free(data);
+        file_list_free(&files);
+        return -1;
+    }
+    file_list_sort(&files);
+
+    for (int i = 0; i < files.count; i++) {
+        int length = read_file(files.paths[i], data);
+        enum blob_kind kind = length > 0 ? blob_classify(data, length) : BLOB_UNREADABLE;
+        enum mock_blob blob;
+        switch (kind) {
+            case BLOB_BOS:
+                blob = MOCK_BOS;
+                break;
+            case BLOB_MSOS20:
+                blob = MOCK_MSOS20;
+                break;
+            case BLOB_WEBUSB_URL:
+                blob = MOCK_URL;
+                break;
+            default:
+                printf(COLOR_ORANGE "WARNING: Ignoring %s (%s)\n" COLOR_RESET, files.paths[i], blob_kind_name(kind));
+                continue;
+        }
+        memcpy(profile->blobs[blob].data, data, length);
+        profile->blobs[blob].length = length;
+        found++;
+    }
+
+    free(data);
+    file_list_free(&files);
+    if (found == 0) {
+        printf(COLOR_RED "ERROR: No BOS, MS OS 2.0 set or WebUSB URL descriptor in '%s'\n" COLOR_RESET, path);
+        return -1;
+    }
+    mock_profile_update(profile);
+    return 0;
+}
+
+void mock_profile_update(struct mock_profile *profile) {
+    struct bos_view *view = calloc(1, sizeof(*view));  // Large; only the summary is kept
+
+    if (!view) {
+        memset(&profile->summary, 0, sizeof(profile->summary));
+        return;
+    }
+    parse_bos_descriptor(view, profile->blobs[MOCK_BOS].data, profile->blobs[MOCK_BOS].length, 0);
+    profile->summary = view->summary;
+    free(view);
+}
+
+static int respond_with(uint8_t *data, const uint8_t *descriptor, int length, uint16_t wLength) {
+    if (length > wLength) {
+        length = wLength;
+    }
+    memcpy(data, descriptor, length);
+    return length;
+}
+
+static int respond_descriptor(const struct mock_profile *profile, const struct control_request *setup,
+                              uint8_t *data) {
+    uint8_t buffer[256];
+    uint8_t type = (uint8_t)(setup->wValue >> 8);
+    uint8_t index = (uint8_t)setup->wValue;
+
+    switch (type) {
+        case USB_DT_DEVICE:
+            memset(buffer, 0, USB_DT_DEVICE_SIZE);
+            buffer[0] = USB_DT_DEVICE_SIZE;
+            buffer[1] = USB_DT_DEVICE;
+            put_le16(&buffer[2], 0x0210);   // 2.1: the host asks for the BOS
+            buffer[7] = 64;                 // bMaxPacketSize0
+            put_le16(&buffer[8], profile->vid);
+            put_le16(&buffer[10], profile->pid);
+            put_le16(&buffer[12], 0x0100);
+            buffer[14] = 1;
+            buffer[15] = 2;
+            buffer[16] = 3;
+            buffer[17] = 1;                 // bNumConfigurations
+            return respond_with(data, buffer, USB_DT_DEVICE_SIZE, setup->wLength);
+        case USB_DT_DEVICE_QUALIFIER:
+            memset(buffer, 0, 10);
+            buffer[0] = 10;
+            buffer[1] = USB_DT_DEVICE_QUALIFIER;
+            put_le16(&buffer[2], 0x0200);
+            buffer[6] = 64;
+            buffer[8] = 1;
+            return respond_with(data, buffer, 10, setup->wLength);
+        case USB_DT_CONFIG: {
+            // One vendor-specific interface without endpoints: nothing for a host driver to claim
+            static const uint8_t config[] = {
+                9, USB_DT_CONFIG, 18, 0, 1, 1, 0, 0x80, 50,
+                9, USB_DT_INTERFACE, 0, 0, 0, 0xFF, 0, 0, 0,
+            };
+            return respond_with(data, config, sizeof(config), setup->wLength);
+        }
+        case USB_DT_STRING:
+            if (index > MOCK_STRING_COUNT) {
+                return -1;
+            }
+            if (index == 0) {
+                put_le16(&buffer[2], 0x0409);
+                buffer[0] = 4;
+            } else {
+                // The 2-byte header takes the place of the terminator in bLength
+                buffer[0] = (uint8_t)put_utf16(&buffer[2], mock_strings[index - 1]);
+            }
+            buffer[1] = USB_DT_STRING;
+            return respond_with(data, buffer, buffer[0], setup->wLength);
+        case USB_DT_BOS:
+            return respond_with(data, profile->blobs[MOCK_BOS].data, profile->blobs[MOCK_BOS].length,
+                                setup->wLength);
+        default:
+            return -1;
+    }
+}
+
+int mock_respond(const struct mock_profile *profile, const struct control_request *setup, uint8_t *data) {
+    const struct bos_summary *summary = &profile->summary;
+
+    if (setup->bmRequestType == REQUEST_TYPE_STANDARD_IN && setup->bRequest == USB_REQUEST_GET_DESCRIPTOR) {
+        return respond_descriptor(profile, setup, data);
+    }
+    if (setup->bmRequestType != REQUEST_TYPE_VENDOR_IN) {
+        return -1;
+    }
+    if (summary->has_msos20 && setup->bRequest == summary->msos20_vendor_code &&
+        setup->wIndex == MS_OS_20_DESCRIPTOR_INDEX) {
+        return respond_with(data, profile->blobs[MOCK_MSOS20].data, profile->blobs[MOCK_MSOS20].length,
+                            setup->wLength);
+    }
+    if (summary->has_webusb && setup->bRequest == summary->webusb_vendor_code && setup->wIndex == WEBUSB_GET_URL) {
+        return respond_with(data, profile->blobs[MOCK_URL].data, profile->blobs[MOCK_URL].length, setup->wLength);
+    }
+    return -1;
+}
+
+/*
+ * Configuration
+ */
+
+static int parse_number(const char *key, const char *value, double min, double max, double *out) {
+    char *endptr;
+    double number = strtod(value, &endptr);
+    if (endptr == value || *endptr != '\0' || !(number >= min && number <= max)) {
+        printf(COLOR_RED "ERROR: Invalid mock %s '%s' (%g to %g)\n" COLOR_RESET, key, value, min, max);
+        return -1;
+    }
+    *out = number;
+    return 0;
+}
+
+int mock_parse_config(struct mock_config *config, const char *spec) {
+    config->devices = 1000;
+    config->latency_us = 200;
+    config->jitter_us = 50;
+    config->distribution = MOCK_UNIFORM;
+    config->stall_rate = 0;
+    config->timeout_rate = 0;
+    config->short_rate = 0;
+    config->disconnect_rate = 0;
+    config->timeout_ms = CONTROL_TIMEOUT_MS;
+    config->seed = 1;
+    config->reports = 0;
+
+    char buffer[256];
+    if (snprintf(buffer, sizeof(buffer), "%s", spec) >= (int)sizeof(buffer)) {
+        printf(COLOR_RED "ERROR: Mock spec too long\n" COLOR_RESET);
+        return -1;
+    }
+
+    char *saveptr;
+    for (char *item = strtok_r(buffer, ",", &saveptr); item; item = strtok_r(NULL, ",", &saveptr)) {
+        char *value = strchr(item, '=');
+        if (!value) {
+            printf(COLOR_RED "ERROR: Mock spec item '%s' is not key=value\n" COLOR_RESET, item);
+            return -1;
+        }
+        *value++ = '\0';
+
+        double number = 0;
+        int result = 0;
+        if (strcmp(item, "dist") == 0) {
+            if (strcmp(value, "uniform") == 0) {
+                config->distribution = MOCK_UNIFORM;
+            } else if (strcmp(value, "normal") == 0) {
+                config->distribution = MOCK_NORMAL;
+            } else if (strcmp(value, "exp") == 0) {
+                config->distribution = MOCK_EXPONENTIAL;
+            } else {
+                printf(COLOR_RED "ERROR: Unknown mock distribution '%s' (uniform, normal, exp)\n" COLOR_RESET, value);
+                return -1;
+            }
+        } else if (strcmp(item, "devices") == 0) {
+            result = parse_number(item, value, 1, MOCK_MAX_DEVICES, &number);
+            config->devices = (int)number;
+        } else if (strcmp(item, "latency") == 0) {
+            result = parse_number(item, value, 0, 60e6, &number);
+            config->latency_us = (uint32_t)number;
+        } else if (strcmp(item, "jitter") == 0) {
+            result = parse_number(item, value, 0, 60e6, &number);
+            config->jitter_us = (uint32_t)number;
+        } else if (strcmp(item, "stall") == 0) {
+            result = parse_number(item, value, 0, 1, &config->stall_rate);
+        } else if (strcmp(item, "timeout") == 0) {
+            result = parse_number(item, value, 0, 1, &config->timeout_rate);
+        } else if (strcmp(item, "short") == 0) {
+            result = parse_number(item, value, 0, 1, &config->short_rate);
+        } else if (strcmp(item, "disconnect") == 0) {
+            result = parse_number(item, value, 0, 1, &config->disconnect_rate);
+        } else if (strcmp(item, "timeout_ms") == 0) {
+            result = parse_number(item, value, 0, 600000, &number);
+            config->timeout_ms = (uint32_t)number;
+        } else if (strcmp(item, "seed") == 0) {
+            result = parse_number(item, value, 0, 9007199254740992.0, &number);
+            config->seed = (uint64_t)number;
+        } else if (strcmp(item, "reports") == 0) {
+            result = parse_number(item, value, 0, 1, &number);
+            config->reports = (int)number;
+        } else {
+            printf(COLOR_RED "ERROR: Unknown mock spec key '%s'\n" COLOR_RESET, item);
+            return -1;
+        }
+        if (result != 0) {
+            return -1;
+        }
+    }
+
+    if (config->stall_rate + config->timeout_rate + config->disconnect_rate > 1) {
+        printf(COLOR_RED "ERROR: stall, timeout and disconnect rates add up to more than 1\n" COLOR_RESET);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Backend
+ */
+
+// xorshift64*: fast, and the same seed gives the same run
+static uint64_t next_random(struct mock_farm *farm) {
+    farm->rng ^= farm->rng >> 12;
+    farm->rng ^= farm->rng << 25;
+    farm->rng ^= farm->rng >> 27;
+    return farm->rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in (0, 1)
+static double next_unit(struct mock_farm *farm) {
+    return ((next_random(farm) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static uint64_t sample_latency_ns(struct mock_farm *farm) {
+    const struct mock_config *config = &farm->config;
+    double latency = config->latency_us;
+
+    switch (config->distribution) {
+        case MOCK_UNIFORM:
+            latency += config->jitter_us * (2 * next_unit(farm) - 1);
+            break;
+        case MOCK_NORMAL:
+            latency += config->jitter_us * sqrt(-2 * log(next_unit(farm))) * cos(2 * MOCK_PI * next_unit(farm));
+            break;
+        case MOCK_EXPONENTIAL:
+            latency -= config->jitter_us * log(next_unit(farm));
+            break;
+    }
+    return latency > 0 ? (uint64_t)(latency * 1000) : 0;
+}
+
+static int heap_push(struct mock_farm *farm, struct mock_pending pending) {
+    if (farm->heap_count == farm->heap_capacity) {
+        int capacity = farm->heap_capacity ? farm->heap_capacity * 2 : 256;
+        struct mock_pending *heap = realloc(farm->heap, capacity * sizeof(*heap));
+        if (!heap) {
+            return LIBUSB_ERROR_NO_MEM;
+        }
+        farm->heap = heap;
+        farm->heap_capacity = capacity;
+    }
+
+    int i = farm->heap_count++;
+    while (i > 0 && farm->heap[(i - 1) / 2].due_ns > pending.due_ns) {
+        farm->heap[i] = farm->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    farm->heap[i] = pending;
+    return 0;
+}
+
+static struct mock_pending heap_pop(struct mock_farm *farm) {
+    struct mock_pending top = farm->heap[0];
+    struct mock_pending last = farm->heap[--farm->heap_count];
+
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= farm->heap_count) {
+            break;
+        }
+        if (child + 1 < farm->heap_count && farm->heap[child + 1].due_ns < farm->heap[child].due_ns) {
+            child++;
+        }
+        if (farm->heap[child].due_ns >= last.due_ns) {
+            break;
+        }
+        farm->heap[i] = farm->heap[child];
+        i = child;
+    }
+    if (farm->heap_count > 0) {
+        farm->heap[i] = last;
+    }
+    return top;
+}
+
+// Decide the outcome now; the response goes into the transfer's buffer right away
+static int mock_submit(struct usb_engine *engine, libusb_device_handle *handle,
+                       struct control_transfer *xfer, unsigned char *buffer) {
+    struct mock_farm *farm = engine->backend_data;
+    struct mock_device *device = (struct mock_device *)handle;
+    const struct mock_config *config = &farm->config;
+    (void)buffer;
+
+    struct mock_pending pending = { .due_ns = xfer->submit_ns + sample_latency_ns(farm), .xfer = xfer };
+    double draw = next_unit(farm);
+
+    farm->transfers++;
+    if (device->disconnected) {
+        pending.result = LIBUSB_ERROR_NO_DEVICE;
+        farm->no_device++;
+    } else if (draw < config->disconnect_rate) {
+        device->disconnected = 1;
+        pending.result = LIBUSB_ERROR_NO_DEVICE;
+        farm->disconnects++;
+    } else if ((draw -= config->disconnect_rate) < config->timeout_rate) {
+        pending.due_ns = xfer->submit_ns + (uint64_t)config->timeout_ms * 1000000u;
+        pending.result = LIBUSB_ERROR_TIMEOUT;
+        farm->timeouts++;
+    } else if ((draw -= config->timeout_rate) < config->stall_rate) {
+        pending.result = LIBUSB_ERROR_PIPE;
+        farm->stalls++;
+    } else {
+        pending.result = mock_respond(device->profile, &xfer->setup, xfer->data);
+        if (pending.result < 0) {
+            pending.result = LIBUSB_ERROR_PIPE;
+        } else if (pending.result > 0 && config->short_rate > 0 && next_unit(farm) < config->short_rate) {
+            pending.result = (int)(next_random(farm) % (uint64_t)pending.result);
+            farm->short_reads++;
+        }
+    }
+    return heap_push(farm, pending);
+}
+
+static int mock_handle_events(struct usb_engine *engine, int timeout_ms) {
+    struct mock_farm *farm = engine->backend_data;
+
+    if (farm->heap_count == 0) {
+        return 0;
+    }
+
+    uint64_t now = engine_now_ns();
+    uint64_t deadline = now + (uint64_t)timeout_ms * 1000000u;
+    uint64_t wake = farm->heap[0].due_ns < deadline ? farm->heap[0].due_ns : deadline;
+    if (wake > now) {
+        uint64_t delay = wake - now;
+        struct timespec ts = { (time_t)(delay / 1000000000u), (long)(delay % 1000000000u) };
+        nanosleep(&ts, NULL);
+    }
+
+    // Take the due transfers out first: their callbacks may submit new ones
+    struct mock_pending due[MOCK_BATCH];
+    int due_count = 0;
+    now = engine_now_ns();
+    while (due_count < MOCK_BATCH && farm->heap_count > 0 && farm->heap[0].due_ns <= now) {
+        due[due_count++] = heap_pop(farm);
+    }
+
+    for (int i = 0; i < due_count; i++) {
+        uint64_t lag = now - due[i].due_ns;
+        farm->lag_total_ns += lag;
+        if (lag > farm->lag_max_ns) {
+            farm->lag_max_ns = lag;
+        }
+        engine_complete(engine, due[i].xfer, due[i].result);
+    }
+    return 0;
+}
+
+// Every pending transfer becomes due now, which keeps the heap ordered
+static void mock_cancel(struct usb_engine *engine) {
+    struct mock_farm *farm = engine->backend_data;
+    uint64_t now = engine_now_ns();
+
+    for (int i = 0; i < farm->heap_count; i++) {
+        farm->heap[i].due_ns = now;
+        farm->heap[i].result = LIBUSB_ERROR_INTERRUPTED;
+    }
+}
+
+static const struct engine_backend mock_backend = {
+    .submit = mock_submit,
+    .handle_events = mock_handle_events,
+    .cancel = mock_cancel,
+};
+
+int mock_farm_init(struct mock_farm *farm, struct usb_engine *engine, const struct mock_config *config,
+                   const struct mock_profile *profiles, int profile_count) {
+    memset(farm, 0, sizeof(*farm));
+    farm->config = *config;
+    farm->rng = config->seed ? config->seed : 1;    // xorshift needs a non-zero state
+    farm->devices = calloc(config->devices, sizeof(*farm->devices));
+    if (!farm->devices) {
+        return -1;
+    }
+    for (int i = 0; i < config->devices; i++) {
+        farm->devices[i].profile = &profiles[i % profile_count];
+    }
+
+    engine_init(engine, NULL);
+    engine->backend = &mock_backend;
+    engine->backend_data = farm;
+    return 0;
+}
+
+void mock_farm_free(struct mock_farm *farm) {
+    free(farm->devices);
+    free(farm->heap);
+    memset(farm, 0, sizeof(*farm));
+}
+
+libusb_device_handle *mock_farm_handle(struct mock_farm *farm, int index) {
+    return (libusb_device_handle *)&farm->devices[index];
+}
+
+void mock_farm_render(FILE *out, const struct mock_farm *farm) {
+    fprintf(out, "=== Mock Farm ===\n");
+    fprintf(out, "Transfers: %d (%d STALLs, %d timeouts, %d short reads, %d disconnects injected, "
+            "%d after disconnect)\n", farm->transfers, farm->stalls, farm->timeouts, farm->short_reads,
+            farm->disconnects, farm->no_device);
+    if (farm->transfers > 0) {
+        fprintf(out, "Completion lag behind schedule: %.3f ms average, %.3f ms max\n",
+                (double)farm->lag_total_ns / farm->transfers / 1e6, (double)farm->lag_max_ns / 1e6);
+    }
+}
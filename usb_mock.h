@@ -0,0 +1,128 @@
+#ifndef USB_MOCK_H
+#define USB_MOCK_H
+
+#include <libusb-1.0/libusb.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "request_plan.h"
+#include "usb_descriptors.h"
+#include "usb_engine.h"
+
+/*
+ * Simulated devices
+ *
+ * A profile holds what a device answers on ep0: the standard device,
+ * configuration and string descriptors, plus a BOS, MS OS 2.0 descriptor
+ * set and WebUSB URL descriptor. The vendor requests it answers are the
+ * ones its own BOS announces, even if that BOS is malformed.
+ *
+ * The mock backend serves any number of such devices to the engine in
+ * place of libusb. Every transfer gets a latency from the configured
+ * distribution and may be turned into a STALL, timeout, short read or
+ * disconnect, so the multi-device and asynchronous paths can be
+ * load-tested in one process. Pending completions are kept in a binary
+ * heap, so the backend stays cheap with many thousands in flight.
+ */
+
+#define MOCK_BLOB_MAX       65535   // wLength is 16 bits
+#define MOCK_VID            0x1209  // pid.codes test VID/PID
+#define MOCK_PID            0x0001
+#define MOCK_BATCH          256     // Transfers completed per mock_handle_events() call
+
+enum mock_blob {
+    MOCK_BOS,
+    MOCK_MSOS20,
+    MOCK_URL,
+    MOCK_BLOB_COUNT
+};
+
+struct mock_profile {
+    uint16_t vid;
+    uint16_t pid;
+    struct {
+        uint8_t data[MOCK_BLOB_MAX];
+        int length;
+    } blobs[MOCK_BLOB_COUNT];
+    struct bos_summary summary;     // Set by mock_profile_update()
+};
+
+// A well-formed WebUSB + MS OS 2.0 device that Windows binds to WinUSB
+void mock_profile_default(struct mock_profile *profile);
+
+// Replace one blob with the contents of a file, as is; prints an error and returns -1 on failure
+int mock_profile_read(struct mock_profile *profile, enum mock_blob blob, const char *path);
+
+// Replace the blobs found under path (a dump file or a directory of them), recognized by their header
+int mock_profile_load(struct mock_profile *profile, const char *path);
+
+// Decode the vendor codes from the profile's BOS; call after changing it
+void mock_profile_update(struct mock_profile *profile);
+
+// Answer a control IN request: the bytes written to data (at most wLength), or -1 to STALL
+int mock_respond(const struct mock_profile *profile, const struct control_request *setup, uint8_t *data);
+
+enum mock_distribution {
+    MOCK_UNIFORM,           // latency +- jitter
+    MOCK_NORMAL,            // mean latency, standard deviation jitter
+    MOCK_EXPONENTIAL,       // latency plus an exponential tail with mean jitter
+};
+
+struct mock_config {
+    int devices;
+    uint32_t latency_us;
+    uint32_t jitter_us;
+    int distribution;       // enum mock_distribution
+    double stall_rate;      // Per request
+    double timeout_rate;
+    double short_rate;
+    double disconnect_rate; // The device answers LIBUSB_ERROR_NO_DEVICE from then on
+    uint32_t timeout_ms;    // When a timed-out request completes
+    uint64_t seed;
+    int reports;            // Print every device's report, not only the summary
+};
+
+// Defaults, then "key=value,..." overrides; prints an error and returns -1 on a bad spec
+int mock_parse_config(struct mock_config *config, const char *spec);
+
+struct mock_device {
+    const struct mock_profile *profile;
+    int disconnected;
+};
+
+struct mock_pending;
+
+struct mock_farm {
+    struct mock_config config;
+    struct mock_device *devices;
+    uint64_t rng;
+
+    struct mock_pending *heap;      // Ordered by due time
+    int heap_count;
+    int heap_capacity;
+
+    // Statistics
+    int transfers;
+    int stalls;
+    int timeouts;
+    int short_reads;
+    int disconnects;
+    int no_device;                  // Requests to a device after it disconnected
+    uint64_t lag_total_ns;          // Completion later than scheduled, summed
+    uint64_t lag_max_ns;
+};
+
+/*
+ * Create config->devices devices, spread over the profiles round-robin, and
+ * make engine serve them. Returns -1 if out of memory.
+ */
+int mock_farm_init(struct mock_farm *farm, struct usb_engine *engine, const struct mock_config *config,
+                   const struct mock_profile *profiles, int profile_count);
+void mock_farm_free(struct mock_farm *farm);
+
+// The handle a session uses for device index; it only means something to the mock backend
+libusb_device_handle *mock_farm_handle(struct mock_farm *farm, int index);
+
+void mock_farm_render(FILE *out, const struct mock_farm *farm);
+
+#endif
@@ -0,0 +1,679 @@
+#include "usb_session.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "report.h"
+#include "report_json.h"
+
+#define STRING_DESCRIPTOR_MAX_LENGTH    255
+
+static void transfer_done(struct control_transfer *xfer);
+
+static void finish_transfer(struct usb_session *session) {
+    if (--session->pending == 0) {
+        session->end_ns = engine_now_ns();
+        if (session->on_complete) {
+            session->on_complete(session);
+        }
+    }
+}
+
+static void submit(struct usb_session *session, enum session_transfer slot, struct control_request setup) {
+    struct control_transfer *xfer = &session->transfers[slot];
+
+    xfer->setup = setup;
+    xfer->tag = slot;
+    xfer->callback = transfer_done;
+    xfer->user_data = session;
+
+    session->pending++;
+    int result = engine_submit(session->engine, session->handle, xfer, &session->arena);
+    if (result != 0) {
+        // Report the failure as a completed transfer so the chain still ends
+        xfer->result = result;
+        xfer->state = TRANSFER_DONE;
+        xfer->submit_ns = xfer->complete_ns = engine_now_ns();
+        transfer_done(xfer);
+    }
+}
+
+static int transfer_ok(const struct usb_session *session, enum session_transfer slot, int min_length) {
+    const struct control_transfer *xfer = &session->transfers[slot];
+    return xfer->state == TRANSFER_DONE && xfer->result >= min_length;
+}
+
+// Strings need both the device descriptor (indices) and the LANGID table
+static void request_strings(struct usb_session *session) {
+    if (!transfer_ok(session, SESSION_DEVICE, USB_DT_DEVICE_SIZE) ||
+        !transfer_ok(session, SESSION_LANGID, 4)) {
+        return;
+    }
+
+    const unsigned char *device = session->transfers[SESSION_DEVICE].data;
+    uint16_t langid = get_le16(&session->transfers[SESSION_LANGID].data[2]);
+    static const struct { enum session_transfer slot; int offset; } strings[] = {
+        { SESSION_MANUFACTURER, 14 },   // iManufacturer
+        { SESSION_PRODUCT,      15 },   // iProduct
+        { SESSION_SERIAL,       16 },   // iSerialNumber
+    };
+
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        uint8_t index = device[strings[i].offset];
+        if (index != 0) {
+            submit(session, strings[i].slot,
+                   descriptor_request(USB_DT_STRING, index, langid, STRING_DESCRIPTOR_MAX_LENGTH));
+        }
+    }
+}
+
+static int parse_flags(const struct usb_session *session) {
+    return (session->flags & SESSION_FAIL_FAST) ? PARSE_STOP_AT_ERROR : 0;
+}
+
+// Fail-fast sessions stop here: an error finding or a failed MS OS 2.0 request so far
+static int session_failed(const struct usb_session *session) {
+    const struct control_transfer *msos20 = &session->transfers[SESSION_MSOS20];
+    return session->bos_view.findings.error_count > 0 || session->url_view.findings.error_count > 0 ||
+           session->msos20_view.findings.error_count > 0 || (msos20->state == TRANSFER_DONE && msos20->result <= 0);
+}
+
+// The BOS is complete: validate it once and plan everything that depends on it
+static void bos_complete(struct usb_session *session, const unsigned char *data, int length) {
+    session->bos_data = data;
+    session->bos_length = length;
+    parse_bos_descriptor(&session->bos_view, data, length, parse_flags(session));
+    if ((session->flags & SESSION_FAIL_FAST) && session_failed(session)) {
+        return;
+    }
+    plan_requests(&session->plan, &session->bos_view.summary);
+
+    for (int i = 0; i < session->plan.count; i++) {
+        const struct planned_request *request = &session->plan.requests[i];
+        switch (request->kind) {
+            case REQUEST_WEBUSB_URL:
+                submit(session, SESSION_WEBUSB_URL, request->setup);
+                break;
+            case REQUEST_MSOS20_SET:
+                submit(session, SESSION_MSOS20, request->setup);
+                break;
+        }
+    }
+}
+
+static void transfer_done(struct control_transfer *xfer) {
+    struct usb_session *session = xfer->user_data;
+
+    switch (xfer->tag) {
+        case SESSION_DEVICE:
+        case SESSION_LANGID:
+            request_strings(session);
+            break;
+        case SESSION_BOS_HEADER:
+            if (xfer->result >= USB_DT_BOS_SIZE) {
+                uint16_t total_length = get_le16(&xfer->data[2]);
+                if (total_length > USB_DT_BOS_SIZE) {
+                    submit(session, SESSION_BOS, bos_request(total_length));
+                } else {
+                    bos_complete(session, xfer->data, xfer->result);
+                }
+            } else if (xfer->result > 0) {
+                // Let the parser report a short header
+                bos_complete(session, xfer->data, xfer->result);
+            }
+            break;
+        case SESSION_BOS:
+            if (xfer->result > 0) {
+                bos_complete(session, xfer->data, xfer->result);
+            }
+            break;
+        case SESSION_WEBUSB_URL:
+            // The URL and MS OS 2.0 requests are in flight together; the first to fail decides
+            if (xfer->result > 0 && !((session->flags & SESSION_FAIL_FAST) && session_failed(session))) {
+                parse_webusb_url_descriptor(&session->url_view, xfer->data, xfer->result, parse_flags(session));
+            }
+            break;
+        case SESSION_MSOS20:
+            if (xfer->result > 0 && !((session->flags & SESSION_FAIL_FAST) && session_failed(session))) {
+                parse_msos20_descriptor(&session->msos20_view, xfer->data, xfer->result, parse_flags(session));
+            }
+            break;
+        default:
+            break;
+    }
+
+    finish_transfer(session);
+}
+
+struct usb_session *session_create(struct usb_engine *engine, libusb_device_handle *handle) {
+    struct usb_session *session = calloc(1, sizeof(*session));
+    if (!session) {
+        return NULL;
+    }
+    session->engine = engine;
+    session->handle = handle;
+    arena_init(&session->arena);
+    return session;
+}
+
+void session_reset(struct usb_session *session, libusb_device_handle *handle) {
+    struct usb_engine *engine = session->engine;
+    struct arena arena = session->arena;
+
+    arena_reset(&arena);
+    memset(session, 0, sizeof(*session));
+    session->engine = engine;
+    session->handle = handle;
+    session->arena = arena;
+}
+
+void session_destroy(struct usb_session *session) {
+    if (session) {
+        arena_free(&session->arena);
+        free(session);
+    }
+}
+
+void session_start(struct usb_session *session) {
+    session->start_ns = engine_now_ns();
+    session->plan.count = 0;
+
+    // Hold a reference so early completions cannot finish the session mid-start
+    session->pending++;
+    if (!(session->flags & SESSION_QUIET)) {
+        submit(session, SESSION_DEVICE, descriptor_request(USB_DT_DEVICE, 0, 0, USB_DT_DEVICE_SIZE));
+        submit(session, SESSION_CONFIG, descriptor_request(USB_DT_CONFIG, 0, 0, USB_DT_CONFIG_SIZE));
+        submit(session, SESSION_LANGID, descriptor_request(USB_DT_STRING, 0, 0, STRING_DESCRIPTOR_MAX_LENGTH));
+    }
+    submit(session, SESSION_BOS_HEADER, bos_request(USB_DT_BOS_SIZE));
+    finish_transfer(session);
+}
+
+void session_detach_kernel_driver(FILE *out, libusb_device_handle *handle) {
+    if (libusb_kernel_driver_active(handle, 0) == 1) {
+        fprintf(out, "Kernel driver is active on interface 0, attempting to detach...\n");
+        int result = libusb_detach_kernel_driver(handle, 0);
+        if (result != 0 && result != LIBUSB_ERROR_NOT_FOUND) {
+            fprintf(out, COLOR_ORANGE "WARNING: Could not detach kernel driver: %s\n" COLOR_RESET,
+                    libusb_error_name(result));
+        }
+    }
+}
+
+static void render_string(FILE *out, const struct usb_session *session, const char *label,
+                          enum session_transfer slot) {
+    const struct control_transfer *xfer = &session->transfers[slot];
+    if (xfer->state != TRANSFER_DONE) {
+        return;
+    }
+    if (xfer->result >= 2) {
+        int length = xfer->data[0] < xfer->result ? xfer->data[0] : xfer->result;
+        fprintf(out, "%s: ", label);
+        render_utf16_ascii(out, &xfer->data[2], length - 2);
+        fprintf(out, "\n");
+    } else {
+        fprintf(out, "%s: (request failed: %s)\n", label, libusb_error_name(xfer->result));
+    }
+}
+
+static void render_device(FILE *out, const struct usb_session *session) {
+    const struct control_transfer *device = &session->transfers[SESSION_DEVICE];
+    const struct control_transfer *config = &session->transfers[SESSION_CONFIG];
+
+    fprintf(out, "=== Device ===\n");
+    if (device->result < USB_DT_DEVICE_SIZE) {
+        fprintf(out, "INFO: Device descriptor request failed (%d): %s\n\n",
+                device->result, libusb_error_name(device->result));
+        return;
+    }
+
+    const unsigned char *d = device->data;
+    uint16_t bcd_usb = get_le16(&d[2]);
+    fprintf(out, "bcdUSB: 0x%04x\n", bcd_usb);
+    fprintf(out, "bDeviceClass: 0x%02x\n", d[4]);
+    fprintf(out, "idVendor: 0x%04x\n", get_le16(&d[8]));
+    fprintf(out, "idProduct: 0x%04x\n", get_le16(&d[10]));
+    fprintf(out, "bcdDevice: 0x%04x\n", get_le16(&d[12]));
+    render_string(out, session, "Manufacturer", SESSION_MANUFACTURER);
+    render_string(out, session, "Product", SESSION_PRODUCT);
+    render_string(out, session, "Serial Number", SESSION_SERIAL);
+
+    if (config->result >= USB_DT_CONFIG_SIZE) {
+        fprintf(out, "Configuration %d: %d interface(s), wTotalLength %d\n",
+                config->data[5], config->data[4], get_le16(&config->data[2]));
+    }
+
+    // Hosts only ask USB 2.1+ devices for their BOS
+    if (bcd_usb < 0x0201) {
+        fprintf(out, COLOR_ORANGE "WARNING: bcdUSB 0x%04x is below 0x0201, hosts will not request the BOS descriptor\n"
+                COLOR_RESET, bcd_usb);
+    }
+    fprintf(out, "\n");
+}
+
+static void render_bos(FILE *out, const struct usb_session *session) {
+    const struct control_transfer *header = &session->transfers[SESSION_BOS_HEADER];
+    const struct control_transfer *bos = &session->transfers[SESSION_BOS];
+
+    fprintf(out, "=== Fetching BOS Descriptor ===\n");
+    if (header->result >= USB_DT_BOS_SIZE) {
+        fprintf(out, "BOS header reports wTotalLength=%d\n", get_le16(&header->data[2]));
+    }
+
+    if (session->bos_data) {
+        fprintf(out, "SUCCESS: BOS descriptor retrieved (%d bytes)\n\n", session->bos_length);
+
+        struct dump_annotation annotation = { bos_dump_field, &session->bos_view };
+        render_raw_data(out, "BOS", session->bos_data, session->bos_length,
+                        session->flags & SESSION_ANNOTATE_DUMPS ? &annotation : NULL);
+
+        render_bos_descriptor(out, &session->bos_view);
+    } else {
+        int result = bos->state == TRANSFER_DONE ? bos->result : header->result;
+        fprintf(out, "INFO: BOS descriptor request failed (%d): %s\n", result, libusb_error_name(result));
+        fprintf(out, "Device may not support BOS descriptors (USB 2.0 device?)\n\n");
+    }
+}
+
+static void render_webusb_url(FILE *out, const struct usb_session *session) {
+    const struct planned_request *request = find_planned_request(&session->plan, REQUEST_WEBUSB_URL);
+    const struct control_transfer *xfer = &session->transfers[SESSION_WEBUSB_URL];
+
+    if (!request) {
+        fprintf(out, "INFO: No WebUSB capability found in BOS descriptor\n\n");
+        return;
+    }
+
+    fprintf(out, "=== Fetching WebUSB URL ===\n");
+    fprintf(out, "Using WebUSB vendor code: 0x%02x\n", request->setup.bRequest);
+    fprintf(out, "Using landing page index: %d\n", request->setup.wValue);
+
+    if (xfer->result > 0) {
+        fprintf(out, "SUCCESS: WebUSB URL descriptor retrieved (%d bytes)\n\n", xfer->result);
+
+        struct dump_annotation annotation = { webusb_url_dump_field, &session->url_view };
+        render_raw_data(out, "WebUSB URL", xfer->data, xfer->result,
+                        session->flags & SESSION_ANNOTATE_DUMPS ? &annotation : NULL);
+
+        render_webusb_url_descriptor(out, &session->url_view);
+    } else {
+        fprintf(out, "INFO: WebUSB URL request failed (%d): %s\n", xfer->result, libusb_error_name(xfer->result));
+        if (xfer->result == LIBUSB_ERROR_PIPE) {
+            fprintf(out, "  This may indicate no landing page is configured\n");
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static void render_msos20(FILE *out, const struct usb_session *session) {
+    const struct planned_request *request = find_planned_request(&session->plan, REQUEST_MSOS20_SET);
+    const struct control_transfer *xfer = &session->transfers[SESSION_MSOS20];
+
+    if (!request) {
+        fprintf(out, "INFO: No MS OS 2.0 capability found in BOS descriptor, skipping MS OS 2.0 request\n\n");
+        return;
+    }
+
+    const struct control_request *setup = &request->setup;
+    int result = xfer->result;
+
+    fprintf(out, "=== Fetching MS OS 2.0 Descriptor ===\n");
+    fprintf(out, "Sending MS OS 2.0 descriptor request...\n");
+    fprintf(out, "  bmRequestType: 0x%02X (IN, VENDOR, DEVICE)\n", setup->bmRequestType);
+    fprintf(out, "  bRequest: 0x%02x (bMS_VendorCode)\n", setup->bRequest);
+    fprintf(out, "  wValue: 0x%04x\n", setup->wValue);
+    fprintf(out, "  wIndex: 0x%04x (MS_OS_20_DESCRIPTOR_INDEX)\n", setup->wIndex);
+    fprintf(out, "  wLength: %d (wMSOSDescriptorSetTotalLength)\n\n", setup->wLength);
+
+    if (result > 0) {
+        fprintf(out, "SUCCESS: MS OS 2.0 descriptor retrieved (%d bytes)\n\n", result);
+
+        // Validate minimum expected size
+        if (result < 10) {
+            fprintf(out, COLOR_ORANGE "WARNING: Descriptor very short (%d bytes), may be truncated\n" COLOR_RESET, result);
+        }
+
+        struct dump_annotation annotation = { msos20_dump_field, &session->msos20_view };
+        render_raw_data(out, "MS OS 2.0", xfer->data, result,
+                        session->flags & SESSION_ANNOTATE_DUMPS ? &annotation : NULL);
+
+        render_msos20_descriptor(out, &session->msos20_view);
+    } else if (result == 0) {
+        fprintf(out, COLOR_ORANGE "WARNING: Device returned 0 bytes (empty response)\n" COLOR_RESET);
+        fprintf(out, "This may indicate the device doesn't support MS OS 2.0 descriptors\n");
+    } else {
+        fprintf(out, COLOR_RED "ERROR: Failed to get MS OS 2.0 descriptor (%d): %s\n" COLOR_RESET,
+                result, libusb_error_name(result));
+
+        switch (result) {
+            case LIBUSB_ERROR_PIPE:
+                fprintf(out, "  Device returned STALL although the BOS advertises MS OS 2.0 descriptors\n");
+                fprintf(out, "  with vendor code 0x%02x\n", setup->bRequest);
+                break;
+            case LIBUSB_ERROR_TIMEOUT:
+                fprintf(out, "  Request timed out - device may be unresponsive\n");
+                break;
+            case LIBUSB_ERROR_NO_DEVICE:
+                fprintf(out, "  Device was disconnected during request\n");
+                break;
+            case LIBUSB_ERROR_ACCESS:
+                fprintf(out, "  Access denied - try running with sudo\n");
+                break;
+            case LIBUSB_ERROR_NOT_SUPPORTED:
+                fprintf(out, "  Control transfer not supported by device or host controller\n");
+                break;
+            default:
+                fprintf(out, "  Check device documentation for supported vendor requests\n");
+                break;
+        }
+    }
+}
+
+void session_render(FILE *out, const struct usb_session *session) {
+    int transfers = 0;
+    for (int i = 0; i < SESSION_TRANSFER_COUNT; i++) {
+        if (session->transfers[i].state != TRANSFER_IDLE) {
+            transfers++;
+        }
+    }
+
+    render_device(out, session);
+    render_bos(out, session);
+    render_webusb_url(out, session);
+    render_msos20(out, session);
+
+    fprintf(out, "Analysis finished: %d control transfers in %.1f ms\n", transfers,
+            (double)(session->end_ns - session->start_ns) / 1e6);
+}
+
+static void json_string_descriptor(struct json_writer *writer, const char *key, const struct usb_session *session,
+                                   enum session_transfer slot) {
+    const struct control_transfer *xfer = &session->transfers[slot];
+    if (xfer->state == TRANSFER_DONE && xfer->result >= 2) {
+        int length = xfer->data[0] < xfer->result ? xfer->data[0] : xfer->result;
+        json_utf16(writer, key, &xfer->data[2], length - 2);
+    }
+}
+
+static void json_device(struct json_writer *writer, const struct usb_session *session) {
+    const struct control_transfer *device = &session->transfers[SESSION_DEVICE];
+    const struct control_transfer *config = &session->transfers[SESSION_CONFIG];
+
+    if (device->result < USB_DT_DEVICE_SIZE) {
+        json_null(writer, "device");
+        return;
+    }
+
+    const unsigned char *d = device->data;
+    json_begin_object(writer, "device");
+    json_hex(writer, "raw", d, USB_DT_DEVICE_SIZE);
+    json_int(writer, "bcdUSB", get_le16(&d[2]));
+    json_int(writer, "bDeviceClass", d[4]);
+    json_int(writer, "idVendor", get_le16(&d[8]));
+    json_int(writer, "idProduct", get_le16(&d[10]));
+    json_int(writer, "bcdDevice", get_le16(&d[12]));
+    json_string_descriptor(writer, "manufacturer", session, SESSION_MANUFACTURER);
+    json_string_descriptor(writer, "product", session, SESSION_PRODUCT);
+    json_string_descriptor(writer, "serial", session, SESSION_SERIAL);
+    if (config->result >= USB_DT_CONFIG_SIZE) {
+        json_begin_object(writer, "configuration");
+        json_int(writer, "bConfigurationValue", config->data[5]);
+        json_int(writer, "bNumInterfaces", config->data[4]);
+        json_int(writer, "wTotalLength", get_le16(&config->data[2]));
+        json_end_object(writer);
+    }
+    json_end_object(writer);
+}
+
+void session_render_json(struct json_writer *writer, const struct usb_session *session) {
+    static const char * const transfer_names[SESSION_TRANSFER_COUNT] = {
+        [SESSION_DEVICE] = "device",
+        [SESSION_CONFIG] = "config",
+        [SESSION_LANGID] = "langid",
+        [SESSION_MANUFACTURER] = "manufacturer",
+        [SESSION_PRODUCT] = "product",
+        [SESSION_SERIAL] = "serial",
+        [SESSION_BOS_HEADER] = "bos_header",
+        [SESSION_BOS] = "bos",
+        [SESSION_WEBUSB_URL] = "webusb_url",
+        [SESSION_MSOS20] = "msos20",
+    };
+    int errors, warnings;
+
+    session_count_findings(session, &errors, &warnings);
+    json_string(writer, "status", session_status(session) == 0 ? "ok" : "failed");
+    json_int(writer, "errors", errors);
+    json_int(writer, "warnings", warnings);
+    json_double(writer, "elapsed_ms", (double)(session->end_ns - session->start_ns) / 1e6);
+
+    json_begin_array(writer, "transfers");
+    for (int i = 0; i < SESSION_TRANSFER_COUNT; i++) {
+        const struct control_transfer *xfer = &session->transfers[i];
+        if (xfer->state != TRANSFER_DONE) {
+            continue;
+        }
+        json_begin_object(writer, NULL);
+        json_string(writer, "request", transfer_names[i]);
+        json_int(writer, "bmRequestType", xfer->setup.bmRequestType);
+        json_int(writer, "bRequest", xfer->setup.bRequest);
+        json_int(writer, "wValue", xfer->setup.wValue);
+        json_int(writer, "wIndex", xfer->setup.wIndex);
+        json_int(writer, "wLength", xfer->setup.wLength);
+        json_int(writer, "result", xfer->result);
+        if (xfer->result < 0) {
+            json_string(writer, "error", libusb_error_name(xfer->result));
+        }
+        json_double(writer, "latency_ms", (double)(xfer->complete_ns - xfer->submit_ns) / 1e6);
+        json_end_object(writer);
+    }
+    json_end_array(writer);
+
+    json_device(writer, session);
+    if (session->bos_data) {
+        json_bos_descriptor(writer, "bos", &session->bos_view);
+    } else {
+        json_null(writer, "bos");
+    }
+    if (session->transfers[SESSION_WEBUSB_URL].result > 0) {
+        json_webusb_url_descriptor(writer, "webusb_url", &session->url_view);
+    } else {
+        json_null(writer, "webusb_url");
+    }
+    if (session->transfers[SESSION_MSOS20].result > 0) {
+        json_msos20_descriptor(writer, "msos20", &session->msos20_view);
+    } else {
+        json_null(writer, "msos20");
+    }
+
+    json_begin_array(writer, "findings");
+    json_findings(writer, "bos", &session->bos_view.findings);
+    json_findings(writer, "webusb_url", &session->url_view.findings);
+    json_findings(writer, "msos20", &session->msos20_view.findings);
+    json_end_array(writer);
+    json_int(writer, "findings_dropped", session->bos_view.findings.dropped + session->url_view.findings.dropped +
+             session->msos20_view.findings.dropped);
+}
+
+void session_count_findings(const struct usb_session *session, int *errors, int *warnings) {
+    const struct finding_list *lists[] = {
+        &session->bos_view.findings,
+        &session->url_view.findings,
+        &session->msos20_view.findings,
+    };
+
+    *errors = 0;
+    *warnings = 0;
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        *errors += lists[i]->error_count;
+        *warnings += lists[i]->warning_count;
+    }
+}
+
+int session_status(const struct usb_session *session) {
+    if (find_planned_request(&session->plan, REQUEST_MSOS20_SET)) {
+        return session->transfers[SESSION_MSOS20].result > 0 ? 0 : -1;
+    }
+    return session->bos_data ? 0 : -1;
+}
+
+// Failure class of an error finding, or of a Compatible ID warning that session_outcome fails on purpose
+static enum session_outcome rule_outcome(enum descriptor_rule rule) {
+    switch (rule) {
+        case RULE_BOS_TOO_SHORT:
+        case RULE_BOS_CAP_TRUNCATED:
+        case RULE_MSOS20_CAP_SET_LENGTH:
+            return OUTCOME_BOS_LENGTH;
+        case RULE_BOS_TYPE:
+            return OUTCOME_BOS_INVALID;
+        case RULE_URL_TOO_SHORT:
+            return OUTCOME_WEBUSB_URL_INVALID;
+        case RULE_MSOS20_TRUNCATED:
+        case RULE_MSOS20_ZERO_LENGTH:
+        case RULE_MSOS20_BAD_LENGTH:
+        case RULE_MSOS20_OVERRUN:
+        case RULE_MSOS20_SET_HEADER_SHORT:
+        case RULE_MSOS20_CONFIG_SHORT:
+        case RULE_MSOS20_CONFIG_OVERRUN:
+        case RULE_MSOS20_FUNCTION_SHORT:
+        case RULE_MSOS20_FUNCTION_OVERRUN:
+        case RULE_MSOS20_FUNCTION_UNDERRUN:
+        case RULE_MSOS20_REG_PROPERTY_SHORT:
+        case RULE_MSOS20_REG_PROPERTY_NAME_LENGTH:
+        case RULE_MSOS20_REG_PROPERTY_NAME_OVERRUN:
+        case RULE_MSOS20_REG_PROPERTY_DATA_LENGTH_OVERRUN:
+        case RULE_MSOS20_REG_PROPERTY_LENGTH:
+        case RULE_MSOS20_REG_PROPERTY_DATA_OVERRUN:
+        case RULE_MSOS20_COMPAT_ID_SHORT:
+            return OUTCOME_MSOS20_LENGTH;
+        case RULE_MSOS20_COMPAT_ID_NOT_WINUSB:
+        case RULE_MSOS20_COMPAT_ID_PADDING:
+            return OUTCOME_COMPAT_ID;
+        default:
+            return OUTCOME_MSOS20_INVALID;
+    }
+}
+
+// The first stored finding of a severity, or NULL
+static const struct finding *first_finding(const struct finding_list *findings, enum finding_severity severity) {
+    for (int i = 0; i < findings->count; i++) {
+        if (descriptor_rules[findings->items[i].rule].severity == severity) {
+            return &findings->items[i];
+        }
+    }
+    return NULL;
+}
+
+// Classify the first error of a descriptor; fallback covers errors that were counted but not stored
+static enum session_outcome error_outcome(const struct finding_list *findings, enum session_outcome fallback,
+                                          const char **detail) {
+    const struct finding *finding = first_finding(findings, SEVERITY_ERROR);
+    if (!finding) {
+        return fallback;
+    }
+    *detail = descriptor_rules[finding->rule].id;
+    return rule_outcome(finding->rule);
+}
+
+enum session_outcome session_outcome(const struct usb_session *session, const char **detail) {
+    const struct finding_list *bos = &session->bos_view.findings;
+    const struct finding_list *url = &session->url_view.findings;
+    const struct finding_list *msos20 = &session->msos20_view.findings;
+
+    *detail = NULL;
+    if (!session->bos_data) {
+        const struct control_transfer *header = &session->transfers[SESSION_BOS_HEADER];
+        const struct control_transfer *full = &session->transfers[SESSION_BOS];
+        int result = full->state == TRANSFER_DONE ? full->result : header->result;
+        if (result < 0) {
+            *detail = libusb_error_name(result);
+        }
+        return result >= 0 || result == LIBUSB_ERROR_PIPE ? OUTCOME_BOS_MISSING : OUTCOME_USB_ERROR;
+    }
+    if (bos->error_count > 0) {
+        return error_outcome(bos, OUTCOME_BOS_INVALID, detail);
+    }
+
+    const struct control_transfer *xfer = &session->transfers[SESSION_MSOS20];
+    if (find_planned_request(&session->plan, REQUEST_MSOS20_SET) && xfer->result <= 0) {
+        if (xfer->result < 0) {
+            *detail = libusb_error_name(xfer->result);
+        }
+        return xfer->result == LIBUSB_ERROR_PIPE ? OUTCOME_MSOS20_STALL : OUTCOME_MSOS20_FAILED;
+    }
+    if (url->error_count > 0) {
+        return error_outcome(url, OUTCOME_WEBUSB_URL_INVALID, detail);
+    }
+    if (msos20->error_count > 0) {
+        return error_outcome(msos20, OUTCOME_MSOS20_INVALID, detail);
+    }
+    // Windows matches all 8 bytes of the Compatible ID, so anything but a zero-padded WINUSB loads no driver
+    for (int i = 0; i < msos20->count; i++) {
+        enum descriptor_rule rule = msos20->items[i].rule;
+        if (descriptor_rules[rule].severity == SEVERITY_WARNING && rule_outcome(rule) == OUTCOME_COMPAT_ID) {
+            *detail = descriptor_rules[rule].id;
+            return OUTCOME_COMPAT_ID;
+        }
+    }
+
+    if (bos->warning_count + url->warning_count + msos20->warning_count > 0) {
+        const struct finding *finding = first_finding(bos, SEVERITY_WARNING);
+        if (!finding) {
+            finding = first_finding(url, SEVERITY_WARNING);
+        }
+        if (!finding) {
+            finding = first_finding(msos20, SEVERITY_WARNING);
+        }
+        *detail = finding ? descriptor_rules[finding->rule].id : NULL;
+        return OUTCOME_WARN;
+    }
+    return OUTCOME_PASS;
+}
+
+static const char *outcome_name(enum session_outcome outcome) {
+    switch (outcome) {
+        case OUTCOME_PASS:
+            return "pass";
+        case OUTCOME_WARN:
+            return "warn";
+        case OUTCOME_NO_DEVICE:
+            return "no-device";
+        case OUTCOME_USB_ERROR:
+            return "usb-error";
+        case OUTCOME_BOS_MISSING:
+            return "bos-missing";
+        case OUTCOME_BOS_LENGTH:
+            return "bos-length";
+        case OUTCOME_BOS_INVALID:
+            return "bos-invalid";
+        case OUTCOME_WEBUSB_URL_INVALID:
+            return "webusb-url-invalid";
+        case OUTCOME_MSOS20_STALL:
+            return "msos20-stall";
+        case OUTCOME_MSOS20_FAILED:
+            return "msos20-failed";
+        case OUTCOME_MSOS20_LENGTH:
+            return "msos20-length";
+        case OUTCOME_COMPAT_ID:
+            return "compat-id";
+        case OUTCOME_MSOS20_INVALID:
+            return "msos20-invalid";
+    }
+    return "unknown";
+}
+
+void session_print_outcome(FILE *out, const char *path, enum session_outcome outcome, const char *detail) {
+    if (path) {
+        fprintf(out, "%s ", path);
+    }
+    if (outcome == OUTCOME_PASS) {
+        fputs("PASS", out);
+    } else if (outcome == OUTCOME_WARN) {
+        fputs("WARN", out);
+    } else {
+        fprintf(out, "FAIL %s", outcome_name(outcome));
+    }
+    if (detail) {
+        fprintf(out, " %s", detail);
+    }
+    fputc('\n', out);
+}
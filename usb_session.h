@@ -0,0 +1,128 @@
+#ifndef USB_SESSION_H
+#define USB_SESSION_H
+
+#include <stdio.h>
+
+#include "arena.h"
+#include "json_writer.h"
+#include "request_plan.h"
+#include "usb_descriptors.h"
+#include "usb_engine.h"
+
+/*
+ * Analysis of one device
+ *
+ * A session issues every request it can right away (device, configuration,
+ * LANGID and BOS header descriptors) and chains the rest on completions:
+ * strings after the device descriptor and LANGID table, the full BOS after
+ * its header, and the planned WebUSB and MS OS 2.0 requests after the BOS
+ * has been parsed. When the last transfer completes, on_complete is called
+ * and the session can be rendered.
+ */
+
+enum session_transfer {
+    SESSION_DEVICE,
+    SESSION_CONFIG,
+    SESSION_LANGID,
+    SESSION_MANUFACTURER,
+    SESSION_PRODUCT,
+    SESSION_SERIAL,
+    SESSION_BOS_HEADER,
+    SESSION_BOS,
+    SESSION_WEBUSB_URL,
+    SESSION_MSOS20,
+    SESSION_TRANSFER_COUNT
+};
+
+// usb_session.flags
+#define SESSION_ANNOTATE_DUMPS  0x01    // Name the descriptor fields next to each row of the raw dumps
+#define SESSION_QUIET           0x02    // Verdict only: skip the requests that only feed the report
+#define SESSION_FAIL_FAST       0x04    // Stop parsing and requesting at the first error finding or failed request
+
+/*
+ * Outcome of a session for --quiet runs, which is also their exit code.
+ * A failure is classified by what went wrong first: a descriptor request
+ * that failed, or the category of the first error finding.
+ */
+enum session_outcome {
+    OUTCOME_PASS                = 0,
+    OUTCOME_WARN                = 1,    // Warnings only
+    OUTCOME_NO_DEVICE           = 10,   // Not found, or could not be opened
+    OUTCOME_USB_ERROR           = 11,   // Event handling or a BOS request failed other than by a STALL
+    OUTCOME_BOS_MISSING         = 20,   // BOS request stalled or returned nothing
+    OUTCOME_BOS_LENGTH          = 21,
+    OUTCOME_BOS_INVALID         = 22,
+    OUTCOME_WEBUSB_URL_INVALID  = 30,
+    OUTCOME_MSOS20_STALL        = 40,
+    OUTCOME_MSOS20_FAILED       = 41,   // Any other failure of the MS OS 2.0 request, or an empty response
+    OUTCOME_MSOS20_LENGTH       = 42,
+    OUTCOME_COMPAT_ID           = 43,
+    OUTCOME_MSOS20_INVALID      = 44,
+};
+
+struct usb_session;
+typedef void (*session_complete_cb)(struct usb_session *session);
+
+struct usb_session {
+    struct usb_engine *engine;
+    libusb_device_handle *handle;
+    struct arena arena;
+    struct control_transfer transfers[SESSION_TRANSFER_COUNT];
+    int pending;
+    uint64_t start_ns;
+    uint64_t end_ns;
+
+    const unsigned char *bos_data;      // Full BOS, or NULL if it could not be read
+    int bos_length;
+    struct request_plan plan;
+
+    struct bos_view bos_view;
+    struct webusb_url_view url_view;
+    struct msos20_view msos20_view;
+
+    int flags;                          // SESSION_*, set before the session is rendered
+    session_complete_cb on_complete;
+    void *user_data;
+};
+
+struct usb_session *session_create(struct usb_engine *engine, libusb_device_handle *handle);
+
+/*
+ * Make a finished session (nothing pending) ready for another device. Its
+ * arena is reset and keeps its memory, so a session of the same shape as
+ * the last one allocates nothing.
+ */
+void session_reset(struct usb_session *session, libusb_device_handle *handle);
+void session_destroy(struct usb_session *session);
+
+// Submit the first round of requests; completion is reported through on_complete
+void session_start(struct usb_session *session);
+
+// Detach a kernel driver bound to interface 0, reporting problems to out
+void session_detach_kernel_driver(FILE *out, libusb_device_handle *handle);
+
+void session_render(FILE *out, const struct usb_session *session);
+
+/*
+ * The members of an NDJSON device record: every transfer, the decoded
+ * descriptors with their raw bytes, and all findings. The caller opens the
+ * record, may add members of its own, and ends it.
+ */
+void session_render_json(struct json_writer *writer, const struct usb_session *session);
+
+/*
+ * Classify a finished session; *detail is set to the rule ID of the deciding
+ * finding or the libusb error of the failed request, or NULL.
+ */
+enum session_outcome session_outcome(const struct usb_session *session, const char **detail);
+
+// One line for --quiet runs: "[path ]PASS", "[path ]WARN rule" or "[path ]FAIL outcome[ detail]"
+void session_print_outcome(FILE *out, const char *path, enum session_outcome outcome, const char *detail);
+
+// Sum of the validation findings over every parsed descriptor
+void session_count_findings(const struct usb_session *session, int *errors, int *warnings);
+
+// 0 if the descriptors the tool is after were retrieved, -1 otherwise
+int session_status(const struct usb_session *session);
+
+#endif
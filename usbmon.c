@@ -0,0 +1,195 @@
+#include "usbmon.h"
+
+#include <string.h>
+
+static uint16_t host16(const uint8_t *p, int swapped) {
+    uint16_t value = get_le16(p);
+    return swapped ? (uint16_t)((value >> 8) | (value << 8)) : value;
+}
+
+static uint32_t host32(const uint8_t *p, int swapped) {
+    uint32_t value = get_le32(p);
+    if (swapped) {
+        value = (value >> 24) | ((value >> 8) & 0xFF00u) | ((value << 8) & 0xFF0000u) | (value << 24);
+    }
+    return value;
+}
+
+static uint64_t host64(const uint8_t *p, int swapped) {
+    uint64_t first = host32(p, swapped);
+    uint64_t second = host32(p + 4, swapped);
+    return swapped ? (first << 32) | second : (second << 32) | first;
+}
+
+int usbmon_decode(struct usbmon_event *event, const uint8_t *record, uint32_t length,
+                  int header_size, int swapped) {
+    if (length < (uint32_t)header_size) {
+        return -1;
+    }
+
+    event->id = host64(&record[0], swapped);
+    event->type = (char)record[8];
+    event->xfer_type = record[9];
+    event->endpoint = record[10];
+    event->devnum = record[11];
+    event->busnum = host16(&record[12], swapped);
+    event->has_setup = record[14] == 0;
+    event->ts_sec = (int64_t)host64(&record[16], swapped);
+    event->ts_usec = (int32_t)host32(&record[24], swapped);
+    event->status = (int32_t)host32(&record[28], swapped);
+    event->urb_length = host32(&record[32], swapped);
+
+    // The setup packet is in USB (little-endian) order regardless of the host
+    const uint8_t *setup = &record[40];
+    event->setup.bmRequestType = setup[0];
+    event->setup.bRequest = setup[1];
+    event->setup.wValue = get_le16(&setup[2]);
+    event->setup.wIndex = get_le16(&setup[4]);
+    event->setup.wLength = get_le16(&setup[6]);
+
+    uint32_t captured = host32(&record[36], swapped);
+    uint32_t available = length - header_size;
+    event->data = &record[header_size];
+    event->data_length = captured < available ? captured : available;
+    return 0;
+}
+
+void usbmon_matcher_init(struct usbmon_matcher *matcher) {
+    memset(matcher, 0, sizeof(*matcher));
+}
+
+static struct usbmon_device *find_device(struct usbmon_matcher *matcher, uint16_t busnum, uint8_t devnum) {
+    for (int i = 0; i < USBMON_MAX_DEVICES; i++) {
+        struct usbmon_device *device = &matcher->devices[i];
+        if (device->used && device->busnum == busnum && device->devnum == devnum) {
+            return device;
+        }
+    }
+    return NULL;
+}
+
+void usbmon_matcher_learn(struct usbmon_matcher *matcher, uint16_t busnum, uint8_t devnum,
+                          const struct bos_summary *summary) {
+    struct usbmon_device *device = find_device(matcher, busnum, devnum);
+    if (!device) {
+        device = &matcher->devices[matcher->next_device];
+        matcher->next_device = (matcher->next_device + 1) % USBMON_MAX_DEVICES;
+    }
+
+    device->busnum = busnum;
+    device->devnum = devnum;
+    device->used = 1;
+    device->has_webusb = summary->has_webusb != 0;
+    device->webusb_vendor_code = summary->webusb_vendor_code;
+    device->has_msos20 = summary->has_msos20 != 0;
+    device->msos20_vendor_code = summary->msos20_vendor_code;
+}
+
+// Classify a submission; -1 for requests the tool does not analyze
+static int classify_request(struct usbmon_matcher *matcher, const struct usbmon_event *event) {
+    const struct control_request *setup = &event->setup;
+
+    if (setup->bmRequestType == REQUEST_TYPE_STANDARD_IN && setup->bRequest == USB_REQUEST_GET_DESCRIPTOR &&
+        (setup->wValue >> 8) == USB_DT_BOS) {
+        return EXCHANGE_BOS;
+    }
+    if (setup->bmRequestType != REQUEST_TYPE_VENDOR_IN) {
+        return -1;
+    }
+
+    const struct usbmon_device *device = find_device(matcher, event->busnum, event->devnum);
+    if (setup->wIndex == MS_OS_20_DESCRIPTOR_INDEX &&
+        (!device || (device->has_msos20 && setup->bRequest == device->msos20_vendor_code))) {
+        return EXCHANGE_MSOS20;
+    }
+    if (setup->wIndex == WEBUSB_GET_URL &&
+        (!device || (device->has_webusb && setup->bRequest == device->webusb_vendor_code))) {
+        return EXCHANGE_WEBUSB_URL;
+    }
+    return -1;
+}
+
+static struct usbmon_pending *find_pending(struct usbmon_matcher *matcher, const struct usbmon_event *event) {
+    for (int i = 0; i < USBMON_MAX_OUTSTANDING; i++) {
+        struct usbmon_pending *pending = &matcher->pending[i];
+        if (pending->used && pending->id == event->id && pending->busnum == event->busnum) {
+            return pending;
+        }
+    }
+    return NULL;
+}
+
+int usbmon_matcher_feed(struct usbmon_matcher *matcher, const struct usbmon_event *event,
+                        struct usb_exchange *exchange) {
+    if (event->xfer_type != USBMON_XFER_CONTROL) {
+        return 0;
+    }
+
+    if (event->type == 'S') {
+        if (!event->has_setup) {
+            return 0;
+        }
+        int kind = classify_request(matcher, event);
+        if (kind < 0) {
+            return 0;
+        }
+
+        // A reused URB id means its completion was lost; the new submission replaces it
+        struct usbmon_pending *slot = find_pending(matcher, event);
+        for (int i = 0; !slot && i < USBMON_MAX_OUTSTANDING; i++) {
+            if (!matcher->pending[i].used) {
+                slot = &matcher->pending[i];
+            }
+        }
+        if (!slot) {
+            matcher->dropped++;
+            return 0;
+        }
+        if (!slot->used) {
+            matcher->outstanding++;
+        }
+
+        slot->id = event->id;
+        slot->busnum = event->busnum;
+        slot->devnum = event->devnum;
+        slot->used = 1;
+        slot->kind = (enum exchange_kind)kind;
+        slot->unverified = kind != EXCHANGE_BOS && !find_device(matcher, event->busnum, event->devnum);
+        slot->setup = event->setup;
+        return 0;
+    }
+
+    // Completion ('C') or submission error ('E')
+    struct usbmon_pending *pending = find_pending(matcher, event);
+    if (!pending) {
+        return 0;
+    }
+    pending->used = 0;
+    matcher->outstanding--;
+
+    exchange->kind = pending->kind;
+    exchange->busnum = pending->busnum;
+    exchange->devnum = pending->devnum;
+    exchange->setup = pending->setup;
+    exchange->status = event->status;
+    exchange->ts_sec = event->ts_sec;
+    exchange->ts_usec = event->ts_usec;
+    exchange->data = event->data;
+    exchange->length = event->type == 'C' ? event->data_length : 0;
+    exchange->unverified = pending->unverified;
+    matcher->matched++;
+    return 1;
+}
+
+const char *exchange_kind_name(enum exchange_kind kind) {
+    switch (kind) {
+        case EXCHANGE_BOS:
+            return "GET_DESCRIPTOR(BOS)";
+        case EXCHANGE_MSOS20:
+            return "MS OS 2.0 descriptor set";
+        case EXCHANGE_WEBUSB_URL:
+            return "WebUSB GET_URL";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef USBMON_H
+#define USBMON_H
+
+#include <stdint.h>
+
+#include "request_plan.h"
+#include "usb_descriptors.h"
+
+/*
+ * Linux usbmon events and control exchange matching
+ *
+ * usbmon reports every URB twice: a submission ('S') carrying the setup
+ * packet and a completion ('C') carrying the status and the IN data. The
+ * matcher keeps the submissions of the requests this tool understands and
+ * pairs them with their completions by URB id. Both of its tables are
+ * fixed-size, so memory use does not grow with the length of the trace.
+ */
+
+#define USBMON_HEADER_SIZE          48
+#define USBMON_MMAPPED_HEADER_SIZE  64
+
+#define USBMON_XFER_CONTROL         2
+
+#define USBMON_MAX_OUTSTANDING      64      // Tracked submissions without a completion yet
+#define USBMON_MAX_DEVICES          128     // Devices whose BOS vendor codes are remembered
+
+struct usbmon_event {
+    uint64_t id;                // URB tag, shared by submission and completion
+    char type;                  // 'S', 'C' or 'E'
+    uint8_t xfer_type;
+    uint8_t endpoint;           // Bit 7 set for IN
+    uint8_t devnum;
+    uint16_t busnum;
+    int has_setup;
+    int64_t ts_sec;
+    int32_t ts_usec;
+    int32_t status;             // 0 or a negative errno
+    uint32_t urb_length;
+    struct control_request setup;
+    const uint8_t *data;
+    uint32_t data_length;       // Bytes actually captured
+};
+
+/*
+ * Decode a usbmon record of header_size bytes (USBMON_HEADER_SIZE or
+ * USBMON_MMAPPED_HEADER_SIZE) plus data. The header is in the byte order of
+ * the capturing host; swapped says it differs from little-endian. Returns 0
+ * or -1 if the record is too short.
+ */
+int usbmon_decode(struct usbmon_event *event, const uint8_t *record, uint32_t length,
+                  int header_size, int swapped);
+
+enum exchange_kind {
+    EXCHANGE_BOS,
+    EXCHANGE_MSOS20,
+    EXCHANGE_WEBUSB_URL,
+    EXCHANGE_KIND_COUNT
+};
+
+// A request of interest together with its completion
+struct usb_exchange {
+    enum exchange_kind kind;
+    uint16_t busnum;
+    uint8_t devnum;
+    struct control_request setup;
+    int32_t status;
+    int64_t ts_sec;
+    int32_t ts_usec;
+    const uint8_t *data;        // Valid until the next event is fed
+    uint32_t length;
+    int unverified;             // Vendor request classified by wIndex alone, before the device's BOS was seen
+};
+
+struct usbmon_pending {
+    uint64_t id;
+    uint16_t busnum;
+    uint8_t devnum;
+    uint8_t used;
+    uint8_t unverified;
+    enum exchange_kind kind;
+    struct control_request setup;
+};
+
+struct usbmon_device {
+    uint16_t busnum;
+    uint8_t devnum;
+    uint8_t used;
+    uint8_t has_webusb;
+    uint8_t webusb_vendor_code;
+    uint8_t has_msos20;
+    uint8_t msos20_vendor_code;
+};
+
+struct usbmon_matcher {
+    struct usbmon_pending pending[USBMON_MAX_OUTSTANDING];
+    struct usbmon_device devices[USBMON_MAX_DEVICES];
+    int next_device;                // Round-robin replacement when the table is full
+    int outstanding;                // Tracked submissions awaiting completion
+    uint64_t dropped;               // Submissions not tracked because the table was full
+    uint64_t matched;
+};
+
+void usbmon_matcher_init(struct usbmon_matcher *matcher);
+
+// Returns 1 and fills exchange if event completes a tracked request, 0 otherwise
+int usbmon_matcher_feed(struct usbmon_matcher *matcher, const struct usbmon_event *event,
+                        struct usb_exchange *exchange);
+
+/*
+ * Remember the vendor codes from a device's BOS. Vendor requests of that
+ * device are then only classified if they use these codes; before its BOS
+ * has been seen they are classified by wIndex alone.
+ */
+void usbmon_matcher_learn(struct usbmon_matcher *matcher, uint16_t busnum, uint8_t devnum,
+                          const struct bos_summary *summary);
+
+const char *exchange_kind_name(enum exchange_kind kind);
+
+#endif
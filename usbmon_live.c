@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "usbmon_live.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "report.h"
+#include "trace_analysis.h"
+#include "usbmon.h"
+
+// Binary usbmon interface (Documentation/usb/usbmon.rst); the kernel exports no header for it
+struct mon_bin_stats {
+    uint32_t queued;
+    uint32_t dropped;
+};
+
+struct mon_bin_mfetch {
+    uint32_t *offvec;               // Offsets of the fetched events in the ring
+    uint32_t nfetch;                // In: room in offvec, out: events fetched
+    uint32_t nflush;                // In: events to release first, out: events released
+};
+
+#define MON_IOC_MAGIC       0x92
+#define MON_IOCG_STATS      _IOR(MON_IOC_MAGIC, 3, struct mon_bin_stats)
+#define MON_IOCT_RING_SIZE  _IO(MON_IOC_MAGIC, 4)
+#define MON_IOCQ_RING_SIZE  _IO(MON_IOC_MAGIC, 5)
+#define MON_IOCX_MFETCH     _IOWR(MON_IOC_MAGIC, 7, struct mon_bin_mfetch)
+
+#define MON_FILLER_EVENT    '@'     // Padding the kernel inserts before wrapping the ring
+
+// Findings of the current enumeration of one bus address
+struct live_device {
+    uint16_t busnum;
+    uint8_t devnum;
+    uint8_t used;
+    uint8_t seen_bos;               // A full BOS was analyzed; the next BOS request is a new enumeration
+    int exchanges;
+    int failed;
+    uint64_t errors;
+    uint64_t warnings;
+};
+
+struct live_state {
+    FILE *out;
+    struct trace_analyzer *analyzer;
+    struct live_device devices[USBMON_MAX_DEVICES];
+    int next_device;
+    int verdicts;
+    int failing;
+};
+
+static void print_verdict(struct live_state *state, struct live_device *device) {
+    if (device->used && device->exchanges > 0) {
+        const char *verdict = device->errors > 0 ? COLOR_RED "FAIL" COLOR_RESET :
+                              device->warnings > 0 || device->failed > 0 ? COLOR_ORANGE "WARN" COLOR_RESET : "PASS";
+        fprintf(state->out, "Verdict bus %d device %d: %s (%d exchanges, %d failed, %llu errors, %llu warnings)\n\n",
+                device->busnum, device->devnum, verdict, device->exchanges, device->failed,
+                (unsigned long long)device->errors, (unsigned long long)device->warnings);
+        state->verdicts++;
+        if (device->errors > 0) {
+            state->failing++;
+        }
+    }
+    memset(device, 0, sizeof(*device));
+}
+
+static struct live_device *find_device(struct live_state *state, uint16_t busnum, uint8_t devnum) {
+    for (int i = 0; i < USBMON_MAX_DEVICES; i++) {
+        struct live_device *device = &state->devices[i];
+        if (device->used && device->busnum == busnum && device->devnum == devnum) {
+            return device;
+        }
+    }
+
+    // A new address; when the table is full the oldest entry gets its verdict early
+    struct live_device *device = &state->devices[state->next_device];
+    state->next_device = (state->next_device + 1) % USBMON_MAX_DEVICES;
+    print_verdict(state, device);
+    device->busnum = busnum;
+    device->devnum = devnum;
+    device->used = 1;
+    return device;
+}
+
+static void analyze_exchange(struct live_state *state, const struct usb_exchange *exchange) {
+    struct trace_analyzer *analyzer = state->analyzer;
+    struct live_device *device = find_device(state, exchange->busnum, exchange->devnum);
+
+    // The host fetches the BOS again only when it enumerates the address again
+    if (exchange->kind == EXCHANGE_BOS && device->seen_bos) {
+        print_verdict(state, device);
+        device->busnum = exchange->busnum;
+        device->devnum = exchange->devnum;
+        device->used = 1;
+    }
+
+    int full_bos = exchange->kind == EXCHANGE_BOS && exchange->status == 0 &&
+                   exchange->setup.wLength > USB_DT_BOS_SIZE;
+    uint64_t errors = analyzer->errors;
+    uint64_t warnings = analyzer->warnings;
+    uint64_t failed = analyzer->failed;
+
+    trace_analyze_exchange(analyzer, exchange);
+    fflush(state->out);
+
+    if (full_bos || exchange->kind != EXCHANGE_BOS || exchange->status != 0) {
+        device->exchanges++;
+    }
+    device->seen_bos |= full_bos;
+    device->failed += (int)(analyzer->failed - failed);
+    device->errors += analyzer->errors - errors;
+    device->warnings += analyzer->warnings - warnings;
+}
+
+// Decode and feed one event from the ring
+static void feed_event(struct live_state *state, const uint8_t *ring, uint32_t ring_size, uint32_t offset,
+                       int swapped) {
+    struct usbmon_event event;
+    struct usb_exchange exchange;
+
+    if (offset > ring_size - USBMON_MMAPPED_HEADER_SIZE || ring[offset + 8] == MON_FILLER_EVENT) {
+        return;
+    }
+    if (usbmon_decode(&event, &ring[offset], ring_size - offset, USBMON_MMAPPED_HEADER_SIZE, swapped) != 0) {
+        return;
+    }
+    state->analyzer->events++;
+    if (usbmon_matcher_feed(&state->analyzer->matcher, &event, &exchange)) {
+        analyze_exchange(state, &exchange);
+    }
+}
+
+int usbmon_live_run(FILE *out, int bus, volatile sig_atomic_t *stop) {
+    char path[32];
+    struct live_state state;
+    uint32_t offsets[USBMON_LIVE_BATCH];
+    const uint16_t byte_order = 1;
+    int swapped = *(const uint8_t *)&byte_order == 0;   // Events are in host byte order
+    int result = 0;
+
+    snprintf(path, sizeof(path), "/dev/usbmon%d", bus);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf(COLOR_RED "ERROR: Cannot open %s: %s\n" COLOR_RESET, path, strerror(errno));
+        printf("Make sure:\n");
+        printf("- The usbmon module is loaded (modprobe usbmon)\n");
+        printf("- You have read access to %s (usually requires root)\n", path);
+        return -1;
+    }
+
+    // A larger ring rides out bursts; keep the default if the kernel refuses
+    ioctl(fd, MON_IOCT_RING_SIZE, USBMON_LIVE_RING_SIZE);
+    int ring_size = ioctl(fd, MON_IOCQ_RING_SIZE);
+    if (ring_size < USBMON_MMAPPED_HEADER_SIZE) {
+        printf(COLOR_RED "ERROR: Cannot query the usbmon ring size: %s\n" COLOR_RESET, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)ring_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        printf(COLOR_RED "ERROR: Cannot map the usbmon ring: %s\n" COLOR_RESET, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    const uint8_t *ring = map;
+
+    memset(&state, 0, sizeof(state));
+    state.out = out;
+    state.analyzer = trace_analyzer_create(out);
+    if (!state.analyzer) {
+        printf(COLOR_RED "ERROR: Out of memory\n" COLOR_RESET);
+        munmap(map, (size_t)ring_size);
+        close(fd);
+        return -1;
+    }
+
+    if (bus == 0) {
+        fprintf(out, "Listening passively on every bus (Ctrl+C to stop)\n\n");
+    } else {
+        fprintf(out, "Listening passively on bus %d (Ctrl+C to stop)\n\n", bus);
+    }
+    fflush(out);
+
+    // Events stay in the ring until the next fetch releases them
+    uint32_t to_release = 0;
+    while (!*stop) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, USBMON_LIVE_POLL_MS);
+        if (ready < 0 && errno != EINTR) {
+            printf(COLOR_RED "ERROR: Polling %s failed: %s\n" COLOR_RESET, path, strerror(errno));
+            result = -1;
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        struct mon_bin_mfetch fetch = { .offvec = offsets, .nfetch = USBMON_LIVE_BATCH, .nflush = to_release };
+        if (ioctl(fd, MON_IOCX_MFETCH, &fetch) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf(COLOR_RED "ERROR: Fetching events from %s failed: %s\n" COLOR_RESET, path, strerror(errno));
+            result = -1;
+            break;
+        }
+        for (uint32_t i = 0; i < fetch.nfetch; i++) {
+            feed_event(&state, ring, (uint32_t)ring_size, offsets[i], swapped);
+        }
+        to_release = fetch.nfetch;
+    }
+
+    for (int i = 0; i < USBMON_MAX_DEVICES; i++) {
+        print_verdict(&state, &state.devices[i]);
+    }
+
+    struct mon_bin_stats stats;
+    if (ioctl(fd, MON_IOCG_STATS, &stats) == 0 && stats.dropped > 0) {
+        fprintf(out, COLOR_ORANGE "WARNING: The kernel dropped %u events because the ring was full; "
+                "some exchanges may be missing\n" COLOR_RESET, stats.dropped);
+    }
+    fprintf(out, "Passive analysis: %d device verdict(s), %d failing\n", state.verdicts, state.failing);
+    if (trace_analyzer_finish(state.analyzer) != 0) {
+        result = -1;
+    }
+
+    trace_analyzer_destroy(state.analyzer);
+    munmap(map, (size_t)ring_size);
+    close(fd);
+    return result;
+}
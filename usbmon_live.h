@@ -0,0 +1,28 @@
+#ifndef USBMON_LIVE_H
+#define USBMON_LIVE_H
+
+#include <signal.h>
+#include <stdio.h>
+
+/*
+ * Passive live analysis through the binary usbmon interface
+ *
+ * /dev/usbmonN (N = 0 for every bus) is opened and its event ring is
+ * memory-mapped. Events are fetched from the ring in batches with
+ * MON_IOCX_MFETCH and released with the next fetch, so nothing is copied
+ * out of the kernel. The host's own BOS, MS OS 2.0 and WebUSB requests are
+ * analyzed as they complete; the tool never sends a transfer itself.
+ *
+ * A device's verdict is printed when its address is enumerated again (a new
+ * BOS request) and for every remaining device on exit. Needs read access to
+ * /dev/usbmonN, which usually means root and the usbmon module.
+ */
+
+#define USBMON_LIVE_RING_SIZE   (1200 * 1024)   // Largest ring the kernel allows
+#define USBMON_LIVE_BATCH       64              // Events fetched per MFETCH
+#define USBMON_LIVE_POLL_MS     1000            // How often the stop flag is checked when the bus is idle
+
+// Analyze until *stop is set; 0 if no descriptor had errors, -1 otherwise
+int usbmon_live_run(FILE *out, int bus, volatile sig_atomic_t *stop);
+
+#endif